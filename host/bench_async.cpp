@@ -0,0 +1,320 @@
+// Non-blocking command engine (uhf_async.h) against the blocking calls.
+//
+// The workload is the sketch's scan: one full inventory round, select the
+// strongest tag, read its TID. It runs in a loop() that also does some UI
+// work (--ui-us, emulated by advancing the virtual clock), once with the
+// blocking calls, once with UhfAsync jobs chained from their callbacks.
+// Reported per variant: scans per second and the longest loop() iteration,
+// i.e. how long a button press or a console line may wait. Then a write
+// sequence (PC -> EPC -> reselect -> read back) is checked on the emulator,
+// and a queued job is cancelled while another one runs, then the running job
+// itself, before and during its last step.
+// The gap between the two rates is the time a reply waits for the next
+// poll(), behind the UI work: both variants run again without UI work, and
+// the per-step wait is printed.
+// Exit status 1 if an async loop() iteration ever takes more than
+// --max-loop-ms, if async scans fall under 0.85x the blocking rate (0.98x
+// without UI work: the engine itself must not leave the module idle), if the
+// cancelled job is not reported CANCELLED or the running one loses its
+// tags or TID, if cancelling the running job during its last step does not
+// leave it OK, or if the write sequence does not leave the new EPC on the tag.
+//
+//   ./build/bench_async [--tags N] [--seconds S] [--ui-us US] [--max-loop-ms MS]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string>
+
+#include "universal_inventory.h"
+#include "uhf_async.h"
+#include "jrd4035_sim.h"
+
+struct BenchArgs {
+  size_t   tags;
+  double   seconds;
+  uint32_t ui_us;         // UI work per loop() iteration
+  uint32_t max_loop_ms;
+  BenchArgs() : tags(4), seconds(5.0), ui_us(2000), max_loop_ms(10) {}
+};
+
+struct RunResult {
+  uint32_t scans;          // TIDs read
+  uint32_t failed;
+  uint32_t loops;
+  uint64_t loop_max_us;
+  double   scans_per_s;
+};
+
+static void printRun(const char* name, const RunResult& r) {
+  printf("%-8s %5u scans %6.1f scans/s, %3u failed, %6u loop() calls, longest %6.2f ms\n",
+         name, r.scans, r.scans_per_s, r.failed, r.loops, r.loop_max_us / 1000.0);
+}
+
+static const RawTagData* strongest(const RawTagData* tags, uint8_t n) {
+  const RawTagData* best = nullptr;
+  for (uint8_t i = 0; i < n; i++) if (!best || tags[i].rssi_dbm > best->rssi_dbm) best = &tags[i];
+  return best;
+}
+
+static RunResult runBlocking(const BenchArgs& a) {
+  RunResult res;
+  memset(&res, 0, sizeof(res));
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  while (hostClockMicros() < t_end) {
+    const uint64_t l0 = hostClockMicros();
+    // The whole round, as the async inventory step reads it (rawInventoryWithRssi
+    // stops at the first frame)
+    RawTagData tags[UHF_ASYNC_MAX_TAGS];
+    uint8_t n = 0;
+    bool done = !uhfReader().beginInventory(200);
+    while (!done) n += uhfReader().pollRound(tags + n, uint8_t(UHF_ASYNC_MAX_TAGS - n), UHF_ROUND_GAP_MS, done);
+    const RawTagData* best = strongest(tags, n);
+    uint8_t tid[12];
+    if (best && uhfSelectEpc(best->epc_raw, best->epc_len) && uhfRead(0x02, 0, tid, sizeof(tid), 6) == 12) {
+      res.scans++;
+    } else {
+      res.failed++;
+    }
+    delayMicroseconds(a.ui_us);
+    res.loops++;
+    const uint64_t dt = hostClockMicros() - l0;
+    if (dt > res.loop_max_us) res.loop_max_us = dt;
+  }
+  res.scans_per_s = res.scans / (double(hostClockMicros() - t0) / 1e6);
+  return res;
+}
+
+// ---------- Async: scan -> callback -> select + read TID -> callback -> scan ----------
+
+struct AsyncScan {
+  UhfAsync* engine;
+  RunResult res;
+  bool      stopping;
+};
+
+static void onTid(const UhfAsyncResult& r, void* ctx);
+
+static void submitScan(AsyncScan& s, void (*fn)(const UhfAsyncResult&, void*)) {
+  UhfAsyncSeq seq;
+  seq.inventory();
+  s.engine->submit(seq, fn, &s);
+}
+
+static void onScan(const UhfAsyncResult& r, void* ctx) {
+  AsyncScan& s = *static_cast<AsyncScan*>(ctx);
+  const RawTagData* best = r.status == UHF_ASYNC_OK ? strongest(r.tags, r.tag_count) : nullptr;
+  if (!best) {
+    s.res.failed++;
+    if (!s.stopping) submitScan(s, onScan);
+    return;
+  }
+  UhfAsyncSeq seq;
+  seq.selectEpc(best->epc_raw, best->epc_len).read(0x02, 0, 6);
+  s.engine->submit(seq, onTid, &s);
+}
+
+static void onTid(const UhfAsyncResult& r, void* ctx) {
+  AsyncScan& s = *static_cast<AsyncScan*>(ctx);
+  if (r.status == UHF_ASYNC_OK && r.data_len == 12) s.res.scans++;
+  else                                              s.res.failed++;
+  if (!s.stopping) submitScan(s, onScan);
+}
+
+static RunResult runAsync(const BenchArgs& a, UhfAsync& engine) {
+  AsyncScan s;
+  memset(&s.res, 0, sizeof(s.res));
+  s.engine = &engine;
+  s.stopping = false;
+  engine.resetStats();
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  submitScan(s, onScan);
+  while (hostClockMicros() < t_end || engine.busy()) {
+    if (hostClockMicros() >= t_end) s.stopping = true;
+    const uint64_t l0 = hostClockMicros();
+    engine.poll();
+    delayMicroseconds(a.ui_us);
+    s.res.loops++;
+    const uint64_t dt = hostClockMicros() - l0;
+    if (dt > s.res.loop_max_us) s.res.loop_max_us = dt;
+  }
+  s.res.scans_per_s = s.res.scans / (double(hostClockMicros() - t0) / 1e6);
+  return s.res;
+}
+
+// ---------- Write sequence ----------
+
+struct WriteCheck {
+  bool     done;
+  uint8_t  status;
+  uint8_t  step;
+  uint8_t  data[EPC_MAX_BYTES];
+  uint8_t  len;
+};
+
+static void onWrite(const UhfAsyncResult& r, void* ctx) {
+  WriteCheck& w = *static_cast<WriteCheck*>(ctx);
+  w.done = true;
+  w.status = r.status;
+  w.step = r.steps_done;
+  w.len = r.data_len;
+  memcpy(w.data, r.data, r.data_len);
+}
+
+static bool checkWrite(Jrd4035Sim& sim, UhfAsync& engine) {
+  SimTag& tag = sim.tags()[0];
+  const uint8_t old_words = uint8_t(tag.pc >> 11);
+  uint8_t epc[12];
+  for (uint8_t i = 0; i < sizeof(epc); i++) epc[i] = uint8_t(0xE0 + i);
+  const uint16_t pc = uint16_t((sizeof(epc) / 2) << 11);
+
+  UhfAsyncSeq seq;
+  seq.selectEpc(tag.epc, size_t(old_words) * 2)
+     .writePc(pc)
+     .write(0x01, 2, epc, sizeof(epc))
+     .selectEpc(epc, sizeof(epc))
+     .read(0x01, 1, 1 + sizeof(epc) / 2);
+  WriteCheck w;
+  memset(&w, 0, sizeof(w));
+  const uint32_t sent0 = engine.stats().steps;
+  const uint64_t t0 = hostClockMicros();
+  if (!engine.submit(seq, onWrite, &w)) return false;
+  while (!w.done) engine.poll();
+  const bool ok = w.status == UHF_ASYNC_OK && w.len == 2 + sizeof(epc) &&
+                  w.data[0] == uint8_t(pc >> 8) && w.data[1] == uint8_t(pc) &&
+                  memcmp(w.data + 2, epc, sizeof(epc)) == 0 &&
+                  tag.pc == pc && memcmp(tag.epc, epc, sizeof(epc)) == 0;
+  printf("write    PC + %u-byte EPC, reselect, read back: %u steps in %.1f ms, %s (status %u, step %u)\n",
+         (unsigned)sizeof(epc), engine.stats().steps - sent0, (hostClockMicros() - t0) / 1000.0,
+         ok ? "verified" : "WRONG", w.status, w.step);
+  return ok;
+}
+
+// ---------- Cancelling a queued job while another one runs ----------
+
+struct DoneCheck {
+  bool           done;
+  UhfAsyncResult r;
+};
+
+static void onDone(const UhfAsyncResult& r, void* ctx) {
+  DoneCheck& d = *static_cast<DoneCheck*>(ctx);
+  d.done = true;
+  d.r = r;
+}
+
+static bool checkCancel(Jrd4035Sim& sim, UhfAsync& engine) {
+  const SimTag& tag = sim.tags()[0];
+  UhfAsyncSeq run;
+  run.inventory().selectEpc(tag.epc, size_t(tag.pc >> 11) * 2).read(0x02, 0, 6);
+  UhfAsyncSeq queued;
+  queued.inventory();
+  DoneCheck a, b;
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+  const uint16_t id_a = engine.submit(run, onDone, &a);
+  const uint16_t id_b = engine.submit(queued, onDone, &b);
+  // Cancel once the running job holds its inventory, before its read
+  const uint32_t sent0 = engine.stats().steps;
+  while (!a.done && engine.stats().steps - sent0 < 2) engine.poll();
+  const bool cancelled = engine.cancel(id_b);
+  const bool b_now = b.done;
+  while (!a.done) engine.poll();
+  const bool ok = id_a && id_b && cancelled && b_now && !engine.busy() &&
+                  b.r.id == id_b && b.r.status == UHF_ASYNC_CANCELLED &&
+                  a.r.id == id_a && a.r.status == UHF_ASYNC_OK && a.r.tag_count > 0 &&
+                  a.r.data_len == sizeof(tag.tid) && memcmp(a.r.data, tag.tid, sizeof(tag.tid)) == 0;
+  printf("cancel   queued job while one runs: queued %s, running %s (%u tags, %u TID bytes), %s\n",
+         b.r.status == UHF_ASYNC_CANCELLED ? "cancelled" : "NOT CANCELLED",
+         a.r.status == UHF_ASYNC_OK ? "done" : "FAILED", a.r.tag_count, a.r.data_len,
+         ok ? "intact" : "WRONG");
+  return ok;
+}
+
+// Cancels the running job once `sent` of its steps went out, reply pending
+static DoneCheck cancelRunningAfter(UhfAsync& engine, const UhfAsyncSeq& seq, uint32_t sent, bool& taken) {
+  DoneCheck d;
+  memset(&d, 0, sizeof(d));
+  const uint16_t id = engine.submit(seq, onDone, &d);
+  const uint32_t sent0 = engine.stats().steps;
+  while (!d.done && engine.stats().steps - sent0 < sent) engine.poll();
+  taken = id && !d.done && engine.cancel(id);
+  while (!d.done) engine.poll();
+  return d;
+}
+
+// Cancelling the running job stops it before its next step, but a job whose
+// last reply is in flight has run: it must complete OK, with its data
+static bool checkCancelRunning(Jrd4035Sim& sim, UhfAsync& engine) {
+  const SimTag& tag = sim.tags()[0];
+  UhfAsyncSeq run;
+  run.inventory().selectEpc(tag.epc, size_t(tag.pc >> 11) * 2).read(0x02, 0, 6);
+  bool mid_taken = false, last_taken = false;
+  const DoneCheck mid = cancelRunningAfter(engine, run, 2, mid_taken);
+  const DoneCheck last = cancelRunningAfter(engine, run, run.size(), last_taken);
+  const bool ok = mid_taken && mid.r.status == UHF_ASYNC_CANCELLED && mid.r.steps_done == 2 &&
+                  last_taken && last.r.status == UHF_ASYNC_OK && last.r.data_len == sizeof(tag.tid) &&
+                  memcmp(last.r.data, tag.tid, sizeof(tag.tid)) == 0 && !engine.busy();
+  printf("cancel   running job: before its last step %s (step %u), during it %s (%u TID bytes), %s\n",
+         mid.r.status == UHF_ASYNC_CANCELLED ? "cancelled" : "NOT CANCELLED", mid.r.steps_done,
+         last.r.status == UHF_ASYNC_OK ? "done" : "NOT DONE", last.r.data_len, ok ? "right" : "WRONG");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  BenchArgs a;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--tags" && i + 1 < argc)             a.tags = size_t(atol(argv[++i]));
+    else if (k == "--seconds" && i + 1 < argc)     a.seconds = atof(argv[++i]);
+    else if (k == "--ui-us" && i + 1 < argc)       a.ui_us = uint32_t(atol(argv[++i]));
+    else if (k == "--max-loop-ms" && i + 1 < argc) a.max_loop_ms = uint32_t(atol(argv[++i]));
+    else {
+      fprintf(stderr, "usage: %s [--tags N] [--seconds S] [--ui-us US] [--max-loop-ms MS]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (a.tags == 0) a.tags = 1;
+
+  SimConfig cfg;
+  Jrd4035Sim sim(cfg);
+  sim.addRandomTags(a.tags, 6);
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+  UhfAsync engine(uhfDefaultReader());
+
+  printf("%u tags, 115200 baud, %.0f s sim per run, %.1f ms of UI work per loop()\n",
+         (unsigned)a.tags, a.seconds, a.ui_us / 1000.0);
+  const RunResult blocking = runBlocking(a);
+  printRun("blocking", blocking);
+  const RunResult async = runAsync(a, engine);
+  printRun("async", async);
+  const UhfAsyncStats st = engine.stats();
+  printf("         %u jobs, %u steps, longest poll() %.2f ms\n", st.jobs, st.steps, st.poll_max_us / 1000.0);
+  const double ratio = blocking.scans_per_s > 0 ? async.scans_per_s / blocking.scans_per_s : 0;
+  printf("         x%.2f the blocking scan rate, longest loop() %.1fx shorter\n", ratio,
+         async.loop_max_us ? double(blocking.loop_max_us) / async.loop_max_us : 0.0);
+
+  // Where the gap goes: a reply that lands during the UI work waits for the
+  // next poll(). Without UI work the chained steps must keep the module as
+  // busy as the blocking calls do.
+  BenchArgs bare = a;
+  bare.ui_us = 0;
+  const RunResult bare_blocking = runBlocking(bare);
+  const RunResult bare_async = runAsync(bare, engine);
+  const double bare_ratio = bare_blocking.scans_per_s > 0 ? bare_async.scans_per_s / bare_blocking.scans_per_s : 0;
+  const double steps_per_scan = async.scans ? double(st.steps) / async.scans : 0;
+  const double lost_ms = blocking.scans_per_s > 0 && async.scans_per_s > 0
+                           ? 1000.0 / async.scans_per_s - 1000.0 / blocking.scans_per_s : 0;
+  printf("         no UI work: x%.2f; with it, %.2f ms lost per scan, %.2f ms per step waiting for poll()\n",
+         bare_ratio, lost_ms, steps_per_scan > 0 ? lost_ms / steps_per_scan : 0.0);
+
+  bool ok = async.loop_max_us <= uint64_t(a.max_loop_ms) * 1000 && ratio >= 0.85 && async.scans > 0 &&
+            bare_ratio >= 0.98;
+  ok &= checkCancel(sim, engine);
+  ok &= checkCancelRunning(sim, engine);
+  ok &= checkWrite(sim, engine);
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
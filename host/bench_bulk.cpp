@@ -0,0 +1,187 @@
+// Bulk memory transfers (uhf_bulk.h) on the emulator.
+//
+// Two tag models in the field: A takes 8-word writes and 32-word reads
+// with 512 bytes of user memory, B takes 4-word writes and 16-word reads
+// with 128 bytes. Runs, in simulated time:
+//   - 512 bytes to A with 1-word chunks (what works on any tag), then with
+//     learned chunks from 32 words, verified; then the same again, learned
+//   - 512 bytes read back from A
+//   - 128 bytes to B and back (a second model learned next to A)
+//   - 512 bytes to A, the tag taken away mid-transfer and brought back:
+//     TAG_LOST, then the same job resumes from the last confirmed word
+//   - a write past the end of B's user bank: END_OF_MEMORY at word 64
+// Exit status 1 if any data differs or a check fails, or if learned
+// writes are not at least 1.5x faster than 1-word ones.
+//
+//   ./build/bench_bulk [--bytes N] [--drop-after CHUNKS]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string>
+
+#include "universal_inventory.h"
+#include "uhf_bulk.h"
+#include "jrd4035_sim.h"
+
+struct BenchArgs {
+  uint16_t bytes;          // A transfers, even, up to 512
+  uint16_t drop_after;     // chunks before A goes away
+  BenchArgs() : bytes(512), drop_after(20) {}
+};
+
+static void fill(uint8_t* p, size_t n, uint32_t seed) {
+  for (size_t i = 0; i < n; i++) { seed = seed * 1103515245u + 12345u; p[i] = uint8_t(seed >> 16); }
+}
+
+static void printJob(const char* name, const UhfBulkJob& j) {
+  printf("%-26s %-13s %4u bytes %7.1f ms %6u B/s, %3u commands, %u shrinks, %u reselects, %u resumes, %u rewrites\n",
+         name, uhfBulkStatusName(j.status), j.done_words * 2, j.busy_us / 1000.0, j.bytesPerSecond(), j.commands,
+         j.shrinks, j.reselects, j.resumes, j.rewrites);
+}
+
+static const UhfBulkModel* findModel(const UhfBulk& bulk, const uint8_t* tid) {
+  const uint32_t id = (uint32_t(tid[0]) << 24) | (uint32_t(tid[1] & 0x1F) << 16) | (uint32_t(tid[2]) << 8) | tid[3];
+  for (uint8_t i = 0; i < UHF_BULK_MODELS; i++) if (bulk.models()[i].model == id) return &bulk.models()[i];
+  return nullptr;
+}
+
+struct Drop {
+  SimTag*  tag;
+  uint16_t after;
+  uint16_t chunks;
+  uint16_t done_at_drop;
+};
+
+static void onChunk(const UhfBulkJob& job, bool verify, void* ctx) {
+  Drop& d = *static_cast<Drop*>(ctx);
+  if (verify || ++d.chunks != d.after) return;
+  d.tag->present = false;              // carried out of the field
+  d.done_at_drop = job.done_words;
+}
+
+static bool check(bool ok, const char* what) {
+  if (!ok) printf("  FAILED: %s\n", what);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  BenchArgs a;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--bytes" && i + 1 < argc)           a.bytes = uint16_t(atol(argv[++i]));
+    else if (k == "--drop-after" && i + 1 < argc) a.drop_after = uint16_t(atol(argv[++i]));
+    else { fprintf(stderr, "usage: %s [--bytes N] [--drop-after CHUNKS]\n", argv[0]); return 2; }
+  }
+  a.bytes = uint16_t(min<uint16_t>(a.bytes, 512) & ~1u);
+  if (a.bytes < 2) a.bytes = 2;
+  const uint16_t words = a.bytes / 2;
+
+  SimConfig cfg;
+  Jrd4035Sim sim(cfg);
+  sim.addRandomTags(2, 6);
+  SimTag* A = &sim.tags()[0];
+  SimTag* B = &sim.tags()[1];
+  A->user_words = 256; A->max_write_words = 8; A->max_read_words = 32;
+  B->user_words = 64;  B->max_write_words = 4; B->max_read_words = 16;
+  B->tid[2] = 0x34; B->tid[3] = 0x12;   // another TMN
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+
+  printf("tag A: 8-word writes, 32-word reads, %u-byte user bank; tag B: 4 / 16 words, 128 bytes\n",
+         A->user_words * 2);
+  printf("%u-byte transfers, 115200 baud, %.1f ms per written word, sim time\n",
+         a.bytes, cfg.write_word_us / 1000.0);
+
+  static uint8_t src[512], dst[512];
+  bool ok = true;
+  UhfBulk bulk;
+  UhfBulkConfig bc;
+  UhfBulkJob job;
+
+  // 1-word chunks: no learning needed, one command per word
+  bc.max_write_words = 1;
+  bulk.setConfig(bc);
+  bulk.setTag(A->epc, 12);
+  fill(src, a.bytes, 1);
+  job.begin(0x03, 0, src, words);
+  bulk.write(job);
+  printJob("A write, 1-word chunks", job);
+  ok &= check(job.finished() && memcmp(A->user, src, a.bytes) == 0, "1-word write");
+  const uint32_t one_word_bps = job.bytesPerSecond();
+
+  // Learned: 32 -> 16 -> 8 on the first transfer, then 8 straight away
+  bulk.forgetModels();
+  bc.max_write_words = 32;
+  bulk.setConfig(bc);
+  bulk.setTag(A->epc, 12);
+  fill(src, a.bytes, 2);
+  job.begin(0x03, 0, src, words);
+  bulk.write(job);
+  printJob("A write, learning", job);
+  ok &= check(job.finished() && job.shrinks == 2 && memcmp(A->user, src, a.bytes) == 0, "learning write");
+
+  fill(src, a.bytes, 3);
+  job.begin(0x03, 0, src, words);
+  bulk.write(job);
+  printJob("A write, learned", job);
+  ok &= check(job.finished() && job.shrinks == 0 && memcmp(A->user, src, a.bytes) == 0, "learned write");
+  const uint32_t learned_bps = job.bytesPerSecond();
+
+  job.begin(0x03, 0, dst, words);
+  bulk.read(job);
+  printJob("A read", job);
+  ok &= check(job.finished() && memcmp(dst, src, a.bytes) == 0, "read");
+
+  // Second model, TID passed in (no TID read)
+  bulk.setTag(B->epc, 12, B->tid);
+  fill(src, 128, 4);
+  job.begin(0x03, 0, src, 64);
+  bulk.write(job);
+  printJob("B write, learning", job);
+  ok &= check(job.finished() && memcmp(B->user, src, 128) == 0, "B write");
+  job.begin(0x03, 0, dst, 64);
+  bulk.read(job);
+  printJob("B read, learning", job);
+  ok &= check(job.finished() && memcmp(dst, src, 128) == 0, "B read");
+  const UhfBulkModel* ma = findModel(bulk, A->tid);
+  const UhfBulkModel* mb = findModel(bulk, B->tid);
+  ok &= check(ma && ma->write_words == 8 && ma->read_words == 32, "model A learned 8 / 32");
+  ok &= check(mb && mb->write_words == 4 && mb->read_words == 16, "model B learned 4 / 16");
+
+  // Dropout: TAG_LOST, then resume where the tag left
+  Drop drop = { A, a.drop_after, 0, 0 };
+  bc.on_chunk = onChunk;
+  bc.on_chunk_ctx = &drop;
+  bulk.setConfig(bc);
+  bulk.setTag(A->epc, 12);
+  fill(src, a.bytes, 5);
+  job.begin(0x03, 0, src, words);
+  bulk.write(job);
+  printJob("A write, tag taken away", job);
+  const uint16_t lost_at = job.done_words;
+  ok &= check(job.status == UHF_BULK_TAG_LOST && lost_at == drop.done_at_drop && lost_at > 0,
+              "TAG_LOST at the last confirmed word");
+  A->present = true;                   // back on the antenna
+  bulk.write(job);
+  printJob("A write, resumed", job);
+  ok &= check(job.finished() && job.resumes == 1 && job.rewrites == 0 && memcmp(A->user, src, a.bytes) == 0,
+              "resumed write");
+  bc.on_chunk = nullptr;
+  bulk.setConfig(bc);
+
+  // Past the end of B's 64 words: stops there, B keeps its learned 4 words
+  bulk.setTag(B->epc, 12, B->tid);
+  fill(src, 160, 6);
+  job.begin(0x03, 0, src, 80);
+  bulk.write(job);
+  printJob("B write past the end", job);
+  ok &= check(job.status == UHF_BULK_END_OF_MEMORY && job.end_word == 64 && job.done_words == 64,
+              "END_OF_MEMORY at word 64");
+  ok &= check(mb && mb->write_words == 4, "model B still 4 words after the end of memory");
+
+  const double speedup = one_word_bps ? double(learned_bps) / one_word_bps : 0;
+  printf("learned writes x%.2f the 1-word rate: %u bytes per 1 s pass\n", speedup, learned_bps);
+  ok &= check(speedup >= 1.5, "learned writes at least 1.5x 1-word writes");
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// Distinct tag counting (uhf_count.h): accuracy and cost per read.
+//
+// Host CPU time (steady_clock), like bench_tag_table: the counter is pure
+// computation. First the distinct count for populations from 100 to 2M tags
+// with millions of reads each (exact below the cap, HyperLogLog above). Then
+// a dock door: tags pass in groups, some come back within the repeat
+// window, some after it; the Bloom filter's new / repeat verdict is checked
+// against the exact history. Exit status 1 if an exact count is off, an
+// estimate is off by more than 3 standard errors, a repeat within the
+// window is called new, or more than 1 % of first reads are called repeats.
+//
+//   ./build/bench_count [--reads N] [--seed S]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "uhf_count.h"
+
+static double nowNs() {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 96-bit EPC from a tag number: fixed company prefix, serial in the low bytes
+static void makeEpc(uint32_t serial, uint32_t salt, uint8_t epc[12]) {
+  epc[0] = 0xE2; epc[1] = 0x80; epc[2] = 0x11; epc[3] = 0x60;
+  epc[4] = uint8_t(salt >> 24); epc[5] = uint8_t(salt >> 16); epc[6] = uint8_t(salt >> 8); epc[7] = uint8_t(salt);
+  epc[8] = uint8_t(serial >> 24); epc[9] = uint8_t(serial >> 16); epc[10] = uint8_t(serial >> 8); epc[11] = uint8_t(serial);
+}
+
+static UhfUniqueCounter gCounter;
+
+static bool benchDistinct(uint32_t population, uint64_t reads, std::mt19937& rng) {
+  UhfCountConfig cfg = uhfCountDefaults();
+  cfg.interval_ms = 60000;
+  gCounter.setConfig(cfg);
+  gCounter.reset(0);
+  std::vector<bool> seen(population, false);
+  std::uniform_int_distribution<uint32_t> pick(0, population - 1);
+  const uint32_t salt = rng();
+  uint32_t truth = 0;
+
+  // Tags are drawn up front so the timed loop is the counter only
+  const size_t batch = 1 << 16;
+  std::vector<uint8_t> epcs(batch * 12);
+  double ns = 0;
+  uint32_t now = 0;
+  UhfCountInterval drop[8];
+  for (uint64_t done = 0; done < reads; done += batch) {
+    const size_t n = size_t(std::min<uint64_t>(batch, reads - done));
+    for (size_t i = 0; i < n; i++) {
+      const uint32_t t = pick(rng);
+      if (!seen[t]) { seen[t] = true; truth++; }
+      makeEpc(t, salt, &epcs[i * 12]);
+    }
+    const double t0 = nowNs();
+    for (size_t i = 0; i < n; i++) gCounter.add(&epcs[i * 12], 12, now++ / 256);
+    ns += nowNs() - t0;
+    while (gCounter.pollIntervals(drop, 8) > 0) {}
+  }
+
+  const uint32_t est = gCounter.distinct();
+  const double err = 100.0 * (double(est) - double(truth)) / double(truth);
+  const double sigma = 104.0 / sqrt(double(1u << UHF_COUNT_HLL_BITS));    // %
+  const bool ok = gCounter.exact() ? est == truth : fabs(err) <= 3 * sigma;
+  printf("%8u tags %9llu reads: %8u counted %8u true %+6.2f %%  %-5s %6.1f ns/read%s\n",
+         population, (unsigned long long)reads, est, truth, err, gCounter.exact() ? "exact" : "hll",
+         ns / double(reads), ok ? "" : "  <- off");
+  return ok;
+}
+
+// Dock door: a group of tags in the field for `dwell` ms, read every ~20 ms
+// each; the next group follows. Groups are drawn from a pool, so the same
+// tags come back at every gap: within the window or after it.
+static bool benchPortal(uint64_t reads, std::mt19937& rng) {
+  UhfCountConfig cfg = uhfCountDefaults();
+  cfg.repeat_window_ms = 30000;
+  cfg.interval_ms      = 60000;
+  gCounter.setConfig(cfg);
+  gCounter.reset(0);
+  const uint32_t pool = 20000, group = 40, dwell = 2000;
+  const uint32_t salt = rng();
+  std::unordered_map<uint32_t, uint32_t> last;      // tag -> last read (ms)
+  uint32_t now = 0;
+  uint64_t done = 0, firsts = 0, false_repeats = 0, within = 0, missed = 0, beyond = 0, beyond_new = 0;
+  uint8_t epc[12];
+  UhfCountInterval iv[8];
+  std::vector<UhfCountInterval> intervals;
+  // Regulars: a quarter of each group comes from a small set seen every minute
+  std::uniform_int_distribution<uint32_t> any(0, pool - 1), regular(0, 199);
+  std::vector<uint32_t> tags(group);
+  while (done < reads) {
+    for (uint32_t g = 0; g < group; g++) tags[g] = g < group / 4 ? regular(rng) : any(rng);
+    for (uint32_t t = 0; t < dwell && done < reads; t += 20, now += 20) {
+      for (uint32_t g = 0; g < group && done < reads; g++, done++) {
+        const uint32_t tag = tags[g];
+        makeEpc(tag, salt, epc);
+        const bool is_new = gCounter.add(epc, 12, now);
+        auto it = last.find(tag);
+        if (it == last.end()) {
+          firsts++;
+          if (!is_new) false_repeats++;
+          last[tag] = now;
+          continue;
+        }
+        const uint32_t gap = now - it->second;
+        it->second = now;
+        if (gap < cfg.repeat_window_ms) { within++; if (is_new) missed++; }
+        else if (gap >= 2 * cfg.repeat_window_ms) { beyond++; if (is_new) beyond_new++; }
+      }
+      uint8_t n;
+      while ((n = gCounter.pollIntervals(iv, 8)) > 0) intervals.insert(intervals.end(), iv, iv + n);
+    }
+    now += 500;                                      // gap between two pallets
+  }
+  const double fp = firsts ? 100.0 * double(false_repeats) / double(firsts) : 0;
+  printf("portal: %llu reads over %.1f min, %u distinct (true %u, %s), %u new by the filter\n",
+         (unsigned long long)done, now / 60000.0, gCounter.distinct(), (unsigned)last.size(),
+         gCounter.exact() ? "exact" : "hll", gCounter.stats().new_tags);
+  printf("        first reads called repeat %llu of %llu (%.2f %%), repeats in window called new %llu of %llu\n",
+         (unsigned long long)false_repeats, (unsigned long long)firsts, fp,
+         (unsigned long long)missed, (unsigned long long)within);
+  printf("        back after 2+ windows called new %llu of %llu, %u filter rotations\n",
+         (unsigned long long)beyond_new, (unsigned long long)beyond, gCounter.stats().rotations);
+  for (size_t i = 0; i < intervals.size() && i < 3; i++) {
+    const UhfCountInterval& v = intervals[i];
+    printf("        interval %u s: %u reads, %u new, %.0f reads/s, %u distinct so far\n",
+           v.start_ms / 1000, v.reads, v.new_tags, v.reads * 1000.0 / v.length_ms, v.distinct);
+  }
+  return missed == 0 && fp <= 1.0;
+}
+
+int main(int argc, char** argv) {
+  uint64_t reads = 4000000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--reads" && i + 1 < argc)     reads = strtoull(argv[++i], nullptr, 10);
+    else if (k == "--seed" && i + 1 < argc) seed = uint32_t(atol(argv[++i]));
+    else { fprintf(stderr, "usage: %s [--reads N] [--seed S]\n", argv[0]); return 2; }
+  }
+  std::mt19937 rng(seed);
+  printf("UhfUniqueCounter: %u bytes, exact up to %u, %u HLL registers, 2 x %u Bloom bits\n",
+         (unsigned)sizeof(UhfUniqueCounter), UHF_COUNT_EXACT_MAX, 1u << UHF_COUNT_HLL_BITS,
+         UHF_COUNT_BLOOM_BITS);
+  bool ok = true;
+  const uint32_t pops[] = {100, 1000, 1024, 1025, 5000, 50000, 500000, 2000000};
+  for (uint32_t p : pops) ok &= benchDistinct(p, std::max<uint64_t>(reads, uint64_t(p) * 3), rng);
+  ok &= benchPortal(reads, rng);
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+// Duty-cycled continuous inventory (uhf_duty.h): reads lost against radio-on
+// time and charge, per idle policy.
+//
+// A handheld or portal that mostly sees nothing: groups of 1-3 tags walk
+// past the antenna (one group every --gap-s on average, Poisson), each tag
+// in the field for 1 to 4 s. The same traffic is replayed, in simulated
+// time, under each policy: always on, the default backoff, backoff without
+// the SLEEP state, and configurations sized by uhfDutyForLatency(). The
+// loop is the pipeline's parse task, single-threaded: radioOn() decides
+// whether the 0x27 stream runs, every read goes to noteRead(), and a SLEEP
+// gap is skipped as the sketch's light sleep would.
+//
+// Per policy: radio-on share, tag visits missed, reads lost against always
+// on, latency from a tag entering the field to its first read, and the
+// charge drawn under a rough Core2 + JRD-4035 current model (below).
+// Exit status 1 if the default policy or the 300 ms one misses a visit,
+// exceeds its latency bound, or keeps the radio on longer than its windows
+// allow while idle (burst_ms out of every burst_ms + min_off_ms).
+//
+//   ./build/bench_duty [--minutes M] [--gap-s S] [--seed N]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "uhf_duty.h"
+#include "jrd4035_sim.h"
+
+struct BenchArgs {
+  double   minutes;
+  double   gap_s;          // mean time between two groups of tags
+  uint32_t seed;
+  BenchArgs() : minutes(60), gap_s(40), seed(7) {}
+};
+
+// Current model, mA: board with the CPU awake, display by state, module
+// with the carrier on / idle, board in light sleep (display off)
+static const uint32_t kBoardMa         = 45;
+static const uint32_t kDisplayMa[3]    = { 60, 15, 0 };
+static const uint32_t kRadioOnMa       = 180;
+static const uint32_t kRadioIdleMa     = 12;
+static const uint32_t kLightSleepMa    = 8;
+
+static const size_t   kPool = 24;        // distinct tags that may walk past
+
+struct Visit {
+  uint64_t at_us, until_us;
+  uint8_t  tag;
+  bool     read;
+};
+
+struct Policy {
+  const char*   name;
+  UhfDutyConfig cfg;
+  uint32_t      latency_ms;    // bound checked, 0 = none
+  bool          checked;
+};
+
+struct RunResult {
+  uint32_t     visits, missed, reads;
+  uint64_t     latency_total_ms;
+  uint32_t     latency_max_ms;
+  UhfDutyStats duty;
+};
+
+static std::vector<Visit> makeTraffic(const BenchArgs& a) {
+  std::mt19937 rng(a.seed);
+  std::exponential_distribution<double> gap(1.0 / a.gap_s);
+  std::uniform_real_distribution<double> dwell(1.0, 4.0);
+  std::uniform_int_distribution<int> group(1, 3), pick(0, int(kPool) - 1);
+  std::vector<Visit> v;
+  std::vector<uint64_t> busy_until(kPool, 0);
+  const uint64_t end_us = uint64_t(a.minutes * 60e6) - 10000000;   // every visit over before the end
+  for (double t = gap(rng); t * 1e6 < end_us; t += gap(rng)) {
+    const int n = group(rng);
+    for (int i = 0; i < n; i++) {
+      const uint8_t tag = uint8_t(pick(rng));
+      const uint64_t at = uint64_t(t * 1e6);
+      if (busy_until[tag] > at) continue;          // already walking past
+      Visit vi = { at, at + uint64_t(dwell(rng) * 1e6), tag, false };
+      busy_until[tag] = vi.until_us;
+      v.push_back(vi);
+    }
+  }
+  return v;
+}
+
+static uint32_t modelMa(uint8_t state, bool radio) {
+  return kBoardMa + kDisplayMa[state] + (radio ? kRadioOnMa : kRadioIdleMa);
+}
+
+static RunResult runPolicy(const BenchArgs& a, const Policy& p, std::vector<Visit> visits) {
+  SimConfig cfg;
+  Jrd4035Sim sim(cfg);
+  sim.addRandomTags(kPool, 6);
+  for (SimTag& t : sim.tags()) t.present = false;
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+
+  UhfDutyCycle duty;
+  duty.setConfig(p.cfg);
+  duty.reset(millis());
+
+  RunResult res;
+  memset(&res, 0, sizeof(res));
+  res.visits = uint32_t(visits.size());
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.minutes * 60e6);
+  std::vector<int> current(kPool, -1);           // visit in progress per tag
+  size_t next = 0;
+  bool streaming = false;
+  uint32_t last_rx = millis(), last_charge = millis();
+
+  while (hostClockMicros() < t_end) {
+    // Tags in / out of the field
+    const uint64_t now_us = hostClockMicros() - t0;
+    while (next < visits.size() && visits[next].at_us <= now_us) {
+      current[visits[next].tag] = int(next);
+      sim.tags()[visits[next].tag].present = true;
+      next++;
+    }
+    for (size_t i = 0; i < kPool; i++) {
+      if (current[i] >= 0 && visits[current[i]].until_us <= now_us) {
+        sim.tags()[i].present = false;
+        current[i] = -1;
+      }
+    }
+
+    // Parse task, as UhfPipeline::parseOnce() does it
+    const uint8_t state = duty.state();
+    if (!duty.radioOn(millis())) {
+      if (streaming) uhfStopMultiInventory();
+      streaming = false;
+      const uint32_t budget = duty.sleepBudgetMs(millis());
+      if (budget > 0) {                          // light sleep up to the next window
+        duty.addCharge(duty.state(), modelMa(duty.state(), false), millis() - last_charge);
+        delay(budget);
+        duty.noteSleep(budget);
+        duty.addCharge(duty.state(), kLightSleepMa, budget);
+        last_charge = millis();
+      } else {
+        delay(1);
+      }
+    } else {
+      if (!streaming) {
+        streaming = uhfStartMultiPoll(10000);
+        last_rx = millis();
+      }
+      RawTagData out[16];
+      const uint8_t n = uhfPollInventory(out, 16);
+      const uint32_t now = millis();
+      if (n > 0) last_rx = now;
+      else if (now - last_rx > 2000) { uhfStartMultiPoll(10000); last_rx = now; }
+      for (uint8_t i = 0; i < n; i++) {
+        duty.noteRead(now);
+        res.reads++;
+        for (size_t k = 0; k < kPool; k++) {
+          if (current[k] < 0 || memcmp(out[i].epc_raw, sim.tags()[k].epc, 12) != 0) continue;
+          Visit& v = visits[current[k]];
+          if (!v.read) {
+            v.read = true;
+            const uint32_t lat = uint32_t((hostClockMicros() - t0 - v.at_us) / 1000);
+            res.latency_total_ms += lat;
+            res.latency_max_ms = max(res.latency_max_ms, lat);
+          }
+        }
+      }
+    }
+    const uint32_t now = millis();
+    if (now != last_charge) {
+      duty.addCharge(state, modelMa(state, duty.radio()), now - last_charge);
+      last_charge = now;
+    }
+  }
+  if (streaming) uhfStopMultiInventory();
+  duty.radioOn(millis());                        // account the tail
+  for (const Visit& v : visits) if (!v.read) res.missed++;
+  res.duty = duty.stats();
+  return res;
+}
+
+static void printRun(const Policy& p, const RunResult& r, const RunResult& base) {
+  const UhfDutyStats& d = r.duty;
+  const double total = d.totalMs() ? double(d.totalMs()) : 1.0;
+  const double lost = base.reads ? 100.0 * (double(base.reads) - r.reads) / base.reads : 0;
+  const double avg_ma = double(d.totalChargeMams()) / total;
+  printf("%-14s radio %5.1f%%, %3u/%u visits missed, %7u reads (%5.1f%% lost), latency avg %4u max %5u ms, "
+         "%5.1f mA avg, %6.2f mAs/read\n",
+         p.name, 100.0 * d.radioMs() / total, r.missed, r.visits, r.reads, lost,
+         (unsigned)(r.visits > r.missed ? r.latency_total_ms / (r.visits - r.missed) : 0), r.latency_max_ms,
+         avg_ma, r.reads ? d.totalChargeMams() / 1000.0 / r.reads : 0.0);
+  printf("%14s time active/backoff/sleep %4.1f/%4.1f/%4.1f%%, %u windows, %u wakeups (read %u ms max into a window), "
+         "%u light sleeps (%4.1f%%)\n", "",
+         100.0 * d.ms[UHF_DUTY_ACTIVE] / total, 100.0 * d.ms[UHF_DUTY_BACKOFF] / total,
+         100.0 * d.ms[UHF_DUTY_SLEEP] / total, d.windows, d.wakeups, d.window_read_max_ms, d.sleeps,
+         100.0 * d.slept_ms / total);
+}
+
+int main(int argc, char** argv) {
+  BenchArgs a;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--minutes" && i + 1 < argc)    a.minutes = atof(argv[++i]);
+    else if (k == "--gap-s" && i + 1 < argc) a.gap_s = atof(argv[++i]);
+    else if (k == "--seed" && i + 1 < argc)  a.seed = uint32_t(atol(argv[++i]));
+    else { fprintf(stderr, "usage: %s [--minutes M] [--gap-s S] [--seed N]\n", argv[0]); return 2; }
+  }
+  if (a.minutes < 1) a.minutes = 1;
+  if (a.gap_s <= 0) a.gap_s = 1;
+
+  const std::vector<Visit> traffic = makeTraffic(a);
+  UhfDutyConfig off;
+  off.enabled = false;
+  UhfDutyConfig no_sleep;
+  no_sleep.sleep_after_ms = 0xFFFFFFFFu;
+  const UhfDutyConfig def;
+  const Policy policies[] = {
+    { "always on",    off,                          0,                                     false },
+    { "default",      def,                          def.max_off_ms + UHF_DUTY_FIRST_READ_MS, true },
+    { "no sleep",     no_sleep,                     0,                                     false },
+    { "latency 300",  uhfDutyForLatency(300),       300,                                   true },
+    { "latency 2000", uhfDutyForLatency(2000),      2000,                                  false },
+  };
+
+  printf("%.0f min, %u tag visits of 1-4 s, a group every %.0f s on average, sim time\n",
+         a.minutes, (unsigned)traffic.size(), a.gap_s);
+  bool ok = true;
+  RunResult base;
+  memset(&base, 0, sizeof(base));
+  for (const Policy& p : policies) {
+    const RunResult r = runPolicy(a, p, traffic);
+    if (!p.cfg.enabled) base = r;
+    printRun(p, r, base);
+    if (!p.checked) continue;
+    const UhfDutyStats& d = r.duty;
+    const uint64_t idle_ms = uint64_t(d.ms[UHF_DUTY_BACKOFF]) + d.ms[UHF_DUTY_SLEEP];
+    const uint64_t idle_radio_ms = uint64_t(d.radio_ms[UHF_DUTY_BACKOFF]) + d.radio_ms[UHF_DUTY_SLEEP];
+    const bool pass = r.missed == 0 && r.latency_max_ms <= p.latency_ms &&
+                      idle_radio_ms * (p.cfg.burst_ms + p.cfg.min_off_ms) <= idle_ms * p.cfg.burst_ms;
+    if (!pass) printf("%14s FAILED: missed visits, latency over %u ms or radio on too long\n", "", p.latency_ms);
+    ok &= pass;
+  }
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
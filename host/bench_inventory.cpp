@@ -0,0 +1,509 @@
+// Inventory / write+verify throughput benchmark against the JRD-4035 emulator.
+//
+// Runs the real protocol core (universal_inventory.*) over the simulated
+// UART and reports rates in simulated time, so numbers reflect protocol
+// round trips, fixed sleeps and link speed rather than host CPU speed.
+// The last scenario runs the encoder on a station with neighbours in range,
+// at fixed output powers and with the power policy (uhf_power.h). The
+// flicker scenarios show how many TID reads the EPC -> TID cache avoids for
+// tags that keep leaving and re-entering the field, including after a reboot
+// that restored the cache image.
+//
+//   ./build/bench_inventory [--tags N] [--epc-words W] [--seconds S]
+//                           [--latency-us U] [--noise P] [--miss P]
+//                           [--reject-single-poll] [--burst N]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <set>
+#include <string>
+#include <random>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "uhf_tag_table.h"
+#include "uhf_tid_queue.h"
+#include "uhf_tid_cache.h"
+#include "uhf_encoder.h"
+#include "uhf_power.h"
+#include "jrd4035_sim.h"
+
+struct BenchArgs {
+  size_t   tags;
+  uint8_t  epc_words;
+  double   seconds;
+  size_t   burst;       // new tags appearing every 2 s in the enrichment scenario
+  SimConfig sim;
+  BenchArgs() : tags(8), epc_words(6), seconds(10.0), burst(20) {}
+};
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--tags N] [--epc-words W] [--seconds S] [--latency-us U]\n"
+          "          [--noise P] [--miss P] [--reject-single-poll] [--burst N]\n", argv0);
+  exit(2);
+}
+
+static BenchArgs parseArgs(int argc, char** argv) {
+  BenchArgs a;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    const bool has_val = i + 1 < argc;
+    if (k == "--tags" && has_val)            a.tags = size_t(atol(argv[++i]));
+    else if (k == "--epc-words" && has_val)  a.epc_words = uint8_t(atoi(argv[++i]));
+    else if (k == "--seconds" && has_val)    a.seconds = atof(argv[++i]);
+    else if (k == "--latency-us" && has_val) a.sim.cmd_latency_us = uint32_t(atol(argv[++i]));
+    else if (k == "--noise" && has_val)      a.sim.noise_flip = atof(argv[++i]);
+    else if (k == "--miss" && has_val)       a.sim.read_miss = atof(argv[++i]);
+    else if (k == "--reject-single-poll")    a.sim.reject_single_poll = true;
+    else if (k == "--burst" && has_val)      a.burst = size_t(atol(argv[++i]));
+    else usage(argv[0]);
+  }
+  return a;
+}
+
+static double simSeconds(uint64_t us) { return double(us) / 1e6; }
+
+// ---------- Single-poll loop (0x22 request/response per round) ----------
+static void benchInventory(const BenchArgs& a) {
+  Jrd4035Sim sim(a.sim);
+  sim.addRandomTags(a.tags, a.epc_words);
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+
+  RawTagData out[16];
+  std::set<std::string> unique;
+  uint32_t rounds = 0, reads = 0;
+  uhfResetInventoryAllocStats();
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  while (hostClockMicros() < t_end) {
+    uint8_t n = rawInventoryWithRssi(out, 16);
+    rounds++;
+    reads += n;
+    for (uint8_t i = 0; i < n; i++) unique.insert(std::string((const char*)out[i].epc_raw, out[i].epc_len));
+  }
+  const double s = simSeconds(hostClockMicros() - t0);
+  printf("inventory 0x22: %u rounds, %u tag reads, %u/%u unique in %.2f s sim\n",
+         rounds, reads, (unsigned)unique.size(), (unsigned)a.tags, s);
+  printf("                %.1f inventories/s, %.1f tags/s\n", rounds / s, reads / s);
+  printf("                link: %u frames, %u bytes, %u bad requests\n",
+         sim.stats().frames_out, sim.stats().bytes_out, sim.stats().bad_frames_in);
+  printf("                heap: %u allocations in %u inventory calls\n",
+         uhfInventoryAllocStats().allocs, uhfInventoryAllocStats().rounds);
+  const UhfDecoderStats& rx = uhfRxStats();
+  printf("                rx: %u frames, %u bad checksum, %u bad trailer, %u resync bytes, %u discarded\n",
+         rx.frames, rx.bad_checksum, rx.bad_trailer, rx.resync_bytes, rx.discarded);
+  uhfAttachTransport(nullptr);
+}
+
+// ---------- Streaming loop (what processContinuousScan does: one 0x27, drain) ----------
+static void benchStream(const BenchArgs& a) {
+  Jrd4035Sim sim(a.sim);
+  sim.addRandomTags(a.tags, a.epc_words);
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+
+  RawTagData out[16];
+  std::set<std::string> unique;
+  uint32_t reads = 0;
+  uhfResetInventoryAllocStats();
+  const uint32_t rounds0 = sim.stats().rounds;
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  uint64_t last_rx = t0;
+  uhfStartMultiPoll(10000);
+  while (hostClockMicros() < t_end) {
+    uint8_t n = uhfPollInventory(out, 16);
+    if (n == 0) {
+      if (hostClockMicros() - last_rx > 2000000) { uhfStartMultiPoll(10000); last_rx = hostClockMicros(); }
+      continue;
+    }
+    last_rx = hostClockMicros();
+    reads += n;
+    for (uint8_t i = 0; i < n; i++) unique.insert(std::string((const char*)out[i].epc_raw, out[i].epc_len));
+  }
+  uhfStopMultiInventory();
+  const double s = simSeconds(hostClockMicros() - t0);
+  const uint32_t rounds = sim.stats().rounds - rounds0;
+  const UhfAllocStats& as = uhfInventoryAllocStats();
+  printf("stream 0x27   : %u rounds, %u tag reads, %u/%u unique in %.2f s sim\n",
+         rounds, reads, (unsigned)unique.size(), (unsigned)a.tags, s);
+  printf("                %.1f inventories/s, %.1f tags/s\n", rounds / s, reads / s);
+  printf("                heap: %u allocations in %u inventory calls\n", as.allocs, as.rounds);
+  uhfAttachTransport(nullptr);
+}
+
+// ---------- Stream with new-tag bursts and TID enrichment (processContinuousScan) ----------
+static UhfTagTable<UHF_TAG_TABLE_CAPACITY> gTable;
+static bool benchReadTid(uint8_t tid[8]) { return uhfRead(0x02, 0, tid, 8, 4) == 8; }
+
+static void benchEnrich(const BenchArgs& a, bool deferred) {
+  static UhfTidQueue<UHF_TAG_TABLE_CAPACITY> queue(gTable, benchReadTid);
+  const uint64_t burst_every_us = 2000000;
+  const size_t bursts = size_t(a.seconds * 1e6 / burst_every_us);
+  Jrd4035Sim sim(a.sim);
+  sim.addRandomTags(a.tags + bursts * a.burst, a.epc_words);
+  for (size_t i = a.tags; i < sim.tags().size(); i++) sim.tags()[i].present = false;
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+  gTable.clear();
+  queue.clear();
+  queue.resetStats();
+
+  RawTagData out[16];
+  uint32_t reads = 0, tids = 0;
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  uint64_t last_rx = t0, max_gap = 0;
+  size_t shown = a.tags;
+  uhfStartMultiPoll(10000);
+  while (hostClockMicros() < t_end) {
+    // Next burst walks into the field
+    const size_t due = a.tags + size_t((hostClockMicros() - t0) / burst_every_us) * a.burst;
+    for (; shown < due && shown < sim.tags().size(); shown++) sim.tags()[shown].present = true;
+
+    uint8_t n = uhfPollInventory(out, 16);
+    const uint64_t now_us = hostClockMicros();
+    if (n > 0) {
+      if (now_us - last_rx > max_gap) max_gap = now_us - last_rx;
+      last_rx = now_us;
+    } else if (now_us - last_rx > 2000000) {
+      uhfStartMultiPoll(10000);
+      last_rx = now_us;
+    }
+    reads += n;
+
+    bool stopped = false;
+    for (uint8_t i = 0; i < n; i++) {
+      bool is_new = false;
+      const uint16_t slot = gTable.upsert(out[i].epc_raw, out[i].epc_len, millis(), &is_new);
+      gTable.at(slot).rssi = int16_t(out[i].rssi_dbm);
+      if (!is_new) continue;
+      if (deferred) { queue.push(slot, millis()); continue; }
+      // Previous behaviour: select + read right away
+      if (!stopped) { uhfStopMultiInventory(); stopped = true; }
+      UhfTagEntry& e = gTable.at(slot);
+      if (uhfSelectEpc(e.epc, e.epc_len) && benchReadTid(e.tid)) e.has_tid = true;
+    }
+    if (deferred && queue.service(millis()) > 0) stopped = true;
+    if (stopped) uhfStartMultiPoll(10000);
+  }
+  uhfStopMultiInventory();
+  for (uint16_t i = 0; i < gTable.capacity(); i++)
+    if (gTable.used(i) && gTable.at(i).has_tid) tids++;
+
+  const double s = simSeconds(hostClockMicros() - t0);
+  printf("%s: %u tag reads, %u tags, %u with TID in %.2f s sim\n",
+         deferred ? "enrich queued " : "enrich inline ", reads, gTable.size(), tids, s);
+  printf("                %.1f tags/s, longest stream gap %.0f ms\n", reads / s, max_gap / 1000.0);
+  if (deferred) {
+    const UhfTidQueueStats& q = queue.stats();
+    const uint32_t done = q.served + q.failed;
+    printf("                queue: depth max %u, wait avg %u ms max %u ms, %u batches (longest %u ms), %u dropped\n",
+           q.max_depth, done ? q.wait_total_ms / done : 0, q.wait_max_ms, q.batches,
+           q.batch_max_ms, q.dropped);
+  }
+  uhfAttachTransport(nullptr);
+}
+
+// ---------- Tags flickering at the edge of the field, TID cache (uhf_tid_cache.h) ----------
+// Each tag is in range 500 ms out of 1200 ms: gone long enough to expire
+// from the table (500 ms), so every return is a new tag for the TID queue.
+static void benchFlicker(const BenchArgs& a, UhfTidCache* cache, const char* label) {
+  static UhfTidQueue<UHF_TAG_TABLE_CAPACITY> queue(gTable, benchReadTid);
+  const uint32_t period_ms = 1200, on_ms = 500, expiry_ms = 500;
+  const size_t count = a.tags + a.burst;
+  Jrd4035Sim sim(a.sim);
+  sim.addRandomTags(count, a.epc_words);
+  std::vector<uint32_t> phase(count);
+  for (size_t i = 0; i < count; i++) phase[i] = uint32_t(i * period_ms / count);
+  uhfAttachTransport(&sim);
+  uhfStopMultiInventory();
+  gTable.clear();
+  queue.clear();
+  queue.resetStats();
+  queue.setCache(cache);
+  if (cache) cache->resetStats();
+
+  RawTagData out[16];
+  uint32_t reads = 0, arrivals = 0;
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  uint64_t last_rx = t0, max_gap = 0;
+  uhfStartMultiPoll(10000);
+  while (hostClockMicros() < t_end) {
+    const uint32_t t_ms = uint32_t((hostClockMicros() - t0) / 1000);
+    for (size_t i = 0; i < count; i++) sim.tags()[i].present = (t_ms + phase[i]) % period_ms < on_ms;
+
+    uint8_t n = uhfPollInventory(out, 16);
+    const uint64_t now_us = hostClockMicros();
+    if (n > 0) {
+      if (now_us - last_rx > max_gap) max_gap = now_us - last_rx;
+      last_rx = now_us;
+    } else if (now_us - last_rx > 2000000) {
+      uhfStartMultiPoll(10000);
+      last_rx = now_us;
+    }
+    reads += n;
+    for (uint8_t i = 0; i < n; i++) {
+      bool is_new = false;
+      const uint16_t slot = gTable.upsert(out[i].epc_raw, out[i].epc_len, millis(), &is_new);
+      gTable.at(slot).rssi = int16_t(out[i].rssi_dbm);
+      if (is_new) { arrivals++; queue.push(slot, millis()); }
+    }
+    gTable.expire(millis(), expiry_ms);
+    if (queue.service(millis()) > 0) uhfStartMultiPoll(10000);
+  }
+  uhfStopMultiInventory();
+
+  const double s = simSeconds(hostClockMicros() - t0);
+  const UhfTidQueueStats& q = queue.stats();
+  printf("%-14s: %u tag reads, %u arrivals of %u tags, %u TID reads, %u from cache in %.2f s sim\n",
+         label, reads, arrivals, (unsigned)count, q.served + q.failed, q.cached, s);
+  printf("                %.1f tags/s, longest stream gap %.0f ms, %u batches", reads / s,
+         max_gap / 1000.0, q.batches);
+  if (cache) printf(", hit rate %.1f%%, %u cached", cache->hitRatePermille() / 10.0, cache->size());
+  printf("\n");
+  queue.setCache(nullptr);
+  uhfAttachTransport(nullptr);
+}
+
+static void benchTidCache(const BenchArgs& a) {
+  static UhfTidCache cache, restored;
+  benchFlicker(a, nullptr, "flicker");
+  cache.clear();
+  benchFlicker(a, &cache, "flicker cache");
+
+  // What a reboot with NVS persistence sees: the image, loaded back
+  static uint8_t image[UhfTidCache::IMAGE_MAX], again[UhfTidCache::IMAGE_MAX];
+  const size_t n = cache.serialize(image, sizeof(image));
+  const bool ok = restored.deserialize(image, n) && restored.serialize(again, sizeof(again)) == n &&
+                  memcmp(image, again, n) == 0;
+  printf("                image %u bytes, %u entries restored%s\n", (unsigned)n,
+         restored.stats().loaded, ok ? "" : ", ROUND TRIP MISMATCH");
+  benchFlicker(a, &restored, "flicker reboot");
+}
+
+// ---------- Write + verify cycle (mirrors performEpcWrite + writeEpcVariableSafeWithVerifyRaw) ----------
+static bool writeVerifyCycle(const uint8_t* cur, size_t cur_len, const uint8_t* epc, uint8_t words) {
+  const size_t bytes = size_t(words) * 2;
+
+  uhfStopMultiInventory();
+  if (!uhfSelectEpc(cur, cur_len)) return false;
+
+  // PC read, PC write, EPC write
+  uint8_t pcb[2];
+  uint16_t pc = 0x3000;
+  if (uhfRead(0x01, 1, pcb, 2, 1) == 2) pc = (uint16_t(pcb[0]) << 8) | pcb[1];
+  uhfWritePcWord((pc & 0x07FF) | (uint16_t(words) << 11));
+  if (!uhfWrite(0x01, 2, epc, bytes)) return false;
+
+  // Reselect post-write
+  uhfStopMultiInventory();
+  { RawTagData tmp[1]; (void)rawInventoryWithRssi(tmp, 1); }
+  uhfSelectEpc(epc, bytes);
+
+  // Read-back via PC
+  uhfStopMultiInventory();
+  { RawTagData tmp[1]; (void)rawInventoryWithRssi(tmp, 1); }
+  uint8_t rb[62]; size_t rb_len = 0; uint16_t pc_after = 0;
+  if (!uhfReadEpcViaPc(rb, rb_len, pc_after)) return false;
+  return rb_len == bytes && memcmp(rb, epc, bytes) == 0;
+}
+
+static void benchWriteVerify(const BenchArgs& a) {
+  Jrd4035Sim sim(a.sim);
+  sim.addRandomTags(1, a.epc_words);
+  uhfAttachTransport(&sim);
+  uhfResetCommandTiming();
+
+  uint8_t cur[62];
+  size_t cur_len = size_t(a.epc_words) * 2;
+  memcpy(cur, sim.tags()[0].epc, cur_len);
+
+  uint32_t cycles = 0, ok = 0;
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  while (hostClockMicros() < t_end) {
+    uint8_t next[62];
+    for (size_t i = 0; i < cur_len; i++) next[i] = uint8_t(rand());
+    next[0] = 0xAC; next[1] = 0x71;
+    next[2] = uint8_t(cycles >> 8); next[3] = uint8_t(cycles);
+    cycles++;
+    if (writeVerifyCycle(cur, cur_len, next, a.epc_words)) {
+      ok++;
+      memcpy(cur, next, cur_len);
+    } else {
+      memcpy(cur, sim.tags()[0].epc, cur_len);   // resync like a rescan would
+    }
+  }
+  const double s = simSeconds(hostClockMicros() - t0);
+  printf("write+verify  : %u cycles, %u verified in %.2f s sim\n", cycles, ok, s);
+  printf("                %.2f cycles/s, %.1f ms/cycle, %.0f tags/min\n",
+         ok / s, ok ? 1000.0 * s / ok : 0.0, ok * 60.0 / s);
+  static const uint8_t cmds[] = {0x28, 0x22, 0x0C, 0x39, 0x49};
+  for (uint8_t c : cmds) {
+    const UhfCmdTiming* t = uhfCommandTiming(c);
+    if (!t) continue;
+    printf("                0x%02X: %5u replies, first byte p50 %5.2f ms, reply p50 %5.2f ms p99 %5.2f ms,"
+           " timeout %3u ms, %u timed out, %u errors, %u retries\n",
+           c, t->reply.count, t->first_byte.percentileUs(500) / 1000.0,
+           t->reply.percentileUs(500) / 1000.0, t->reply.percentileUs(990) / 1000.0,
+           uhfCommandTimeout(c, 1000), t->timeouts, t->errors, t->retries);
+  }
+  uhfAttachTransport(nullptr);
+}
+
+// ---------- Batch encoding (uhf_encoder.*): a conveyor brings the next blank tag ----------
+struct Conveyor {
+  Jrd4035Sim* sim;
+  uint8_t     epc_words;
+  uint32_t    failed_shown;
+};
+
+static void conveyorNext(const UhfEncodeResult& r, void* ctx) {
+  Conveyor& c = *static_cast<Conveyor*>(ctx);
+  if (r.status != UHF_ENC_OK && c.failed_shown++ < 3) {
+    printf("                job %u: %s (module error 0x%02X)\n",
+           r.job, uhfEncodeStatusName(r.status), r.module_error);
+  }
+  // Encoded (or rejected) tag leaves, a blank one arrives
+  for (size_t i = 0; i < c.sim->tags().size(); i++) c.sim->tags()[i].present = false;
+  c.sim->addRandomTags(1, c.epc_words);
+}
+
+static void benchEncode(const BenchArgs& a) {
+  Jrd4035Sim sim(a.sim);
+  sim.addRandomTags(1, a.epc_words);
+  uhfAttachTransport(&sim);
+
+  static UhfEncoder enc;
+  Conveyor conv = { &sim, a.epc_words, 0 };
+  uint8_t base[62];
+  const uint8_t len = uint8_t(a.epc_words * 2);
+  memset(base, 0, sizeof(base));
+  base[0] = 0x30; base[1] = 0x08;
+  enc.clear();
+  enc.setTemplate(base, len, 4, 1, 1000000);
+  enc.setResultHandler(conveyorNext, &conv);
+  enc.start();
+
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  while (hostClockMicros() < t_end && enc.running()) enc.step();
+  enc.stop();
+
+  const UhfEncoderStats& st = enc.stats();
+  const double s = simSeconds(hostClockMicros() - t0);
+  printf("encode batch  : %u encoded, %u failed, %u slow-path fallbacks in %.2f s sim\n",
+         st.ok, st.failed, st.fallbacks, s);
+  printf("                %u tags/min (%.1f ms/tag)\n",
+         enc.tagsPerMinute(), st.ok ? 1000.0 * s / st.ok : 0.0);
+  for (uint8_t p = 0; p < UHF_ENC_PHASES; p++) {
+    const UhfEncodePhaseStats& ph = st.phase[p];
+    printf("                %-8s avg %6.2f ms, max %6.2f ms\n", uhfEncodePhaseName(p),
+           ph.count ? ph.total_us / 1000.0 / ph.count : 0.0, ph.max_us / 1000.0);
+  }
+  uhfAttachTransport(nullptr);
+}
+
+// ---------- Encode station power (uhf_power.*) ----------
+// Three tags on the next reel answer from 24..26 dBm: an acquire round that
+// reaches them ends up encoding them. Blanks on the station answer from
+// 14..19 dBm and need 3..9 dB more to be written. The same tags come by
+// twice: the second pass re-encodes them, as a rework loop would.
+struct PowerStation {
+  Jrd4035Sim* sim;
+  size_t      first, count;        // station tags in sim.tags()
+  size_t      shown;               // jobs presented so far
+};
+
+static void powerStationNext(const UhfEncodeResult&, void* ctx) {
+  PowerStation& st = *static_cast<PowerStation*>(ctx);
+  std::vector<SimTag>& tags = st.sim->tags();
+  tags[st.first + st.shown % st.count].present = false;
+  st.shown++;
+  tags[st.first + st.shown % st.count].present = true;
+}
+
+static void benchEncodePower(const BenchArgs& a) {
+  static const uint16_t kFixed[] = {2000, 2600, 3000, 0};       // 0: policy
+  const size_t count = 20;
+  for (uint16_t fixed : kFixed) {
+    Jrd4035Sim sim(a.sim);
+    std::mt19937 rng(7);
+    for (int i = 0; i < 3; i++) {
+      sim.addRandomTags(1, a.epc_words);
+      sim.tags().back().read_dbm100  = uint16_t(2400 + 100 * i);
+      sim.tags().back().write_dbm100 = uint16_t(2700 + 100 * i);
+    }
+    for (size_t i = 0; i < count; i++) {
+      sim.addRandomTags(1, a.epc_words);
+      SimTag& t = sim.tags().back();
+      t.read_dbm100  = uint16_t(1400 + rng() % 6 * 100);
+      t.write_dbm100 = uint16_t(t.read_dbm100 + 300 + rng() % 7 * 100);
+      t.present      = i == 0;
+    }
+    uint8_t neighbours[3][62];
+    for (int i = 0; i < 3; i++) memcpy(neighbours[i], sim.tags()[i].epc, sizeof(neighbours[i]));
+    uhfAttachTransport(&sim);
+    uhfForgetTxPower();
+    uhfResetCommandTiming();
+
+    static UhfEncoder enc;
+    static UhfPowerPolicy policy;
+    policy = UhfPowerPolicy();
+    if (fixed) uhfSetTxPower(fixed);
+    enc.setPowerPolicy(fixed ? nullptr : &policy);
+    PowerStation st = { &sim, 3, count, 0 };
+    uint8_t base[62];
+    memset(base, 0, sizeof(base));
+    base[0] = 0x30; base[1] = 0x0F;
+    enc.clear();
+    enc.setTemplate(base, uint8_t(a.epc_words * 2), 4, 1, uint32_t(count * 2));
+    enc.setResultHandler(powerStationNext, &st);
+    enc.start();
+
+    const uint64_t t0 = hostClockMicros();
+    const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+    while (hostClockMicros() < t_end && enc.running()) enc.step();
+    enc.stop();
+    enc.setPowerPolicy(nullptr);
+
+    const UhfEncoderStats& es = enc.stats();
+    unsigned overwritten = 0;
+    for (int i = 0; i < 3; i++) overwritten += memcmp(neighbours[i], sim.tags()[i].epc, 62) != 0;
+    const UhfCmdTiming* b6 = uhfCommandTiming(0xB6);
+    char label[24];
+    if (fixed) snprintf(label, sizeof(label), "fixed %u dBm", fixed / 100);
+    else       snprintf(label, sizeof(label), "policy");
+    printf("%s%-12s: %2u/%u encoded, %2u failed, %u neighbours overwritten, %3u tags/min,"
+           " %2u power steps, %2u 0xB6\n", fixed == kFixed[0] ? "encode power  " : "              ",
+           label, es.ok, (unsigned)count * 2, es.failed, overwritten, enc.tagsPerMinute(),
+           es.power_steps, b6 ? b6->sent : 0);
+    if (!fixed) {
+      const UhfPowerStats& ps = policy.stats();
+      printf("                %u ops, %u escalations, %u at max, %u cache hits, %u retries saved,"
+             " %u tags cached\n", ps.ops, ps.escalations, ps.at_max, ps.cache_hits, ps.retries_saved,
+             policy.cached());
+    }
+    uhfAttachTransport(nullptr);
+  }
+}
+
+int main(int argc, char** argv) {
+  BenchArgs a = parseArgs(argc, argv);
+  printf("JRD-4035 sim: %u tags x %u bits, %u baud, latency %u us, noise %.4f, miss %.2f\n",
+         (unsigned)a.tags, a.epc_words * 16u, a.sim.baud, a.sim.cmd_latency_us,
+         a.sim.noise_flip, a.sim.read_miss);
+  benchInventory(a);
+  benchStream(a);
+  benchEnrich(a, false);
+  benchEnrich(a, true);
+  benchTidCache(a);
+  benchWriteVerify(a);
+  benchEncode(a);
+  benchEncodePower(a);
+  return 0;
+}
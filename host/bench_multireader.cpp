@@ -0,0 +1,147 @@
+// Several JRD-4035 modules on one controller (uhf_multi_reader.h).
+//
+// One to three emulated modules, each on its own simulated UART with its
+// own tags, driven from this one thread by UhfMultiReader. Rates are in
+// simulated time: the modules run in parallel on the virtual clock, the
+// controller's busy-waits advance it. Every scheduling mode is run with 1,
+// 2 and 3 modules; some tags sit between two zones and are read by both,
+// so the merged stream must count them once. Exit status 1 if the merged
+// tag count is wrong, or if 2 / 3 modules interleaved or streaming read
+// less than 1.8x / 2.6x what one module reads.
+//
+//   ./build/bench_multireader [--tags N] [--shared N] [--seconds S]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "uhf_multi_reader.h"
+#include "uhf_pipeline.h"
+#include "jrd4035_sim.h"
+
+struct BenchArgs {
+  size_t tags;          // per module, own zone
+  size_t shared;        // per pair of neighbouring modules, read by both
+  double seconds;
+  BenchArgs() : tags(12), shared(2), seconds(5.0) {}
+};
+
+static const char* kModeNames[] = {"sequential", "interleaved", "stream"};
+
+struct RunResult {
+  double   reads_per_s;
+  uint32_t reads;
+  uint16_t merged;        // distinct tags in the merged table
+  size_t   expected;
+  uint32_t news;          // NEW events
+  uint32_t shared_tags;   // merged entries read by more than one module
+};
+
+static RunResult run(const BenchArgs& a, uint8_t mode, uint8_t modules) {
+  std::vector<Jrd4035Sim*> sims;
+  std::vector<UhfReader*> readers;
+  std::set<std::string> truth;
+  for (uint8_t m = 0; m < modules; m++) {
+    SimConfig cfg;
+    cfg.seed = 11 + m;
+    Jrd4035Sim* sim = new Jrd4035Sim(cfg);
+    sim->addRandomTags(a.tags, 6);
+    sims.push_back(sim);
+  }
+  // The first `shared` tags of each module are also in range of the next one
+  for (uint8_t m = 0; m + 1 < modules; m++) {
+    for (size_t i = 0; i < a.shared; i++) {
+      const SimTag t = sims[m]->tags()[i];
+      sims[m + 1]->addTag(t.epc, uint8_t(t.pc >> 11), t.rssi);
+    }
+  }
+  for (uint8_t m = 0; m < modules; m++) {
+    for (const SimTag& t : sims[m]->tags()) truth.insert(std::string((const char*)t.epc, (t.pc >> 11) * 2));
+    UhfReader* r = new UhfReader();
+    r->attach(sims[m]);
+    r->stopMultiInventory();
+    readers.push_back(r);
+  }
+
+  // Heap: not on the stack. The merged table is a stopped pipeline's, as
+  // on the sketch.
+  UhfPipeline* pipe = new UhfPipeline();
+  UhfMultiReader* mp = new UhfMultiReader();
+  UhfMultiReader& multi = *mp;
+  for (UhfReader* r : readers) multi.add(*r);
+  UhfMultiConfig cfg;
+  cfg.mode = mode;
+  cfg.tag_expiry_ms = 60000;           // nobody leaves: the table is the union
+  multi.setConfig(cfg);
+
+  RunResult res;
+  memset(&res, 0, sizeof(res));
+  UhfMultiEvent ev[16];
+  const uint64_t t0 = hostClockMicros();
+  const uint64_t t_end = t0 + uint64_t(a.seconds * 1e6);
+  multi.start(pipe->lendTable());
+  while (hostClockMicros() < t_end) {
+    res.reads += multi.step();
+    uint8_t n;
+    while ((n = multi.poll(ev, 16)) > 0) {
+      for (uint8_t i = 0; i < n; i++) if (ev[i].kind == UHF_TAG_NEW) res.news++;
+    }
+  }
+  const double s = double(hostClockMicros() - t0) / 1e6;
+  multi.stop();
+
+  res.reads_per_s = res.reads / s;
+  res.merged = multi.table().size();
+  res.expected = truth.size();
+  for (uint16_t i = multi.table().oldest(); i != UhfMultiReader::Table::NONE; i = multi.table().newer(i)) {
+    const uint8_t m = multi.readersOf(i);
+    if (m & (m - 1)) res.shared_tags++;
+  }
+  printf("%-11s %u module%s: %6u reads %7.1f reads/s, %3u tags merged (%3u expected), %3u NEW, %2u read by 2\n",
+         kModeNames[mode], modules, modules > 1 ? "s" : " ", res.reads, res.reads_per_s, res.merged,
+         (unsigned)res.expected, res.news, res.shared_tags);
+  for (uint8_t m = 0; m < modules; m++) {
+    const UhfMultiReaderStats& st = multi.readerStats(m);
+    const UhfCmdTiming* t = readers[m]->commandTiming(CMD_INVENTORY);
+    printf("            module %u: %5u rounds, %6u reads, %3u first, %5u shared, 0x22 reply p50 %.2f ms\n",
+           m, st.rounds, st.tag_reads, st.first_reads, st.shared_reads,
+           t && t->reply.count ? t->reply.percentileUs(500) / 1000.0 : 0.0);
+  }
+
+  delete mp;
+  delete pipe;
+  for (UhfReader* r : readers) delete r;
+  for (Jrd4035Sim* s : sims) delete s;
+  return res;
+}
+
+int main(int argc, char** argv) {
+  BenchArgs a;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--tags" && i + 1 < argc)         a.tags = size_t(atol(argv[++i]));
+    else if (k == "--shared" && i + 1 < argc)  a.shared = size_t(atol(argv[++i]));
+    else if (k == "--seconds" && i + 1 < argc) a.seconds = atof(argv[++i]);
+    else { fprintf(stderr, "usage: %s [--tags N] [--shared N] [--seconds S]\n", argv[0]); return 2; }
+  }
+  if (a.shared > a.tags) a.shared = a.tags;
+  printf("%u modules max, %u tags per module (%u shared with the next), 115200 baud, %.0f s sim per run\n",
+         UHF_MULTI_MAX_READERS, (unsigned)a.tags, (unsigned)a.shared, a.seconds);
+  bool ok = true;
+  for (uint8_t mode = UHF_MULTI_SEQUENTIAL; mode <= UHF_MULTI_STREAM; mode++) {
+    double one = 0;
+    for (uint8_t m = 1; m <= UHF_MULTI_MAX_READERS && m <= 3; m++) {
+      const RunResult r = run(a, mode, m);
+      ok &= r.merged == r.expected && r.news == r.expected;
+      if (m == 1) one = r.reads_per_s;
+      const double scale = one > 0 ? r.reads_per_s / one : 0;
+      if (m > 1) printf("            x%.2f the reads of one module\n", scale);
+      if (mode != UHF_MULTI_SEQUENTIAL && m > 1 && scale < (m == 2 ? 1.8 : 2.6)) ok = false;
+    }
+  }
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+// Parser microbenchmarks, Google Benchmark style (no dependency).
+//
+// _parseInventoryPayload against its reference copy (parser_ref.h) on
+// payloads from the fast path to worst-case garbage, then UhfFrameDecoder on
+// concatenated notification streams, then RSSI conversion (formula vs
+// table). Every payload case also checks that both parsers give the same
+// reads, the tables must match the formulas byte for byte and a calibration
+// must give a monotonic table through its points; exit status 1 if not. A
+// payload case where the firmware parser is slower than the reference is
+// flagged on its speedup line.
+//
+//   ./build/bench_parser [--min-time SECONDS] [--filter SUBSTRING]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "parser_ref.h"
+
+static double gMinTime = 0.2;
+static const char* gFilter = nullptr;
+
+static double nowNs() {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Calibrates the iteration count to gMinTime, prints one result line.
+// `items` per iteration (frames, payloads) gives the last column.
+template <class F>
+static double runBench(const std::string& name, F body, double items, const char* unit) {
+  if (gFilter && name.find(gFilter) == std::string::npos) return 0;
+  uint64_t iters = 1;
+  double elapsed = 0;
+  for (;;) {
+    const double t0 = nowNs();
+    for (uint64_t i = 0; i < iters; i++) body();
+    elapsed = nowNs() - t0;
+    if (elapsed >= gMinTime * 1e9 || iters >= (1ull << 40)) break;
+    const double scale = elapsed > 0 ? gMinTime * 1e9 / elapsed * 1.4 : 10.0;
+    iters = uint64_t(double(iters) * std::min(std::max(scale, 2.0), 100.0));
+  }
+  const double ns = elapsed / double(iters);
+  printf("%-40s %10.1f ns %12llu %10.2f ns/%s\n", name.c_str(), ns, (unsigned long long)iters,
+         ns / items, unit);
+  return ns;
+}
+
+static volatile uint32_t gSink;
+
+// ---------- Payload cases ----------
+
+struct PayloadCase {
+  std::string name;
+  std::vector<uint8_t> p;
+};
+
+static void putTag(std::vector<uint8_t>& p, uint8_t words, std::mt19937& rng, bool rssi_before) {
+  if (rssi_before) p.push_back(0xD3);
+  p.push_back(uint8_t(words << 3));
+  p.push_back(0x00);
+  for (uint8_t i = 0; i < words * 2; i++) p.push_back(uint8_t(rng() | 1));
+}
+
+static std::vector<PayloadCase> payloadCases() {
+  std::mt19937 rng(7);
+  std::vector<PayloadCase> v;
+  PayloadCase c;
+
+  c.name = "epc96_m5";                 // the usual notification: fast path
+  putTag(c.p, 6, rng, true);
+  c.p.push_back(0x12); c.p.push_back(0x34);    // CRC
+  v.push_back(c);
+
+  // Two leading zeros: no PC at offset 1, so these skip the fast path
+  c.p.assign(2, 0x00); c.name = "epc496_raw";   // longest EPC, sliding window
+  putTag(c.p, 31, rng, false);
+  v.push_back(c);
+
+  c.p.assign(2, 0x00); c.name = "multi3_raw";   // three tags, RSSI between them
+  for (int i = 0; i < 3; i++) putTag(c.p, uint8_t(6 + 4 * i), rng, i > 0);
+  v.push_back(c);
+
+  c.p.assign(505, 0x00); c.name = "zeros505";   // padding only
+  v.push_back(c);
+
+  c.p.clear(); c.name = "low505";      // no byte can start a PC
+  for (int i = 0; i < 505; i++) c.p.push_back(uint8_t(rng() % 0x30));
+  v.push_back(c);
+
+  c.p.clear(); c.name = "garbage505";  // uniform noise
+  for (int i = 0; i < 505; i++) c.p.push_back(uint8_t(rng()));
+  v.push_back(c);
+
+  c.p.clear(); c.name = "pc_zero_runs505";   // PCs announcing 31 words of zeros
+  while (c.p.size() + 64 <= 505) {
+    c.p.push_back(0xF8); c.p.push_back(0xF8);
+    c.p.insert(c.p.end(), 62, 0x00);
+  }
+  c.p.resize(505, 0x00);
+  v.push_back(c);
+  return v;
+}
+
+static bool sameReads(const PayloadCase& c) {
+  RawTagData a[32], b[32];
+  memset(a, 0xA5, sizeof(a));
+  memset(b, 0xA5, sizeof(b));
+  const uint8_t na = refParseInventoryPayload(c.p.data(), c.p.size(), a, 32);
+  const uint8_t nb = _parseInventoryPayload(c.p.data(), c.p.size(), b, 32);
+  return na == nb && memcmp(a, b, sizeof(a)) == 0;
+}
+
+// ---------- Frame streams ----------
+
+static void putFrame(std::vector<uint8_t>& s, const std::vector<uint8_t>& payload) {
+  const size_t at = s.size();
+  s.push_back(0xBB); s.push_back(0x02); s.push_back(0x22);
+  s.push_back(uint8_t(payload.size() >> 8)); s.push_back(uint8_t(payload.size()));
+  s.insert(s.end(), payload.begin(), payload.end());
+  uint8_t sum = 0;
+  for (size_t i = at + 1; i < s.size(); i++) sum = uint8_t(sum + s[i]);
+  s.push_back(sum);
+  s.push_back(0x7E);
+}
+
+class LoopTransport : public UhfTransport {
+public:
+  explicit LoopTransport(const std::vector<uint8_t>& s) : s_(s), pos_(0) {}
+  void   rewind() { pos_ = 0; }
+  int    available() override { return int(s_.size() - pos_); }
+  int    read() override { return pos_ < s_.size() ? s_[pos_++] : -1; }
+  size_t readAvailable(uint8_t* buf, size_t n) override {
+    n = std::min(n, s_.size() - pos_);
+    memcpy(buf, s_.data() + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  size_t write(const uint8_t*, size_t len) override { return len; }
+  void   flush() override {}
+private:
+  const std::vector<uint8_t>& s_;
+  size_t pos_;
+};
+
+static uint32_t decodeAll(UhfFrameDecoder& dec, LoopTransport& t) {
+  dec.reset();
+  t.rewind();
+  UhfFrame f;
+  uint32_t frames = 0;
+  while (dec.pump(t) || dec.buffered()) {
+    bool any = false;
+    while (dec.next(f)) { frames++; any = true; }
+    if (!any && t.available() == 0) break;
+  }
+  return frames;
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--min-time" && i + 1 < argc)     gMinTime = atof(argv[++i]);
+    else if (k == "--filter" && i + 1 < argc)  gFilter = argv[++i];
+    else {
+      fprintf(stderr, "usage: %s [--min-time SECONDS] [--filter SUBSTRING]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("%-40s %13s %12s %13s\n", "Benchmark", "Time", "Iterations", "Per item");
+  printf("%s\n", std::string(81, '-').c_str());
+
+  bool ok = true;
+  RawTagData out[32];
+  for (const PayloadCase& c : payloadCases()) {
+    if (!sameReads(c)) { printf("MISMATCH on %s\n", c.name.c_str()); ok = false; }
+    const uint8_t* p = c.p.data();
+    const size_t n = c.p.size();
+    const double ref = runBench("BM_ParsePayload/ref/" + c.name,
+                                [&] { gSink += refParseInventoryPayload(p, n, out, 32); }, 1, "payload");
+    const double cur = runBench("BM_ParsePayload/firmware/" + c.name,
+                                [&] { gSink += _parseInventoryPayload(p, n, out, 32); }, 1, "payload");
+    // Flagged, not failed: host timings move a few percent from run to run
+    if (ref > 0 && cur > 0) printf("%-40s %10.2fx%s\n", ("  speedup/" + c.name).c_str(), ref / cur,
+                                   ref < cur ? "  SLOWER than the reference" : "");
+  }
+
+  // 200 notifications of 96-bit EPCs, back to back, then with noise between
+  std::mt19937 rng(3);
+  std::vector<uint8_t> clean, noisy, junk;
+  for (int i = 0; i < 200; i++) {
+    std::vector<uint8_t> pl;
+    putTag(pl, 6, rng, true);
+    pl.push_back(0x12); pl.push_back(0x34);
+    putFrame(clean, pl);
+    putFrame(noisy, pl);
+    for (int k = 0; k < 16; k++) noisy.push_back(uint8_t(rng() % 0xBB));   // never a header
+  }
+  for (int i = 0; i < 8192; i++) junk.push_back(uint8_t(rng() % 0xBB));
+
+  static UhfFrameDecoder dec;
+  LoopTransport tc(clean), tn(noisy), tj(junk);
+  const uint32_t fc = decodeAll(dec, tc), fn = decodeAll(dec, tn);
+  RefSplitStats rs;
+  if (fc != 200 || fn != 200 || refSplitFrames(noisy.data(), noisy.size(), rs).size() != fn) {
+    printf("MISMATCH in frame decoding (%u / %u frames)\n", fc, fn);
+    ok = false;
+  }
+  runBench("BM_DecodeFrames/clean200", [&] { gSink += decodeAll(dec, tc); }, 200, "frame");
+  runBench("BM_DecodeFrames/noisy200", [&] { gSink += decodeAll(dec, tn); }, 200, "frame");
+  runBench("BM_DecodeFrames/hunt8k", [&] { gSink += decodeAll(dec, tj); }, double(junk.size()), "byte");
+
+  // RSSI byte -> dBm: the piecewise formula per read vs one table load
+  static const RssiProfile kProfiles[] = {RSSI_LINEAR, RSSI_CURVED, RSSI_CUSTOM};
+  for (RssiProfile p : kProfiles) {
+    for (int v = 0; v < 256; v++) {
+      if (_rssibyte_to_dbm(uint8_t(v), p) != refRssiByteToDbm(uint8_t(v), p)) {
+        printf("MISMATCH in RSSI profile %d at 0x%02X\n", int(p), v);
+        ok = false;
+        break;
+      }
+    }
+  }
+  std::vector<uint8_t> rssi_bytes(4096);
+  for (uint8_t& b : rssi_bytes) b = uint8_t(rng());
+  static volatile uint8_t profile = RSSI_CURVED;     // not a constant for the compiler
+  runBench("BM_RssiToDbm/formula", [&] {
+    const RssiProfile p = RssiProfile(profile);
+    int32_t s = 0;
+    for (uint8_t b : rssi_bytes) s += refRssiByteToDbm(b, p);
+    gSink += uint32_t(s);
+  }, double(rssi_bytes.size()), "read");
+  runBench("BM_RssiToDbm/table", [&] {
+    const RssiProfile p = RssiProfile(profile);
+    int32_t s = 0;
+    for (uint8_t b : rssi_bytes) s += _rssibyte_to_dbm(b, p);
+    gSink += uint32_t(s);
+  }, double(rssi_bytes.size()), "read");
+
+  // Calibration: four distances, noisy reads around a byte per distance
+  UhfRssiCalibration cal;
+  const uint16_t cm[] = {50, 100, 200, 400};
+  const uint8_t  centre[] = {0xE0, 0xC8, 0xA8, 0x80};
+  for (int i = 0; i < 4; i++) {
+    uint8_t raw[31];
+    for (uint8_t& b : raw) b = uint8_t(centre[i] + int(rng() % 9) - 4);
+    raw[0] = 0x01;                                  // outlier, ignored by the median
+    cal.addPoint(cm[i], raw, sizeof(raw));
+  }
+  int8_t table[256];
+  bool cal_ok = cal.build(table);
+  for (int v = 1; cal_ok && v < 256; v++) cal_ok = table[v] >= table[v - 1];
+  for (uint8_t i = 0; cal_ok && i < cal.size(); i++) {
+    const UhfRssiCalPoint& pt = cal.point(i);
+    cal_ok = abs(pt.raw - centre[i]) <= 4 && table[pt.raw] == pt.dbm;
+  }
+  UhfRssiCalibration bad = cal;                    // a closer tag reading weaker
+  const uint8_t weaker[1] = {0x70};
+  bad.addPoint(25, weaker, 1);
+  if (!cal_ok || bad.build(table)) {
+    printf("MISMATCH in RSSI calibration\n");
+    ok = false;
+  }
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// Tag report throughput: binary COBS records (uhf_report.h) vs text lines.
+//
+// 1. Size and host encode cost of one record in each format.
+// 2. Link model: reads arrive at --rate per second, the firmware drops a
+//    record when the console TX buffer (--tx-buffer) cannot take it, the
+//    UART drains baud/10 bytes per second. Reports the records per second
+//    that get through at each baud rate.
+// 3. Round trip: a binary stream with text lines and dropped records mixed
+//    in must decode to exactly the records written, with the drops counted
+//    as seq gaps. Exit status 1 otherwise.
+//
+//   ./build/bench_report [--rate R] [--seconds S] [--tx-buffer B] [--tid-share P]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "uhf_report.h"
+
+static double nowNs() {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// The same fields as a text line, as a text-mode collector would need them
+static size_t formatText(const UhfTagRecord& r, char* out, size_t cap) {
+  char epc[EPC_HEX_SIZE], tid[17] = "-";
+  _toHex(r.epc, r.epc_len, epc, sizeof(epc));
+  if (r.has_tid) _toHex(r.tid, 8, tid, sizeof(tid));
+  const int n = snprintf(out, cap, "TAG seq=%u t=%u epc=%s rssi=%d ant=%u phase=%u tid=%s\n",
+                         r.seq, r.t_ms, epc, r.rssi_dbm, r.antenna, r.phase, tid);
+  return n < 0 ? 0 : size_t(n);
+}
+
+static std::vector<UhfTagRecord> makeReads(size_t n, double tid_share, std::mt19937& rng) {
+  std::vector<UhfTagRecord> tags(64);
+  for (size_t i = 0; i < tags.size(); i++) {
+    UhfTagRecord& t = tags[i];
+    memset(&t, 0, sizeof(t));
+    t.epc_len = 12;
+    for (size_t k = 0; k < 12; k++) t.epc[k] = uint8_t(rng());
+    t.epc[0] = 0xE2; t.epc[1] = 0x80;
+    t.has_tid = std::uniform_real_distribution<double>(0, 1)(rng) < tid_share;
+    for (size_t k = 0; k < 8; k++) t.tid[k] = uint8_t(rng());
+  }
+  std::vector<UhfTagRecord> v(n);
+  for (size_t i = 0; i < n; i++) {
+    v[i] = tags[rng() % tags.size()];
+    v[i].seq      = uint16_t(i);
+    v[i].t_ms     = uint32_t(1000 + i * 2);
+    v[i].rssi_dbm = int8_t(-30 - int(rng() % 50));
+  }
+  return v;
+}
+
+// Records per second through a UART of `baud` with a TX buffer of `buf` bytes
+static double sustained(const std::vector<size_t>& sizes, double rate, double baud, double buf,
+                        uint32_t& dropped) {
+  const double drain = baud / 10.0;   // 8N1
+  double level = 0, t = 0;
+  uint32_t sent = 0;
+  dropped = 0;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    const double at = double(i) / rate;
+    level -= (at - t) * drain;
+    if (level < 0) level = 0;
+    t = at;
+    if (level + double(sizes[i]) > buf) { dropped++; continue; }
+    level += double(sizes[i]);
+    sent++;
+  }
+  return sent / (double(sizes.size()) / rate);
+}
+
+int main(int argc, char** argv) {
+  double rate = 1000, seconds = 10, tx_buffer = 2048, tid_share = 0.5;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    const bool has_val = i + 1 < argc;
+    if (k == "--rate" && has_val)           rate = atof(argv[++i]);
+    else if (k == "--seconds" && has_val)   seconds = atof(argv[++i]);
+    else if (k == "--tx-buffer" && has_val) tx_buffer = atof(argv[++i]);
+    else if (k == "--tid-share" && has_val) tid_share = atof(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--rate R] [--seconds S] [--tx-buffer B] [--tid-share P]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rate <= 0) rate = 1;
+
+  std::mt19937 rng(1);
+  const size_t n = size_t(rate * seconds) > 0 ? size_t(rate * seconds) : 1;
+  const std::vector<UhfTagRecord> reads = makeReads(n, tid_share, rng);
+
+  // 1. Size and encode cost
+  std::vector<size_t> bin_sizes(n), text_sizes(n);
+  uint8_t frame[UHF_REPORT_MAX_FRAME];
+  char line[256];
+  volatile size_t sink = 0;
+  double t0 = nowNs();
+  for (size_t i = 0; i < n; i++) sink += bin_sizes[i] = uhfReportEncode(reads[i], frame);
+  const double bin_ns = (nowNs() - t0) / n;
+  t0 = nowNs();
+  for (size_t i = 0; i < n; i++) sink += text_sizes[i] = formatText(reads[i], line, sizeof(line));
+  const double text_ns = (nowNs() - t0) / n;
+  double bin_avg = 0, text_avg = 0;
+  for (size_t i = 0; i < n; i++) { bin_avg += bin_sizes[i]; text_avg += text_sizes[i]; }
+  bin_avg /= n; text_avg /= n;
+
+  printf("tag report: %u reads, %.0f%% with TID, offered %.0f reads/s, TX buffer %.0f bytes\n",
+         (unsigned)n, tid_share * 100, rate, tx_buffer);
+  printf("  record   : binary %.1f bytes, %.0f ns host encode; text %.1f bytes, %.0f ns\n",
+         bin_avg, bin_ns, text_avg, text_ns);
+
+  // 2. Link model
+  static const double bauds[] = {115200, 921600, 2000000};
+  for (double baud : bauds) {
+    uint32_t bin_drop, text_drop;
+    const double b = sustained(bin_sizes, rate, baud, tx_buffer, bin_drop);
+    const double t = sustained(text_sizes, rate, baud, tx_buffer, text_drop);
+    printf("  %7.0f  : binary %6.0f records/s (%u dropped), text %6.0f records/s (%u dropped), x%.1f\n",
+           baud, b, bin_drop, t, text_drop, t > 0 ? b / t : 0.0);
+  }
+
+  // 3. Round trip with text lines and drops mixed in
+  std::vector<uint8_t> stream;
+  UhfReportWriter writer;
+  std::vector<UhfTagRecord> expect;
+  uint32_t dropped = 0;
+  for (size_t i = 0; i < n; i++) {
+    RawTagData tag;
+    memcpy(tag.epc_raw, reads[i].epc, reads[i].epc_len);
+    tag.epc_len  = reads[i].epc_len;
+    tag.rssi_dbm = reads[i].rssi_dbm;
+    tag.antenna  = reads[i].antenna;
+    tag.phase    = reads[i].phase;
+    const size_t len = writer.frame(tag, reads[i].has_tid ? reads[i].tid : nullptr, reads[i].t_ms, frame);
+    if (rng() % 100 == 0) { dropped++; continue; }        // TX buffer full
+    UhfTagRecord r = reads[i];
+    r.seq = uint16_t(i);
+    expect.push_back(r);
+    stream.insert(stream.end(), frame, frame + len);
+    if (rng() % 200 == 0) {                                // console text in between
+      const size_t tl = size_t(snprintf(line, sizeof(line), "UHF CMD 0x39 sent %u, first p50 1500 us\n", (unsigned)i));
+      stream.insert(stream.end(), line, line + tl);
+    }
+  }
+  UhfReportDecoder dec;
+  UhfTagRecord got;
+  size_t k = 0, mismatch = 0;
+  for (size_t i = 0; i < stream.size(); i++) {
+    if (!dec.push(stream[i], got)) continue;
+    const UhfTagRecord& e = expect[k < expect.size() ? k : expect.size() - 1];
+    if (k >= expect.size() || got.seq != e.seq || got.t_ms != e.t_ms || got.rssi_dbm != e.rssi_dbm ||
+        got.epc_len != e.epc_len || memcmp(got.epc, e.epc, e.epc_len) != 0 || got.has_tid != e.has_tid ||
+        (e.has_tid && memcmp(got.tid, e.tid, 8) != 0)) mismatch++;
+    k++;
+  }
+  const UhfReportDecoderStats& st = dec.stats();
+  printf("  decode   : %u records, %u lost (%u dropped), %u rejected frames, %u mismatches\n",
+         st.records, st.lost, dropped, st.bad_cobs + st.bad_crc + st.bad_layout + st.oversize,
+         (unsigned)mismatch);
+  const bool ok = mismatch == 0 && st.records == expect.size() && st.lost == dropped;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+// Tag table lookup cost as the tag population grows.
+//
+// Unlike bench_inventory this measures host CPU time (steady_clock): the
+// table is pure computation. The linear column is the previous continuous
+// mode lookup (array scan + memcmp) for comparison. Absolute numbers are
+// host numbers; the growth with N is what carries over to the ESP32.
+//
+// Then the "nearest tag" pick on noisy RSSI: last reading vs UhfRssiFilter
+// with uhfNearestTag hysteresis (exit status 1 if smoothing does not help).
+//
+//   ./build/bench_tag_table [--epc-words W] [--ops N]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "uhf_tag_table.h"
+
+static constexpr uint16_t BIG_CAPACITY = 16384;
+
+struct Epc { uint8_t b[EPC_MAX_BYTES]; uint8_t len; };
+
+static double nowNs() {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static std::vector<Epc> makeEpcs(size_t n, uint8_t words, std::mt19937& rng) {
+  std::vector<Epc> v(n);
+  for (size_t i = 0; i < n; i++) {
+    v[i].len = uint8_t(words * 2);
+    for (size_t k = 0; k < v[i].len; k++) v[i].b[k] = uint8_t(rng());
+    // Same company prefix on every tag, like a real warehouse population
+    v[i].b[0] = 0xE2; v[i].b[1] = 0x80; v[i].b[2] = 0x11;
+  }
+  return v;
+}
+
+// Previous continuous-mode lookup: linear scan with memcmp
+static int linearFind(const std::vector<Epc>& tab, size_t n, const Epc& e) {
+  for (size_t i = 0; i < n; i++)
+    if (tab[i].len == e.len && memcmp(tab[i].b, e.b, e.len) == 0) return int(i);
+  return -1;
+}
+
+template <uint16_t Cap>
+static void benchSize(UhfTagTable<Cap>& t, size_t n, const std::vector<Epc>& present,
+                      const std::vector<Epc>& absent, const std::vector<uint32_t>& order,
+                      size_t ops) {
+  t.clear();
+  bool is_new;
+  for (size_t i = 0; i < n; i++) t.upsert(present[i].b, present[i].len, 0, &is_new);
+  t.resetStats();
+
+  volatile uint32_t sink = 0;
+  double t0 = nowNs();
+  for (size_t k = 0; k < ops; k++) {
+    const Epc& e = present[order[k] % n];
+    sink += t.upsert(e.b, e.len, uint32_t(k), &is_new);
+  }
+  const double hit_ns = (nowNs() - t0) / double(ops);
+  const double probe = double(t.stats().probes) / double(t.stats().lookups);
+
+  t0 = nowNs();
+  for (size_t k = 0; k < ops; k++) {
+    const Epc& e = absent[order[k] % absent.size()];
+    sink += t.find(e.b, e.len);
+  }
+  const double miss_ns = (nowNs() - t0) / double(ops);
+
+  // Linear scan gets fewer ops past a few hundred tags, it is O(N)
+  const size_t lops = std::max<size_t>(1000, ops / std::max<size_t>(1, n / 16));
+  t0 = nowNs();
+  for (size_t k = 0; k < lops; k++) sink += uint32_t(linearFind(present, n, present[order[k] % n]));
+  const double lin_ns = (nowNs() - t0) / double(lops);
+  (void)sink;
+
+  printf("%6u %7u  %8.1f  %8.1f  %6.2f %5u  %10.1f\n", (unsigned)n, (unsigned)Cap,
+         hit_ns, miss_ns, probe, t.stats().max_probe, lin_ns);
+}
+
+// Steady churn: tags arrive, get refreshed, expire; must not degrade
+static void benchChurn(UhfTagTable<UHF_TAG_TABLE_CAPACITY>& t, const std::vector<Epc>& pool,
+                       size_t ops, std::mt19937& rng) {
+  t.clear();
+  const size_t live = UHF_TAG_TABLE_CAPACITY / 2;
+  bool is_new;
+  uint32_t now = 0;
+  volatile uint32_t sink = 0;
+  const double t0 = nowNs();
+  for (size_t k = 0; k < ops; k++) {
+    // Sliding window over the pool: ~live tags in the field at a time
+    const size_t base = (k / 64) % pool.size();
+    const Epc& e = pool[(base + rng() % live) % pool.size()];
+    sink += t.upsert(e.b, e.len, now, &is_new);
+    if ((k & 63) == 0) { now += 5; t.expire(now, 500); }
+  }
+  const double ns = (nowNs() - t0) / double(ops);
+  (void)sink;
+
+  // Every live entry must still be reachable after all the backward shifts
+  uint16_t used = 0, reachable = 0;
+  for (uint16_t i = 0; i < t.capacity(); i++) {
+    if (!t.used(i)) continue;
+    used++;
+    if (t.find(t.at(i).epc, t.at(i).epc_len) == i) reachable++;
+  }
+  printf("churn  %7u  %8.1f ns/op  %u inserts, %u expired, %u evictions, max probe %u, %u live%s\n",
+         (unsigned)UHF_TAG_TABLE_CAPACITY, ns, t.stats().inserts, t.stats().expired,
+         t.stats().evictions, t.stats().max_probe, t.size(),
+         (used == t.size() && reachable == used) ? "" : "  INCONSISTENT");
+}
+
+// Three tags 2 and 3 dB apart, Gaussian RSSI noise plus 5 % multipath
+// outliers. Counts how often the pick changes and how often it is right.
+static bool benchNearest(std::mt19937& rng) {
+  static UhfTagTable<16> last, smooth;
+  last.clear();
+  smooth.clear();
+  const int8_t true_dbm[3] = {-50, -52, -53};
+  const uint8_t epcs[3][12] = {{1}, {2}, {3}};
+  std::normal_distribution<float> noise(0.0f, 3.0f);
+  uint16_t pick_last = UhfTagTable<16>::NONE, pick_smooth = UhfTagTable<16>::NONE;
+  uint32_t flips_last = 0, flips_smooth = 0, right_last = 0, right_smooth = 0;
+  const uint32_t reads = 30000, warmup = 30;
+  bool is_new;
+  for (uint32_t k = 0; k < reads; k++) {
+    const uint8_t tag = uint8_t(k % 3);
+    float v = true_dbm[tag] + noise(rng);
+    if (rng() % 20 == 0) v += (rng() & 1) ? 10.0f : -10.0f;
+    const int8_t dbm = int8_t(std::max(-100.0f, std::min(-5.0f, v)));
+
+    UhfTagEntry& a = last.at(last.upsert(epcs[tag], 12, k, &is_new));
+    a.rssi = dbm;                                  // before: last reading
+    UhfTagEntry& b = smooth.at(smooth.upsert(epcs[tag], 12, k, &is_new));
+    b.rssi_f.add(dbm);
+    b.rssi = b.rssi_f.dbm();
+
+    const uint16_t pl = uhfNearestTag(last, UhfTagTable<16>::NONE, 0);
+    const uint16_t ps = uhfNearestTag(smooth, pick_smooth, 3);
+    if (k >= warmup) {
+      flips_last   += pl != pick_last;
+      flips_smooth += ps != pick_smooth;
+      right_last   += last.at(pl).epc[0] == 1;
+      right_smooth += smooth.at(ps).epc[0] == 1;
+    }
+    pick_last = pl;
+    pick_smooth = ps;
+  }
+  const double n = double(reads - warmup);
+  printf("nearest tag (-50/-52/-53 dBm, 3 dB noise, 5%% outliers, %u reads):\n", (unsigned)reads);
+  printf("  last reading          : %6u pick changes, right %5.1f %%\n", (unsigned)flips_last,
+         100.0 * right_last / n);
+  printf("  median+EWMA, 3 dB hyst: %6u pick changes, right %5.1f %%\n", (unsigned)flips_smooth,
+         100.0 * right_smooth / n);
+  return flips_smooth * 10 < flips_last && right_smooth > right_last;
+}
+
+int main(int argc, char** argv) {
+  uint8_t words = 6;
+  size_t ops = 2000000;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--epc-words" && i + 1 < argc) words = uint8_t(atoi(argv[++i]));
+    else if (k == "--ops" && i + 1 < argc)  ops = size_t(atol(argv[++i]));
+    else { fprintf(stderr, "usage: %s [--epc-words W] [--ops N]\n", argv[0]); return 2; }
+  }
+  if (words < 2 || words > EPC_MAX_BYTES / 2) words = 6;
+
+  std::mt19937 rng(1);
+  std::vector<Epc> present = makeEpcs(BIG_CAPACITY, words, rng);
+  std::vector<Epc> absent  = makeEpcs(4096, words, rng);
+  std::vector<uint32_t> order(ops);
+  for (size_t k = 0; k < ops; k++) order[k] = uint32_t(rng());
+
+  // Tables are large: keep them out of the stack
+  static UhfTagTable<UHF_TAG_TABLE_CAPACITY> small;
+  static UhfTagTable<BIG_CAPACITY> big;
+
+  printf("tag table: %u-bit EPCs, %u ops per size, entry %u bytes\n",
+         words * 16u, (unsigned)ops, (unsigned)sizeof(UhfTagEntry));
+  printf("  tags     cap    ns/hit   ns/miss  probe   max   linear ns/hit\n");
+  const size_t sizes[] = {16, 64, 256, 1024};
+  for (size_t n : sizes) benchSize(small, n, present, absent, order, ops);
+  const size_t big_sizes[] = {1024, 4096, 16384};
+  for (size_t n : big_sizes) benchSize(big, n, present, absent, order, ops);
+  benchChurn(small, present, ops, rng);
+  const bool ok = benchNearest(rng);
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,465 @@
+// Fuzz target for the code that sees raw UART bytes: _parseInventoryPayload
+// and UhfFrameDecoder. Both are checked against parser_ref.h (same reads,
+// same frames, same error counters), under ASan/UBSan for memory errors.
+//
+// Input byte 0 selects the target:
+//   bit 7 set    frame splitting, fed to the decoder in chunks of (b & 0x7F) + 1
+//   bit 7 clear  payload parser, maxItems = (b & 0x3F) + 1
+//
+// With -DUHF_LIBFUZZER (make fuzz, clang) this file is only the libFuzzer
+// entry point. Otherwise it has its own driver: corpus files first, then
+// random mutations of them (make fuzz-run, g++ is enough).
+//
+//   ./build/fuzz_parser [--runs N] [--seed S] [--max-len L] [--crash-dir DIR] [FILE|DIR ...]
+//   ./build/fuzz_parser --write-corpus DIR
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "parser_ref.h"
+
+static const char* gFailure = nullptr;
+
+static bool fail(const char* what) {
+  gFailure = what;
+  return false;
+}
+
+// ---------- Payload target ----------
+
+static bool checkPayload(const uint8_t* p, size_t n, uint8_t maxItems) {
+  RawTagData a[64], b[64];
+  memset(a, 0xA5, sizeof(a));
+  memset(b, 0xA5, sizeof(b));
+  const uint8_t na = refParseInventoryPayload(p, n, a, maxItems);
+  const uint8_t nb = _parseInventoryPayload(p, n, b, maxItems);
+  if (na != nb) return fail("payload: tag count differs from reference");
+  if (memcmp(a, b, sizeof(a)) != 0) return fail("payload: reads differ from reference");
+  if (nb > maxItems) return fail("payload: more tags than maxItems");
+  for (uint8_t i = 0; i < nb; i++) {
+    if (b[i].epc_len == 0 || b[i].epc_len > sizeof(b[i].epc_raw) || b[i].epc_len_total > sizeof(b[i].epc_raw))
+      return fail("payload: EPC length out of range");
+  }
+  return true;
+}
+
+// ---------- Frame target ----------
+
+// Hands out `chunk` bytes per pump(), like a UART driver delivering bursts
+class ChunkTransport : public UhfTransport {
+public:
+  ChunkTransport(const uint8_t* p, size_t n, size_t chunk) : p_(p), n_(n), pos_(0), chunk_(chunk) {}
+  bool   done() const { return pos_ == n_; }
+  int    available() override { return int(std::min(chunk_, n_ - pos_)); }
+  int    read() override { return pos_ < n_ ? p_[pos_++] : -1; }
+  size_t readAvailable(uint8_t* buf, size_t n) override {
+    n = std::min(n, n_ - pos_);
+    memcpy(buf, p_ + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  size_t write(const uint8_t*, size_t len) override { return len; }
+  void   flush() override {}
+private:
+  const uint8_t* p_;
+  size_t n_, pos_, chunk_;
+};
+
+static bool checkFrames(const uint8_t* p, size_t n, size_t chunk) {
+  RefSplitStats rs;
+  const std::vector<RefFrame> ref = refSplitFrames(p, n, rs);
+
+  static UhfFrameDecoder dec;
+  dec.reset();
+  ChunkTransport t(p, n, chunk);
+  UhfFrame f;
+  size_t k = 0;
+  for (;;) {
+    const bool last = t.done();
+    dec.pump(t);
+    while (dec.next(f)) {
+      if (k == ref.size()) return fail("frames: decoder found an extra frame");
+      if (f.len != ref[k].len || memcmp(f.data, p + ref[k].off, f.len) != 0)
+        return fail("frames: frame differs from reference");
+      k++;
+    }
+    if (last) break;
+  }
+  const UhfDecoderStats& s = dec.stats();
+  if (k != ref.size() || s.frames != ref.size()) return fail("frames: decoder missed a frame");
+  if (s.bad_checksum != rs.bad_checksum || s.bad_trailer != rs.bad_trailer || s.bad_length != rs.bad_length)
+    return fail("frames: error counters differ from reference");
+  if (s.resync_bytes != rs.resync_bytes) return fail("frames: resync count differs from reference");
+  if (s.overflows) return fail("frames: ring overflow");
+  return true;
+}
+
+static bool checkInput(const uint8_t* data, size_t size) {
+  gFailure = nullptr;
+  if (size == 0) return true;
+  const uint8_t sel = data[0];
+  if (sel & 0x80) return checkFrames(data + 1, size - 1, size_t(sel & 0x7F) + 1);
+  return checkPayload(data + 1, size - 1, uint8_t((sel & 0x3F) + 1));
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (!checkInput(data, size)) {
+    fprintf(stderr, "%s\n", gFailure);
+    abort();
+  }
+  return 0;
+}
+
+#ifndef UHF_LIBFUZZER
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <random>
+#include <string>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+typedef std::vector<uint8_t> Bytes;
+
+// ---------- Synthetic corpus ----------
+
+static const uint8_t kSelPayload = 0x1F;          // maxItems 32
+static const uint8_t kSelFrames  = 0x80 | 15;     // 16-byte chunks
+
+// CRC-16/EPC over PC + EPC, as the tag backscatters it
+static void putTagCrc(Bytes& p, size_t from) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = from; i < p.size(); i++) {
+    crc ^= uint16_t(p[i]) << 8;
+    for (uint8_t b = 0; b < 8; b++) crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+  }
+  crc = uint16_t(~crc);
+  p.push_back(uint8_t(crc >> 8));
+  p.push_back(uint8_t(crc));
+}
+
+static void putTag(Bytes& p, uint8_t words, std::mt19937& rng, int rssi) {
+  if (rssi >= 0) p.push_back(uint8_t(rssi));
+  const size_t at = p.size();
+  p.push_back(uint8_t(words << 3));
+  p.push_back(0x00);
+  for (uint8_t i = 0; i < words * 2; i++) p.push_back(uint8_t(rng()));
+  putTagCrc(p, at);
+}
+
+static Bytes frameOf(const Bytes& payload, uint8_t cmd = 0x22) {
+  Bytes f = {0xBB, 0x02, cmd, uint8_t(payload.size() >> 8), uint8_t(payload.size())};
+  f.insert(f.end(), payload.begin(), payload.end());
+  uint8_t sum = 0;
+  for (size_t i = 1; i < f.size(); i++) sum = uint8_t(sum + f[i]);
+  f.push_back(sum);
+  f.push_back(0x7E);
+  return f;
+}
+
+struct Seed {
+  std::string name;
+  Bytes       data;     // without the selector byte
+};
+
+static std::vector<Seed> payloadSeeds() {
+  std::mt19937 rng(15);
+  std::vector<Seed> v;
+  Seed s;
+
+  // The capture from the README: RSSI 0xD3, PC 0x3030, 96-bit EPC
+  s.name = "real_m5_epc96";
+  s.data = {0xD3, 0x30, 0x30, 0xAC, 0x71, 0x37, 0x62, 0x95, 0x7E, 0xBF, 0x1C, 0x72, 0x29, 0x94, 0x75};
+  putTagCrc(s.data, 1);
+  v.push_back(s);
+
+  for (uint8_t words = 6; words <= 31; words += words < 16 ? 2 : 5) {
+    char name[32];
+    snprintf(name, sizeof(name), "m5_epc%u", unsigned(words * 16));
+    s.name = name; s.data.clear();
+    putTag(s.data, words, rng, 0xC0 + words);
+    v.push_back(s);
+
+    snprintf(name, sizeof(name), "raw_epc%u_padded", unsigned(words * 16));
+    s.name = name; s.data.assign(2, 0x00);
+    putTag(s.data, words, rng, -1);
+    s.data.insert(s.data.end(), 8, 0x00);
+    v.push_back(s);
+  }
+
+  s.name = "raw_multi4"; s.data.assign(2, 0x00);
+  for (int i = 0; i < 4; i++) putTag(s.data, uint8_t(6 + 3 * i), rng, i ? 0xB0 + i : -1);
+  v.push_back(s);
+
+  s.name = "zeros505"; s.data.assign(505, 0x00);
+  v.push_back(s);
+
+  s.name = "low505"; s.data.clear();
+  for (int i = 0; i < 505; i++) s.data.push_back(uint8_t(rng() % 0x30));
+  v.push_back(s);
+
+  s.name = "garbage505"; s.data.clear();
+  for (int i = 0; i < 505; i++) s.data.push_back(uint8_t(rng()));
+  v.push_back(s);
+
+  s.name = "pc_zero_runs505"; s.data.clear();
+  while (s.data.size() + 64 <= 505) {
+    s.data.push_back(0xF8); s.data.push_back(0xF8);
+    s.data.insert(s.data.end(), 62, 0x00);
+  }
+  s.data.resize(505, 0x00);
+  v.push_back(s);
+  return v;
+}
+
+static std::vector<Seed> frameSeeds(const std::vector<Seed>& payloads) {
+  std::mt19937 rng(16);
+  std::vector<Seed> v;
+  Seed s;
+
+  s.name = "frames_clean";
+  for (size_t i = 0; i < 8 && i < payloads.size(); i++) {
+    const Bytes f = frameOf(payloads[i].data);
+    s.data.insert(s.data.end(), f.begin(), f.end());
+  }
+  v.push_back(s);
+
+  s.name = "frames_noisy"; s.data.clear();
+  for (size_t i = 0; i < 6; i++) {
+    const Bytes f = frameOf(payloads[i].data);
+    s.data.insert(s.data.end(), f.begin(), f.end());
+    for (int k = 0; k < 9; k++) s.data.push_back(uint8_t(rng()));
+  }
+  v.push_back(s);
+
+  Bytes f = frameOf(payloads[0].data);
+  s.name = "frame_bad_checksum"; s.data = f; s.data[f.size() - 2] ^= 0x01;
+  s.data.insert(s.data.end(), f.begin(), f.end());
+  v.push_back(s);
+
+  s.name = "frame_bad_trailer"; s.data = f; s.data.back() = 0x7F;
+  s.data.insert(s.data.end(), f.begin(), f.end());
+  v.push_back(s);
+
+  s.name = "frame_bad_length"; s.data = {0xBB, 0x02, 0x22, 0xFF, 0xFF, 0x00, 0x00};
+  s.data.insert(s.data.end(), f.begin(), f.end());
+  v.push_back(s);
+
+  s.name = "frame_truncated"; s.data = f;
+  s.data.insert(s.data.end(), f.begin(), f.begin() + f.size() / 2);
+  v.push_back(s);
+
+  s.name = "frame_max_payload";
+  s.data = frameOf(payloads.back().data);
+  v.push_back(s);
+
+  s.name = "frame_stop_reply"; s.data = {0xBB, 0x01, 0x28, 0x00, 0x01, 0x00, 0x2A, 0x7E};
+  v.push_back(s);
+  return v;
+}
+
+static std::vector<Bytes> builtinCorpus(std::vector<std::string>* names) {
+  const std::vector<Seed> payloads = payloadSeeds();
+  std::vector<Bytes> out;
+  for (const Seed& s : payloads) {
+    Bytes b(1, kSelPayload);
+    b.insert(b.end(), s.data.begin(), s.data.end());
+    out.push_back(b);
+    if (names) names->push_back("payload_" + s.name);
+  }
+  for (const Seed& s : frameSeeds(payloads)) {
+    Bytes b(1, kSelFrames);
+    b.insert(b.end(), s.data.begin(), s.data.end());
+    out.push_back(b);
+    if (names) names->push_back(s.name);
+  }
+  return out;
+}
+
+// ---------- Files ----------
+
+static bool readFile(const std::string& path, Bytes& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  out.clear();
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const std::string& path, const Bytes& data) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static bool loadCorpus(const std::string& path, std::vector<Bytes>& out) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return false;
+  if (!S_ISDIR(st.st_mode)) {
+    Bytes b;
+    if (!readFile(path, b)) return false;
+    out.push_back(b);
+    return true;
+  }
+  DIR* d = opendir(path.c_str());
+  if (!d) return false;
+  while (dirent* e = readdir(d)) {
+    if (e->d_name[0] == '.') continue;
+    Bytes b;
+    if (readFile(path + "/" + e->d_name, b)) out.push_back(b);
+  }
+  closedir(d);
+  return true;
+}
+
+// ---------- Mutations ----------
+
+static void mutate(Bytes& b, const std::vector<Bytes>& corpus, std::mt19937& rng, size_t max_len) {
+  static const uint8_t kInteresting[] = {0x00, 0x01, 0x2F, 0x30, 0x7E, 0x7F, 0x80, 0xBB, 0xF8, 0xFF};
+  const int steps = 1 + int(rng() % 8);
+  for (int s = 0; s < steps; s++) {
+    const size_t n = b.size();
+    switch (rng() % 8) {
+      case 0: if (n) b[rng() % n] ^= uint8_t(1u << (rng() % 8)); break;
+      case 1: if (n) b[rng() % n] = uint8_t(rng()); break;
+      case 2: if (n) b[rng() % n] = kInteresting[rng() % sizeof(kInteresting)]; break;
+      case 3: {                                   // insert a few random bytes
+        const size_t at = n ? rng() % (n + 1) : 0;
+        b.insert(b.begin() + at, 1 + rng() % 8, uint8_t(rng()));
+        break;
+      }
+      case 4: if (n > 1) {                        // erase a range
+        const size_t at = 1 + rng() % (n - 1);
+        b.erase(b.begin() + at, b.begin() + std::min(n, at + 1 + rng() % 32));
+      }
+      break;
+      case 5: if (n > 1) {                        // duplicate a range
+        const size_t at = 1 + rng() % (n - 1);
+        const Bytes r(b.begin() + at, b.begin() + std::min(n, at + 1 + rng() % 64));
+        b.insert(b.begin() + (1 + rng() % (n - 1)), r.begin(), r.end());
+      }
+      break;
+      case 6: {                                   // splice another input's tail
+        const Bytes& o = corpus[rng() % corpus.size()];
+        if (o.size() > 1 && n > 1) {
+          b.resize(1 + rng() % (n - 1));
+          b.insert(b.end(), o.begin() + (1 + rng() % (o.size() - 1)), o.end());
+        }
+        break;
+      }
+      case 7: if (n) b[0] = uint8_t(rng()); break;   // other target / chunk / maxItems
+    }
+  }
+  if (b.size() > max_len) b.resize(max_len);
+}
+
+// ---------- Driver ----------
+
+static std::string gCrashDir = ".";
+static Bytes gCurrent;
+
+static void saveCrash() {
+  char path[256];
+  uint32_t h = 2166136261u;
+  for (uint8_t c : gCurrent) h = (h ^ c) * 16777619u;
+  snprintf(path, sizeof(path), "%s/crash-%08x", gCrashDir.c_str(), (unsigned)h);
+  if (writeFile(path, gCurrent)) fprintf(stderr, "input saved to %s\n", path);
+}
+
+// Copies into an exact-size heap buffer so ASan sees any read past the end
+static bool runOne(const Bytes& input) {
+  gCurrent = input;
+  uint8_t* p = static_cast<uint8_t*>(malloc(input.size() ? input.size() : 1));
+  memcpy(p, input.data(), input.size());
+  const bool ok = checkInput(p, input.size());
+  free(p);
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", gFailure);
+    saveCrash();
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  uint64_t runs = 100000;
+  uint32_t seed = 1;
+  size_t   max_len = 1200;
+  const char* write_dir = nullptr;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--runs" && i + 1 < argc)              runs = strtoull(argv[++i], nullptr, 10);
+    else if (k == "--seed" && i + 1 < argc)         seed = uint32_t(strtoul(argv[++i], nullptr, 10));
+    else if (k == "--max-len" && i + 1 < argc)      max_len = size_t(atol(argv[++i]));
+    else if (k == "--crash-dir" && i + 1 < argc)    gCrashDir = argv[++i];
+    else if (k == "--write-corpus" && i + 1 < argc) write_dir = argv[++i];
+    else if (k.size() > 2 && k[0] == '-' && k[1] == '-') {
+      fprintf(stderr, "usage: %s [--runs N] [--seed S] [--max-len L] [--crash-dir DIR] [FILE|DIR ...]\n"
+                      "       %s --write-corpus DIR\n", argv[0], argv[0]);
+      return 2;
+    }
+    else inputs.push_back(k);
+  }
+
+  if (write_dir) {
+    mkdir(write_dir, 0755);
+    std::vector<std::string> names;
+    const std::vector<Bytes> corpus = builtinCorpus(&names);
+    for (size_t i = 0; i < corpus.size(); i++) {
+      if (!writeFile(std::string(write_dir) + "/" + names[i], corpus[i])) {
+        fprintf(stderr, "cannot write to %s\n", write_dir);
+        return 1;
+      }
+    }
+    printf("%u corpus files written to %s\n", (unsigned)corpus.size(), write_dir);
+    return 0;
+  }
+
+#if defined(__SANITIZE_ADDRESS__)
+  __sanitizer_set_death_callback(saveCrash);
+#endif
+
+  std::vector<Bytes> corpus;
+  for (const std::string& in : inputs) {
+    if (!loadCorpus(in, corpus)) {
+      fprintf(stderr, "cannot read %s\n", in.c_str());
+      return 2;
+    }
+  }
+  if (corpus.empty()) corpus = builtinCorpus(nullptr);
+
+  for (const Bytes& b : corpus) {
+    if (!runOne(b)) return 1;
+  }
+  printf("corpus: %u inputs OK\n", (unsigned)corpus.size());
+
+  std::mt19937 rng(seed);
+  uint64_t payload_runs = 0, frame_runs = 0;
+  for (uint64_t r = 0; r < runs; r++) {
+    Bytes b;
+    if (rng() % 16 == 0) {                         // now and then, plain noise
+      b.resize(1 + rng() % max_len);
+      for (uint8_t& c : b) c = uint8_t(rng());
+    } else {
+      b = corpus[rng() % corpus.size()];
+      mutate(b, corpus, rng, max_len);
+    }
+    if (!b.empty() && (b[0] & 0x80)) frame_runs++;
+    else payload_runs++;
+    if (!runOne(b)) return 1;
+  }
+  printf("mutations: %llu runs (%llu payload, %llu frames), seed %u\n", (unsigned long long)runs,
+         (unsigned long long)payload_runs, (unsigned long long)frame_runs, (unsigned)seed);
+  printf("OK\n");
+  return 0;
+}
+
+#endif  // UHF_LIBFUZZER
@@ -0,0 +1,396 @@
+#include "jrd4035_sim.h"
+
+#include <algorithm>
+
+static uint8_t simCs8(const uint8_t* p, size_t n) {
+  uint32_t s = 0; for (size_t i = 0; i < n; i++) s += p[i]; return uint8_t(s & 0xFF);
+}
+
+// Gen2 CRC-16 (poly 0x1021, preset 0xFFFF, inverted) over PC + EPC
+static uint16_t simCrc16(const uint8_t* p, size_t n) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= uint16_t(p[i]) << 8;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+  }
+  return uint16_t(~crc);
+}
+
+static uint8_t epcWords(const SimTag& t) {
+  uint8_t w = (t.pc >> 11) & 0x1F;
+  return w > t.epc_capacity_words ? t.epc_capacity_words : w;
+}
+
+Jrd4035Sim::Jrd4035Sim(const SimConfig& cfg)
+  : cfg_(cfg), stats_(), rng_(cfg.seed), host_tx_free_us_(0), line_free_us_(0),
+    multi_active_(false), multi_rounds_left_(0), next_round_us_(0), query_(0x1020),
+    tx_power_(2600),
+    sel_valid_(false), sel_bank_(0), sel_ptr_bits_(0), sel_len_bits_(0) {
+  memset(sel_mask_, 0, sizeof(sel_mask_));
+}
+
+// ---------- Tag population ----------
+SimTag& Jrd4035Sim::addTag(const uint8_t* epc, uint8_t epc_words, uint8_t rssi) {
+  SimTag t;
+  memset(&t, 0, sizeof(t));
+  if (epc_words < 1) epc_words = 1;
+  if (epc_words > 31) epc_words = 31;
+  t.pc = uint16_t(epc_words) << 11;
+  t.epc_capacity_words = epc_words < 8 ? 8 : epc_words;
+  if (epc) memcpy(t.epc, epc, size_t(epc_words) * 2);
+  t.tid[0] = 0xE2; t.tid[1] = 0x80; t.tid[2] = 0x11; t.tid[3] = 0x05;
+  for (int i = 4; i < 12; i++) t.tid[i] = uint8_t(rng_());
+  t.user_words = 32;
+  t.rssi = rssi;
+  t.present = true;
+  tags_.push_back(t);
+  return tags_.back();
+}
+
+void Jrd4035Sim::addRandomTags(size_t count, uint8_t epc_words) {
+  uint8_t epc[62];
+  for (size_t n = 0; n < count; n++) {
+    for (size_t i = 0; i < sizeof(epc); i++) epc[i] = uint8_t(rng_());
+    epc[0] = 0xAC; epc[1] = 0x71;
+    addTag(epc, epc_words, uint8_t(0x80 + rng_() % 0x70));
+  }
+}
+
+// ---------- UART model ----------
+void Jrd4035Sim::emit(uint8_t type, uint8_t cmd, const uint8_t* payload, size_t plen, uint64_t at_us) {
+  uint8_t f[5 + 512 + 2];
+  if (plen > 512) plen = 512;
+  size_t i = 0;
+  f[i++] = 0xBB; f[i++] = type; f[i++] = cmd;
+  f[i++] = uint8_t(plen >> 8); f[i++] = uint8_t(plen);
+  if (plen) memcpy(&f[i], payload, plen);
+  i += plen;
+  f[i] = simCs8(&f[1], i - 1); i++;
+  f[i++] = 0x7E;
+
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  uint64_t t = std::max(at_us, line_free_us_);
+  for (size_t k = 0; k < i; k++) {
+    t += byteUs();
+    uint8_t b = f[k];
+    if (cfg_.noise_drop > 0 && u(rng_) < cfg_.noise_drop) { stats_.bytes_dropped++; continue; }
+    if (cfg_.noise_flip > 0 && u(rng_) < cfg_.noise_flip) { b ^= uint8_t(1u << (rng_() % 8)); stats_.bytes_flipped++; }
+    RxByte rb = { t, b };
+    rx_.push_back(rb);
+  }
+  line_free_us_ = t;
+  stats_.frames_out++;
+  stats_.bytes_out += uint32_t(i);
+}
+
+void Jrd4035Sim::emitError(uint8_t, uint8_t code, uint64_t at_us) {
+  emit(0x01, 0xFF, &code, 1, at_us);
+}
+
+void Jrd4035Sim::pump() {
+  const uint64_t now = hostClockMicros();
+  while (multi_active_ && next_round_us_ <= now) {
+    next_round_us_ = runRound(next_round_us_);
+    if (multi_rounds_left_ > 0 && --multi_rounds_left_ == 0) multi_active_ = false;
+  }
+}
+
+int Jrd4035Sim::available() {
+  HostAllocExempt exempt;
+  pump();
+  uint64_t now = hostClockMicros();
+  int n = 0;
+  for (size_t i = 0; i < rx_.size() && rx_[i].at_us <= now; i++) n++;
+  if (n > 0) return n;
+
+  // Nothing on the line yet: let time pass until the next event (max 1 ms),
+  // like a real port would while the caller spins.
+  uint64_t next = now + 1000;
+  if (!rx_.empty()) next = std::min(next, rx_.front().at_us);
+  if (multi_active_) next = std::min(next, next_round_us_);
+  if (next <= now) next = now + 1;
+  hostClockSet(next);
+  pump();
+  now = hostClockMicros();
+  for (size_t i = 0; i < rx_.size() && rx_[i].at_us <= now; i++) n++;
+  return n;
+}
+
+int Jrd4035Sim::read() {
+  HostAllocExempt exempt;
+  pump();
+  if (rx_.empty() || rx_.front().at_us > hostClockMicros()) return -1;
+  uint8_t b = rx_.front().b;
+  rx_.pop_front();
+  return b;
+}
+
+size_t Jrd4035Sim::write(const uint8_t* data, size_t len) {
+  HostAllocExempt exempt;
+  if (!data || len == 0) return 0;
+  host_tx_free_us_ = std::max<uint64_t>(hostClockMicros(), host_tx_free_us_) + uint64_t(len) * byteUs();
+  in_.insert(in_.end(), data, data + len);
+
+  // Frame the request stream the way the module does: header, PL, CS, trailer
+  size_t off = 0;
+  while (off < in_.size()) {
+    if (in_[off] != 0xBB) { off++; continue; }
+    if (in_.size() - off < 7) break;
+    size_t pl = (size_t(in_[off + 3]) << 8) | in_[off + 4];
+    size_t flen = 5 + pl + 2;
+    if (in_.size() - off < flen) break;
+    const uint8_t* f = &in_[off];
+    if (f[flen - 1] != 0x7E || simCs8(&f[1], flen - 3) != f[flen - 2]) {
+      stats_.bad_frames_in++;
+      off++;
+      continue;
+    }
+    stats_.frames_in++;
+    handleFrame(f, flen, host_tx_free_us_);
+    off += flen;
+  }
+  in_.erase(in_.begin(), in_.begin() + off);
+  return len;
+}
+
+void Jrd4035Sim::flush() {
+  hostClockSet(host_tx_free_us_);
+}
+
+// ---------- Air interface ----------
+void Jrd4035Sim::notifyTag(const SimTag& tag, uint64_t at_us) {
+  uint8_t p[1 + 2 + 62 + 2];
+  const size_t eb = size_t(epcWords(tag)) * 2;
+  size_t i = 0;
+  p[i++] = tag.rssi;
+  p[i++] = uint8_t(tag.pc >> 8); p[i++] = uint8_t(tag.pc);
+  memcpy(&p[i], tag.epc, eb); i += eb;
+  const uint16_t crc = simCrc16(&p[1], 2 + eb);
+  p[i++] = uint8_t(crc >> 8); p[i++] = uint8_t(crc);
+  emit(0x02, 0x22, p, i, at_us);
+  stats_.notifications++;
+}
+
+uint64_t Jrd4035Sim::runRound(uint64_t start_us) {
+  if (cfg_.aloha) return runSlottedRound(start_us);
+  std::vector<size_t> order;
+  for (size_t i = 0; i < tags_.size(); i++) if (powered(tags_[i])) order.push_back(i);
+  std::shuffle(order.begin(), order.end(), rng_);
+
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  stats_.rounds++;
+  uint64_t t = start_us + cfg_.round_overhead_us;
+  for (size_t k = 0; k < order.size(); k++) {
+    if (cfg_.read_miss > 0 && u(rng_) < cfg_.read_miss) continue;
+    t += cfg_.slot_us;
+    notifyTag(tags_[order[k]], t);
+  }
+  return t;
+}
+
+// One Query round at a fixed Q: every participating tag draws a slot in
+// 0..2^Q-1; singletons are read, the rest cost an empty or collided slot.
+// S0 flags reset between rounds (the carrier drops), S1 decays after
+// s1_persist_us, S2/S3 hold while the tag stays powered.
+uint64_t Jrd4035Sim::runSlottedRound(uint64_t start_us) {
+  const uint8_t q       = (query_ >> 3) & 0x0F;
+  const uint8_t session = (query_ >> 8) & 0x03;
+  const uint8_t target  = (query_ >> 7) & 0x01;
+  const uint8_t sel     = (query_ >> 10) & 0x03;
+  const size_t  slots   = size_t(1) << q;
+
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  std::vector<uint32_t> replies(slots, 0), who(slots, 0);
+  for (size_t i = 0; i < tags_.size(); i++) {
+    SimTag& tag = tags_[i];
+    if (!powered(tag)) continue;
+    tag.inventoried &= uint8_t(~0x01);
+    if ((tag.inventoried & 0x02) && start_us >= tag.s1_until_us) tag.inventoried &= uint8_t(~0x02);
+    if (sel >= 2 && tagMatchesSelect(tag) != (sel == 3)) continue;
+    if (((tag.inventoried >> session) & 1) != target) continue;
+    if (cfg_.read_miss > 0 && u(rng_) < cfg_.read_miss) continue;   // too weak to answer
+    const size_t k = rng_() % slots;
+    replies[k]++;
+    who[k] = uint32_t(i);
+  }
+
+  stats_.rounds++;
+  uint64_t t = start_us + cfg_.round_overhead_us;
+  for (size_t s = 0; s < slots; s++) {
+    if (replies[s] == 0) {
+      t += cfg_.empty_slot_us;
+      stats_.empty_slots++;
+    } else if (replies[s] > 1) {
+      t += cfg_.collision_slot_us;
+      stats_.collision_slots++;
+    } else {
+      t += cfg_.slot_us;
+      SimTag& tag = tags_[who[s]];
+      notifyTag(tag, t);
+      tag.inventoried ^= uint8_t(1u << session);
+      if (session == 1) tag.s1_until_us = t + cfg_.s1_persist_us;
+    }
+  }
+  return t;
+}
+
+// Bank image as the tag exposes it, word-addressed from 0
+size_t Jrd4035Sim::bankImage(const SimTag& t, uint8_t bank, uint8_t* out, size_t cap) const {
+  size_t n = 0;
+  switch (bank) {
+    case 0x00:  // Reserved: kill + access passwords
+      n = std::min<size_t>(8, cap); memset(out, 0, n); break;
+    case 0x01: {
+      const size_t eb = size_t(t.epc_capacity_words) * 2;
+      if (cap < 4 + eb) return 0;
+      uint8_t pc_epc[2 + 62];
+      pc_epc[0] = uint8_t(t.pc >> 8); pc_epc[1] = uint8_t(t.pc);
+      memcpy(&pc_epc[2], t.epc, size_t(epcWords(t)) * 2);
+      const uint16_t crc = simCrc16(pc_epc, 2 + size_t(epcWords(t)) * 2);
+      out[0] = uint8_t(crc >> 8); out[1] = uint8_t(crc);
+      out[2] = pc_epc[0]; out[3] = pc_epc[1];
+      memcpy(&out[4], t.epc, eb);
+      n = 4 + eb;
+      break;
+    }
+    case 0x02:
+      n = std::min(sizeof(t.tid), cap); memcpy(out, t.tid, n); break;
+    case 0x03:
+      n = std::min<size_t>(size_t(t.user_words) * 2, cap); memcpy(out, t.user, n); break;
+  }
+  return n;
+}
+
+bool Jrd4035Sim::tagMatchesSelect(const SimTag& t) const {
+  if (!sel_valid_) return true;
+  uint8_t img[4 + 512];
+  const size_t n = bankImage(t, sel_bank_, img, sizeof(img));
+  if (sel_ptr_bits_ + sel_len_bits_ > n * 8) return false;
+  for (uint32_t b = 0; b < sel_len_bits_; b++) {
+    const uint32_t src = sel_ptr_bits_ + b;
+    const int tb = (img[src >> 3] >> (7 - (src & 7))) & 1;
+    const int mb = (sel_mask_[b >> 3] >> (7 - (b & 7))) & 1;
+    if (tb != mb) return false;
+  }
+  return true;
+}
+
+SimTag* Jrd4035Sim::accessTarget() {
+  for (size_t i = 0; i < tags_.size(); i++) {
+    if (powered(tags_[i]) && tagMatchesSelect(tags_[i])) return &tags_[i];
+  }
+  return nullptr;
+}
+
+void Jrd4035Sim::handleFrame(const uint8_t* f, size_t len, uint64_t t_us) {
+  (void)len;
+  const uint8_t  cmd = f[2];
+  const uint16_t pl  = (uint16_t(f[3]) << 8) | f[4];
+  const uint8_t* p   = &f[5];
+  // The module handles one thing at a time: a request that arrives while it
+  // is still sending a previous answer is processed after it.
+  const uint64_t at  = std::max(t_us, line_free_us_) + cfg_.cmd_latency_us;
+  const uint8_t  ok  = 0x00;
+
+  switch (cmd) {
+    case 0x22: {   // single poll
+      if (cfg_.reject_single_poll) { emitError(cmd, 0x17, at); break; }
+      const uint32_t before = stats_.notifications;
+      const uint64_t end = runRound(at);
+      if (stats_.notifications == before) emitError(cmd, 0x15, end);
+      break;
+    }
+    case 0x27: {   // multi-poll: 0x22, CNT_H, CNT_L
+      uint16_t count = pl >= 3 ? uint16_t((uint16_t(p[1]) << 8) | p[2]) : 1;
+      if (count == 0) count = 1;
+      multi_active_ = true;
+      multi_rounds_left_ = count;
+      next_round_us_ = at;
+      break;
+    }
+    case 0x28:     // stop multi-poll
+      multi_active_ = false;
+      multi_rounds_left_ = 0;
+      emit(0x01, cmd, &ok, 1, at);
+      break;
+    case 0x0C: {   // select: SelParam, Ptr(4, bits), MaskLen(bits), Truncate, Mask
+      if (pl < 7) { emitError(cmd, 0x17, at); break; }
+      const uint8_t mask_bits = p[5];
+      const size_t  mask_bytes = (size_t(mask_bits) + 7) / 8;
+      if (pl < 7 + mask_bytes || mask_bytes > sizeof(sel_mask_)) { emitError(cmd, 0x17, at); break; }
+      sel_bank_ = p[0] & 0x03;
+      sel_ptr_bits_ = (uint32_t(p[1]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 8) | p[4];
+      sel_len_bits_ = mask_bits;
+      memcpy(sel_mask_, &p[7], mask_bytes);
+      sel_valid_ = mask_bits > 0;
+      emit(0x01, cmd, &ok, 1, at);
+      break;
+    }
+    case 0x12:     // select mode
+      emit(0x01, cmd, &ok, 1, at);
+      break;
+    case 0x0E:     // set query parameters: one 16-bit word
+      if (pl != 2) { emitError(cmd, 0x17, at); break; }
+      query_ = uint16_t((uint16_t(p[0]) << 8) | p[1]);
+      emit(0x01, cmd, &ok, 1, at);
+      break;
+    case 0x0D: {   // get query parameters
+      const uint8_t w[2] = { uint8_t(query_ >> 8), uint8_t(query_) };
+      emit(0x01, cmd, w, 2, at);
+      break;
+    }
+    case 0xB6: {   // set output power: 0.01 dBm, 16 bits
+      const uint16_t v = pl == 2 ? uint16_t((uint16_t(p[0]) << 8) | p[1]) : 0;
+      if (v < 1000 || v > 3000) { emitError(cmd, 0x17, at); break; }
+      tx_power_ = v;
+      emit(0x01, cmd, &ok, 1, at);
+      break;
+    }
+    case 0xB7: {   // get output power
+      const uint8_t w[2] = { uint8_t(tx_power_ >> 8), uint8_t(tx_power_) };
+      emit(0x01, cmd, w, 2, at);
+      break;
+    }
+    case 0x39: {   // read: AccessPwd(4), MemBank, WordPtr(2), DL(2)
+      if (pl != 9) { emitError(cmd, 0x17, at); break; }
+      const uint8_t  bank = p[4];
+      const uint16_t ptr  = (uint16_t(p[5]) << 8) | p[6];
+      const uint16_t dl   = (uint16_t(p[7]) << 8) | p[8];
+      SimTag* t = accessTarget();
+      if (!t) { emitError(cmd, 0x09, at); break; }
+      uint8_t img[4 + 512];
+      const size_t n = bankImage(*t, bank, img, sizeof(img));
+      if (dl == 0 || (size_t(ptr) + dl) * 2 > n) { emitError(cmd, 0xA3, at); break; }
+      if (t->max_read_words && dl > t->max_read_words) { emitError(cmd, 0xA3, at); break; }
+      emit(0x01, cmd, &img[size_t(ptr) * 2], size_t(dl) * 2, at);
+      break;
+    }
+    case 0x49: {   // write: AccessPwd(4), MemBank, WordPtr(2), DL(2), Data
+      if (pl < 9) { emitError(cmd, 0x17, at); break; }
+      const uint8_t  bank = p[4];
+      const uint16_t ptr  = (uint16_t(p[5]) << 8) | p[6];
+      const uint16_t dl   = (uint16_t(p[7]) << 8) | p[8];
+      if (dl == 0 || pl != 9 + size_t(dl) * 2) { emitError(cmd, 0x17, at); break; }
+      SimTag* t = accessTarget();
+      if (!t) { emitError(cmd, 0x09, at); break; }
+      if (bank == 0x02) { emitError(cmd, 0xA4, at); break; }
+      if (tx_power_ < t->write_dbm100) { emitError(cmd, 0xB3, at + cfg_.write_word_us); break; }
+      uint8_t img[4 + 512];
+      const size_t n = bankImage(*t, bank, img, sizeof(img));
+      if ((size_t(ptr) + dl) * 2 > n) { emitError(cmd, 0xA3, at); break; }
+      if (t->max_write_words && dl > t->max_write_words) { emitError(cmd, 0xA3, at); break; }
+      memcpy(&img[size_t(ptr) * 2], &p[9], size_t(dl) * 2);
+      if (bank == 0x01) {
+        t->pc = (uint16_t(img[2]) << 8) | img[3];
+        memcpy(t->epc, &img[4], size_t(t->epc_capacity_words) * 2);
+      } else if (bank == 0x03) {
+        memcpy(t->user, img, n);
+      }
+      emit(0x01, cmd, &ok, 1, at + uint64_t(dl) * cfg_.write_word_us);
+      break;
+    }
+    default:
+      emitError(cmd, 0x17, at);
+      break;
+  }
+}
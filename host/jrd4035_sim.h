@@ -0,0 +1,140 @@
+#pragma once
+// Software JRD-4035 module for the Linux build.
+//
+// Implements UhfTransport so the unmodified protocol core can be attached
+// with uhfAttachTransport(&sim). Bytes travel over a simulated 8N1 UART:
+// every reply byte gets an arrival timestamp on the virtual clock
+// (host/shim/Arduino.h), and available() advances that clock while the
+// firmware busy-waits, exactly as a real port would make it wait.
+//
+// Commands answered: 0x22 single poll, 0x27 multi-poll, 0x28 stop,
+// 0x0C select, 0x12 select mode, 0x0E / 0x0D query parameters, 0xB6 / 0xB7
+// output power, 0x39 read, 0x49 write.
+//
+// Inventory rounds read every present tag once by default. With
+// SimConfig::aloha they follow the query parameters instead: fixed-Q framed
+// slotted ALOHA over 2^Q slots, where only tags whose session flag matches
+// the target take part and a read flips that flag.
+//
+// Power: a tag with read_dbm100 set is only inventoried and accessed
+// (0x09 otherwise) once the output power reaches it; a write below its
+// write_dbm100 fails with 0xB3. 0 keeps the tag powered at any level.
+
+#include <Arduino.h>
+#include <deque>
+#include <random>
+#include <vector>
+#include "uhf_transport.h"
+
+struct SimTag {
+  uint16_t pc;                  // EPC bank word 1
+  uint8_t  epc[62];             // EPC bank from word 2
+  uint8_t  epc_capacity_words;  // writable EPC words (6..31)
+  uint8_t  tid[12];
+  uint8_t  user[512];
+  uint16_t user_words;          // user bank size (up to 256)
+  uint8_t  rssi;                // raw RSSI byte reported in notifications
+  bool     present;
+  uint8_t  inventoried;         // session flags, bit n = Sn is B (aloha model)
+  uint64_t s1_until_us;         // S1 flag decays back to A at this time
+  uint16_t read_dbm100;         // output power it needs to answer, 0 = any
+  uint16_t write_dbm100;        // output power it needs to write, 0 = any
+  uint8_t  max_read_words;      // longest 0x39 it answers, 0 = any (else 0xA3)
+  uint8_t  max_write_words;     // longest 0x49 it accepts, 0 = any (else 0xA3)
+};
+
+struct SimConfig {
+  uint32_t baud;                // UART speed, 8N1
+  uint32_t cmd_latency_us;      // end of request -> first reply byte
+  uint32_t round_overhead_us;   // Query/anti-collision cost per inventory round
+  uint32_t slot_us;             // air time per singulated tag
+  uint32_t write_word_us;       // Gen2 write time per word
+  double   noise_flip;          // per reply byte: probability of a bit flip
+  double   noise_drop;          // per reply byte: probability it is lost
+  double   read_miss;           // per tag per round: probability it is not read
+  bool     reject_single_poll;  // answer 0x22 with error 0x17 (older firmware)
+  bool     aloha;               // slotted rounds driven by the query parameters
+  uint32_t empty_slot_us;       // aloha: slot nobody answered
+  uint32_t collision_slot_us;   // aloha: two or more RN16 replies
+  uint32_t s1_persist_us;       // aloha: S1 flag persistence
+  uint32_t seed;
+
+  SimConfig()
+    : baud(115200), cmd_latency_us(1500), round_overhead_us(4000),
+      slot_us(2500), write_word_us(4000), noise_flip(0), noise_drop(0),
+      read_miss(0), reject_single_poll(false), aloha(false), empty_slot_us(250),
+      collision_slot_us(600), s1_persist_us(1000000), seed(1) {}
+};
+
+struct SimStats {
+  uint32_t frames_in;           // well-formed requests received
+  uint32_t bad_frames_in;       // requests dropped (checksum / trailer)
+  uint32_t frames_out;
+  uint32_t bytes_out;
+  uint32_t rounds;              // inventory rounds run (0x22 and 0x27)
+  uint32_t notifications;       // tag frames sent by inventories
+  uint32_t bytes_dropped;
+  uint32_t bytes_flipped;
+  uint32_t empty_slots;         // aloha model only
+  uint32_t collision_slots;
+};
+
+class Jrd4035Sim : public UhfTransport {
+public:
+  explicit Jrd4035Sim(const SimConfig& cfg = SimConfig());
+
+  // ---- Tag population ----
+  SimTag& addTag(const uint8_t* epc, uint8_t epc_words, uint8_t rssi);
+  void    addRandomTags(size_t count, uint8_t epc_words);
+  std::vector<SimTag>& tags() { return tags_; }
+
+  SimConfig& config() { return cfg_; }
+  const SimStats& stats() const { return stats_; }
+  bool multiPollActive() const { return multi_active_; }
+  uint16_t queryWord() const { return query_; }
+  uint16_t txPower() const { return tx_power_; }
+
+  // ---- UhfTransport ----
+  int    available() override;
+  int    read() override;
+  size_t write(const uint8_t* data, size_t len) override;
+  void   flush() override;
+
+private:
+  struct RxByte { uint64_t at_us; uint8_t b; };
+
+  uint32_t byteUs() const { return 10000000u / cfg_.baud; }
+  void     pump();
+  void     handleFrame(const uint8_t* f, size_t len, uint64_t t_us);
+  void     emit(uint8_t type, uint8_t cmd, const uint8_t* payload, size_t plen, uint64_t at_us);
+  void     emitError(uint8_t cmd_for, uint8_t code, uint64_t at_us);
+  uint64_t runRound(uint64_t start_us);   // returns end of round
+  uint64_t runSlottedRound(uint64_t start_us);
+  void     notifyTag(const SimTag& tag, uint64_t at_us);
+  SimTag*  accessTarget();
+  bool     tagMatchesSelect(const SimTag& t) const;
+  bool     powered(const SimTag& t) const { return t.present && tx_power_ >= t.read_dbm100; }
+  size_t   bankImage(const SimTag& t, uint8_t bank, uint8_t* out, size_t cap) const;
+
+  SimConfig cfg_;
+  SimStats  stats_;
+  std::vector<SimTag> tags_;
+  std::mt19937 rng_;
+
+  std::vector<uint8_t> in_;             // request bytes not yet parsed
+  uint64_t host_tx_free_us_;
+  std::deque<RxByte> rx_;               // reply bytes with arrival time
+  uint64_t line_free_us_;
+
+  bool     multi_active_;
+  uint32_t multi_rounds_left_;
+  uint64_t next_round_us_;
+  uint16_t query_;                      // 0x0E word
+  uint16_t tx_power_;                   // 0xB6 level, 0.01 dBm
+
+  bool     sel_valid_;
+  uint8_t  sel_bank_;
+  uint32_t sel_ptr_bits_;
+  uint8_t  sel_len_bits_;
+  uint8_t  sel_mask_[32];
+};
@@ -0,0 +1,289 @@
+// Host side of the deferred log (uhf_log.h).
+//
+// Reads a console capture (file or stdin) holding "LOG DUMP" output or the
+// idle-time hex lines of "LOG HEX", and prints the records as the sketch
+// would have in "LOG TEXT" mode. Other console output is skipped. The format
+// table is compiled in: a dump from firmware with another table (hash in the
+// LOG BEGIN line) is flagged, ids past this table print their raw arguments.
+//
+// --self-test: every format through the text drain and through hex + decode
+// (same lines expected), a full ring (newest dropped, oldest kept), disabled
+// calls not evaluating their arguments, then producer threads against a
+// draining consumer (no torn or reordered record, written + dropped adds up).
+// Also prints the cost of one record against formatting the same line and
+// sending it at 115200 baud, as the synchronous Serial.printf did.
+//
+//   ./build/log_decode [FILE|-]
+//   ./build/log_decode --self-test [--threads N] [--records N]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "uhf_log.h"
+
+static double nowNs() {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static int hexVal(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// "LOG <48 hex digits>" -> record
+static bool parseHexLine(const std::string& line, UhfLogRecord& r) {
+  if (line.size() < 4 + 2 * UHF_LOG_RECORD_SIZE || line.compare(0, 4, "LOG ") != 0) return false;
+  uint8_t b[UHF_LOG_RECORD_SIZE];
+  for (size_t i = 0; i < UHF_LOG_RECORD_SIZE; i++) {
+    const int hi = hexVal(line[4 + 2 * i]), lo = hexVal(line[5 + 2 * i]);
+    if (hi < 0 || lo < 0) return false;
+    b[i] = uint8_t(hi << 4 | lo);
+  }
+  return uhfLogDecode(b, r);
+}
+
+static std::string trimEol(std::string s) {
+  while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) s.pop_back();
+  return s;
+}
+
+static int decodeStream(FILE* in) {
+  char buf[512], line[UHF_LOG_LINE_MAX];
+  uint32_t records = 0, bad = 0;
+  UhfLogRecord r;
+  while (fgets(buf, sizeof(buf), in)) {
+    const std::string s = trimEol(buf);
+    if (s.compare(0, 10, "LOG BEGIN ") == 0) {
+      const size_t at = s.find("formats ");
+      const uint32_t hash = at == std::string::npos ? 0 : uint32_t(strtoul(s.c_str() + at + 8, nullptr, 16));
+      fprintf(stderr, "%s\n", s.c_str());
+      if (hash != uhfLogFormatsHash())
+        fprintf(stderr, "warning: formats %08X here, dump made with another table\n", (unsigned)uhfLogFormatsHash());
+      continue;
+    }
+    if (s.compare(0, 4, "LOG ") != 0 || s == "LOG END") continue;
+    if (!parseHexLine(s, r)) {
+      if (s.size() == 4 + 2 * UHF_LOG_RECORD_SIZE) bad++;    // a record line, damaged
+      continue;
+    }
+    uhfLogFormatRecord(r, line, sizeof(line));
+    printf("%s\n", line);
+    records++;
+  }
+  fprintf(stderr, "%u records, %u bad lines\n", records, bad);
+  return 0;
+}
+
+// ---------- Self-test ----------
+
+static bool check(bool ok, const char* what) {
+  if (!ok) printf("  FAILED: %s\n", what);
+  return ok;
+}
+
+static void collect(const char* line, void* ctx) {
+  static_cast<std::vector<std::string>*>(ctx)->push_back(line);
+}
+
+// One record per format, at a fixed virtual time
+static void putEveryFormat() {
+  static const uint8_t frame[] = { 0xBB, 0x00, 0x22, 0x00, 0x00, 0x22, 0x7E };
+  static const uint8_t epc[40] = { 0x30, 0x08, 0x33, 0xB2, 0xDD, 0xD9, 0x01, 0x40, 0x00, 0x00, 0x00, 0x01 };
+  for (uint16_t id = 1; id < UHF_LOG_IDS; id++) {
+    if (id == UHF_LOG_ID_FRAME_TX)   uhfLogBytes(UHF_LOG_DEBUG, UHF_LOG_CAT_FRAMES, id, frame, sizeof(frame));
+    else if (id == UHF_LOG_ID_PARSE_RAW) uhfLogBytes(UHF_LOG_DEBUG, UHF_LOG_CAT_RSSI, id, epc, sizeof(epc), 320, uint32_t(-61));
+    else if (id == UHF_LOG_ID_READBACK)  uhfLogBytes(UHF_LOG_INFO, UHF_LOG_CAT_WRITE, id, epc, 12, 0x3000, 6);
+    else uhfLogPut(UHF_LOG_WARN, UHF_LOG_CAT_LINK, id, id, 0x27, uint32_t(-1), 4);
+  }
+}
+
+struct Consumer {
+  uint32_t threads;
+  std::vector<int64_t> last;         // per producer, last sequence seen
+  uint32_t slots, errors;
+  // Bytes record in progress
+  uint32_t cont_left, cont_thread, cont_seq, cont_off;
+
+  void line(const char* s) {
+    UhfLogRecord r;
+    if (!parseHexLine(s, r)) { errors++; return; }
+    slots++;
+    if (r.id == UHF_LOG_ID_BYTES) {
+      if (cont_left == 0) { errors++; return; }
+      const uint8_t* b = reinterpret_cast<const uint8_t*>(r.arg);
+      for (uint8_t k = 0; k < r.cat; k++)
+        if (b[k] != uint8_t(cont_thread * 31 + cont_seq + cont_off + k)) { errors++; break; }
+      cont_off += r.cat;
+      cont_left--;
+      return;
+    }
+    if (cont_left != 0) { errors++; cont_left = 0; }   // continuation missing
+    const uint32_t t = r.id == UHF_LOG_ID_READBACK ? r.arg[1] : r.arg[0];
+    const uint32_t i = r.id == UHF_LOG_ID_READBACK ? r.arg[2] : r.arg[1];
+    if (t >= threads || int64_t(i) <= last[t]) { errors++; return; }
+    last[t] = i;
+    if (r.id == UHF_LOG_ID_READBACK) {
+      const uint32_t kept = min<uint32_t>(r.arg[0], UHF_LOG_BYTES_MAX);
+      cont_left = (kept + UHF_LOG_CHUNK - 1) / UHF_LOG_CHUNK;
+      cont_thread = t; cont_seq = i; cont_off = 0;
+    } else if (r.id != UHF_LOG_ID_CORRUPTED_REPLY || r.arg[2] != i * 2654435761u ||
+               r.arg[3] != (t ^ i ^ 0x5A5A5A5Au)) {
+      errors++;
+    }
+  }
+  static void fn(const char* s, void* ctx) { static_cast<Consumer*>(ctx)->line(s); }
+};
+
+static uint32_t slotsFor(uint32_t i) {
+  if (i % 8) return 1;
+  const uint32_t len = 1 + i % 90;
+  return 1 + (min<uint32_t>(len, UHF_LOG_BYTES_MAX) + UHF_LOG_CHUNK - 1) / UHF_LOG_CHUNK;
+}
+
+static void produce(uint32_t t, uint32_t n) {
+  uint8_t data[96];
+  for (uint32_t i = 0; i < n; i++) {
+    if (i % 8 == 0) {
+      const uint32_t len = 1 + i % 90;
+      for (uint32_t k = 0; k < len; k++) data[k] = uint8_t(t * 31 + i + k);
+      uhfLogBytes(UHF_LOG_INFO, UHF_LOG_CAT_WRITE, UHF_LOG_ID_READBACK, data, len, t, i);
+    } else {
+      uhfLogPut(UHF_LOG_WARN, UHF_LOG_CAT_LINK, UHF_LOG_ID_CORRUPTED_REPLY, t, i, i * 2654435761u,
+                t ^ i ^ 0x5A5A5A5Au);
+    }
+    if ((i & 7) == 7) std::this_thread::yield();   // bursts, as tasks log
+  }
+}
+
+static int selfTest(uint32_t threads, uint32_t records) {
+  bool ok = true;
+  printf("log self-test: %u formats (hash %08X), %u-record ring, %u bytes of RAM\n", (unsigned)UHF_LOG_IDS,
+         (unsigned)uhfLogFormatsHash(), (unsigned)UHF_LOG_RECORDS,
+         (unsigned)(UHF_LOG_RECORDS * (sizeof(UhfLogRecord) + sizeof(uint32_t))));
+
+  // Text drain and hex + decode give the same lines
+  uhfLogClear();
+  std::vector<std::string> text, hex, decoded;
+  putEveryFormat();
+  uhfLogDrain(collect, &text, 1000);
+  putEveryFormat();
+  uhfLogDumpHex(collect, &hex);
+  char line[UHF_LOG_LINE_MAX];
+  for (const std::string& h : hex) {
+    UhfLogRecord r;
+    if (!parseHexLine(h, r)) continue;
+    uhfLogFormatRecord(r, line, sizeof(line));
+    decoded.push_back(line);
+  }
+  printf("  every format: %u lines, %u hex lines, e.g.\n", (unsigned)text.size(), (unsigned)hex.size());
+  for (size_t i = 0; i < text.size() && i < 4; i++) printf("    %s\n", text[i].c_str());
+  ok &= check(!text.empty() && text == decoded, "text drain and decoded hex dump differ");
+  ok &= check(hex.size() == decoded.size() + 2 && hex.front().compare(0, 10, "LOG BEGIN ") == 0 &&
+              hex.back() == "LOG END", "dump framing");
+
+  // Full ring: the oldest records stay, the newest are counted
+  uhfLogClear();
+  for (uint32_t i = 0; i < UHF_LOG_RECORDS + 10; i++) uhfLogPut(UHF_LOG_WARN, UHF_LOG_CAT_LINK, UHF_LOG_ID_INV_DONE, i);
+  UhfLogStats st = uhfLogStats();
+  std::vector<std::string> full;
+  uhfLogDrain(collect, &full, 1);
+  ok &= check(st.pending == UHF_LOG_RECORDS && st.dropped == 10 && st.written == UHF_LOG_RECORDS &&
+              full.size() == 1 && full[0].find("found=0") != std::string::npos, "full ring");
+
+  // Disabled calls: below the level, or in a masked category
+  int evaluated = 0;
+  uhfLogClear();
+  UHF_LOGD(RSSI, INV_DONE, ++evaluated);
+#undef UHF_LOG_CATEGORIES
+#define UHF_LOG_CATEGORIES UHF_LOG_CAT_LINK
+  UHF_LOGI(WRITE, WRITE_OK, ++evaluated);
+  UHF_LOGW(LINK, CORRUPTED_REPLY, ++evaluated);
+  ok &= check(evaluated == 1 && uhfLogStats().written == 1, "disabled calls evaluated or stored");
+
+  // Producers against a draining consumer
+  uhfLogClear();
+  Consumer c;
+  c.threads = threads;
+  c.last.assign(threads, -1);
+  c.slots = c.errors = c.cont_left = 0;
+  std::atomic<uint32_t> running(threads);
+  const double t0 = nowNs();
+  std::vector<std::thread> producers;
+  for (uint32_t t = 0; t < threads; t++)
+    producers.emplace_back([t, records, &running] { produce(t, records); running.fetch_sub(1); });
+  while (running.load() > 0 || uhfLogStats().pending > 0) {
+    if (uhfLogDrainHex(Consumer::fn, &c, 64) == 0) std::this_thread::yield();
+  }
+  for (std::thread& p : producers) p.join();
+  const double mt_ms = (nowNs() - t0) / 1e6;
+  uint64_t attempted = 0;
+  for (uint32_t i = 0; i < records; i++) attempted += slotsFor(i);
+  attempted *= threads;
+  st = uhfLogStats();
+  printf("  %u producers x %u records against one consumer: %u slots taken, %u dropped, %u errors, %.1f ms\n",
+         threads, records, c.slots, st.dropped, c.errors, mt_ms);
+  ok &= check(c.errors == 0 && c.cont_left == 0, "torn, reordered or incomplete records");
+  ok &= check(st.written == c.slots && uint64_t(st.written) + st.dropped == attempted, "written + dropped");
+
+  // Cost of a record, against what the synchronous printf did
+  uhfLogClear();
+  const uint32_t n = 1000000;
+  double t1 = nowNs();
+  for (uint32_t i = 0; i < n; i++) {
+    uhfLogPut(UHF_LOG_WARN, UHF_LOG_CAT_LINK, UHF_LOG_ID_LENGTH_MISMATCH, i, 64);
+    if ((i & 127) == 127) uhfLogDrain(nullptr, nullptr, 128);
+  }
+  const double put_ns = (nowNs() - t1) / n;
+  uhfLogClear();
+  uint8_t frame[24];
+  for (size_t i = 0; i < sizeof(frame); i++) frame[i] = uint8_t(i);
+  t1 = nowNs();
+  for (uint32_t i = 0; i < n; i++) {
+    uhfLogBytes(UHF_LOG_DEBUG, UHF_LOG_CAT_FRAMES, UHF_LOG_ID_FRAME_RX, frame, sizeof(frame));
+    if ((i & 31) == 31) uhfLogDrain(nullptr, nullptr, 128);
+  }
+  const double bytes_ns = (nowNs() - t1) / n;
+  t1 = nowNs();
+  size_t chars = 0;
+  for (uint32_t i = 0; i < n; i++)
+    chars += size_t(snprintf(line, sizeof(line), "Frame length mismatch: got %u, buffer %u\n", (unsigned)i, 64u));
+  const double fmt_ns = (nowNs() - t1) / n;
+  const double uart_us = double(chars) / n * 10 * 1e6 / 115200;   // 8N1
+  printf("  one record %.0f ns, a 24-byte frame dump %.0f ns; the same printf: %.0f ns to format, "
+         "%.0f us at 115200 baud\n", put_ns, bytes_ns, fmt_ns, uart_us);
+  uhfLogClear();
+
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  bool self_test = false;
+  uint32_t threads = 4, records = 200000;
+  const char* path = "-";
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--self-test")                    self_test = true;
+    else if (k == "--threads" && i + 1 < argc) threads = uint32_t(max(1, atoi(argv[++i])));
+    else if (k == "--records" && i + 1 < argc) records = uint32_t(max(1, atoi(argv[++i])));
+    else if (k[0] != '-' || k == "-")          path = argv[i];
+    else {
+      fprintf(stderr, "usage: %s [FILE|-] | --self-test [--threads N] [--records N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (self_test) return selfTest(threads, records);
+  FILE* in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (!in) { fprintf(stderr, "%s: cannot read\n", path); return 1; }
+  const int rc = decodeStream(in);
+  if (in != stdin) fclose(in);
+  return rc;
+}
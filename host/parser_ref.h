@@ -0,0 +1,137 @@
+#pragma once
+// Reference implementations the optimised parsers are checked against.
+//
+// refParseInventoryPayload is _parseInventoryPayload as it was before the
+// word-wise scan (byte-by-byte window, per-position zero check), debug
+// output removed. refRssiByteToDbm is the piecewise RSSI formula the
+// lookup tables replaced. refSplitFrames is the frame grammar applied to a flat
+// buffer with no ring and no resumption. fuzz_parser and bench_parser
+// require identical results from the firmware versions.
+
+#include <Arduino.h>
+#include <vector>
+#include "universal_inventory.h"
+
+static inline int8_t refRssiByteToDbm(uint8_t v, RssiProfile profile) {
+  int16_t dbm = 0;
+  switch (profile) {
+    case RSSI_LINEAR:
+      dbm = -95 + ((int16_t)v * 85) / 255; break;
+    case RSSI_CURVED:
+      if (v > 200)      dbm = -10 - ((255 - v) * 20) / 55;   // -10..-30
+      else if (v > 100) dbm = -30 - ((200 - v) * 40) / 100;  // -30..-70
+      else              dbm = -70 - ((100 - v) * 25) / 100;  // -70..-95
+      break;
+    case RSSI_CUSTOM:
+      dbm = -50 - ((255 - v) * 45) / 255; break;
+  }
+  if (dbm > -5)   dbm = -5;
+  if (dbm < -100) dbm = -100;
+  return (int8_t)dbm;
+}
+
+static uint8_t refParseInventoryPayload(const uint8_t* payload, size_t plen,
+                                        RawTagData* out, uint8_t maxItems)
+{
+  if (!payload || !out || maxItems == 0 || plen < 3) return 0;
+
+  uint8_t found = 0;
+  size_t pos = 0;
+
+  // Fast-path: M5Stack style {RSSI | PC | 12 EPC bytes}
+  if (plen >= 15) {
+    uint8_t  rssi_byte = payload[0];
+    uint16_t pc        = (uint16_t(payload[1]) << 8) | payload[2];
+    uint8_t  epc_words = (pc >> 11) & 0x1F;
+
+    if (pc != 0x0000 && epc_words >= 6 && epc_words <= 31) {
+      const uint8_t* epc_ptr = &payload[3];
+      size_t total_bytes = epc_words * 2;
+      if (total_bytes > sizeof(out[0].epc_raw)) total_bytes = sizeof(out[0].epc_raw);
+      size_t epc_bytes = min<size_t>(12, total_bytes);
+
+      bool all_zero = true;
+      for (size_t i=0;i<epc_bytes;i++){ if (epc_ptr[i] != 0){ all_zero=false; break; } }
+      if (!all_zero) {
+        memcpy(out[0].epc_raw, epc_ptr, epc_bytes);
+        out[0].epc_len       = epc_bytes;
+        out[0].epc_len_total = uint8_t(min<size_t>(epc_words * 2, sizeof(out[0].epc_raw)));
+        out[0].rssi_dbm      = _rssibyte_to_dbm(rssi_byte);
+        out[0].rssi_raw      = rssi_byte;
+        out[0].antenna = 0; out[0].phase = 0;
+        return 1;
+      }
+    }
+  }
+
+  // Sliding-window fallback (raw protocol)
+  while (pos + 2 <= plen - 1 && found < maxItems) {
+    uint16_t pc = (uint16_t(payload[pos]) << 8) | payload[pos + 1];
+    uint8_t  epc_words = (pc >> 11) & 0x1F;
+
+    if (epc_words >= 6 && epc_words <= 31) {
+      size_t epc_bytes_total = epc_words * 2;
+      if (pos + 2 + epc_bytes_total <= plen) {
+        const uint8_t* epc_ptr = &payload[pos + 2];
+
+        bool all_zero = true;
+        for (size_t i=0;i<epc_bytes_total;i++){ if (epc_ptr[i] != 0){ all_zero=false; break; } }
+
+        if (!all_zero) {
+          size_t to_copy = min(epc_bytes_total, sizeof(out[found].epc_raw));
+          memcpy(out[found].epc_raw, epc_ptr, to_copy);
+          out[found].epc_len       = (uint8_t)to_copy;
+          out[found].epc_len_total = (uint8_t)min<size_t>(epc_bytes_total, sizeof(out[found].epc_raw));
+
+          int8_t rssi_dbm = -70;
+          uint8_t rssi_raw = 0;
+          if (pos > 0 && _looks_like_rssi(payload[pos - 1])) {
+            rssi_raw = payload[pos - 1];
+            rssi_dbm = _rssibyte_to_dbm(rssi_raw);
+          } else if (pos + 2 + epc_bytes_total < plen && _looks_like_rssi(payload[pos + 2 + epc_bytes_total])) {
+            rssi_raw = payload[pos + 2 + epc_bytes_total];
+            rssi_dbm = _rssibyte_to_dbm(rssi_raw);
+          }
+          out[found].rssi_dbm = rssi_dbm;
+          out[found].rssi_raw = rssi_raw;
+          out[found].antenna = 0; out[found].phase = 0;
+
+          found++;
+          pos += 2 + epc_bytes_total;
+          continue;
+        }
+      }
+    }
+    pos++;
+  }
+  return found;
+}
+
+struct RefFrame { size_t off; size_t len; };
+
+struct RefSplitStats {
+  uint32_t bad_checksum, bad_trailer, bad_length;
+  uint32_t resync_bytes;     // non-0xBB bytes skipped while hunting
+};
+
+// Every frame UhfFrameDecoder must find in `data`, in order
+static std::vector<RefFrame> refSplitFrames(const uint8_t* data, size_t n, RefSplitStats& st) {
+  std::vector<RefFrame> frames;
+  st.bad_checksum = st.bad_trailer = st.bad_length = st.resync_bytes = 0;
+  size_t i = 0;
+  for (;;) {
+    while (i < n && data[i] != 0xBB) { i++; st.resync_bytes++; }
+    if (n - i < 7) break;
+    const size_t pl = (size_t(data[i + 3]) << 8) | data[i + 4];
+    if (pl > UhfFrameDecoder::MAX_PAYLOAD) { st.bad_length++; i++; continue; }
+    const size_t flen = 5 + pl + 2;
+    if (n - i < flen) break;
+    if (data[i + flen - 1] != 0x7E) { st.bad_trailer++; i++; continue; }
+    uint8_t s = 0;
+    for (size_t k = 1; k < flen - 2; k++) s = uint8_t(s + data[i + k]);
+    if (s != data[i + flen - 2]) { st.bad_checksum++; i++; continue; }
+    frames.push_back(RefFrame{i, flen});
+    i += flen;
+  }
+  return frames;
+}
@@ -0,0 +1,115 @@
+// Collector side of the binary tag report stream (uhf_report.h).
+//
+// Reads the console stream of a Core2 in "OUT BIN" mode from a serial port,
+// a capture file or stdin, and prints one line per record. Text lines mixed
+// into the stream (status, stats) are skipped by the decoder. Counters go to
+// stderr at the end (or on Ctrl-C).
+//
+//   ./build/report_decode [--csv] [--baud B] [--start] [PORT|FILE|-]
+//
+// --start sends "OUT BIN" first (serial port only).
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <string>
+
+#include "uhf_report.h"
+
+static volatile sig_atomic_t gStop = 0;
+static void onSignal(int) { gStop = 1; }
+
+static speed_t baudConstant(long baud) {
+  switch (baud) {
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    case 2000000: return B2000000;
+    default:      return 0;
+  }
+}
+
+static bool setupTty(int fd, long baud) {
+  termios t;
+  if (tcgetattr(fd, &t) != 0) return false;
+  cfmakeraw(&t);
+  t.c_cc[VMIN] = 1;
+  t.c_cc[VTIME] = 0;
+  const speed_t sp = baudConstant(baud);
+  if (!sp) { fprintf(stderr, "unsupported baud %ld\n", baud); return false; }
+  cfsetispeed(&t, sp);
+  cfsetospeed(&t, sp);
+  return tcsetattr(fd, TCSANOW, &t) == 0;
+}
+
+static void printRecord(const UhfTagRecord& r, bool csv) {
+  char epc[EPC_HEX_SIZE], tid[17] = "";
+  _toHex(r.epc, r.epc_len, epc, sizeof(epc));
+  if (r.has_tid) _toHex(r.tid, 8, tid, sizeof(tid));
+  if (csv) {
+    printf("%u,%u,%s,%d,%u,%u,%s\n", r.seq, r.t_ms, epc, r.rssi_dbm, r.antenna, r.phase, tid);
+  } else {
+    printf("#%-5u %10u ms  %-24s %4d dBm  ant %u  phase %3u%s%s\n", r.seq, r.t_ms, epc,
+           r.rssi_dbm, r.antenna, r.phase, r.has_tid ? "  TID " : "", tid);
+  }
+}
+
+int main(int argc, char** argv) {
+  bool csv = false, start = false;
+  long baud = 115200;
+  std::string path = "-";
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    if (k == "--csv")                         csv = true;
+    else if (k == "--start")                  start = true;
+    else if (k == "--baud" && i + 1 < argc)   baud = atol(argv[++i]);
+    else if (k[0] != '-' || k == "-")         path = k;
+    else {
+      fprintf(stderr, "usage: %s [--csv] [--baud B] [--start] [PORT|FILE|-]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  int fd = 0;
+  if (path != "-") {
+    fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+    if (fd < 0) fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno)); return 1; }
+  }
+  const bool tty = isatty(fd);
+  if (tty && !setupTty(fd, baud)) { fprintf(stderr, "cannot configure %s\n", path.c_str()); return 1; }
+  if (start) {
+    if (!tty) { fprintf(stderr, "--start needs a serial port\n"); return 2; }
+    const char cmd[] = "OUT BIN\n";
+    if (write(fd, cmd, sizeof(cmd) - 1) < 0) { perror("write"); return 1; }
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal;          // no SA_RESTART: read() returns on Ctrl-C
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  if (csv) printf("seq,t_ms,epc,rssi_dbm,antenna,phase,tid\n");
+  UhfReportDecoder dec;
+  UhfTagRecord rec;
+  uint8_t buf[4096];
+  while (!gStop) {
+    const ssize_t n = read(fd, buf, sizeof(buf));
+    if (n == 0) break;
+    if (n < 0) { if (errno == EINTR) continue; perror("read"); break; }
+    for (ssize_t i = 0; i < n; i++)
+      if (dec.push(buf[i], rec)) printRecord(rec, csv);
+    fflush(stdout);
+  }
+
+  const UhfReportDecoderStats& st = dec.stats();
+  fprintf(stderr, "%u records, %u lost (seq gaps), rejected: %u cobs, %u crc, %u layout, %u oversize\n",
+          st.records, st.lost, st.bad_cobs, st.bad_crc, st.bad_layout, st.oversize);
+  return 0;
+}
@@ -0,0 +1,37 @@
+#include "Arduino.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+HostSerial Serial;
+
+// Atomic so the threaded pipeline tools can share it
+static std::atomic<uint64_t> g_clock_us(0);
+
+uint64_t hostClockMicros() { return g_clock_us.load(std::memory_order_relaxed); }
+void hostClockAdvance(uint64_t us) { g_clock_us.fetch_add(us, std::memory_order_relaxed); }
+void hostClockSet(uint64_t us) {
+  uint64_t cur = g_clock_us.load(std::memory_order_relaxed);
+  while (us > cur && !g_clock_us.compare_exchange_weak(cur, us, std::memory_order_relaxed)) {}
+}
+
+// Every C++ heap allocation (String, containers) goes through here
+static std::atomic<uint32_t> g_allocs(0);
+static thread_local int      g_exempt = 0;
+
+uint32_t hostAllocCount() { return g_allocs.load(std::memory_order_relaxed); }
+HostAllocExempt::HostAllocExempt() { g_exempt++; }
+HostAllocExempt::~HostAllocExempt() { g_exempt--; }
+
+void* operator new(size_t n) {
+  if (g_exempt == 0) g_allocs.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
@@ -0,0 +1,82 @@
+#pragma once
+// Minimal Arduino API for the Linux build of the protocol core.
+// Only what universal_inventory.* and friends actually use.
+//
+// Time is virtual: millis()/micros() read a simulated clock that only moves
+// when delay() is called or when the module emulator advances it while the
+// firmware busy-waits on available(). Benchmarks therefore report
+// link/protocol time, independent of how fast the host CPU is.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+// ---------- Virtual clock ----------
+uint64_t hostClockMicros();
+void     hostClockAdvance(uint64_t us);
+void     hostClockSet(uint64_t us);   // only moves forward
+
+inline uint32_t millis() { return uint32_t(hostClockMicros() / 1000); }
+inline uint32_t micros() { return uint32_t(hostClockMicros()); }
+inline void     delay(uint32_t ms) { hostClockAdvance(uint64_t(ms) * 1000); }
+inline void     delayMicroseconds(uint32_t us) { hostClockAdvance(us); }
+inline void     yield() {}
+
+#define F(s) (s)
+
+// ---------- Heap accounting (global operator new is counted) ----------
+uint32_t hostAllocCount();
+
+// Allocations made while one of these is alive are not counted (the module
+// emulator's own queues are not part of the firmware being measured)
+struct HostAllocExempt {
+  HostAllocExempt();
+  ~HostAllocExempt();
+};
+
+// ---------- String (subset) ----------
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  void   reserve(size_t n) { s_.reserve(n); }
+  size_t length() const { return s_.size(); }
+  const char* c_str() const { return s_.c_str(); }
+  char   operator[](size_t i) const { return s_[i]; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  String& operator+=(const char* s) { s_ += s; return *this; }
+  String& operator+=(const String& s) { s_ += s.s_; return *this; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  String substring(size_t from, size_t to) const { return String(s_.substr(from, to - from)); }
+private:
+  std::string s_;
+};
+
+// ---------- Serial console (stderr, so bench results stay on stdout) ----------
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+  int  available() { return 0; }
+  int  read() { return -1; }
+  size_t write(const uint8_t* b, size_t n) { return fwrite(b, 1, n, stderr); }
+  void print(const char* s) { fputs(s, stderr); }
+  void print(const String& s) { fputs(s.c_str(), stderr); }
+  void println(const char* s = "") { fputs(s, stderr); fputc('\n', stderr); }
+  void println(const String& s) { println(s.c_str()); }
+  int  printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap; va_start(ap, fmt);
+    int n = vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    return n;
+  }
+};
+extern HostSerial Serial;
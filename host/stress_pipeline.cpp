@@ -0,0 +1,216 @@
+// Threaded stress test of the continuous-mode pipeline (uhf_pipeline.*).
+//
+// A synthetic UART streams 0x22 tag notifications as fast as the ingest
+// thread takes them; the main thread plays the UI and can be slowed down to
+// force back-pressure. Runs in real time (std::thread), the virtual clock
+// is slaved to it. Checks that no byte is lost or reordered between the
+// UART and the parser and that every event is accounted for.
+//
+//   ./build/stress_pipeline [--seconds S] [--tags N] [--ui-delay-us U]
+//                           [--noise P] [--rate FRAMES_PER_S]
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "uhf_pipeline.h"
+
+// Streams notifications while a 0x27 is active, stops on 0x28 and acks it.
+// read side: ingest thread only; write side: parse thread only.
+class SyntheticUart : public UhfTransport {
+public:
+  SyntheticUart(size_t tags, double noise, double rate, uint32_t seed)
+    : noise_(noise), rate_(rate), rng_(seed), len_(0), pos_(0),
+      streaming_(false), stop_ack_(false), frames_(0), bytes_read_(0), flipped_(0), writes_(0) {
+    epcs_.resize(tags);
+    for (size_t i = 0; i < tags; i++) {
+      for (size_t k = 0; k < 12; k++) epcs_[i].b[k] = uint8_t(rng_());
+      epcs_[i].b[0] = 0xE2; epcs_[i].b[1] = 0x80;
+    }
+    t0_ = std::chrono::steady_clock::now();
+  }
+
+  bool knows(const uint8_t* epc, uint8_t len) const {
+    if (len != 12) return false;
+    for (size_t i = 0; i < epcs_.size(); i++)
+      if (memcmp(epcs_[i].b, epc, 12) == 0) return true;
+    return false;
+  }
+
+  int available() override {
+    if (pos_ == len_) refill();
+    return int(len_ - pos_);
+  }
+  int read() override {
+    if (available() <= 0) return -1;
+    bytes_read_.fetch_add(1, std::memory_order_relaxed);
+    return buf_[pos_++];
+  }
+  size_t readAvailable(uint8_t* out, size_t n) override {
+    if (available() <= 0) return 0;
+    if (n > len_ - pos_) n = len_ - pos_;
+    memcpy(out, &buf_[pos_], n);
+    pos_ += n;
+    bytes_read_.fetch_add(uint32_t(n), std::memory_order_relaxed);
+    return n;
+  }
+  size_t write(const uint8_t* d, size_t n) override {
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    if (n >= 3 && d[2] == 0x27) streaming_ = true;
+    if (n >= 3 && d[2] == 0x28) { streaming_ = false; stop_ack_ = true; }
+    return n;
+  }
+  void flush() override {}
+
+  uint32_t frames() const { return frames_.load(); }
+  uint32_t bytesRead() const { return bytes_read_.load(); }
+  uint32_t flipped() const { return flipped_.load(); }
+
+private:
+  struct Epc { uint8_t b[12]; };
+
+  void refill() {
+    pos_ = len_ = 0;
+    if (stop_ack_.exchange(false)) {
+      static const uint8_t ack[] = {0xBB, 0x01, 0x28, 0x00, 0x01, 0x00, 0x2A, 0x7E};
+      memcpy(buf_, ack, sizeof(ack));
+      len_ = sizeof(ack);
+      return;
+    }
+    if (!streaming_) return;
+    if (rate_ > 0) {
+      const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0_).count();
+      if (frames_.load() >= s * rate_) return;
+    }
+    // A burst of frames, like one inventory round
+    for (int f = 0; f < 8; f++) {
+      const Epc& e = epcs_[rng_() % epcs_.size()];
+      uint8_t* p = &buf_[len_];
+      size_t i = 0;
+      p[i++] = 0xBB; p[i++] = 0x02; p[i++] = 0x22; p[i++] = 0x00; p[i++] = 0x11;
+      p[i++] = uint8_t(0xC0 + rng_() % 0x30);       // RSSI
+      p[i++] = 0x30; p[i++] = 0x00;                 // PC: 6 words
+      memcpy(&p[i], e.b, 12); i += 12;
+      p[i++] = 0x12; p[i++] = 0x34;                 // CRC
+      uint8_t cs = 0;
+      for (size_t k = 1; k < i; k++) cs += p[k];
+      p[i++] = cs; p[i++] = 0x7E;
+      if (noise_ > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < noise_) {
+        p[rng_() % i] ^= uint8_t(1u << (rng_() % 8));
+        flipped_.fetch_add(1, std::memory_order_relaxed);
+      }
+      len_ += i;
+      frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<Epc> epcs_;
+  double noise_, rate_;
+  std::mt19937 rng_;
+  uint8_t buf_[8 * 32];
+  size_t len_, pos_;
+  std::atomic<bool> streaming_, stop_ack_;
+  std::atomic<uint32_t> frames_, bytes_read_, flipped_, writes_;
+  std::chrono::steady_clock::time_point t0_;
+};
+
+int main(int argc, char** argv) {
+  double seconds = 3.0, noise = 0.0, rate = 0.0;
+  size_t tags = 200;
+  uint32_t ui_delay_us = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    const bool has_val = i + 1 < argc;
+    if (k == "--seconds" && has_val)          seconds = atof(argv[++i]);
+    else if (k == "--tags" && has_val)        tags = size_t(atol(argv[++i]));
+    else if (k == "--ui-delay-us" && has_val) ui_delay_us = uint32_t(atol(argv[++i]));
+    else if (k == "--noise" && has_val)       noise = atof(argv[++i]);
+    else if (k == "--rate" && has_val)        rate = atof(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--seconds S] [--tags N] [--ui-delay-us U] [--noise P] [--rate F]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (tags == 0) tags = 1;
+
+  SyntheticUart uart(tags, noise, rate, 1);
+  uhfAttachTransport(&uart);
+
+  static UhfPipeline pipeline;         // tag table inside: keep it off the stack
+  UhfPipelineConfig cfg;
+  cfg.tag_expiry_ms = 200;
+  pipeline.begin(uart, cfg);
+
+  static UhfTagTable<64> ui;           // what the display would hold
+  UhfTagEvent ev[16];
+  uint32_t got = 0, unknown = 0, news = 0, gones = 0, max_total = 0;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count(); };
+  pipeline.start();
+  // One UI pass takes at most one batch; a slow UI then really falls behind
+  auto uiPass = [&]() -> bool {
+    const uint8_t n = pipeline.poll(ev, 16);
+    if (n == 0) return false;
+    for (uint8_t i = 0; i < n; i++) {
+      got++;
+      if (!uart.knows(ev[i].epc, ev[i].epc_len)) unknown++;
+      if (ev[i].total > max_total) max_total = ev[i].total;
+      bool is_new;
+      if (ev[i].kind == UHF_TAG_GONE) {
+        gones++;
+        ui.remove(ui.find(ev[i].epc, ev[i].epc_len));
+      } else {
+        if (ev[i].kind == UHF_TAG_NEW) news++;
+        ui.upsert(ev[i].epc, ev[i].epc_len, ev[i].t_ms, &is_new);
+      }
+    }
+    if (ui_delay_us) std::this_thread::sleep_for(std::chrono::microseconds(ui_delay_us));
+    return true;
+  };
+  while (elapsed() < seconds) {
+    hostClockSet(uint64_t(elapsed() * 1e6));
+    if (!uiPass()) std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  pipeline.stop();
+  while (uiPass()) {}
+  const double s = elapsed();
+  pipeline.end();
+  uhfAttachTransport(nullptr);
+
+  const UhfPipelineStats ps = pipeline.stats();
+  const UhfDecoderStats& rx = uhfRxStats();
+  printf("pipeline stress: %u tags, %.2f s, ui delay %u us, noise %.4f\n",
+         (unsigned)tags, s, ui_delay_us, noise);
+  printf("  uart     : %u frames generated, %u bytes taken, %u corrupted\n",
+         uart.frames(), uart.bytesRead(), uart.flipped());
+  printf("  ingest   : %u bytes (%.2f MB/s), %u stalls, byte ring high %u/%u\n",
+         ps.rx_bytes, ps.rx_bytes / s / 1e6, ps.rx_stalls, ps.rx_ring_high, UHF_PIPELINE_RX_RING);
+  printf("  parse    : %u tag reads (%.0f /s), %u expired; rx %u bad checksum, %u resync bytes\n",
+         ps.tag_reads, ps.tag_reads / s, ps.tags_expired, rx.bad_checksum, rx.resync_bytes);
+  printf("  events   : %u published, %u dropped, ring high %u/%u\n",
+         ps.events, ps.events_dropped, ps.event_ring_high, UHF_PIPELINE_EVENT_RING);
+  printf("  ui       : %u received (%u new, %u gone), max %u tracked, %u unknown EPCs\n",
+         got, news, gones, max_total, unknown);
+
+  // Invariants
+  int fail = 0;
+  if (ps.rx_bytes != uart.bytesRead()) { printf("FAIL: ingest bytes != UART bytes\n"); fail = 1; }
+  if (unknown) { printf("FAIL: events with an EPC the UART never sent\n"); fail = 1; }
+  if (got != ps.events) { printf("FAIL: UI received %u of %u published events\n", got, ps.events); fail = 1; }
+  if (ps.events + ps.events_dropped != ps.tag_reads + ps.tags_expired) {
+    printf("FAIL: events + dropped != reads + expired\n"); fail = 1;
+  }
+  if (noise == 0 && (rx.bad_checksum || rx.bad_trailer || rx.bad_length)) {
+    printf("FAIL: corrupted frames on a clean link (bytes lost or reordered)\n"); fail = 1;
+  }
+  if (ps.tag_reads == 0) { printf("FAIL: nothing parsed\n"); fail = 1; }
+  printf("%s\n", fail ? "FAILED" : "OK");
+  return fail;
+}
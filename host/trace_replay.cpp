@@ -0,0 +1,512 @@
+// Replays UART traces (uhf_trace.h) through the unmodified protocol core.
+//
+// Input is a trace file or a console capture holding a "TRACE DUMP" (the hex
+// lines are extracted, other console output is ignored).
+//
+// Protocol replay (default): the recorded commands are issued again through
+// the uhf* API (0x22 through rawInventoryWithRssi, 0x27 / 0x28 through the
+// multi-poll calls and uhfPollInventory, anything else through uhfTransact)
+// and the module side answers with the recorded bytes:
+//   - at recorded speed (default): each RX chunk arrives on the virtual clock
+//     at the same offset from its command as in the capture, so timeouts and
+//     the single-poll "what has arrived" cut behave as they did in the field;
+//   - --fast: every reply is there as soon as its command is written.
+// Decode replay (--decode-only): all RX bytes straight into UhfFrameDecoder
+// and _parseInventoryPayload, for parser benchmarks.
+//
+// Both print a digest of the tag reads (EPC + RSSI, in order). --expect
+// fails the run when it differs, to catch parser regressions on captures.
+//
+//   ./build/trace_replay [--fast | --decode-only] [--repeat N] [--expect DIGEST]
+//                        [--save OUT.uht] TRACE
+//   ./build/trace_replay --self-test [--save OUT.uht]   record against the emulator,
+//                                                      replay, compare
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "universal_inventory.h"
+#include "uhf_trace.h"
+#include "jrd4035_sim.h"
+
+static double nowNs() {
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// ---------- Loading ----------
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+// "TRACE BEGIN <size> ..." / "TRACE <offset> <hex>" / "TRACE END" in a console log
+static bool extractConsoleDump(const std::vector<uint8_t>& text, std::vector<uint8_t>& out) {
+  const std::string s(text.begin(), text.end());
+  size_t pos = 0, expect = 0;
+  bool in = false;
+  while (pos < s.size()) {
+    size_t eol = s.find('\n', pos);
+    if (eol == std::string::npos) eol = s.size();
+    std::string line = s.substr(pos, eol - pos);
+    pos = eol + 1;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.compare(0, 12, "TRACE BEGIN ") == 0) {
+      out.clear();
+      expect = strtoul(line.c_str() + 12, nullptr, 10);
+      in = true;
+    } else if (in && line == "TRACE END") {
+      return out.size() == expect;
+    } else if (in && line.compare(0, 6, "TRACE ") == 0) {
+      char* end = nullptr;
+      const unsigned long off = strtoul(line.c_str() + 6, &end, 16);
+      if (off != out.size() || !end || *end != ' ') return false;   // line lost
+      for (const char* h = end + 1; h[0] && h[1]; h += 2) {
+        const char byte[3] = {h[0], h[1], 0};
+        out.push_back(uint8_t(strtoul(byte, nullptr, 16)));
+      }
+    }
+  }
+  return false;
+}
+
+struct Event { uint8_t dir; uint32_t t_us; std::vector<uint8_t> data; };
+
+static bool loadTrace(const std::vector<uint8_t>& file, std::vector<Event>& events, uint8_t& flags) {
+  UhfTraceReader r;
+  if (!r.open(file.data(), file.size())) return false;
+  UhfTraceEvent ev;
+  while (r.next(ev)) {
+    Event e;
+    e.dir = ev.dir;
+    e.t_us = ev.t_us;
+    e.data.assign(ev.data, ev.data + ev.len);
+    events.push_back(e);
+  }
+  flags = r.flags();
+  return !r.bad() && events.size() == r.events();
+}
+
+// ---------- Module side: the recorded replies ----------
+
+class ReplayTransport : public UhfTransport {
+public:
+  ReplayTransport(const std::vector<Event>& ev, bool fast)
+    : ev_(ev), fast_(fast), cursor_(0), anchor_t_(0), anchor_clock_(hostClockMicros()),
+      chunk_(0), chunk_off_(0), tx_matched_(0), tx_mismatched_(0), tx_extra_(0) {
+    release();
+  }
+
+  // Next recorded command not yet sent by the replayed code, nullptr at the end
+  const Event* nextTx() const { return cursor_ < ev_.size() ? &ev_[cursor_] : nullptr; }
+  void skipTx() { if (cursor_ < ev_.size()) { cursor_++; release(); } }
+  bool rxPending() const { return chunk_ < pending_.size(); }
+  bool rxPendingBefore(uint64_t t) const { return rxPending() && pending_[chunk_].at_us < t; }
+
+  // Virtual time the next command went out at, relative to the previous one
+  uint64_t nextTxDue() const {
+    return fast_ || cursor_ >= ev_.size() ? 0 : anchor_clock_ + (ev_[cursor_].t_us - anchor_t_);
+  }
+
+  uint32_t txMatched() const    { return tx_matched_; }
+  uint32_t txMismatched() const { return tx_mismatched_; }
+  uint32_t txExtra() const      { return tx_extra_; }
+
+  int available() override {
+    size_t n = ready();
+    if (n > 0 || !rxPending()) {
+      if (n == 0) hostClockAdvance(1000);   // idle line: time passes for timeouts
+      return int(n);
+    }
+    // Nothing yet: wait for the next chunk, at most 1 ms, as a real port would
+    const uint64_t now = hostClockMicros();
+    hostClockSet(std::min<uint64_t>(now + 1000, std::max<uint64_t>(pending_[chunk_].at_us, now + 1)));
+    return int(ready());
+  }
+
+  int read() override {
+    uint8_t b;
+    return readAvailable(&b, 1) ? b : -1;
+  }
+
+  size_t readAvailable(uint8_t* buf, size_t n) override {
+    size_t got = 0;
+    const uint64_t now = hostClockMicros();
+    while (got < n && chunk_ < pending_.size() && pending_[chunk_].at_us <= now) {
+      const Event& e = ev_[pending_[chunk_].event];
+      const size_t take = std::min(n - got, e.data.size() - chunk_off_);
+      memcpy(buf + got, e.data.data() + chunk_off_, take);
+      got += take;
+      chunk_off_ += take;
+      if (chunk_off_ == e.data.size()) { chunk_++; chunk_off_ = 0; }
+    }
+    return got;
+  }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    if (cursor_ >= ev_.size()) { tx_extra_++; return len; }
+    const Event& e = ev_[cursor_];
+    if (e.data.size() == len && memcmp(e.data.data(), data, len) == 0) tx_matched_++;
+    else tx_mismatched_++;
+    anchor_t_ = e.t_us;
+    anchor_clock_ = hostClockMicros();
+    cursor_++;
+    release();
+    return len;
+  }
+
+  void flush() override {}
+
+private:
+  struct Pending { uint64_t at_us; size_t event; };
+
+  size_t ready() const {
+    const uint64_t now = hostClockMicros();
+    size_t n = 0;
+    for (size_t i = chunk_; i < pending_.size() && pending_[i].at_us <= now; i++)
+      n += ev_[pending_[i].event].data.size() - (i == chunk_ ? chunk_off_ : 0);
+    return n;
+  }
+
+  // Schedule the RX chunks up to the next recorded command
+  void release() {
+    for (; cursor_ < ev_.size() && ev_[cursor_].dir == UHF_TRACE_RX; cursor_++) {
+      Pending p;
+      p.at_us = fast_ ? 0 : anchor_clock_ + (ev_[cursor_].t_us - anchor_t_);
+      p.event = cursor_;
+      pending_.push_back(p);
+    }
+  }
+
+  const std::vector<Event>& ev_;
+  bool     fast_;
+  size_t   cursor_;
+  uint32_t anchor_t_;          // recorded time of the last command
+  uint64_t anchor_clock_;      // virtual time it was replayed at
+  std::vector<Pending> pending_;
+  size_t   chunk_, chunk_off_;
+  uint32_t tx_matched_, tx_mismatched_, tx_extra_;
+};
+
+// ---------- Results ----------
+
+struct ReplayResult {
+  uint32_t reads;
+  uint32_t unique;
+  uint64_t digest;
+  uint32_t commands;
+  uint32_t tx_matched, tx_mismatched, tx_extra;
+  double   virtual_ms;
+  double   host_ns;
+};
+
+struct ReadDigest {
+  uint64_t h = 1469598103934665603ull;   // FNV-1a 64
+  uint32_t reads = 0;
+  std::set<std::string> epcs;
+
+  void byte(uint8_t b) { h = (h ^ b) * 1099511628211ull; }
+  void add(const RawTagData* t, uint8_t n) {
+    for (uint8_t i = 0; i < n; i++) {
+      byte(t[i].epc_len);
+      for (uint8_t k = 0; k < t[i].epc_len; k++) byte(t[i].epc_raw[k]);
+      byte(uint8_t(t[i].rssi_dbm));
+      epcs.insert(std::string(reinterpret_cast<const char*>(t[i].epc_raw), t[i].epc_len));
+      reads++;
+    }
+  }
+};
+
+// Multi-poll stream open: the recorded notifications are read with
+// uhfPollInventory up to the moment the next command went out. Whatever came
+// later is taken and discarded by that command, as in the field.
+static void pollStream(ReplayTransport& rt, ReadDigest& d, uint64_t until) {
+  RawTagData buf[32];
+  while (rt.rxPendingBefore(until)) d.add(buf, uhfPollInventory(buf, 32));
+}
+
+static ReplayResult replayProtocol(const std::vector<Event>& ev, bool fast) {
+  ReplayTransport rt(ev, fast);
+  uhfAttachTransport(&rt);
+  uhfResetLinkStats();
+  uhfResetCommandTiming();
+  ReadDigest d;
+  RawTagData buf[32];
+  uint32_t commands = 0;
+  const uint64_t v0 = hostClockMicros();
+  const double t0 = nowNs();
+
+  // A capture that starts with RX began inside a stream
+  bool streaming = !ev.empty() && ev[0].dir == UHF_TRACE_RX;
+  while (const Event* tx = rt.nextTx()) {
+    const uint64_t due = rt.nextTxDue();
+    if (streaming) pollStream(rt, d, fast ? UINT64_MAX : due);
+    if (due > hostClockMicros()) hostClockSet(due);   // the caller's own pace
+
+    const std::vector<uint8_t>& f = tx->data;
+    const size_t before = size_t(tx - ev.data());
+    const uint8_t cmd = f.size() >= 7 && f[0] == 0xBB ? f[2] : 0;
+    UhfFrame r;
+    commands++;
+    if (cmd == CMD_INVENTORY) {
+      d.add(buf, rawInventoryWithRssi(buf, 32));
+    } else if (cmd == CMD_MULTI_POLL && f.size() >= 10) {
+      uhfStartMultiPoll(uint16_t((f[6] << 8) | f[7]));
+      streaming = true;
+    } else if (cmd == 0x28) {
+      uhfStopMultiInventory();
+      streaming = false;
+    } else {
+      uhfTransact(f.data(), f.size(), r, 1000);
+    }
+    // Not sent by the API (malformed record): skip it
+    if (rt.nextTx() && size_t(rt.nextTx() - ev.data()) == before) rt.skipTx();
+  }
+  if (streaming) pollStream(rt, d, UINT64_MAX);
+
+  ReplayResult res = {};
+  res.host_ns    = nowNs() - t0;
+  res.virtual_ms = (hostClockMicros() - v0) / 1000.0;
+  res.reads      = d.reads;
+  res.unique     = uint32_t(d.epcs.size());
+  res.digest     = d.h;
+  res.commands   = commands;
+  res.tx_matched    = rt.txMatched();
+  res.tx_mismatched = rt.txMismatched();
+  res.tx_extra      = rt.txExtra();
+  uhfAttachTransport(nullptr);
+  return res;
+}
+
+// All RX bytes, no commands: UhfFrameDecoder + _parseInventoryPayload only
+class MemoryTransport : public UhfTransport {
+public:
+  MemoryTransport(const uint8_t* p, size_t n) : p_(p), n_(n), pos_(0) {}
+  int    available() override { return int(n_ - pos_); }
+  int    read() override { return pos_ < n_ ? p_[pos_++] : -1; }
+  size_t readAvailable(uint8_t* buf, size_t n) override {
+    n = std::min(n, n_ - pos_);
+    memcpy(buf, p_ + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  size_t write(const uint8_t*, size_t len) override { return len; }
+  void   flush() override {}
+private:
+  const uint8_t* p_;
+  size_t n_, pos_;
+};
+
+static ReplayResult replayDecode(const std::vector<uint8_t>& rx, uint32_t& frames) {
+  static UhfFrameDecoder dec;
+  dec.reset();
+  MemoryTransport mt(rx.data(), rx.size());
+  ReadDigest d;
+  RawTagData buf[32];
+  UhfFrame f;
+  const double t0 = nowNs();
+  while (dec.pump(mt) || dec.buffered()) {
+    bool any = false;
+    while (dec.next(f)) {
+      any = true;
+      if (f.cmd() == CMD_INVENTORY && f.pl() > 0) {
+        _initRawTagData(buf, 32);
+        d.add(buf, _parseInventoryPayload(f.payload(), f.pl(), buf, 32));
+      }
+    }
+    if (!any && mt.available() == 0) break;   // trailing partial frame
+  }
+  ReplayResult res = {};
+  res.host_ns    = nowNs() - t0;
+  res.reads      = d.reads;
+  res.unique     = uint32_t(d.epcs.size());
+  res.digest     = d.h;
+  frames = dec.stats().frames;
+  return res;
+}
+
+static void printResult(const char* mode, const ReplayResult& r, size_t rx_bytes) {
+  printf("  %-8s : %u reads, %u tags, digest %016llx", mode, r.reads, r.unique, (unsigned long long)r.digest);
+  if (r.virtual_ms > 0) printf(", %.1f ms link time", r.virtual_ms);
+  printf(", %.0f us host (%.1f MB/s)\n", r.host_ns / 1000.0,
+         r.host_ns > 0 ? rx_bytes * 1000.0 / r.host_ns : 0.0);
+  if (r.commands)
+    printf("  commands : %u replayed, %u sent as recorded, %u differ, %u beyond the trace\n",
+           r.commands, r.tx_matched, r.tx_mismatched, r.tx_extra);
+}
+
+// ---------- Self-test ----------
+
+static void saveSink(const uint8_t* p, size_t n, void* ctx) {
+  std::vector<uint8_t>* v = static_cast<std::vector<uint8_t>*>(ctx);
+  v->insert(v->end(), p, p + n);
+}
+
+static void consoleSink(const char* line, void* ctx) {
+  std::string* s = static_cast<std::string*>(ctx);
+  *s += line;
+  *s += "\r\n";
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t>& data) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && ok;
+}
+
+static int selfTest(const char* save) {
+  SimConfig sc;
+  sc.read_miss = 0.3;
+  Jrd4035Sim sim(sc);
+  sim.addRandomTags(12, 6);
+  static UhfTraceRecorder rec;
+  rec.attach(&sim);
+  rec.start();
+  uhfAttachTransport(&rec);
+  uhfResetLinkStats();
+  uhfResetCommandTiming();
+  const uint64_t v0 = hostClockMicros();
+
+  // Field session: single polls, a tag access, then a multi-poll stream
+  ReadDigest live;
+  RawTagData buf[32];
+  for (int i = 0; i < 6; i++) live.add(buf, rawInventoryWithRssi(buf, 32));
+  uint8_t tid[8];
+  if (uhfSelectEpc(sim.tags()[0].epc, 12)) uhfRead(2, 0, tid, sizeof(tid), 4);
+  uhfStartMultiPoll(20);
+  const uint32_t t_stream = millis();
+  while (millis() - t_stream < 150) live.add(buf, uhfPollInventory(buf, 32));
+  uhfStopMultiInventory();
+  rec.stop();
+  const double live_ms = (hostClockMicros() - v0) / 1000.0;
+  uhfAttachTransport(nullptr);
+
+  std::vector<uint8_t> file;
+  rec.exportTrace(saveSink, &file);
+  if (save && !writeFile(save, file)) { fprintf(stderr, "%s: cannot write\n", save); return 1; }
+  const UhfTraceStats st = rec.stats();
+  printf("trace self-test: %u RX / %u TX events, %u + %u bytes of traffic, trace %u bytes\n",
+         st.rx_events, st.tx_events, st.rx_bytes, st.tx_bytes, (unsigned)file.size());
+  printf("  live     : %u reads, %u tags, digest %016llx, %.1f ms link time\n", live.reads,
+         (unsigned)live.epcs.size(), (unsigned long long)live.h, live_ms);
+
+  // The console form must give the same file back
+  std::string console = "boot noise\n";
+  uhfTraceDumpHex(rec, consoleSink, &console);
+  console += "UHF LINK ...\n";
+  std::vector<uint8_t> parsed;
+  const bool console_ok = extractConsoleDump(std::vector<uint8_t>(console.begin(), console.end()), parsed) &&
+                          parsed == file;
+
+  std::vector<Event> ev;
+  uint8_t flags = 0;
+  if (!loadTrace(file, ev, flags)) { printf("FAILED: trace does not load\n"); return 1; }
+  size_t rx_bytes = 0;
+  for (const Event& e : ev) if (e.dir == UHF_TRACE_RX) rx_bytes += e.data.size();
+
+  const ReplayResult rec_run = replayProtocol(ev, false);
+  printResult("recorded", rec_run, rx_bytes);
+  const ReplayResult fast1 = replayProtocol(ev, true);
+  const ReplayResult fast2 = replayProtocol(ev, true);
+  printResult("fast", fast1, rx_bytes);
+
+  // A small ring must keep a consistent, loadable tail of the session
+  static uint8_t ring_buf[40];
+  UhfTraceRing small_ring(ring_buf, sizeof(ring_buf));
+  for (uint32_t i = 0; i < 50; i++) { const uint8_t b[3] = {uint8_t(i), 1, 2}; small_ring.put(i * 10, b, 3); }
+  UhfTraceRing::Cursor c = small_ring.begin();
+  uint32_t walked = 0, last_t = 0;
+  while (small_ring.next(c)) { walked++; last_t = c.t_us; }
+
+  printf("  console  : %u lines, %s\n", (unsigned)std::count(console.begin(), console.end(), '\n'),
+         console_ok ? "reads back identical" : "DIFFERS");
+  const bool ok = console_ok && !(flags & UHF_TRACE_FLAG_WRAPPED) && rec_run.digest == live.h && rec_run.reads == live.reads && rec_run.tx_mismatched == 0 &&
+                  fast1.digest == fast2.digest && walked == small_ring.events() && last_t == 490 &&
+                  small_ring.overwritten() == 50 - walked;
+  printf("  ring     : %u events kept of 50, newest at %u us\n", walked, last_t);
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  bool fast = false, decode_only = false, self_test = false;
+  int repeat = 1;
+  const char* expect = nullptr;
+  const char* save = nullptr;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    std::string k = argv[i];
+    const bool has_val = i + 1 < argc;
+    if (k == "--fast")                     fast = true;
+    else if (k == "--decode-only")         decode_only = true;
+    else if (k == "--self-test")           self_test = true;
+    else if (k == "--repeat" && has_val)   repeat = std::max(1, atoi(argv[++i]));
+    else if (k == "--expect" && has_val)   expect = argv[++i];
+    else if (k == "--save" && has_val)     save = argv[++i];
+    else if (k[0] != '-')                  path = argv[i];
+    else {
+      fprintf(stderr, "usage: %s [--fast | --decode-only] [--repeat N] [--expect DIGEST] "
+                      "[--save OUT.uht] TRACE | --self-test\n", argv[0]);
+      return 2;
+    }
+  }
+  if (self_test) return selfTest(save);
+  if (!path) { fprintf(stderr, "no trace given\n"); return 2; }
+
+  std::vector<uint8_t> raw, file;
+  if (!readFile(path, raw)) { fprintf(stderr, "%s: cannot read\n", path); return 1; }
+  if (raw.size() >= 4 && memcmp(raw.data(), "UHFT", 4) == 0) file.swap(raw);
+  else if (!extractConsoleDump(raw, file)) { fprintf(stderr, "%s: no complete TRACE dump\n", path); return 1; }
+
+  std::vector<Event> ev;
+  uint8_t flags = 0;
+  if (!loadTrace(file, ev, flags)) { fprintf(stderr, "%s: bad trace\n", path); return 1; }
+  if (save && !writeFile(save, file)) { fprintf(stderr, "%s: cannot write\n", save); return 1; }
+
+  std::vector<uint8_t> rx;
+  uint32_t tx_events = 0;
+  for (const Event& e : ev) {
+    if (e.dir == UHF_TRACE_RX) rx.insert(rx.end(), e.data.begin(), e.data.end());
+    else tx_events++;
+  }
+  printf("trace %s: %u events (%u commands), %u RX bytes, %.1f ms%s\n", path, (unsigned)ev.size(),
+         tx_events, (unsigned)rx.size(), ev.empty() ? 0.0 : ev.back().t_us / 1000.0,
+         (flags & UHF_TRACE_FLAG_WRAPPED) ? ", ring wrapped (oldest traffic lost)" : "");
+
+  ReplayResult r = {};
+  for (int i = 0; i < repeat; i++) {
+    if (decode_only) {
+      uint32_t frames = 0;
+      r = replayDecode(rx, frames);
+      if (i == repeat - 1) {
+        printResult("decode", r, rx.size());
+        printf("  frames   : %u, %.0f ns per frame\n", frames, frames ? r.host_ns / frames : 0.0);
+      }
+    } else {
+      r = replayProtocol(ev, fast);
+      if (i == repeat - 1) printResult(fast ? "fast" : "recorded", r, rx.size());
+    }
+  }
+  if (!decode_only) {
+    const UhfDecoderStats& ds = uhfRxStats();
+    printf("  decoder  : %u frames, %u bad checksum, %u bad trailer, %u resync bytes\n",
+           ds.frames, ds.bad_checksum, ds.bad_trailer, ds.resync_bytes);
+  }
+  if (expect) {
+    const bool same = strtoull(expect, nullptr, 16) == r.digest;
+    printf("%s\n", same ? "OK" : "DIGEST MISMATCH");
+    return same ? 0 : 1;
+  }
+  return 0;
+}
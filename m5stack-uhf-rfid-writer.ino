@@ -5,12 +5,26 @@
 #include <M5Unified.h>
 // #include "UNIT_UHF_RFID.h"  // Plus besoin - 100% raw!
 #include "universal_inventory.h"
-
-// We need the module's port here
-extern HardwareSerial* gUhf;   // defined in universal_inventory.cpp
+#include "uhf_tag_table.h"
+#include "uhf_pipeline.h"
+#include "uhf_encoder.h"
+#include "uhf_report.h"
+#include "uhf_trace.h"
+#include "uhf_rssi.h"
+#include "uhf_query.h"
+#include "uhf_power.h"
+#include "uhf_tid_cache.h"
+#include "uhf_count.h"
+#include "uhf_multi_reader.h"
+#include "uhf_async.h"
+#include "uhf_bulk.h"
+#include "uhf_duty.h"
+#include "uhf_log.h"
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/uart.h>
 
 // hex utils (prototypes so we can call them before their body)
-static bool   hexToBytes(const String& hex, uint8_t* out, size_t max_bytes);
 static String bytesToHex(const uint8_t* data, size_t len);
 
 // === Codes d'erreur ===
@@ -42,9 +56,8 @@ static constexpr uint32_t CMD_TIMEOUT  = 500;      // Timeout commandes ms
 static constexpr uint32_t LONG_PRESS_DURATION = 1000;  // 1 seconde pour appui long
 static constexpr uint16_t BEEP_FREQ = 1000;     // Fréquence bip 1kHz (plus discret)
 static constexpr uint8_t BEEP_DURATION = 25;    // Durée bip 25ms (4x plus court)
-
-// === Debug toggle ===
-#define DEBUG_UHF_FRAMES 0  // Mettre à 1 pour activer le debug hex
+static constexpr uint32_t CONSOLE_BAUD = 115200;   // Console USB (le pont USB-série accepte 921600)
+static constexpr size_t CONSOLE_TX_BUFFER = 2048;  // Buffer TX console (sortie binaire)
 
 // Unit_UHF_RFID uhf; // Plus besoin - 100% raw implementation!
 
@@ -52,38 +65,307 @@ static constexpr uint8_t BEEP_DURATION = 25;    // Durée bip 25ms (4x plus cour
 bool continuous_scan_active = false;
 uint32_t button_press_start = 0;
 bool button_was_long_pressed = false;
-String last_detected_epc = "";
+static bool btn_b_long_handled = false;        // B : appui long déjà traité
 uint32_t last_beep_time = 0;
 
 
 
-// === Structure pour multi-tags en continu ===
-struct ContinuousTag {
-  String epc;
-  String tid;
-  int rssi;
-  uint32_t last_seen;
-  bool is_new;
-};
-
 // === Structure pour tag avec RSSI brut ===
 // RawTagData maintenant définie dans universal_inventory.h
 
-static constexpr size_t MAX_CONTINUOUS_TAGS = 16;  // Max tags à afficher
-ContinuousTag continuous_tags[MAX_CONTINUOUS_TAGS];
-uint8_t continuous_tags_count = 0;
+// === Mode continu en pipeline ===
+// Tâches UART et parse/dédup sur le core UHF_PIPELINE_IO_CORE (table de hachage
+// UHF_TAG_TABLE_CAPACITY tags, file TID), loop() ne fait que l'UI avec les
+// événements reçus. Ici : copie des tags à afficher uniquement.
+static constexpr uint32_t TAG_EXPIRY_MS       = 500;    // tag retiré s'il n'est plus vu
+static constexpr uint16_t MULTI_POLL_ROUNDS   = 10000;  // tours par commande 0x27
+static constexpr uint32_t MULTI_POLL_REARM_MS = 2000;   // relance si plus rien reçu
+static constexpr uint16_t DISPLAY_TAGS        = 16;     // tags gardés côté UI
+static UhfPipeline pipeline;
+static UhfTagTable<DISPLAY_TAGS> display_tags;
+// Tag cible de l'écriture = le plus proche (RSSI lissé par le pipeline) ; il ne
+// change que si un autre le dépasse de plus de NEAREST_MARGIN_DB
+static constexpr int16_t NEAREST_MARGIN_DB = 3;
+static uint16_t nearest_slot = UhfTagTable<DISPLAY_TAGS>::NONE;
+static UhfEncoder encoder;                              // encodage en série (console)
+// Q / session / target du module : adaptés par la tâche de parsing en mode
+// continu, par le scan simple sinon (préréglage : QUERY sur la console)
+static UhfQueryController query_ctl(UHF_QUERY_AUTO);
+// Puissance RF du poste d'encodage : inventaire bas (les tags voisins restent
+// hors champ), écriture / relecture montées par paliers sur erreur de puissance
+static UhfPowerPolicy tx_power;
+// TID des tags déjà lus, par EPC : un tag qui sort du champ plus de
+// TAG_EXPIRY_MS puis revient ne coûte pas un nouveau select + lecture.
+// Rechargé au démarrage, écrit en NVS à l'arrêt du mode continu s'il a changé.
+static constexpr bool TID_CACHE_PERSIST = true;
+static UhfTidCache tid_cache;
+// Veille du mode continu (uhf_duty.h, DUTY sur la console) : sans tag lu
+// pendant idle_after_ms, le module n'écoute plus que par fenêtres de plus en
+// plus espacées et l'écran baisse ; après sleep_after_ms l'écran s'éteint et
+// le CPU dort (light sleep) entre deux fenêtres, réveillé par le timer, la
+// console (UART0, les premiers caractères sont perdus) ou le tactile (INT du
+// FT6336 = boutons A/B/C). Un tag lu : retour immédiat au plein régime.
+// Courant batterie (AXP192) échantillonné et compté par état ; sur USB il
+// est nul. Endormi, il ne se mesure pas : DUTY_SLEEP_MA est compté à la place.
+#ifndef DUTY_CYCLE
+#define DUTY_CYCLE 1
+#endif
+#ifndef DUTY_LIGHT_SLEEP
+#define DUTY_LIGHT_SLEEP 1
+#endif
+static constexpr uint8_t    DUTY_BRIGHT_DIM   = 24;     // écran en BACKOFF
+static constexpr uint32_t   DUTY_SAMPLE_MS    = 1000;   // période du courant batterie
+static constexpr uint32_t   DUTY_SLEEP_MA     = 8;      // carte en light sleep, écran éteint
+static constexpr uint32_t   DUTY_MIN_SLEEP_MS = 50;     // plus court : pas la peine
+static constexpr gpio_num_t TOUCH_INT_PIN     = GPIO_NUM_39;
+static UhfDutyCycle duty;                               // tâche de parsing pendant le mode continu
+static uint8_t  duty_bright_full = 0;                   // luminosité de départ
+static uint8_t  duty_shown = UHF_DUTY_ACTIVE;           // état appliqué à l'écran
+static uint32_t duty_sample_ms = 0;
+uint16_t tracked_tags = 0;                              // total suivi par le pipeline
 uint32_t last_display_update = 0;
 
+// === Sortie binaire des lectures (OUT BIN / OUT TEXT sur la console) ===
+// Une trame COBS par lecture (uhf_report.h), écrite par la tâche de parsing
+// sans formatage ; les lignes NEW TAG / TID found ne sont plus imprimées.
+// Une trame qui ne tient pas dans le buffer TX est abandonnée : le collecteur
+// voit le trou dans les numéros de séquence.
+static std::atomic<bool> report_binary(false);
+static UhfReportWriter report_writer;                   // tâche de parsing seulement
+static std::atomic<uint32_t> report_sent(0), report_dropped(0);
+
+// === Comptage portail (COUNT START / STOP / SHOW sur la console) ===
+// EPC distincts depuis COUNT START (exacts jusqu'au plafond, estimés au-delà)
+// et tags nouveaux / répétés sur une fenêtre glissante, en mémoire fixe.
+// Alimenté par la tâche de parsing en mode continu ; les intervalles clos
+// arrivent à loop() par l'anneau du compteur.
+// Sur le tas (voir STATIC_UHF_BUDGET) : 22 Ko qui ne servent qu'en COUNT
+static UhfUniqueCounter& portal_count = *new UhfUniqueCounter;   // tâche de parsing pendant le mode continu
+static std::atomic<bool> count_active(false);
+static UhfCountInterval last_count_interval;
+static bool has_count_interval = false;
+
+static void printCountInterval(const UhfCountInterval& v) {
+  Serial.printf("COUNT %lu s: %u reads, %u new, %u reads/s, %u distinct%s\n",
+                (unsigned long)(v.start_ms / 1000), (unsigned)v.reads, (unsigned)v.new_tags,
+                (unsigned)(v.length_ms ? uint64_t(v.reads) * 1000 / v.length_ms : 0),
+                (unsigned)v.distinct, v.exact ? "" : " (estimate)");
+}
+
+// === Second module (MULTI sur la console) ===
+// Un JRD-4035 de plus sur Serial1 (PORT-C), piloté avec celui de Serial2 par
+// le même ordonnanceur ; tags fusionnés en un seul flux dédoublonné. L'UART0
+// reste à la console : deux modules au plus sur le Core2.
+#ifndef UHF_SECOND_MODULE
+#define UHF_SECOND_MODULE 0
+#endif
+#if UHF_SECOND_MODULE
+static constexpr int RX2_PIN = 13;
+static constexpr int TX2_PIN = 14;
+static UhfReader second_reader;
+#endif
+// Hors mode continu seulement : sa table est celle du pipeline, prêtée à
+// chaque MULTI (pipeline.lendTable()), au lieu d'une seconde table de 1024 tags
+static UhfMultiReader& multi_reader = *new UhfMultiReader;   // loop() seulement, sur le tas
+
+// Scan (A) et écriture (B) en séquences non bloquantes : loop() appelle
+// poll() à chaque tour, les étapes suivantes partent des callbacks. Tant
+// qu'une séquence tourne, le module lui appartient : console, encodeur et
+// boutons attendent (uhf_async.busy()).
+static UhfAsync uhf_async(uhfDefaultReader());
+
+// === Transferts de banque par blocs (BULK sur la console) ===
+// Sur le dernier tag scanné. Taille des blocs apprise par modèle de tag ; le
+// job et son tampon (une banque user de 512 octets) restent d'une commande à
+// l'autre pour BULK RESUME après un tag perdu.
+static UhfBulk bulk;
+static UhfBulkJob bulk_job;
+static uint8_t bulk_buf[512];
+static bool bulk_is_write = false;
+
+static void onTagRead(const RawTagData& read, const UhfTagEntry& tag, void*) {
+  if (count_active.load(std::memory_order_relaxed)) portal_count.add(read.epc_raw, read.epc_len, millis());
+  if (!report_binary.load(std::memory_order_relaxed)) return;
+  uint8_t frame[UHF_REPORT_MAX_FRAME];
+  const size_t n = report_writer.frame(read, tag.has_tid ? tag.tid : nullptr, tag.last_seen, frame);
+  if (n == 0) return;
+  if (Serial.availableForWrite() < int(n)) {
+    report_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Serial.write(frame, n);
+  report_sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+// === Capture du trafic UART (TRACE ON / OFF / DUMP / STAT sur la console) ===
+// Décore le transport Serial2 : chaque morceau lu ou écrit est horodaté en RAM
+// (uhf_trace.h), les plus anciens écrasés. Le dump hexadécimal se rejoue sur
+// Linux avec host/trace_replay. Inactif, il ne coûte qu'un test par appel.
+// Ses 16 Ko de tampons sont sur le tas (voir STATIC_UHF_BUDGET).
+static UhfTraceRecorder& uart_trace = *new UhfTraceRecorder;
+
+static void printTraceLine(const char* line, void*) { Serial.println(line); }
+
+static void printTraceStats() {
+  const UhfTraceStats st = uart_trace.stats();
+  Serial.printf("TRACE %s %u RX / %u TX events, %u + %u bytes, %u overwritten, %u truncated\n",
+                uart_trace.recording() ? "ON" : "OFF", (unsigned)st.rx_events, (unsigned)st.tx_events,
+                (unsigned)st.rx_bytes, (unsigned)st.tx_bytes, (unsigned)st.overwritten,
+                (unsigned)st.truncated);
+}
+
+// === Empreinte statique ===
+// .data + .bss doivent tenir dans dram0_0_seg (~180 Ko sur l'ESP32), core
+// Arduino et M5Unified compris : les objets UHF statiques, ceux du sketch et
+// des bibliothèques, en gardent STATIC_UHF_BUDGET au plus. Un tampon de plus
+// qui ne sert qu'à une commande va sur le tas, comme COUNT, TRACE et MULTI.
+static constexpr size_t STATIC_UHF_BUDGET = 160 * 1024;
+static constexpr size_t STATIC_UHF_BYTES =
+    sizeof(pipeline) + sizeof(display_tags) + sizeof(encoder) + sizeof(query_ctl) + sizeof(tx_power) +
+    sizeof(tid_cache) + sizeof(duty) + sizeof(report_writer) + sizeof(last_count_interval) +
+    sizeof(uhf_async) + sizeof(bulk) + sizeof(bulk_job) + sizeof(bulk_buf) +
+    sizeof(UhfReader) * (1 + UHF_SECOND_MODULE) +                    // uhfDefaultReader() et second_reader
+    UHF_LOG_RECORDS * (sizeof(UhfLogRecord) + sizeof(uint32_t)) +     // anneau du journal
+    UhfTidCache::IMAGE_MAX;                                           // image NVS du cache TID
+static_assert(STATIC_UHF_BYTES <= STATIC_UHF_BUDGET,
+              "objets UHF statiques trop gros pour dram0_0_seg : passer un tampon sur le tas");
+
+// === Journal différé (uhf_log.h, LOG ... sur la console) ===
+// Les appels UHF_LOGx ne font que poser un enregistrement binaire en RAM ; la
+// mise en forme et l'envoi ont lieu ici, en temps libre, sans jamais attendre
+// la console : au plus ce que son buffer TX accepte à chaque tour de loop().
+// TEXT : lignes formatées ; HEX : enregistrements bruts pour host/log_decode ;
+// HOLD : gardés en RAM jusqu'à LOG DUMP.
+enum LogOutput : uint8_t { LOG_OUT_TEXT, LOG_OUT_HEX, LOG_OUT_HOLD };
+static LogOutput log_output = LOG_OUT_TEXT;
+
+static void printLogLine(const char* line, void*) { Serial.println(line); }
+
+static void drainLog() {
+  // La sortie binaire des lectures ne doit pas être entrecoupée
+  if (log_output == LOG_OUT_HOLD || report_binary.load(std::memory_order_relaxed)) return;
+  const size_t room = size_t(max(Serial.availableForWrite(), 0));
+  const size_t n = room / UHF_LOG_LINE_MAX;
+  if (n == 0) return;
+  if (log_output == LOG_OUT_HEX) uhfLogDrainHex(printLogLine, nullptr, n);
+  else uhfLogDrain(printLogLine, nullptr, n);
+}
+
+static void printLogState() {
+  static const char* const outputs[] = { "TEXT", "HEX", "HOLD" };
+  const UhfLogStats st = uhfLogStats();
+  Serial.printf("LOG %s level %s, categories 0x%02X, %u pending, %u written, %u dropped, formats %08X\n",
+                outputs[log_output], UHF_LOG_LEVEL ? uhfLogLevelName(UHF_LOG_LEVEL) : "off",
+                (unsigned)UHF_LOG_CATEGORIES, (unsigned)st.pending, (unsigned)st.written,
+                (unsigned)st.dropped, (unsigned)uhfLogFormatsHash());
+}
+
+static void handleLogCommand(char* args) {
+  char* save = nullptr;
+  const char* sub = args ? strtok_r(args, " ", &save) : nullptr;
+  if (!sub || strcmp(sub, "SHOW") == 0) {
+    printLogState();
+  } else if (strcmp(sub, "TEXT") == 0) {
+    log_output = LOG_OUT_TEXT;
+    printLogState();
+  } else if (strcmp(sub, "HEX") == 0) {
+    log_output = LOG_OUT_HEX;
+    printLogState();
+  } else if (strcmp(sub, "HOLD") == 0) {
+    log_output = LOG_OUT_HOLD;
+    printLogState();
+  } else if (strcmp(sub, "DUMP") == 0) {
+    uhfLogDumpHex(printLogLine, nullptr);
+  } else if (strcmp(sub, "CLEAR") == 0) {
+    uhfLogClear();
+    printLogState();
+  } else {
+    Serial.println("LOG ERR usage: LOG SHOW|TEXT|HEX|HOLD|DUMP|CLEAR");
+  }
+}
+
 // === DisplayManager - Interface utilisateur unifiée ===
+#ifndef DISPLAY_FULL_REDRAW
+#define DISPLAY_FULL_REDRAW 0   // 1 : ancien rendu plein écran, pour comparer le coût
+#endif
+
 class DisplayManager {
+public:
+  static constexpr int MAX_ROWS = 7;       // tags listés en mode continu
+
+  // Coût d'affichage par cycle de scan (micros())
+  struct FrameStats {
+    uint32_t frames;
+    uint32_t strips;      // zones réellement poussées vers l'écran
+    uint32_t total_us;
+    uint32_t max_us;
+    uint32_t last_us;
+  };
+
 private:
   static constexpr int HEADER_SIZE = 2;
   static constexpr int BODY_SIZE = 1;
   static constexpr int SEPARATOR_Y = 45;
 
+  // Mode continu : lignes de tags 0..MAX_ROWS-1, puis en-tête et pied
+  static constexpr int LIST_Y    = 50;
+  static constexpr int ROW_PITCH = 24;     // EPC + RSSI/TID + ligne vide
+  static constexpr int STRIP_H   = 16;     // hauteur d'une zone dessinée
+  static constexpr int FOOTER_Y  = LIST_Y + MAX_ROWS * ROW_PITCH;
+  static constexpr int HEADER    = MAX_ROWS;
+  static constexpr int FOOTER    = MAX_ROWS + 1;
+  static constexpr int STRIPS    = MAX_ROWS + 2;
+
+  struct Strip {
+    char     text[2][48];
+    uint16_t color;
+    bool     valid;
+  };
+  struct ContinuousView {
+    Strip      strips[STRIPS];
+    M5Canvas   canvas;        // une zone 320x16, réutilisée pour toutes
+    bool       drawn;         // cadre fixe à l'écran
+    FrameStats stats;
+    ContinuousView() : canvas(&M5.Display), drawn(false) {
+      memset(strips, 0, sizeof(strips));
+      memset(&stats, 0, sizeof(stats));
+    }
+  };
+  static ContinuousView& view() { static ContinuousView v; return v; }
+
+  // Tout autre écran écrase le mode continu : tout redessiner au retour
+  static void leaveContinuous() { view().drawn = false; }
+
+  // Redessine une zone si son contenu diffère du modèle
+  static void drawStrip(int slot, int y, int textSize, const char* line1, const char* line2, uint16_t color) {
+    Strip& st = view().strips[slot];
+    if (st.valid && st.color == color &&
+        strncmp(st.text[0], line1, sizeof(st.text[0])) == 0 &&
+        strncmp(st.text[1], line2, sizeof(st.text[1])) == 0) return;
+    snprintf(st.text[0], sizeof(st.text[0]), "%s", line1);
+    snprintf(st.text[1], sizeof(st.text[1]), "%s", line2);
+    st.color = color;
+    st.valid = true;
+    
+    M5Canvas& c = view().canvas;
+    c.fillSprite(BLACK);
+    c.setTextSize(textSize);
+    c.setTextColor(color, BLACK);
+    c.setCursor(0, 0);
+    c.print(st.text[0]);
+    if (st.text[1][0]) {
+      c.setTextColor(WHITE, BLACK);
+      c.setCursor(0, 8 * textSize);
+      c.print(st.text[1]);
+    }
+    c.pushSprite(0, y);
+    view().stats.strips++;
+  }
+
 public:
   // Affichage de statut générique
   static void showStatus(const String& line1, const String& line2 = "", const String& line3 = "", const String& line4 = "", const String& line5 = "") {
+    leaveContinuous();
     M5.Display.fillScreen(BLACK);
     M5.Display.setCursor(0, 0);
     M5.Display.setTextSize(HEADER_SIZE);
@@ -96,54 +378,83 @@ public:
     if (line5.length() > 0) M5.Display.println(line5);
   }
 
-  // Affichage du mode continu avec en-tête et liste de tags
-  static void showContinuousMode(int tagCount, const String& powerText) {
-    M5.Display.fillScreen(BLACK);
-    M5.Display.setTextColor(WHITE);
-    
-    // En-tête avec statistiques
-    M5.Display.setCursor(0, 0);
-    M5.Display.setTextSize(HEADER_SIZE);
-    M5.Display.printf("CONTINUOUS [%d] %s\n", tagCount, powerText.c_str());
-    
-    // Contrôles disponibles
-    M5.Display.setTextSize(1);
-    M5.Display.println("A:stop B:power");
-    
-    // Ligne de séparation
-    M5.Display.drawLine(0, SEPARATOR_Y, 320, SEPARATOR_Y, WHITE);
-    
-    // Zone de contenu tags
-    M5.Display.setCursor(0, 50);
-    M5.Display.setTextSize(BODY_SIZE);
-    
-    if (tagCount == 0) {
-      M5.Display.println("No tags detected...");
+  // === Mode continu : rendu incrémental ===
+  // Le modèle garde ce qui est à l'écran pour chaque zone (en-tête, lignes de
+  // tags, pied "more") ; une zone n'est redessinée que si son texte ou sa
+  // couleur change. Chaque zone est composée dans un sprite hors écran puis
+  // poussée en un seul transfert : pas de fillScreen, pas de scintillement.
+  // DISPLAY_FULL_REDRAW=1 redessine tout à chaque image (mesure de référence).
+
+  // Début d'une image : cadre fixe dessiné une seule fois par entrée en mode continu
+  static uint32_t beginContinuousFrame() {
+    const uint32_t t0 = micros();
+    if (DISPLAY_FULL_REDRAW) view().drawn = false;
+    if (!view().drawn) {
+      M5.Display.fillScreen(BLACK);
+      M5.Display.setTextColor(WHITE);
+      M5.Display.setTextSize(BODY_SIZE);
+      M5.Display.setCursor(0, STRIP_H);
+      M5.Display.println("A:stop B:power");
+      M5.Display.drawLine(0, SEPARATOR_Y, 320, SEPARATOR_Y, WHITE);
+      for (int i = 0; i < STRIPS; i++) view().strips[i].valid = false;
+      if (view().canvas.width() == 0) {
+        view().canvas.setColorDepth(16);
+        view().canvas.createSprite(320, STRIP_H);
+      }
+      view().drawn = true;
     }
+    M5.Display.startWrite();
+    return t0;
   }
 
-  // Affichage d'un tag dans la liste continue
-  static void showTagEntry(int index, const String& epc, int rssi, const String& tid, bool isRecent) {
-    // Cas spécial pour "more..." (index négatif)
-    if (index < 0) {
-      M5.Display.setTextColor(YELLOW);
-      M5.Display.println(epc); // epc contient le message "more..."
-      return;
-    }
-    
+  // En-tête avec statistiques (redessiné si le compte ou la puissance change)
+  static void showContinuousHeader(int tagCount, const char* powerText) {
+    char line[32];
+    snprintf(line, sizeof(line), "CONTINUOUS [%d] %s", tagCount, powerText);
+    drawStrip(HEADER, 0, HEADER_SIZE, line, "", WHITE);
+  }
+
+  // Affichage d'un tag dans la liste continue (row 0..MAX_ROWS-1)
+  static void showTagEntry(int row, const char* epc, int rssi, const char* tid, bool isRecent) {
+    if (row < 0 || row >= MAX_ROWS) return;
+    char line1[48], line2[32];
+    snprintf(line1, sizeof(line1), "%d. %s", row + 1, epc);
+    snprintf(line2, sizeof(line2), "   RSSI:%d TID:%s", rssi, tid);
     // Couleur selon l'âge du tag
-    uint16_t color = isRecent ? GREEN : YELLOW;
-    M5.Display.setTextColor(color);
+    drawStrip(row, LIST_Y + row * ROW_PITCH, BODY_SIZE, line1, line2, isRecent ? GREEN : YELLOW);
+  }
+
+  // Fin d'une image : efface les lignes devenues vides, pied "more" ou
+  // "No tags", et comptabilise le temps écoulé depuis beginContinuousFrame()
+  static void endContinuousFrame(uint32_t t0, int rowsUsed, int tagCount) {
+    for (int row = rowsUsed; row < MAX_ROWS; row++) {
+      if (row == 0 && tagCount == 0) {
+        drawStrip(0, LIST_Y, BODY_SIZE, "No tags detected...", "", WHITE);
+      } else {
+        drawStrip(row, LIST_Y + row * ROW_PITCH, BODY_SIZE, "", "", WHITE);
+      }
+    }
+    char more[24] = "";
+    if (tagCount > rowsUsed && rowsUsed == MAX_ROWS) {
+      snprintf(more, sizeof(more), "+ %d more...", tagCount - rowsUsed);
+    }
+    drawStrip(FOOTER, FOOTER_Y, BODY_SIZE, more, "", YELLOW);
+    M5.Display.endWrite();
     
-    // Format compact optimisé
-    M5.Display.printf("%d. %s\n", index + 1, epc.c_str());
-    M5.Display.setTextColor(WHITE);
-    M5.Display.printf("   RSSI:%d TID:%s\n", rssi, tid.c_str());
-    M5.Display.println(); // Ligne vide
+    FrameStats& fs = view().stats;
+    const uint32_t us = micros() - t0;
+    fs.frames++;
+    fs.total_us += us;
+    fs.last_us = us;
+    if (us > fs.max_us) fs.max_us = us;
   }
 
+  static const FrameStats& frameStats() { return view().stats; }
+  static void resetFrameStats() { memset(&view().stats, 0, sizeof(FrameStats)); }
+
   // Affichage de scan simple avec détails
   static void showScanResult(int tagCount, const String& selectedEpc, int selectedIndex, const String& powerText, const String& tidInfo = "") {
+    leaveContinuous();
     M5.Display.fillScreen(BLACK);
     M5.Display.setCursor(0, 0);
     M5.Display.setTextSize(HEADER_SIZE);
@@ -166,6 +477,7 @@ public:
 
   // Affichage des résultats d'écriture
   static void showWriteResult(bool success, const String& message, const String& details = "", const String& newEpc = "") {
+    leaveContinuous();
     M5.Display.fillScreen(BLACK);
     M5.Display.setCursor(0, 0);
     M5.Display.setTextSize(HEADER_SIZE);
@@ -195,11 +507,20 @@ public:
 };
 
 // Wrapper pour compatibilité avec l'ancien code
+// Bandeau temporaire (longueur EPC changée) : loop() remet l'écran d'accueil
+// après MODE_BANNER_MS, sauf si un autre statut l'a remplacé entre-temps
+static constexpr uint32_t MODE_BANNER_MS = 1200;
+static bool mode_banner_shown = false;
+static uint32_t mode_banner_since = 0;
+
 void displayStatus(const String& line1, const String& line2 = "", const String& line3 = "", const String& line4 = "", const String& line5 = "") {
+  mode_banner_shown = false;
   DisplayManager::showStatus(line1, line2, line3, line4, line5);
 }
 
 // === Variables pour gestion TX Power ===
+// Puissance du mode continu (B) ; scan simple et écriture suivent tx_power
+static constexpr uint16_t SCAN_POWERS[] = {2000, TX_PWR_DBM10, 3000};  // 0.01 dBm
 uint8_t current_power_index = 1;  // Index power (0=20dBm, 1=26dBm, 2=30dBm)
 
 // === Cible longueur EPC en words (16 bits/word) ===
@@ -216,7 +537,12 @@ static void cycleEpcWords() {
   if (g_target_words < 6 || g_target_words > 31) g_target_words = 6;
   Serial.printf("🔄 Target EPC length: %u words (%u bits)\n", g_target_words, g_target_words * 16);
   displayStatus("Mode Changed", getEpcWordsText(), "Ready to write");
-  delay(1200);
+  mode_banner_shown = true;
+  mode_banner_since = millis();
+}
+
+static void serviceModeBanner() {
+  if (!mode_banner_shown || millis() - mode_banner_since < MODE_BANNER_MS) return;
   displayStatus("UHF Ready", "A: Scan | A long: Continuous", getEpcWordsText());
 }
 
@@ -234,116 +560,20 @@ TagInfo current_tag = { {0}, {0}, 0, 0, false };
 
 
 // === Utils protocole EL-UHF-RMT01/JRD-4035 ===
-static uint8_t cs8(const uint8_t* p, size_t n) {
-  uint32_t s = 0;
-  for (size_t i = 0; i < n; i++) s += p[i];
-  return uint8_t(s & 0xFF);
-}
-
-#if DEBUG_UHF_FRAMES
-static void hexDump(const char* label, const uint8_t* data, size_t len) {
-  Serial.print(label);
-  Serial.print(": ");
-  for (size_t i = 0; i < len; i++) {
-    Serial.printf("%02X ", data[i]);
-    if (i > 0 && (i + 1) % 16 == 0) {
-      Serial.println();
-      Serial.print("    ");  // Indentation
-    }
-  }
-  Serial.println();
-}
-#else
-#define hexDump(label, data, len) ((void)0)
-#endif
-
-// Vidage complet du buffer RX avec timeout dynamique
-static void clearRxBuffer(HardwareSerial& s, uint32_t timeout = 50) {
-  uint32_t start = millis();
-  while (millis() - start < timeout) {
-    while (s.available()) {
-      s.read();
-      start = millis();  // Reset timeout à chaque octet reçu
-    }
-    delay(1);
-  }
-}
+// Trames construites par uhf_frames.h (constantes à la compilation ou
+// écrites dans le buffer TX partagé uhfTxFrame())
 
 // Stop multi-inventaire amélioré
 // stopMultiInv supprimée - utiliser uhfStopMultiInventory()
 
-// === Envoi/recv bruts améliorés ===
-bool sendCmdRaw(const uint8_t* frame, size_t len, uint8_t* resp, size_t& rlen, uint32_t tout_ms) {
-  if (!gUhf) return false;
-  clearRxBuffer(*gUhf, 20);
-  
-  hexDump("TX", frame, len);  // Debug envoi
-  
-  gUhf->write(frame, len);
-  gUhf->flush();
-  
-  uint32_t t0 = millis();
-  size_t idx = 0;
-  bool frame_started = false;
-  
-  while (millis() - t0 < tout_ms && idx < rlen) {
-    if (gUhf->available()) {
-      uint8_t b = (uint8_t)gUhf->read();
-      
-      // Attendre le début de trame 0xBB
-      if (!frame_started) {
-        if (b == 0xBB) {
-          frame_started = true;
-          resp[idx++] = b;
-        }
-      } else {
-        resp[idx++] = b;
-        // Dès que PL est connu, attendre exactement expected_len
-        if (idx >= 5) {
-          uint16_t pl = (resp[3] << 8) | resp[4];
-          size_t expected_len = 5 + pl + 2;
-          if (idx >= expected_len) {
-            break;  // Trame complète reçue
-          }
-        }
-      }
-    }
-  }
-  
-  rlen = idx;
-  
-  // === Validation stricte de la trame ===
-  if (idx < 7) return false;  // Trame trop courte
-  if (resp[0] != 0xBB) return false;  // Mauvais header
-  if (resp[idx-1] != 0x7E) return false;  // Mauvais trailer
-  
-  // Vérifier longueur exacte
-  uint16_t pl = (resp[3] << 8) | resp[4];
-  size_t expected_len = 5 + pl + 2;  // Header(1) + Type(1) + CMD(1) + PL(2) + Data(pl) + CS(1) + Trailer(1)
-  
-  if (idx != expected_len) {
-    Serial.printf("Frame length mismatch: got %d, expected %d\n", idx, expected_len);
-    return false;
-  }
-  
-  // Vérifier checksum
-  uint8_t calculated_cs = cs8(&resp[1], expected_len - 3);  // Type + CMD + PL + Data
-  uint8_t received_cs = resp[idx - 2];  // CS avant trailer
-  
-  if (calculated_cs != received_cs) {
-    Serial.printf("Checksum mismatch: calc=0x%02X, recv=0x%02X\n", calculated_cs, received_cs);
-    hexDump("BAD_RX", resp, idx);  // Debug trame corrompue
-    return false;
-  }
-  
-  hexDump("RX", resp, idx);  // Debug réception
-  return true;
-}
+// sendCmdRaw déplacée dans universal_inventory.cpp (transport attaché)
 
 // Function rawInventoryWithRssi() now directly available from universal_inventory.h
 
-// === SELECT raw en copiant exactement le format M5Stack ===
+// === SELECT raw au format M5Stack (SET_SELECT_PARAMETER, EPC 96 bits) ===
+// Même trame que uhfSelectEpc() : SelParam 0x01, pointeur 0x20, 96 bits
 static bool rawSelect(const uint8_t* epc, size_t epc_len, uint32_t access_pwd = 0) {
+  (void)access_pwd;
   if (!epc || epc_len == 0 || epc_len > 31) return false;
   
   if (epc_len != 12) {
@@ -351,63 +581,16 @@ static bool rawSelect(const uint8_t* epc, size_t epc_len, uint32_t access_pwd =
     return uhfSelectEpc(epc, epc_len);
   }
   
-  // Copier exactement SET_SELECT_PARAMETER_CMD de M5Stack
-  uint8_t select_cmd[] = {0xBB, 0x00, 0x0C, 0x00, 0x13, 0x01, 0x00, 0x00, 0x00,
-                          0x20, 0x60, 0x00, 0x30, 0x75, 0x1F, 0xEB, 0x70, 0x5C,
-                          0x59, 0x04, 0xE3, 0xD5, 0x0D, 0x70, 0xAD, 0x7E};
-  
-  // Remplacer les 12 bytes EPC par les nôtres (positions 12-23)
-  for (uint8_t i = 0; i < 12; i++) {
-    select_cmd[12 + i] = epc[i];
-  }
-  
-  // Recalculer checksum (position 24)
-  uint8_t check = 0;
-  for (uint8_t i = 1; i < 24; i++) {
-    check += select_cmd[i];
-  }
-  select_cmd[24] = check & 0xFF;
-  
-  Serial.printf("M5Stack SELECT with EPC: ");
-  for (size_t i = 0; i < 12; i++) {
-    Serial.printf("%02X", epc[i]);
-  }
-  Serial.println();
-  
-  uint8_t resp[32];
-  size_t rlen = sizeof(resp);
-  
-  if (!sendCmdRaw(select_cmd, sizeof(select_cmd), resp, rlen, 500)) {
-    Serial.println("❌ SELECT command failed");
-    return false;
-  }
-  
-  Serial.printf("SELECT resp: ");
-  for (size_t i = 0; i < min(rlen, (size_t)10); i++) {
-    Serial.printf("%02X ", resp[i]);
-  }
-  Serial.println();
-  
-  // Vérifier réponse OK: {0xBB, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x0E, 0x7E}
-  const uint8_t expected[] = {0xBB, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x0E, 0x7E};
-  if (rlen == 8) {
-    bool match = true;
-    for (int i = 0; i < 8; i++) {
-      if (resp[i] != expected[i]) {
-        match = false;
-        break;
-      }
-    }
-    if (match) {
-      Serial.println("✅ M5Stack SELECT successful");
-      return true;
-    }
+  UHF_LOGI_BYTES(SELECT, SELECT_EPC, epc, 12);
+  if (uhfSelectEpc(epc, 12)) {
+    UHF_LOGI(SELECT, SELECT_OK);
+    return true;
   }
   
-  if (resp[2] == 0xFF && rlen > 5) {
-    Serial.printf("❌ SELECT error: 0x%02X\n", resp[5]);
+  if (uhfLastErrorCode()) {
+    UHF_LOGW(SELECT, SELECT_ERROR, uhfLastErrorCode());
   } else {
-    Serial.println("❌ SELECT unexpected response");
+    UHF_LOGW(SELECT, SELECT_FAILED);
   }
   
   return false;
@@ -445,62 +628,17 @@ static const char* errorToString(WriteError err) {
 }
 
 // === Lecture du TID ===
+// READ bank 2 (TID), word 0, 4 words ; uhfRead() gère les deux formats de
+// réponse (DATA seul, ou UL + PC/EPC + DATA)
 static bool readTid(uint8_t tid[8]) {
-  // READ bank 2 (TID), word 0, 4 words
-  uint8_t frame[32];
-  size_t i = 0;
-  
-  frame[i++] = 0xBB;
-  frame[i++] = 0x00;  // Type
-  frame[i++] = 0x39;  // CMD = Read
-  frame[i++] = 0x00;  // PL high
-  frame[i++] = 0x09;  // PL low = 9
-  
-  // AccessPwd
-  frame[i++] = 0x00;
-  frame[i++] = 0x00;
-  frame[i++] = 0x00;
-  frame[i++] = 0x00;
-  
-  frame[i++] = 0x02;  // Bank = TID
-  frame[i++] = 0x00;  // WordPtr high
-  frame[i++] = 0x00;  // WordPtr low
-  frame[i++] = 0x00;  // DL high
-  frame[i++] = 0x04;  // DL low = 4 words = 8 bytes
-  
-  uint8_t cs = cs8(&frame[1], i - 1);
-  frame[i++] = cs;
-  frame[i++] = 0x7E;
-  
-  uint8_t resp[256];
-  size_t rlen = sizeof(resp);
-  
-  if (!sendCmdRaw(frame, i, resp, rlen, 500)) {
-    return false;
-  }
-  
-  // Parser la réponse
-  if (resp[2] == 0x39) {
-    // Format avec UL
-    if (rlen >= 7) {
-      uint8_t ul = resp[5];  // UL = taille PC+EPC
-      size_t data_offset = 6 + ul;
-      
-      // Vérifier format alternatif (DATA only)
-      uint16_t pl = (resp[3] << 8) | resp[4];
-      if (pl == 8) {  // 4 words * 2 = 8 bytes
-        // Format DATA only
-        memcpy(tid, &resp[5], 8);
-        return true;
-      } else if (data_offset + 8 <= rlen - 2) {
-        // Format avec UL
-        memcpy(tid, &resp[data_offset], 8);
-        return true;
-      }
-    }
-  }
-  
-  return false;
+  return uhfRead(0x02, 0, tid, 8, 4) == 8;
+}
+
+// Après pipeline.stop() : la tâche de parsing a rendu le cache
+static void persistTidCache() {
+  if (!TID_CACHE_PERSIST || !tid_cache.dirty()) return;
+  if (uhfTidCacheSave(tid_cache)) Serial.printf("TID cache: %u tags saved to NVS\n", tid_cache.size());
+  else Serial.println("TID cache: NVS save failed");
 }
 
 // === Fonction obsolète - remplacée par rawSelect() ===
@@ -515,322 +653,19 @@ static bool readTid(uint8_t tid[8]) {
 // writePcWord supprimée - utiliser uhfWritePcWord()
 
 
-// === WRITE EPC 96-bit SEULEMENT avec logs détaillés ===
-static WriteError writeEpcWithPc(const uint8_t* epc, size_t epc_bytes, uint32_t accessPwd) {
-  Serial.println("\n========== WRITE EPC 96-BIT DETAILED LOG ==========");
-  
-  // Validation des paramètres
-  if (epc_bytes != 12) {
-    Serial.printf("ERROR: Only 96-bit EPC supported, got %u bytes\n", epc_bytes);
-    Serial.println("WRITE ABORTED: Invalid EPC length");
-    return WRITE_MEMORY_OVERRUN;
-  }
-  
-  if (!epc) {
-    Serial.println("ERROR: NULL EPC pointer");
-    Serial.println("WRITE ABORTED: Invalid parameters");
-    return WRITE_UNKNOWN_ERROR;
-  }
-  
-  // Log des paramètres d'entrée
-  Serial.printf("Input Parameters:\n");
-  Serial.printf("  EPC length: %u bytes (%u bits)\n", epc_bytes, epc_bytes * 8);
-  Serial.printf("  Access password: 0x%08X\n", accessPwd);
-  Serial.printf("  Target EPC: ");
-  for (size_t j = 0; j < epc_bytes; j++) {
-    Serial.printf("%02X", epc[j]);
-    if (j < epc_bytes - 1) Serial.print(" ");
-  }
-  Serial.println();
-  
-  // === ÉTAPE 1: Lire le PC word actuel ===
-  Serial.println("\n--- STEP 1: Reading current PC word ---");
-  
-  // Commande READ: Bank=EPC, WordPtr=1, WordCount=1 (pour lire PC)
-  uint8_t read_cmd[] = {
-    0xBB, 0x00, 0x39,     // Header + READ command
-    0x00, 0x09,           // PL = 9 bytes
-    0x00, 0x00, 0x00, 0x00,  // Access password
-    0x01,                 // Bank = EPC  
-    0x00, 0x01,          // WordPtr = 1 (PC word)
-    0x00, 0x01,          // WordCount = 1
-    0x00,                 // Checksum (à calculer)
-    0x7E                  // Trailer
-  };
-  
-  // Calculer checksum
-  read_cmd[14] = cs8(&read_cmd[1], 13);
-  
-  uint8_t resp[32];
-  size_t rlen = sizeof(resp);
-  
-  if (sendCmdRaw(read_cmd, sizeof(read_cmd), resp, rlen, 500) && resp[2] == 0x39) {
-    // Succès de lecture
-    if (rlen >= 7) {
-      uint16_t current_pc = (resp[5] << 8) | resp[6];
-      uint8_t current_epc_words = (current_pc >> 11) & 0x1F;
-      uint8_t current_epc_bits = current_epc_words * 16;
-      
-      Serial.printf("Current PC word: 0x%04X\n", current_pc);
-      Serial.printf("Current EPC length: %u words (%u bits)\n", current_epc_words, current_epc_bits);
-      
-      // Pour 96-bit on a besoin de 6 words (PC bits [15:11] = 6)
-      if (current_epc_words == 6) {
-        Serial.println("✅ PC word already correct for 96-bit EPC, skipping PC write");
-      } else {
-        Serial.printf("PC word needs update: %u words → 6 words (96-bit)\n", current_epc_words);
-        
-        uint16_t new_pc = (current_pc & 0x07FF) | 0x3000;  // Garder les bits de protocole, changer la longueur
-        Serial.printf("New PC word: 0x%04X\n", new_pc);
-        
-        if (!uhfWritePcWord(new_pc, accessPwd)) {
-          Serial.println("❌ PC WRITE FAILED");
-          Serial.println("WRITE ABORTED: Cannot set PC word");
-          Serial.println("==================================================");
-          return WRITE_UNKNOWN_ERROR;
-        }
-        Serial.println("✅ PC write successful");
-      }
-    } else {
-      Serial.println("⚠️  Invalid PC read response, using default 0x3000");
-      goto use_default_pc;
-    }
-  } else {
-    Serial.println("⚠️  Cannot read current PC, using default 0x3000");
-    use_default_pc:
-    uint16_t default_pc = 0x3000;
-    
-    if (!uhfWritePcWord(default_pc, accessPwd)) {
-      Serial.println("❌ PC WRITE FAILED");  
-      Serial.println("WRITE ABORTED: Cannot set PC word");
-      Serial.println("==================================================");
-      return WRITE_UNKNOWN_ERROR;
-    }
-    Serial.println("✅ PC write successful");
-  }
-  
-  delay(50);
-  
-  // === ÉTAPE 2: Construire la commande d'écriture EPC ===
-  Serial.println("\n--- STEP 2: Building EPC write command ---");
-  uint16_t pl = 9 + 12;  // 9 bytes params + 12 bytes EPC
-  uint8_t buf[32];
-  size_t i = 0;
-  
-  buf[i++] = 0xBB;           // Header
-  buf[i++] = 0x00;           // Type
-  buf[i++] = 0x49;           // CMD = WRITE
-  buf[i++] = (pl >> 8);      // PL high
-  buf[i++] = (pl & 0xFF);    // PL low
-  
-  // Access Password (4 bytes)
-  buf[i++] = (accessPwd >> 24);
-  buf[i++] = (accessPwd >> 16);
-  buf[i++] = (accessPwd >> 8);
-  buf[i++] = accessPwd;
-  
-  buf[i++] = 0x01;           // Bank = EPC
-  buf[i++] = 0x00;           // WordPtr high
-  buf[i++] = 0x02;           // WordPtr low = 2 (début EPC après CRC+PC)
-  buf[i++] = 0x00;           // WordCount high  
-  buf[i++] = 0x06;           // WordCount low = 6 (96-bit)
-  
-  // Copier l'EPC
-  memcpy(&buf[i], epc, 12);
-  i += 12;
-  
-  // Checksum et fin
-  uint8_t cs = cs8(&buf[1], i - 1);
-  buf[i++] = cs;
-  buf[i++] = 0x7E;           // Trailer
-  
-  Serial.printf("EPC write frame built: %u bytes total\n", i);
-  Serial.printf("  PL=%u (9 params + 12 EPC bytes)\n", pl);
-  Serial.printf("  Bank=EPC (0x01), WordPtr=2, WordCount=6\n");
-  Serial.printf("  Checksum: 0x%02X\n", cs);
-  Serial.printf("  Frame: ");
-  for (size_t j = 0; j < i; j++) {
-    Serial.printf("%02X ", buf[j]);
-  }
-  Serial.println();
-  
-  // === ÉTAPE 3: Envoyer la commande d'écriture EPC ===
-  Serial.println("\n--- STEP 3: Sending EPC write command ---");
-  Serial.println("Sending EPC write command to module...");
-  
-  uint8_t epc_resp[64];
-  size_t epc_rlen = sizeof(epc_resp);
-  
-  if (!sendCmdRaw(buf, i, epc_resp, epc_rlen, 1000)) {
-    Serial.println("❌ EPC WRITE FAILED: No response or timeout");
-    Serial.println("Possible causes:");
-    Serial.println("  - Module not responding");
-    Serial.println("  - Tag lost or moved out of range");
-    Serial.println("  - UART communication error");
-    Serial.println("==================================================");
-    return WRITE_UNKNOWN_ERROR;
-  }
-  
-  Serial.printf("Received response: %u bytes\n", epc_rlen);
-  Serial.printf("Response: ");
-  for (size_t j = 0; j < epc_rlen; j++) {
-    Serial.printf("%02X ", epc_resp[j]);
-  }
-  Serial.println();
-  
-  // === ÉTAPE 4: Analyser la réponse ===
-  Serial.println("\n--- STEP 4: Analyzing response ---");
-  
-  if (epc_resp[2] == 0x49) {
-    Serial.println("✅ EPC WRITE SUCCESS");
-    Serial.printf("Response CMD=0x%02X (matches request 0x49)\n", epc_resp[2]);
-    
-    // Analyser les détails de la réponse
-    if (epc_rlen >= 5) {
-      uint16_t resp_pl = (epc_resp[3] << 8) | epc_resp[4];
-      Serial.printf("Response payload: %u bytes\n", resp_pl);
-      
-      if (resp_pl > 0 && epc_rlen >= 6 + resp_pl) {
-        Serial.printf("Response data: ");
-        for (size_t j = 5; j < 5 + resp_pl; j++) {
-          Serial.printf("%02X ", epc_resp[j]);
-        }
-        Serial.println();
-      }
-    }
-  } else if (epc_resp[2] == 0xFF) {
-    Serial.println("❌ EPC WRITE ERROR");
-    Serial.printf("Response CMD=0xFF (Error response)\n");
-    
-    if (epc_rlen > 5) {
-      uint8_t error_code = epc_resp[5];
-      uint16_t resp_pl = (epc_resp[3] << 8) | epc_resp[4];
-      
-      Serial.printf("Error code: 0x%02X\n", error_code);
-      Serial.printf("Error payload: %u bytes\n", resp_pl);
-      
-      // Analyser le code d'erreur
-      WriteError parsed_error = parseWriteError(error_code);
-      Serial.printf("Parsed error: %s\n", errorToString(parsed_error));
-      
-      // Détails spécifiques selon l'erreur
-      switch (error_code) {
-        case 0x09:
-          Serial.println("DIAGNOSIS: No tag in field or tag lost during write");
-          Serial.println("SOLUTION: Re-scan and retry, check tag position");
-          break;
-        case 0x10:
-          Serial.println("DIAGNOSIS: Invalid parameter (PC word issue)");
-          Serial.println("SOLUTION: Check tag compatibility with 96-bit EPC");
-          break;
-        case 0x16:
-          Serial.println("DIAGNOSIS: Access denied (wrong password or locked)");
-          Serial.println("SOLUTION: Check access password or unlock tag");
-          break;
-        case 0xA3:
-          Serial.println("DIAGNOSIS: Memory overrun (trying to write beyond capacity)");
-          Serial.println("SOLUTION: This shouldn't happen with 96-bit, check tag specs");
-          break;
-        case 0xA4:
-          Serial.println("DIAGNOSIS: Memory locked (EPC bank is write-protected)");
-          Serial.println("SOLUTION: Unlock EPC bank first");
-          break;
-        case 0xB3:
-          Serial.println("DIAGNOSIS: Insufficient power for write operation");
-          Serial.printf("SOLUTION: Increase TX power (current: %s)\n", getCurrentPowerText());
-          break;
-        default:
-          Serial.printf("DIAGNOSIS: Unknown error code 0x%02X\n", error_code);
-          Serial.println("SOLUTION: Check module documentation");
-          break;
-      }
-      
-      // Afficher données d'erreur supplémentaires
-      if (resp_pl > 1 && epc_rlen >= 6 + resp_pl) {
-        Serial.printf("Error data: ");
-        for (size_t j = 6; j < 5 + resp_pl; j++) {
-          Serial.printf("%02X ", epc_resp[j]);
-        }
-        Serial.println();
-      }
-      
-      Serial.println("==================================================");
-      return parsed_error;
-    } else {
-      Serial.println("❌ Malformed error response (missing error code)");
-      Serial.println("==================================================");
-      return WRITE_UNKNOWN_ERROR;
-    }
-  } else {
-    Serial.printf("❌ UNEXPECTED RESPONSE: CMD=0x%02X (expected 0x49)\n", epc_resp[2]);
-    Serial.println("DIAGNOSIS: Module returned unexpected command code");
-    Serial.println("SOLUTION: Check module firmware, retry operation");
-    Serial.println("==================================================");
-    return WRITE_UNKNOWN_ERROR;
-  }
-  
-  // === ÉTAPE 5: Vérification post-écriture ===
-  Serial.println("\n--- STEP 5: Post-write verification ---");
-  delay(50);  // Délai pour stabilisation
-  
-  Serial.println("Performing verification scan...");
-  uhfStopMultiInventory();
-  delay(100);
-  
-  RawTagData verify_tags[8];
-  uint8_t n = rawInventoryWithRssi(verify_tags, 8);
-  if (n > 0) {
-    bool found = false;
-    String target_epc = bytesToHex(epc, 12);
-    target_epc.toUpperCase();
-    
-    Serial.printf("Found %u tags during verification:\n", n);
-    for (uint8_t j = 0; j < n; j++) {
-      String found_epc = verify_tags[j].epc;
-      found_epc.toUpperCase();
-      Serial.printf("  Tag %u: %s", j+1, found_epc.c_str());
-      
-      if (found_epc == target_epc) {
-        Serial.println(" ✅ MATCH!");
-        found = true;
-      } else {
-        Serial.println(" (different)");
-      }
-    }
-    
-    if (found) {
-      Serial.println("✅ VERIFICATION SUCCESS: New EPC confirmed by scan");
-    } else {
-      Serial.println("⚠️  VERIFICATION WARNING: New EPC not found in scan");
-      Serial.println("   This might be normal if multiple tags are present");
-    }
-  } else {
-    Serial.println("⚠️  VERIFICATION WARNING: No tags found during verification scan");
-    Serial.println("   Tag might have moved or be out of range");
-  }
-  
-  Serial.println("==================================================");
-  Serial.println("✅ WRITE OPERATION COMPLETED SUCCESSFULLY");
-  Serial.println("==================================================\n");
-  
-  return WRITE_OK;
-}
+// writeEpcWithPc supprimée - utiliser writeEpcVariableSafeWithVerifyRaw()
 
 // === SAFE variable-length EPC write with auto-clip / retry ===
 static WriteError writeEpcVariableSafe(const uint8_t* epc, size_t epc_bytes, uint32_t accessPwd,
                                        uint8_t max_retries = 3)
 {
-  Serial.println("\n========== WRITE EPC VARIABLE SAFE ==========");
-  
   if (!epc || epc_bytes == 0) return WRITE_UNKNOWN_ERROR;
 
-  const size_t epc_bytes_in = epc_bytes;     // <--- sauvegarde longueur originale
+  UHF_LOGI(WRITE, WRITE_BEGIN, epc_bytes);
   // EPC bank = mots 16 bits → longueur paire (en octets)
   if (epc_bytes & 0x01) epc_bytes++;               // alignement sur mot
   if (epc_bytes > 62)   epc_bytes = 62;            // protocole (31 words max)
 
-  Serial.printf("Input: %u bytes, adjusted to %u bytes\n", (unsigned)epc_bytes_in, (unsigned)epc_bytes);
-
   // On part sur la longueur demandée, on réduira si 0xA3
   uint8_t  words_target = epc_bytes / 2;
   if (words_target < 6) words_target = 6;          // la plupart des tags = mini 96 bits
@@ -839,134 +674,73 @@ static WriteError writeEpcVariableSafe(const uint8_t* epc, size_t epc_bytes, uin
   // Lecture du PC existant (optionnel mais propre)
   uint16_t current_pc = 0x3000;
   {
-    uint8_t read_cmd[] = {
-      0xBB,0x00,0x39, 0x00,0x09,
-      0x00,0x00,0x00,0x00, // AccessPwd
-      0x01,                // Bank EPC
-      0x00,0x01,           // WordPtr = 1 (PC)
-      0x00,0x01,           // WordCount = 1
-      0x00, 0x7E
-    };
-    read_cmd[14] = cs8(&read_cmd[1], 13);
-    uint8_t resp[32]; size_t rlen = sizeof(resp);
-    if (sendCmdRaw(read_cmd, sizeof(read_cmd), resp, rlen, 500) && resp[2]==0x39 && rlen>=7) {
-      current_pc = (uint16_t(resp[5])<<8) | resp[6];
-      Serial.printf("Current PC: 0x%04X\n", current_pc);
+    uint8_t pcb[2];
+    if (uhfRead(0x01, 1, pcb, sizeof(pcb), 1) == 2) {   // Bank EPC, word 1 (PC)
+      current_pc = (uint16_t(pcb[0])<<8) | pcb[1];
+      UHF_LOGI(WRITE, WRITE_PC_CURRENT, current_pc);
     } else {
-      Serial.println("Using default PC: 0x3000");
+      UHF_LOGW(WRITE, WRITE_PC_DEFAULT);
     }
   }
 
   uint8_t tries = 0;
   while (tries++ <= max_retries) {
-    Serial.printf("\n--- Attempt %u: trying %u words (%u bits) ---\n", tries, words_target, words_target * 16);
-
     // 1) Ecrire PC word avec la nouvelle longueur (bits [15:11])
     uint16_t new_pc = (current_pc & 0x07FF) | (uint16_t(words_target) << 11);
-    Serial.printf("Writing PC: 0x%04X\n", new_pc);
+    UHF_LOGI(WRITE, WRITE_ATTEMPT, tries, words_target, words_target * 16, new_pc);
     
     if (!uhfWritePcWord(new_pc, accessPwd)) {
-      Serial.println("⚠️ PC write failed, continuing anyway");
+      UHF_LOGW(WRITE, WRITE_PC_FAILED);
       // si PC word refuse, on tente quand même l'écriture EPC (certains firmwares le mettent à jour eux-mêmes)
     }
-    delay(5); // laisse respirer le tag avant l'écriture EPC
 
     // 2) Construire et envoyer WRITE EPC (Bank=EPC, WordPtr=2)
+    // EPC demandé tronqué à la longueur courante, complété de zéros
     const uint8_t word_count = words_target;
-    const uint16_t pl = 9 + word_count * 2;
-    uint8_t buf[128]; size_t i = 0;
-
-    buf[i++] = 0xBB; buf[i++] = 0x00; buf[i++] = 0x49;
-    buf[i++] = (pl >> 8); buf[i++] = (pl & 0xFF);
-    buf[i++] = (accessPwd >> 24);
-    buf[i++] = (accessPwd >> 16);
-    buf[i++] = (accessPwd >> 8);
-    buf[i++] =  accessPwd;
-    buf[i++] = 0x01;           // EPC bank
-    buf[i++] = 0x00; buf[i++] = 0x02;    // WordPtr = 2 (début EPC)
-    buf[i++] = 0x00; buf[i++] = word_count;
-
-    // Copier EPC demandé, tronqué à la longueur courante
-    size_t bytes_now = size_t(word_count) * 2;
-    memcpy(&buf[i], epc, min(bytes_now, epc_bytes));
-    // Padding zéros si nécessaire
-    if (bytes_now > epc_bytes) {
-      memset(&buf[i + epc_bytes], 0, bytes_now - epc_bytes);
-    }
-    i += bytes_now;
+    UhfFrameWriter& tx = uhfTxFrame();
+    const size_t tx_len = uhfFrameWrite(tx, accessPwd, 0x01, 2, epc, epc_bytes, word_count);
 
-    buf[i++] = cs8(&buf[1], i - 1);
-    buf[i++] = 0x7E;
-
-    Serial.printf("Writing %u bytes EPC data\n", bytes_now);
-
-    uint8_t resp[64]; size_t rlen = sizeof(resp);
-    if (!sendCmdRaw(buf, i, resp, rlen, 1000)) {
-      Serial.println("❌ No response from module");
+    UhfFrame resp;
+    if (!uhfTransact(tx.data(), tx_len, resp, 1000)) {
+      UHF_LOGE(WRITE, WRITE_NO_REPLY);
       return WRITE_UNKNOWN_ERROR;
     }
 
     // 3) Analyse
-    if (resp[2] == 0x49) {
+    if (resp.cmd() == 0x49) {
       // succès
-      Serial.printf("✅ SUCCESS: EPC written at %u words (%u bits)\n", words_target, words_target * 16);
-      Serial.println("==================================================");
+      UHF_LOGI(WRITE, WRITE_OK, words_target, words_target * 16);
       // synchroniser l'UI avec la longueur réellement écrite
       g_target_words = words_target;
       return WRITE_OK;
     }
-    if (resp[2] == 0xFF && rlen > 5) {
-      uint8_t ec = resp[5];
-      Serial.printf("❌ Error code: 0x%02X\n", ec);
+    if (resp.isError() && resp.pl() > 0) {
+      uint8_t ec = resp.errorCode();
+      UHF_LOGW(WRITE, WRITE_ERROR, ec);
       
       if (ec == 0xA3 /* Memory Overrun */) {
-        Serial.printf("Memory overrun - reducing from %u to %u words\n", words_target, words_target - 1);
         // → réduire d'1 mot et retenter
         if (words_target > 6) {
+          UHF_LOGI(WRITE, WRITE_OVERRUN, words_target, words_target - 1);
           words_target--;
+          uhfNoteRetry(0x49);
           continue; // retry
         }
       }
       // autre erreur → sortir proprement avec le code
-      WriteError err = parseWriteError(ec);
-      Serial.printf("Final error: %s\n", errorToString(err));
-      Serial.println("==================================================");
-      return err;
+      return parseWriteError(ec);
     }
 
     // Réponse inattendue
-    Serial.println("❌ Unexpected response");
+    UHF_LOGE(WRITE, WRITE_UNEXPECTED, resp.cmd());
     break;
   }
 
-  Serial.printf("❌ Failed after %u attempts\n", max_retries);
-  Serial.println("==================================================");
+  UHF_LOGE(WRITE, WRITE_GAVE_UP, max_retries);
   return WRITE_UNKNOWN_ERROR;
 }
 
-// === Hex utilities ===
-static bool hexToBytes(const String& hex, uint8_t* out, size_t max_bytes) {
-  size_t len = hex.length();
-  if (len % 2 != 0 || len / 2 > max_bytes) return false;
-  
-  auto nyb = [](char c) -> int {
-    if (c >= '0' && c <= '9') return c - '0';
-    c |= 0x20;  // to lowercase
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    return -1;
-  };
-  
-  size_t bytes = len / 2;
-  for (size_t i = 0; i < bytes; i++) {
-    int a = nyb(hex[2*i]);
-    int b = nyb(hex[2*i+1]);
-    if (a < 0 || b < 0) return false;
-    out[i] = (a << 4) | b;
-  }
-  
-  return true;
-}
-
+// === Hex utilities (affichage/log uniquement) ===
 static String bytesToHex(const uint8_t* data, size_t len) {
   String result = "";
   for (size_t i = 0; i < len; i++) {
@@ -999,24 +773,10 @@ static void generateRandomEpc(uint8_t* epc, size_t epc_bytes) {
 
 // === Set Select Mode (commande 0x12) ===
 static bool setSelectMode(uint8_t mode) {
-  uint8_t frame[10];
-  size_t i = 0;
-  
-  frame[i++] = 0xBB;
-  frame[i++] = 0x00;
-  frame[i++] = 0x12;  // CMD = Set Select Mode
-  frame[i++] = 0x00;
-  frame[i++] = 0x01;  // PL = 1
-  frame[i++] = mode;  // 0x00=EPC, 0x01=TID, 0x02=User
-  
-  uint8_t cs = cs8(&frame[1], i - 1);
-  frame[i++] = cs;
-  frame[i++] = 0x7E;
-  
-  uint8_t resp[32];
-  size_t rlen = sizeof(resp);
-  
-  return sendCmdRaw(frame, i, resp, rlen, 200) && resp[2] == 0x12;
+  UhfFrameWriter& tx = uhfTxFrame();
+  const size_t tx_len = uhfFrameSetSelectMode(tx, mode);
+  UhfFrame resp;
+  return uhfTransact(tx.data(), tx_len, resp, 200) && resp.cmd() == 0x12;
 }
 
 // === Fonctions de gestion TX Power ===
@@ -1028,19 +788,25 @@ static const char* getCurrentPowerText() {
 }
 
 // Cycle TX Power : 20dBm → 26dBm → 30dBm → 20dBm
+// En mode continu le pipeline possède l'UART : flux arrêté le temps du 0xB6,
+// puis relancé sans vider la liste des tags
 static void cycleTxPower() {
-  const uint16_t powers[] = {2000, 2600, 3000};  // 20, 26, 30 dBm
   const char* power_names[] = {"20dBm", "26dBm", "30dBm"};
   
   current_power_index = (current_power_index + 1) % 3;
-  uint16_t new_power = powers[current_power_index];
+  uint16_t new_power = SCAN_POWERS[current_power_index];
   
-  // TX Power sera géré par nos commandes raw si nécessaire
-  // uhf.setTxPower(new_power);
+  const bool restart = pipeline.running();
+  if (restart) pipeline.stop();
+  const bool applied = uhfApplyTxPower(new_power);
+  if (restart) pipeline.start(false);
   
   // Bip de confirmation + feedback
   M5.Speaker.tone(1200 + (current_power_index * 300), 80, 0, false);
-  Serial.printf("TX Power cycled to: %s\n", power_names[current_power_index]);
+  if (!report_binary) {
+    Serial.printf("TX Power cycled to: %s%s\n", power_names[current_power_index],
+                  applied ? "" : " (module did not accept 0xB6)");
+  }
 }
 
 // === Fonctions pour le mode scan continu ===
@@ -1051,202 +817,336 @@ static void shortBeep() {
   if (now - last_beep_time > 200) {  // Minimum 200ms entre les bips
     M5.Speaker.tone(BEEP_FREQ, BEEP_DURATION, 0, false);  // Volume faible
     last_beep_time = now;
-    Serial.println("♪ TAG DETECTED");
+    if (!report_binary) Serial.println("♪ TAG DETECTED");
   }
 }
 
 // === Fonctions de gestion multi-tags ===
 
-// Réinitialiser la liste des tags continus
+// Réinitialiser la liste des tags continus (côté UI)
 static void clearContinuousTags() {
-  continuous_tags_count = 0;
-  for (uint8_t i = 0; i < MAX_CONTINUOUS_TAGS; i++) {
-    continuous_tags[i].epc = "";
-    continuous_tags[i].tid = "";
-    continuous_tags[i].rssi = 0;
-    continuous_tags[i].last_seen = 0;
-    continuous_tags[i].is_new = false;
-  }
-}
-
-// Ajouter ou mettre à jour un tag dans la liste
-static bool addOrUpdateContinuousTag(const String& epc, const String& tid = "N/A", int rssi = 0) {
-  uint32_t now = millis();
-  
-  // Chercher si le tag existe déjà
-  for (uint8_t i = 0; i < continuous_tags_count; i++) {
-    if (continuous_tags[i].epc == epc) {
-      continuous_tags[i].last_seen = now;
-      continuous_tags[i].is_new = false;
-      // Mettre à jour TID et RSSI si fournis
-      if (tid != "N/A") continuous_tags[i].tid = tid;
-      if (rssi != 0) continuous_tags[i].rssi = rssi;
-      return false;  // Tag déjà connu
-    }
-  }
-  
-  // Nouveau tag - l'ajouter si place disponible
-  if (continuous_tags_count < MAX_CONTINUOUS_TAGS) {
-    continuous_tags[continuous_tags_count].epc = epc;
-    continuous_tags[continuous_tags_count].tid = tid;
-    continuous_tags[continuous_tags_count].rssi = rssi;
-    continuous_tags[continuous_tags_count].last_seen = now;
-    continuous_tags[continuous_tags_count].is_new = true;
-    continuous_tags_count++;
-    return true;  // Nouveau tag ajouté
-  }
-  
-  return false;  // Plus de place
-}
-
-// Nettoyer les vieux tags (pas vus depuis x secondes)
-static void cleanupOldTags() {
-  uint32_t now = millis();
-  uint8_t write_idx = 0;
-  
-  for (uint8_t read_idx = 0; read_idx < continuous_tags_count; read_idx++) {
-    if (now - continuous_tags[read_idx].last_seen < 500) {  // 500ms
-      if (read_idx != write_idx) {
-        continuous_tags[write_idx] = continuous_tags[read_idx];
-      }
-      write_idx++;
-    }
-  }
-  
-  continuous_tags_count = write_idx;
+  display_tags.clear();
+  nearest_slot = UhfTagTable<DISPLAY_TAGS>::NONE;
+  tracked_tags = 0;
 }
 
-// Démarrage du mode inventory continu - Version simplifiée
+// Démarrage du mode inventory continu : un seul 0x27 multi-poll, le module
+// diffuse ensuite les tags sans aller-retour requête/réponse. Le pipeline
+// prend le port UART jusqu'à pipeline.stop().
 static bool startContinuousInventory() {
   // Arrêter toute opération en cours
   uhfStopMultiInventory();
-  delay(100);
   
-  Serial.println("Starting continuous mode (using repeated polling)");
+  // Avec OUT BIN, aucun texte ne doit se glisser dans le flux COBS
+  if (!report_binary) Serial.println("Starting continuous mode (0x27 multi-poll stream, pipelined)");
   
   // Réinitialiser la liste des tags
   clearContinuousTags();
+  uhfResetInventoryAllocStats();
+  pipeline.resetStats();
+  DisplayManager::resetFrameStats();
+  
+  // Puissance choisie avec B (le scan simple a pu la baisser)
+  uhfApplyTxPower(SCAN_POWERS[current_power_index]);
+  duty_sample_ms = millis();
+  return pipeline.start();
+}
+
+// Preuve "zéro allocation" : allocations heap faites pendant les tours d'inventory
+static void printInventoryAllocStats() {
+  const UhfAllocStats& as = uhfInventoryAllocStats();
+  Serial.printf("Inventory heap allocations: %u in %u rounds (%u rounds allocating)\n",
+                (unsigned)as.allocs, (unsigned)as.rounds, (unsigned)as.rounds_with_alloc);
+  
+  // Pipeline : débit, back-pressure, pertes
+  const UhfPipelineStats ps = pipeline.stats();
+  Serial.printf("Pipeline: %u bytes in, %u stalls (ring max %u), %u tag reads, %u events, %u dropped (ring max %u)\n",
+                (unsigned)ps.rx_bytes, (unsigned)ps.rx_stalls, (unsigned)ps.rx_ring_high,
+                (unsigned)ps.tag_reads, (unsigned)ps.events, (unsigned)ps.events_dropped,
+                (unsigned)ps.event_ring_high);
+  
+  // File TID : profondeur et temps d'attente (lu pipeline arrêté)
+  const UhfTidQueueStats& q = pipeline.tidStats();
+  const uint32_t done = q.served + q.failed;
+  Serial.printf("TID queue: %u queued, %u read, %u failed, %u stale, %u dropped, max depth %u\n",
+                (unsigned)q.pushed, (unsigned)q.served, (unsigned)q.failed, (unsigned)q.stale,
+                (unsigned)q.dropped, (unsigned)q.max_depth);
+  Serial.printf("TID wait: avg %u ms, max %u ms; %u batches, longest %u ms\n",
+                (unsigned)(done ? q.wait_total_ms / done : 0), (unsigned)q.wait_max_ms,
+                (unsigned)q.batches, (unsigned)q.batch_max_ms);
+  
+  // Coût d'affichage par cycle de scan (rendu incrémental)
+  const DisplayManager::FrameStats& fs = DisplayManager::frameStats();
+  Serial.printf("Display: %u frames, avg %u us, max %u us, %u strips pushed (%u.%02u per frame)\n",
+                (unsigned)fs.frames, (unsigned)(fs.frames ? fs.total_us / fs.frames : 0),
+                (unsigned)fs.max_us, (unsigned)fs.strips,
+                (unsigned)(fs.frames ? fs.strips / fs.frames : 0),
+                (unsigned)(fs.frames ? (fs.strips * 100 / fs.frames) % 100 : 0));
+  
+  // Sortie binaire : trames envoyées / abandonnées (buffer TX plein)
+  if (report_sent || report_dropped) {
+    Serial.printf("Report: %u records sent, %u dropped\n",
+                  (unsigned)report_sent.load(), (unsigned)report_dropped.load());
+  }
   
-  // Le mode continu sera géré par des appels répétés à pollingOnce()
-  // dans processContinuousScan() - plus simple et plus fiable
-  return true;
+  // Lien UHF : latences par commande, erreurs, débit
+  uhfPrintLinkStats();
 }
 
-// Lecture des tags en mode continu - Version multi-tags
+// Mode continu côté UI : consomme les événements du pipeline (jamais bloquant,
+// aucun accès UART ici)
 static void processContinuousScan() {
   if (!continuous_scan_active) return;
   
-  // Nettoyer les vieux tags de temps en temps
- static uint32_t last_cleanup = 0;
-  if (millis() - last_cleanup > 500) {  // Toutes les 500ms
-    cleanupOldTags();
-    last_cleanup = millis();
-  }
-  
-  // Scanner avec inventory raw pour récupérer RSSI réel
-  RawTagData raw_tags[16];  // Buffer pour tags avec RSSI
-  uint8_t n = rawInventoryWithRssi(raw_tags, 16);
-  
-  if (n > 0) {
-    bool new_tags_found = false;
-    
-    // Traiter TOUS les tags détectés avec leur RSSI réel !
+  bool new_tags_found = false;
+  bool changed = false;
+  UhfTagEvent ev[16];
+  uint8_t n;
+  while ((n = pipeline.poll(ev, 16)) > 0) {
+    changed = true;
     for (uint8_t i = 0; i < n; i++) {
-      String epc_str = raw_tags[i].epc;
-      int rssi_value = raw_tags[i].rssi_dbm;  // RSSI réel depuis trame brute !
+      const UhfTagEvent& e = ev[i];
+      tracked_tags = e.total;
       
-      // Ajouter/mettre à jour ce tag avec RSSI RÉEL
-      bool is_new = addOrUpdateContinuousTag(epc_str, "N/A", rssi_value);
+      if (e.kind == UHF_TAG_GONE) {
+        display_tags.remove(display_tags.find(e.epc, e.epc_len));
+        continue;
+      }
       
-      // 🔍 Lecture TID uniquement si tag nouveau (optimisation performance)
-      if (is_new) {
+      bool is_new = false;
+      UhfTagEntry& t = display_tags.at(display_tags.upsert(e.epc, e.epc_len, e.t_ms, &is_new));
+      t.rssi = e.rssi;
+      if (e.has_tid && !t.has_tid) {
+        memcpy(t.tid, e.tid, sizeof(t.tid));
+        t.has_tid = true;
+        char tid_hex[17];
+        _toHex(t.tid, 8, tid_hex, sizeof(tid_hex));
+        if (!report_binary) Serial.printf("TID found: %s\n", tid_hex);
+      }
+      if (e.kind == UHF_TAG_NEW) {
         new_tags_found = true;
-        Serial.printf("NEW TAG: %s RSSI: %d dBm\n", epc_str.c_str(), rssi_value);
-        
-        // Brief stop pour éviter conflicts RF avant select  
-        uhfStopMultiInventory();
-        delay(10);
-        
-        uint8_t epc_bytes[62];
-        size_t epc_len = epc_str.length() / 2;
-        if (hexToBytes(epc_str, epc_bytes, sizeof(epc_bytes)) &&
-            uhfSelectEpc(epc_bytes, epc_len))
-        {
-          uint8_t tid_buf[8];
-          if (readTid(tid_buf)) {
-            String tid_str = bytesToHex(tid_buf, 8).substring(0, 8);
-            continuous_tags[continuous_tags_count-1].tid = tid_str;
-            Serial.printf("TID found: %s\n", tid_str.c_str());
-          }
+        if (!report_binary) {
+          char epc_hex[EPC_HEX_SIZE];
+          _toHex(e.epc, e.epc_len, epc_hex, sizeof(epc_hex));
+          Serial.printf("NEW TAG: %s RSSI: %d dBm\n", epc_hex, e.rssi);
         }
       }
     }
-    
-    // Bip seulement s'il y a de nouveaux tags (évite la cacophonie)
-    if (new_tags_found) {
-      shortBeep();
+  }
+  
+  // Intervalles clos du comptage portail
+  UhfCountInterval iv[4];
+  while ((n = portal_count.pollIntervals(iv, 4)) > 0) {
+    for (uint8_t i = 0; i < n; i++) {
+      last_count_interval = iv[i];
+      has_count_interval = true;
+      if (!report_binary) printCountInterval(iv[i]);
     }
-    
-    // Mettre à jour l'affichage si nécessaire
-    if (millis() - last_display_update > 50) {  // Max ms
-      updateMultiTagDisplay();
-      last_display_update = millis();
+  }
+  
+  // current_tag = tag le plus proche (pour l'écriture), stable entre deux tags voisins
+  if (changed) {
+    nearest_slot = uhfNearestTag(display_tags, nearest_slot, NEAREST_MARGIN_DB);
+    if (nearest_slot != UhfTagTable<DISPLAY_TAGS>::NONE) {
+      const UhfTagEntry& t = display_tags.at(nearest_slot);
+      current_tag.epc_len = t.epc_len;
+      memcpy(current_tag.epc, t.epc, t.epc_len);
+      current_tag.has_tid = t.has_tid;
+      if (t.has_tid) memcpy(current_tag.tid, t.tid, sizeof(current_tag.tid));
     }
-    
-    // Mettre à jour current_tag avec le premier tag (pour compatibilité write)
-    String first_epc = raw_tags[0].epc;
-    current_tag.epc_len = first_epc.length() / 2;
-    hexToBytes(first_epc, current_tag.epc, sizeof(current_tag.epc));
   }
   
-  delay(25);  // Petit délai pour éviter la surcharge
+  // Un GONE perdu (file pleine) ne laisse pas de ligne fantôme
+  if (display_tags.expire(millis(), TAG_EXPIRY_MS * 2)) changed = true;
+  if (!changed) return;
+  
+  // Bip seulement s'il y a de nouveaux tags (évite la cacophonie)
+  if (new_tags_found) {
+    shortBeep();
+  }
+  
+  // Mettre à jour l'affichage si nécessaire
+  if (millis() - last_display_update > 50) {  // Max ms
+    updateMultiTagDisplay();
+    last_display_update = millis();
+  }
+}
+
+// CPU endormi jusqu'à la prochaine fenêtre d'écoute (ou console / tactile)
+static uint32_t dutyLightSleep(uint32_t ms) {
+  Serial.flush();                                       // sinon la fin de ligne part après le réveil
+  esp_sleep_enable_timer_wakeup(uint64_t(ms) * 1000);
+  uart_set_wakeup_threshold(UART_NUM_0, 3);
+  esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  gpio_wakeup_enable(TOUCH_INT_PIN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  const uint32_t t0 = millis();
+  esp_light_sleep_start();
+  return millis() - t0;
+}
+
+// Veille côté UI : luminosité selon l'état, courant batterie, light sleep
+// entre deux fenêtres en SLEEP (la tâche de parsing a arrêté le flux)
+static void serviceDutyCycle() {
+  const uint8_t st = continuous_scan_active ? duty.state() : uint8_t(UHF_DUTY_ACTIVE);
+  if (st != duty_shown) {
+    M5.Display.setBrightness(st == UHF_DUTY_ACTIVE ? duty_bright_full : st == UHF_DUTY_BACKOFF ? DUTY_BRIGHT_DIM : 0);
+    duty_shown = st;
+  }
+  if (!continuous_scan_active) return;
+
+  const uint32_t now = millis();
+  if (now - duty_sample_ms >= DUTY_SAMPLE_MS) {
+    const int32_t ma = M5.Power.getBatteryCurrent();   // < 0 : décharge
+    duty.addCharge(st, ma < 0 ? uint32_t(-ma) : 0, now - duty_sample_ms);
+    duty_sample_ms = now;
+  }
+  const uint32_t budget = duty.sleepBudgetMs(now);
+  if (!DUTY_LIGHT_SLEEP || budget < DUTY_MIN_SLEEP_MS || Serial.available()) return;
+  const uint32_t slept = dutyLightSleep(budget);
+  duty.noteSleep(slept);
+  duty.addCharge(UHF_DUTY_SLEEP, DUTY_SLEEP_MA, slept);
+  duty_sample_ms = millis();
 }
 
-// Affichage multi-tags unifié avec DisplayManager
+// Affichage multi-tags unifié avec DisplayManager (hex produit ici seulement).
+// Rendu incrémental : seules les lignes dont le contenu a changé partent à l'écran.
 static void updateMultiTagDisplay() {
-  // Initialiser l'écran avec l'en-tête via DisplayManager
-  DisplayManager::showContinuousMode(continuous_tags_count, getCurrentPowerText());
-  
-  // Afficher chaque tag via DisplayManager
-  if (continuous_tags_count > 0) {
-    for (uint8_t i = 0; i < continuous_tags_count; i++) {
-      // Tronquer l'EPC si nécessaire pour l'affichage
-      String display_epc = continuous_tags[i].epc;
-      if (display_epc.length() > 38) {
-        display_epc = display_epc.substring(0, 36) + "..";
-      }
-      
-      // Utiliser DisplayManager pour l'affichage unifié
-      uint16_t tl = (uint16_t)continuous_tags[i].tid.length();
-      String tid_short = continuous_tags[i].tid.substring(0, (tl < 8 ? tl : 8));
-      DisplayManager::showTagEntry(i, display_epc, continuous_tags[i].rssi, tid_short, continuous_tags[i].is_new);
-      
-      // Marquer comme plus nouveau après affichage
-      continuous_tags[i].is_new = false;
-      
-      // Limite d'affichage - utiliser DisplayManager pour cohérence
-      if (i >= 6) {  // Limite réduite pour laisser place aux détails
-        DisplayManager::showTagEntry(-1, String("+ ") + String(continuous_tags_count - 7) + " more...", 0, "", false);
-        break;
-      }
+  const uint16_t total = tracked_tags;
+  const uint32_t t0 = DisplayManager::beginContinuousFrame();
+  DisplayManager::showContinuousHeader(total, getCurrentPowerText());
+  
+  // Afficher les tags dans l'ordre des slots (une ligne ne bouge pas tant que le tag reste)
+  int row = 0;
+  for (uint16_t i = 0; i < display_tags.capacity() && row < DisplayManager::MAX_ROWS; i++) {
+    if (!display_tags.used(i)) continue;
+    UhfTagEntry& t = display_tags.at(i);
+    
+    // Tronquer l'EPC si nécessaire pour l'affichage (38 caractères max)
+    char display_epc[EPC_HEX_SIZE];
+    size_t hl = _toHex(t.epc, t.epc_len, display_epc, sizeof(display_epc));
+    if (hl > 38) {
+      display_epc[36] = '.'; display_epc[37] = '.'; display_epc[38] = '\0';
     }
+    
+    // TID : 8 premiers caractères hex
+    char tid_short[9] = "N/A";
+    if (t.has_tid) _toHex(t.tid, 4, tid_short, sizeof(tid_short));
+    DisplayManager::showTagEntry(row, display_epc, t.rssi, tid_short, t.is_new);
+    
+    // Marquer comme plus nouveau après affichage
+    t.is_new = false;
+    row++;
   }
+  
+  // Lignes libérées, "+ N more..." et compteur de temps d'affichage
+  DisplayManager::endContinuousFrame(t0, row, total);
 }
 
 // === Fonctions pour gestion mode EPC cyclique ===
 
 // Fonction pour cycler entre les modes EPC
 
-// Fonction pour effectuer l'écriture selon le mode actuel
-static void performEpcWrite() {
-  if (current_tag.epc_len == 0) {
-    displayStatus("Error", "Scan first!");
+// === Scan non bloquant (bouton A) ===
+// Séquence 1 : stop + puissance d'inventaire + un tour 0x22. Séquence 2,
+// lancée par son callback si le TID n'est pas en cache : select + TID.
+// Un échec de la séquence 1 repasse par le scan bloquant (repli 0x27 des
+// firmwares qui refusent 0x22 compris).
+static int16_t scan_rssi = 0;
+
+// Garder le tag le plus fort du tour (le plus proche de l'antenne)
+static bool pickStrongestTag(const RawTagData* raw_tags, uint8_t n) {
+  query_ctl.noteRound(n);
+  for (uint8_t i = 0; i < n; i++) query_ctl.noteRead(raw_tags[i].epc_raw, raw_tags[i].epc_len);
+  if (query_ctl.update(millis())) uhfSetQueryParams(query_ctl.params());
+  
+  if (n == 0) {
+    displayStatus("Scan: 0", "No tags");
+    return false;
+  }
+  uint8_t best = 0;
+  for (uint8_t i = 1; i < n; i++) {
+    if (raw_tags[i].rssi_dbm > raw_tags[best].rssi_dbm) best = i;
+  }
+  current_tag.epc_len = raw_tags[best].epc_len;
+  memcpy(current_tag.epc, raw_tags[best].epc_raw, raw_tags[best].epc_len);
+  scan_rssi = raw_tags[best].rssi_dbm;
+  return true;
+}
+
+static void showScannedTag(bool selected) {
+  if (!selected) {
+    displayStatus("Scan OK", "Select failed");
+    return;
+  }
+  char epc_hex[EPC_HEX_SIZE];
+  _toHex(current_tag.epc, current_tag.epc_len, epc_hex, sizeof(epc_hex));
+  String epc_str = epc_hex;  // affichage uniquement
+  String tid_str = current_tag.has_tid ? bytesToHex(current_tag.tid, 8) : "N/A";
+  
+  displayStatus(
+    "Tag found",
+    "EPC: " + String(current_tag.epc_len * 8) + "b RSSI: " + String(scan_rssi) + "dBm",
+    "Data: " + String(epc_str.length() > 36 ? epc_str.substring(0, 36) + ".." : epc_str),
+    "TID: " + tid_str.substring(0, 16),
+    getEpcWordsText()
+  );
+}
+
+static void performScanBlocking() {
+  uhfStopMultiInventory();
+  
+  // Puissance d'inventaire du poste d'encodage : le tag posé, pas ses voisins
+  uhfApplyTxPower(tx_power.base(UHF_POWER_INVENTORY));
+  RawTagData raw_tags[8];
+  uint8_t n = rawInventoryWithRssi(raw_tags, 8);
+  if (!pickStrongestTag(raw_tags, n)) return;
+  
+  // Sélectionner et lire TID, sauf s'il est déjà dans le cache
+  current_tag.has_tid = tid_cache.lookup(current_tag.epc, uint8_t(current_tag.epc_len), current_tag.tid);
+  bool selected = current_tag.has_tid;
+  if (!selected) {
+    selected = rawSelect(current_tag.epc, current_tag.epc_len);
+    if (selected) current_tag.has_tid = readTid(current_tag.tid);
+    if (current_tag.has_tid) tid_cache.put(current_tag.epc, uint8_t(current_tag.epc_len), current_tag.tid);
+  }
+  showScannedTag(selected);
+}
+
+static void onScanTid(const UhfAsyncResult& r, void*) {
+  current_tag.has_tid = r.status == UHF_ASYNC_OK && r.data_len >= 8;
+  if (current_tag.has_tid) {
+    memcpy(current_tag.tid, r.data, 8);
+    tid_cache.put(current_tag.epc, uint8_t(current_tag.epc_len), current_tag.tid);
+  }
+  // Étape 0 = select : au-delà, seul le TID a manqué
+  showScannedTag(r.status == UHF_ASYNC_OK || r.steps_done > 0);
+}
+
+static void onScanDone(const UhfAsyncResult& r, void*) {
+  if (r.status != UHF_ASYNC_OK || (r.tag_count == 0 && uhf_async.reader().lastErrorCode() == 0x17)) {
+    Serial.printf("Async scan failed (status %u, step %u) -> blocking scan\n", r.status, r.steps_done);
+    performScanBlocking();
     return;
   }
+  if (!pickStrongestTag(r.tags, r.tag_count)) return;
   
-  // Stopper multi-inventory
+  current_tag.has_tid = tid_cache.lookup(current_tag.epc, uint8_t(current_tag.epc_len), current_tag.tid);
+  if (current_tag.has_tid) {
+    showScannedTag(true);
+    return;
+  }
+  // READ bank 2 (TID), word 0, 4 words : comme readTid()
+  UhfAsyncSeq seq;
+  seq.selectEpc(current_tag.epc, current_tag.epc_len).read(0x02, 0, 4);
+  if (!uhf_async.submit(seq, onScanTid)) showScannedTag(false);
+}
+
+// Écriture bloquante : select EPC puis TID, write avec auto-clip et paliers
+// de puissance, reselect + read-back
+static void writeEpcBlocking(const uint8_t* new_epc, size_t target_len) {
+  // Stopper multi-inventory (confirmé par la réponse du module)
   uhfStopMultiInventory();
-  delay(50);
   
   // Sélectionner le tag
   bool selected = false;
@@ -1264,22 +1164,16 @@ static void performEpcWrite() {
     return;
   }
   
-  // Générer EPC selon la longueur ciblée (words → bytes)
-  uint8_t new_epc[62]; // max 31 words = 62 bytes
-  const uint8_t target_words = g_target_words;
-  const size_t  target_len   = size_t(target_words) * 2;
-  Serial.printf("=== WRITE RANDOM EPC: %u words (%u bits) ===\n", target_words, target_words * 16);
-  
-  generateRandomEpc(new_epc, target_len);
   String newEpcHex = bytesToHex(new_epc, target_len);
   
-  Serial.println("Target new EPC: " + newEpcHex);
-  
   // Écriture + reselect + read-back (même pipeline que touche 'C')
   WriteError err = writeEpcVariableSafeWithVerifyRaw(new_epc, target_len, ACCESS_PWD);
   Serial.println("Write result: " + String(errorToString(err)));
   
   if (err == WRITE_OK) {
+    // L'ancien EPC ne désigne plus ce tag : son TID suit le nouveau
+    tid_cache.forget(current_tag.epc, uint8_t(current_tag.epc_len));
+    if (current_tag.has_tid) tid_cache.put(new_epc, uint8_t(target_len), current_tag.tid);
     // Le wrapper a déjà fait un read-back via PC; afficher juste OK + EPC cible
     DisplayManager::showWriteResult(true, "Write+Readback done", "", newEpcHex);
   } else {
@@ -1287,76 +1181,923 @@ static void performEpcWrite() {
   }
 }
 
+// === Écriture non bloquante (bouton B) ===
+// Séquence 1 : stop + puissance d'écriture + select + lecture du PC.
+// Séquence 2, lancée par son callback : PC (nouvelle longueur) + EPC +
+// reselect du nouvel EPC + relecture PC/EPC, sans délai entre les étapes.
+// Un échec avant l'écriture de l'EPC repasse par l'écriture bloquante.
+static struct {
+  uint8_t  epc[62];
+  uint8_t  len;
+  uint16_t level;
+} pending_write;
+
+static void onWriteDone(const UhfAsyncResult& r, void*) {
+  // Étapes 0-1 : PC + EPC ; 2-3 : reselect + relecture
+  if (r.status != UHF_ASYNC_OK && r.steps_done < 2) {
+    Serial.printf("Async write failed (step %u, error 0x%02X) -> blocking write\n", r.steps_done, r.module_error);
+    writeEpcBlocking(pending_write.epc, pending_write.len);
+    return;
+  }
+  Serial.println("Write result: " + String(errorToString(WRITE_OK)));
+  tx_power.succeeded(UHF_POWER_WRITE, pending_write.epc, pending_write.len, pending_write.level);
+  // L'ancien EPC ne désigne plus ce tag : son TID suit le nouveau
+  tid_cache.forget(current_tag.epc, uint8_t(current_tag.epc_len));
+  if (current_tag.has_tid) tid_cache.put(pending_write.epc, pending_write.len, current_tag.tid);
+  
+  if (r.status == UHF_ASYNC_OK && r.data_len >= 2) {
+    const uint16_t pc = (uint16_t(r.data[0]) << 8) | r.data[1];
+    const size_t n = min(size_t((pc >> 11) & 0x1F) * 2, size_t(r.data_len - 2));
+    UHF_LOGI_BYTES(WRITE, READBACK, r.data + 2, n, pc, (pc >> 11) & 0x1F);
+    // Mettre à jour current_tag avec ce qu'il y a VRAIMENT sur le tag
+    current_tag.epc_len = n;
+    memcpy(current_tag.epc, r.data + 2, n);
+  } else {
+    // Écrit : certains firmwares ratent le reselect juste après
+    UHF_LOGW(WRITE, READBACK_FAILED);
+  }
+  DisplayManager::showWriteResult(true, "Write+Readback done", "", bytesToHex(pending_write.epc, pending_write.len));
+}
+
+static void onWritePc(const UhfAsyncResult& r, void*) {
+  if (r.status != UHF_ASYNC_OK || r.data_len < 2) {
+    Serial.printf("Async select/PC failed (step %u, error 0x%02X) -> blocking write\n", r.steps_done, r.module_error);
+    writeEpcBlocking(pending_write.epc, pending_write.len);
+    return;
+  }
+  // Longueur dans les bits [15:11], le reste du PC est conservé
+  const uint16_t current_pc = (uint16_t(r.data[0]) << 8) | r.data[1];
+  const uint8_t words = pending_write.len / 2;
+  const uint16_t new_pc = (current_pc & 0x07FF) | (uint16_t(words) << 11);
+  Serial.printf("Current PC: 0x%04X, writing PC: 0x%04X\n", current_pc, new_pc);
+  
+  UhfAsyncSeq seq;
+  seq.writePc(new_pc, ACCESS_PWD)
+     .write(0x01, 2, pending_write.epc, pending_write.len, ACCESS_PWD)
+     .selectEpc(pending_write.epc, pending_write.len)
+     .read(0x01, 1, uint8_t(1 + words), ACCESS_PWD);
+  if (!uhf_async.submit(seq, onWriteDone)) writeEpcBlocking(pending_write.epc, pending_write.len);
+}
+
+// Fonction pour effectuer l'écriture selon le mode actuel
+static void performEpcWrite() {
+  if (current_tag.epc_len == 0) {
+    displayStatus("Error", "Scan first!");
+    return;
+  }
+  
+  // Générer EPC selon la longueur ciblée (words → bytes)
+  const uint8_t target_words = g_target_words;
+  const size_t  target_len   = size_t(target_words) * 2;
+  Serial.printf("=== WRITE RANDOM EPC: %u words (%u bits) ===\n", target_words, target_words * 16);
+  
+  generateRandomEpc(pending_write.epc, target_len);
+  pending_write.len = uint8_t(target_len);
+  Serial.println("Target new EPC: " + bytesToHex(pending_write.epc, target_len));
+  
+  // Puissance retenue pour ce tag ; les paliers restent à l'écriture bloquante
+  pending_write.level = tx_power.begin(UHF_POWER_WRITE, current_tag.epc, current_tag.epc_len);
+  UhfAsyncSeq seq;
+  seq.stop()
+     .power(pending_write.level)
+     .selectEpc(current_tag.epc, current_tag.epc_len)
+     .read(0x01, 1, 1, ACCESS_PWD);                  // Bank EPC, word 1 (PC)
+  if (!uhf_async.submit(seq, onWritePc)) writeEpcBlocking(pending_write.epc, target_len);
+}
+
 // === NEW: Read-back EPC complet via PC word, en s'appuyant 100% sur rawRead() ===
 // readEpcFullFromPcRaw supprimée - utiliser uhfReadEpcViaPc()
 
 // === NEW: Wrapper "write + reselect + read-back" basé rawRead() + fallback TID ===
 static WriteError writeEpcVariableSafeWithVerifyRaw(const uint8_t* epc, size_t epc_bytes, uint32_t accessPwd) {
-  // 1) Write variable sécurisé (PC + EPC, auto-clip/auto-retry)
-  WriteError err = writeEpcVariableSafe(epc, epc_bytes, accessPwd);
-  if (err != WRITE_OK) return err;
+  // 1) Write variable sécurisé (PC + EPC, auto-clip/auto-retry), à la
+  // puissance retenue pour ce tag ; un palier de plus par erreur de puissance
+  uint16_t level = tx_power.begin(UHF_POWER_WRITE, current_tag.epc, current_tag.epc_len);
+  WriteError err;
+  for (;;) {
+    uhfApplyTxPower(level);
+    err = writeEpcVariableSafe(epc, epc_bytes, accessPwd);
+    if (err == WRITE_OK) break;
+    const uint16_t next = tx_power.escalate(UHF_POWER_WRITE, level, uhfLastErrorCode());
+    if (!next) return err;
+    UHF_LOGI(WRITE, WRITE_POWER, level, next);
+    uhfNoteRetry(0x49);
+    level = next;
+  }
+  tx_power.succeeded(UHF_POWER_WRITE, epc, uint8_t(min(epc_bytes, (size_t)62)), level);
 
   // 2) Reselect post-write (wake + full → 96b → TID → reset-select retry)
+  // Chaque commande rend la main à sa réponse : aucun délai fixe entre les étapes
   uhfStopMultiInventory();
-  delay(20);
   { RawTagData tmp[1]; (void)rawInventoryWithRssi(tmp, 1); } // wake the tag
-  delay(10);
   size_t try_len = epc_bytes;
   if (try_len & 1) try_len++;           // alignement sécurité (mots)
   if (try_len > 62) try_len = 62;
 
   bool selected = false;
-  Serial.println("🔁 Post-write reselect (full EPC)...");
   selected = uhfSelectEpc(epc, try_len);
   if (!selected && try_len > 12) {
-    Serial.println("⚠️ Full-length SELECT failed → trying 96-bit prefix");
+    UHF_LOGW(WRITE, RESELECT_PREFIX);
+    uhfNoteRetry(0x0C);
     selected = uhfSelectEpc(epc, 12);
   }
   if (!selected && current_tag.has_tid) {
-    Serial.println("⚠️ Prefix SELECT failed → trying TID");
+    UHF_LOGW(WRITE, RESELECT_TID);
     selected = uhfSelectTid64(current_tag.tid);
   }
   if (!selected) {
     // Last-chance: reset select mode to EPC and try again
     setSelectMode(0x00); // EPC
     { RawTagData tmp[1]; (void)rawInventoryWithRssi(tmp, 1); }
-    delay(10);
+    uhfNoteRetry(0x0C);
     selected = uhfSelectEpc(epc, min(try_len,(size_t)12));
   }
   if (!selected) {
-    Serial.println("❌ Post-write reselect FAILED (EPC/TID)");
+    UHF_LOGE(WRITE, RESELECT_FAILED);
     // On peut continuer au read-back; certains firmwares renvoient quand même le bon contenu.
   } else {
-    Serial.println("✅ Post-write reselect OK");
+    UHF_LOGI(WRITE, RESELECT_OK);
   }
 
-  // 3) Read-back EPC via PC (source of truth)
+  // 3) Read-back EPC via PC (source of truth), même politique de puissance
   uhfStopMultiInventory();
-  delay(20);
-  { RawTagData tmp[1]; (void)rawInventoryWithRssi(tmp, 1); } // re-energize link
-  delay(10);
   uint8_t epc_read[62]; size_t epc_read_len = 0; uint16_t pc_after = 0;
-  if (uhfReadEpcViaPc(epc_read, epc_read_len, pc_after, ACCESS_PWD)) {
-    Serial.printf("🔍 PC after write: 0x%04X (len=%u words)\n", pc_after, (pc_after >> 11) & 0x1F);
-    Serial.print("🔍 EPC read-back: ");
-    for (size_t i = 0; i < epc_read_len; ++i) Serial.printf("%02X", epc_read[i]);
-    Serial.println();
+  if (tx_power.run(UHF_POWER_READ, epc, uint8_t(try_len), [&] {
+        { RawTagData tmp[1]; (void)rawInventoryWithRssi(tmp, 1); } // re-energize link
+        return uhfReadEpcViaPc(epc_read, epc_read_len, pc_after, ACCESS_PWD);
+      })) {
+    UHF_LOGI_BYTES(WRITE, READBACK, epc_read, epc_read_len, pc_after, (pc_after >> 11) & 0x1F);
 
     // Mettre à jour current_tag avec ce qu'il y a VRAIMENT sur le tag
     current_tag.epc_len = epc_read_len;
     memcpy(current_tag.epc, epc_read, epc_read_len);
   } else {
-    Serial.println("⚠️ EPC read-back failed (module busy or tag moved?)");
+    UHF_LOGW(WRITE, READBACK_FAILED);
   }
   return WRITE_OK;
 }
 
+// === TEST: Write EPC 128-bit fixe avec touche 'C' ===
+static void testWrite128() {
+  uint8_t epc128[16] = {
+    0x30, 0x08, 0x33, 0xB2,
+    0xDD, 0xD9, 0x01, 0x40,
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01
+  };
+  // Une ligne de résultat sur la console ; les étapes vont au journal différé
+  
+  // Sécurisation : rendre l'UART au loop() (mode continu), arrêter
+  // multi-inventory et sélectionner un tag
+  if (continuous_scan_active) {
+    continuous_scan_active = false;
+    pipeline.stop();
+  }
+  uhfStopMultiInventory();
+  
+  bool tag_selected = false;
+  if (current_tag.epc_len > 0) {
+    // Utiliser le tag scanné précédemment
+    UHF_LOGI(WRITE, TEST_SELECT_LAST);
+    tag_selected = rawSelect(current_tag.epc, current_tag.epc_len)
+                   || uhfSelectEpc(current_tag.epc, current_tag.epc_len); // fallback EPC raw
+  } else {
+    // Fallback: poll 1 tag et select
+    UHF_LOGI(WRITE, TEST_SELECT_SCAN);
+    RawTagData one[1];
+    if (rawInventoryWithRssi(one, 1) > 0) {
+      const uint8_t* b = one[0].epc_raw;
+      size_t L = one[0].epc_len;
+      tag_selected = rawSelect(b, L) || uhfSelectEpc(b, L); // fallback EPC raw
+    }
+  }
+  
+  if (!tag_selected) {
+    if (!report_binary) Serial.println("C ERR no tag selected, write aborted");
+    return;
+  }
+  // → Ecriture + reselect (full→96→TID) + read-back EPC via rawRead()
+  const WriteError result = writeEpcVariableSafeWithVerifyRaw(epc128, sizeof(epc128), ACCESS_PWD);
+  if (report_binary) return;
+  if (result == WRITE_OK) Serial.println("C OK 128-bit EPC written and verified");
+  else Serial.printf("C ERR %s\n", errorToString(result));
+}
+
+// === Encodage en série piloté par la console ===
+// Une ligne par commande :
+//   ENC ADD <epc_hex> [<epc_hex> ...]            EPC explicites (file FIFO)
+//   ENC TPL <base_hex> <first> <count> [bytes]   numéro de série big-endian
+//                                                dans les `bytes` derniers octets (défaut 4)
+//   ENC GO | ENC STOP | ENC STAT | ENC CLEAR
+// Un tag à la fois dans le champ ; résultat de chaque job renvoyé sur une ligne
+// "ENC JOB ...", puis "ENC DONE" et les statistiques en fin de lot.
+//
+// Santé du lien UHF (latences par commande, erreurs, débit d'inventaire) :
+//   UHF STAT | UHF RESET
+// Lectures du mode continu en binaire (host/report_decode) ou en texte :
+//   OUT BIN | OUT TEXT
+// Capture du trafic UART pour host/trace_replay (ON et DUMP hors mode continu) :
+//   TRACE ON | TRACE OFF | TRACE DUMP | TRACE STAT
+// Calibration RSSI (hors mode continu) : un seul tag devant l'antenne, posé à
+// chaque distance, puis SAVE construit la table et l'écrit en NVS :
+//   CAL <distance_cm> | CAL SAVE | CAL CLEAR | CAL SHOW
+// Anti-collision (préréglage hors mode continu) :
+//   QUERY AUTO | QUERY ENCODE | QUERY PORTAL | QUERY FIXED | QUERY SHOW
+// Puissance RF en 0.01 dBm : base par opération, plafond et palier de la
+// politique, lecture du module (hors mode continu), cache par tag :
+//   POWER INV|READ|WRITE|MAX|STEP <cdBm> | POWER GET | POWER SHOW | POWER CLEAR
+// Cache EPC -> TID : taux de réussite, écriture NVS et effacement (hors mode
+// continu ; à vider avant d'encoder des vierges qui partagent leur EPC) :
+//   TID SHOW | TID SAVE | TID CLEAR
+// Comptage portail : EPC distincts depuis START, nouveaux tags et lectures/s
+// par intervalle (START hors mode continu ; plafond exact, intervalle et
+// fenêtre de répétition en secondes, 0 = valeur par défaut) :
+//   COUNT START [exact_cap [interval_s [window_s]]] | COUNT STOP | COUNT SHOW
+// Inventaire sur tous les modules (hors mode continu, 0x22 entrelacés ou
+// flux 0x27, durée en secondes, 30 au plus). Tourne dans loop() ; A ou
+// STOP l'arrête, les autres commandes attendent la fin :
+//   MULTI [seconds [STREAM]] | MULTI STOP
+// Transferts par blocs sur le dernier tag scanné (hors mode continu ; banque
+// 1 EPC, 2 TID en lecture, 3 user ; adresse et longueur en mots, 256 au plus ;
+// écritures relues). RESUME reprend le dernier job après TAG_LOST :
+//   BULK READ <bank> <word> <words> | BULK WRITE <bank> <word> <hex>
+//   BULK FILL <bank> <word> <words> [byte_hex] | BULK RESUME | BULK MODELS
+// Veille du mode continu : temps, lectures et charge par état, fenêtres,
+// light sleeps ; ON avec une cible de latence au premier tag en ms (ON, OFF
+// et RESET hors mode continu) :
+//   DUTY SHOW | DUTY ON [latency_ms] | DUTY OFF | DUTY RESET
+// Journal différé : sortie en temps libre formatée (TEXT, défaut), brute pour
+// host/log_decode (HEX) ou gardée en RAM (HOLD) ; DUMP vide l'anneau en hex :
+//   LOG SHOW | LOG TEXT | LOG HEX | LOG HOLD | LOG DUMP | LOG CLEAR
+static char console_line[256];
+static size_t console_len = 0;
+
+static size_t parseHexEpc(const char* s, uint8_t* out, size_t cap) {
+  size_t n = 0;
+  while (s[0] && s[1]) {
+    if (n == cap || !isxdigit((unsigned char)s[0]) || !isxdigit((unsigned char)s[1])) return 0;
+    char byte[3] = {s[0], s[1], 0};
+    out[n++] = uint8_t(strtoul(byte, nullptr, 16));
+    s += 2;
+  }
+  return s[0] ? 0 : n;   // nombre impair de chiffres : refusé
+}
+
+static void printEncoderStats() {
+  const UhfEncoderStats& st = encoder.stats();
+  Serial.printf("ENC STAT %u ok, %u failed, %u fallbacks, %u collisions, %u power steps, %u pending, %u tags/min\n",
+                (unsigned)st.ok, (unsigned)st.failed, (unsigned)st.fallbacks, (unsigned)st.collisions,
+                (unsigned)st.power_steps, (unsigned)encoder.pending(), (unsigned)encoder.tagsPerMinute());
+  for (uint8_t p = 0; p < UHF_ENC_PHASES; p++) {
+    const UhfEncodePhaseStats& ph = st.phase[p];
+    Serial.printf("ENC PHASE %s avg %u us, max %u us (%u)\n", uhfEncodePhaseName(p),
+                  (unsigned)(ph.count ? ph.total_us / ph.count : 0), (unsigned)ph.max_us,
+                  (unsigned)ph.count);
+  }
+}
+
+// Résultat d'un job : une ligne série + écran
+static void onEncodeResult(const UhfEncodeResult& r, void*) {
+  char hex[EPC_HEX_SIZE];
+  _toHex(r.epc, r.epc_len, hex, sizeof(hex));
+  if (r.status == UHF_ENC_OK) {
+    Serial.printf("ENC JOB %u OK %s %u us (acq %u sel %u wr %u ver %u) %u.%02u dBm%s\n",
+                  (unsigned)r.job, hex, (unsigned)r.total_us,
+                  (unsigned)r.phase_us[UHF_ENC_ACQUIRE], (unsigned)r.phase_us[UHF_ENC_SELECT],
+                  (unsigned)r.phase_us[UHF_ENC_WRITE], (unsigned)r.phase_us[UHF_ENC_VERIFY],
+                  r.power / 100, r.power % 100, r.fallback ? " fallback" : "");
+    shortBeep();
+  } else {
+    Serial.printf("ENC JOB %u FAIL %s err=0x%02X %s\n",
+                  (unsigned)r.job, uhfEncodeStatusName(r.status), r.module_error, hex);
+    M5.Speaker.tone(400, 150, 0, false);
+  }
+  const UhfEncoderStats& st = encoder.stats();
+  displayStatus("ENCODING", String("Job ") + r.job + (r.status == UHF_ENC_OK ? " OK" : " FAIL"),
+                String(st.ok) + " done, " + encoder.pending() + " left",
+                String(encoder.tagsPerMinute()) + " tags/min", "A: stop");
+}
+
+static void handleEncoderCommand(char* args) {
+  char* save = nullptr;
+  char* verb = strtok_r(args, " ", &save);
+  if (!verb) {
+    Serial.println("ENC ERR usage: ENC ADD|TPL|GO|STOP|STAT|CLEAR");
+    return;
+  }
+  
+  if (strcmp(verb, "ADD") == 0) {
+    uint8_t epc[EPC_MAX_BYTES];
+    uint32_t added = 0;
+    for (char* tok = strtok_r(nullptr, " ", &save); tok; tok = strtok_r(nullptr, " ", &save)) {
+      const size_t len = parseHexEpc(tok, epc, sizeof(epc));
+      if (len == 0) { Serial.printf("ENC ERR bad EPC %s\n", tok); break; }
+      if (!encoder.addEpc(epc, uint8_t(len))) { Serial.println("ENC ERR queue full"); break; }
+      added++;
+    }
+    Serial.printf("ENC ADDED %u, %u pending\n", (unsigned)added, (unsigned)encoder.pending());
+  } else if (strcmp(verb, "TPL") == 0) {
+    const char* base  = strtok_r(nullptr, " ", &save);
+    const char* first = strtok_r(nullptr, " ", &save);
+    const char* count = strtok_r(nullptr, " ", &save);
+    const char* bytes = strtok_r(nullptr, " ", &save);
+    uint8_t epc[EPC_MAX_BYTES];
+    const size_t len = base ? parseHexEpc(base, epc, sizeof(epc)) : 0;
+    if (len == 0 || !first || !count ||
+        !encoder.setTemplate(epc, uint8_t(len), bytes ? uint8_t(atoi(bytes)) : 4,
+                             strtoul(first, nullptr, 0), strtoul(count, nullptr, 0))) {
+      Serial.println("ENC ERR usage: ENC TPL <base_hex> <first> <count> [serial_bytes 1..4]");
+      return;
+    }
+    Serial.printf("ENC TEMPLATE %s, %u pending\n", base, (unsigned)encoder.pending());
+  } else if (strcmp(verb, "GO") == 0) {
+    // Le moteur a besoin de l'UART : arrêter le mode continu
+    if (continuous_scan_active) {
+      continuous_scan_active = false;
+      pipeline.stop();
+    }
+    if (!encoder.start()) {
+      Serial.println("ENC ERR no job loaded");
+      return;
+    }
+    Serial.printf("ENC STARTED, %u pending\n", (unsigned)encoder.pending());
+    displayStatus("ENCODING", "Present one tag", String(encoder.pending()) + " jobs", "", "A: stop");
+  } else if (strcmp(verb, "STOP") == 0) {
+    encoder.stop();
+    Serial.println("ENC STOPPED");
+    printEncoderStats();
+  } else if (strcmp(verb, "STAT") == 0) {
+    printEncoderStats();
+  } else if (strcmp(verb, "CLEAR") == 0) {
+    encoder.clear();
+    Serial.println("ENC CLEARED");
+  } else {
+    Serial.printf("ENC ERR unknown command %s\n", verb);
+  }
+}
+
+// === Calibration RSSI (uhf_rssi.h) ===
+static constexpr uint8_t CAL_ROUNDS    = 32;    // tours d'inventaire par distance
+static constexpr uint8_t CAL_MIN_READS = 8;     // lectures minimum pour un point
+static UhfRssiCalibration rssi_cal;
+
+static const char* rssiProfileName(RssiProfile p) {
+  return p == RSSI_LINEAR ? "LINEAR" : p == RSSI_CURVED ? "CURVED" : "CUSTOM";
+}
+
+static void printRssiCalibration() {
+  Serial.printf("CAL PROFILE %s, %u points\n", rssiProfileName(uhfRssiProfile()), (unsigned)rssi_cal.size());
+  for (uint8_t i = 0; i < rssi_cal.size(); i++) {
+    const UhfRssiCalPoint& p = rssi_cal.point(i);
+    Serial.printf("CAL POINT %u cm raw 0x%02X -> %d dBm\n", (unsigned)p.distance_cm, p.raw, p.dbm);
+  }
+}
+
+static void handleCalCommand(char* args) {
+  char* save = nullptr;
+  char* verb = strtok_r(args, " ", &save);
+  if (!verb) {
+    Serial.println("CAL ERR usage: CAL <distance_cm>|SAVE|CLEAR|SHOW");
+    return;
+  }
+  if (strcmp(verb, "SHOW") == 0) {
+    printRssiCalibration();
+    return;
+  }
+  // La tâche de parsing lit la table active pendant le mode continu
+  if (continuous_scan_active) {
+    Serial.println("CAL ERR stop continuous mode first");
+    return;
+  }
+  
+  if (strcmp(verb, "SAVE") == 0) {
+    int8_t table[256];
+    if (!rssi_cal.build(table)) {
+      Serial.println("CAL ERR need 2+ distances, closer tag must read stronger");
+      return;
+    }
+    uhfRssiSetCustomTable(table);
+    Serial.println(uhfRssiSaveCalibration() ? "CAL SAVED" : "CAL ERR NVS write failed (table active until reboot)");
+  } else if (strcmp(verb, "CLEAR") == 0) {
+    rssi_cal.clear();
+    uhfRssiResetCustomTable();
+    uhfRssiEraseCalibration();
+    Serial.println("CAL CLEARED");
+  } else {
+    const long cm = atol(verb);
+    if (cm <= 0 || cm > 65535) {
+      Serial.printf("CAL ERR bad distance %s\n", verb);
+      return;
+    }
+    // Octet RSSI brut du tag le plus fort de chaque tour
+    uint8_t raw[CAL_ROUNDS];
+    uint8_t n = 0;
+    RawTagData tags[8];
+    for (uint8_t r = 0; r < CAL_ROUNDS; r++) {
+      const uint8_t found = rawInventoryWithRssi(tags, 8);
+      uint8_t best = 0;
+      for (uint8_t i = 0; i < found; i++) best = max(best, tags[i].rssi_raw);
+      if (best) raw[n++] = best;
+    }
+    if (n < CAL_MIN_READS || !rssi_cal.addPoint(uint16_t(cm), raw, n)) {
+      Serial.printf("CAL ERR %u reads at %ld cm (points full or tag not seen)\n", (unsigned)n, cm);
+      return;
+    }
+    for (uint8_t i = 0; i < rssi_cal.size(); i++) {
+      const UhfRssiCalPoint& p = rssi_cal.point(i);
+      if (p.distance_cm == cm) {
+        Serial.printf("CAL POINT %u cm raw 0x%02X -> %d dBm (%u reads)\n",
+                      (unsigned)p.distance_cm, p.raw, p.dbm, (unsigned)n);
+      }
+    }
+  }
+}
+
+static void printQueryState() {
+  const UhfQueryParams& p = query_ctl.params();
+  const UhfQueryStats& st = query_ctl.stats();
+  Serial.printf("QUERY %s Q=%u S%u target %c (word 0x%04X)\n", uhfQueryPresetName(query_ctl.policy().preset),
+                p.q, p.session, p.target ? 'B' : 'A', p.word());
+  Serial.printf("QUERY windows %u (silent %u), population ~%u, last %u reads / %u tags\n",
+                (unsigned)st.windows, (unsigned)st.silent_windows, st.population, st.last_reads, st.last_distinct);
+  Serial.printf("QUERY Q changes %u, target flips %u, probes %u kept %u, collision windows %u\n",
+                (unsigned)st.q_changes, (unsigned)st.target_flips, (unsigned)st.probes,
+                (unsigned)st.probes_kept, (unsigned)st.collision_windows);
+}
+
+static void handleQueryCommand(char* args) {
+  char* save = nullptr;
+  char* verb = strtok_r(args, " ", &save);
+  if (!verb) {
+    Serial.println("QUERY ERR usage: QUERY AUTO|ENCODE|PORTAL|FIXED|SHOW");
+    return;
+  }
+  if (strcmp(verb, "SHOW") == 0) {
+    printQueryState();
+    return;
+  }
+  uint8_t preset = 0;
+  while (preset < UHF_QUERY_PRESETS && strcmp(verb, uhfQueryPresetName(preset)) != 0) preset++;
+  if (preset == UHF_QUERY_PRESETS) {
+    Serial.printf("QUERY ERR unknown preset %s\n", verb);
+    return;
+  }
+  // La tâche de parsing possède le contrôleur pendant le mode continu
+  if (continuous_scan_active) {
+    Serial.println("QUERY ERR stop continuous mode first");
+    return;
+  }
+  query_ctl.setPolicy(uhfQueryPolicy(UhfQueryPreset(preset)));
+  if (uhfSetQueryParams(query_ctl.params())) printQueryState();
+  else Serial.println("QUERY ERR module did not accept 0x0E");
+}
+
+static void printPowerState() {
+  const UhfPowerConfig& c = tx_power.config();
+  const UhfPowerStats& st = tx_power.stats();
+  Serial.printf("POWER module %u, inventory %u, read %u, write %u, max %u, step %u (0.01 dBm)\n",
+                uhfTxPower(), c.base[UHF_POWER_INVENTORY], c.base[UHF_POWER_READ],
+                c.base[UHF_POWER_WRITE], c.max, c.step);
+  Serial.printf("POWER %u ops, %u steps up, %u at max, %u cache hits, %u retries saved, %u tags cached\n",
+                (unsigned)st.ops, (unsigned)st.escalations, (unsigned)st.at_max,
+                (unsigned)st.cache_hits, (unsigned)st.retries_saved, (unsigned)tx_power.cached());
+}
+
+static void handlePowerCommand(char* args) {
+  char* save = nullptr;
+  char* verb = strtok_r(args, " ", &save);
+  if (!verb) {
+    Serial.println("POWER ERR usage: POWER INV|READ|WRITE|MAX|STEP <cdBm> | GET | SHOW | CLEAR");
+    return;
+  }
+  if (strcmp(verb, "SHOW") == 0) {
+    printPowerState();
+    return;
+  }
+  if (strcmp(verb, "CLEAR") == 0) {
+    tx_power.clearCache();
+    tx_power.resetStats();
+    Serial.println("POWER CLEARED");
+    return;
+  }
+  if (strcmp(verb, "GET") == 0) {
+    // 0xB7 passe par l'UART, que le pipeline possède en mode continu
+    if (continuous_scan_active) {
+      Serial.println("POWER ERR stop continuous mode first");
+      return;
+    }
+    uint16_t v = 0;
+    if (uhfGetTxPower(v)) Serial.printf("POWER MODULE %u.%02u dBm\n", v / 100, v % 100);
+    else Serial.println("POWER ERR no reply to 0xB7");
+    return;
+  }
+  // Réglages de la politique : pris en compte à la prochaine opération
+  const char* value = strtok_r(nullptr, " ", &save);
+  const long v = value ? atol(value) : 0;
+  const bool step = strcmp(verb, "STEP") == 0;
+  if (step ? (v <= 0 || v > 1000) : (v < UHF_POWER_MIN_DBM100 || v > UHF_POWER_MAX_DBM100)) {
+    Serial.printf("POWER ERR bad value %s\n", value ? value : "(none)");
+    return;
+  }
+  UhfPowerConfig c = tx_power.config();
+  if (strcmp(verb, "INV") == 0)        c.base[UHF_POWER_INVENTORY] = uint16_t(v);
+  else if (strcmp(verb, "READ") == 0)  c.base[UHF_POWER_READ] = uint16_t(v);
+  else if (strcmp(verb, "WRITE") == 0) c.base[UHF_POWER_WRITE] = uint16_t(v);
+  else if (strcmp(verb, "MAX") == 0)   c.max = uint16_t(v);
+  else if (step)                       c.step = uint16_t(v);
+  else {
+    Serial.printf("POWER ERR unknown command %s\n", verb);
+    return;
+  }
+  tx_power.setConfig(c);
+  printPowerState();
+}
+
+static void handleTidCommand(char* args) {
+  char* save = nullptr;
+  const char* verb = strtok_r(args, " ", &save);
+  if (!verb || strcmp(verb, "SHOW") == 0) {
+    const UhfTidCacheStats& st = tid_cache.stats();
+    const uint16_t rate = tid_cache.hitRatePermille();
+    Serial.printf("TID %u/%u tags cached, %u lookups, %u hits (%u.%u%%), %u evictions, %u loaded%s\n",
+                  tid_cache.size(), (unsigned)UhfTidCache::CAPACITY, (unsigned)st.lookups,
+                  (unsigned)st.hits, rate / 10, rate % 10, (unsigned)st.evictions, st.loaded,
+                  tid_cache.dirty() ? ", not saved" : "");
+    return;
+  }
+  // La tâche de parsing possède le cache pendant le mode continu
+  if (continuous_scan_active) {
+    Serial.println("TID ERR stop continuous mode first");
+    return;
+  }
+  if (strcmp(verb, "SAVE") == 0) {
+    if (uhfTidCacheSave(tid_cache)) Serial.printf("TID SAVED %u tags\n", tid_cache.size());
+    else Serial.println("TID ERR NVS write failed");
+  } else if (strcmp(verb, "CLEAR") == 0) {
+    tid_cache.clear();
+    uhfTidCacheErase();
+    Serial.println("TID CLEARED");
+  } else {
+    Serial.printf("TID ERR unknown command %s\n", verb);
+  }
+}
+
+static void handleCountCommand(char* args) {
+  char* save = nullptr;
+  const char* verb = strtok_r(args, " ", &save);
+  if (!verb || strcmp(verb, "SHOW") == 0) {
+    const UhfCountConfig& c = portal_count.config();
+    Serial.printf("COUNT %s, exact up to %u, interval %lu s, repeat window %lu s\n",
+                  count_active ? "ON" : "OFF", c.exact_cap, (unsigned long)(c.interval_ms / 1000),
+                  (unsigned long)(c.repeat_window_ms / 1000));
+    // Pendant le mode continu, la tâche de parsing écrit le compteur :
+    // seul le dernier intervalle clos est lu
+    if (continuous_scan_active) {
+      if (has_count_interval) printCountInterval(last_count_interval);
+      return;
+    }
+    const UhfCountStats& st = portal_count.stats();
+    Serial.printf("COUNT %u distinct%s, %u reads, %u new, %u intervals (%u dropped)\n",
+                  (unsigned)portal_count.distinct(), portal_count.exact() ? "" : " (estimate)",
+                  (unsigned)st.reads, (unsigned)st.new_tags, (unsigned)st.intervals,
+                  (unsigned)st.intervals_dropped);
+    return;
+  }
+  if (strcmp(verb, "STOP") == 0) {
+    count_active = false;
+    Serial.println("COUNT STOPPED");
+    return;
+  }
+  if (strcmp(verb, "START") != 0) {
+    Serial.printf("COUNT ERR unknown command %s\n", verb);
+    return;
+  }
+  // La remise à zéro ne doit pas croiser la tâche de parsing
+  if (continuous_scan_active) {
+    Serial.println("COUNT ERR stop continuous mode first");
+    return;
+  }
+  UhfCountConfig c = uhfCountDefaults();
+  const char* cap = strtok_r(nullptr, " ", &save);
+  const char* interval = strtok_r(nullptr, " ", &save);
+  const char* window = strtok_r(nullptr, " ", &save);
+  if (cap && atol(cap) > 0) c.exact_cap = uint16_t(min(atol(cap), long(UHF_COUNT_EXACT_MAX)));
+  if (interval && atol(interval) > 0) c.interval_ms = uint32_t(atol(interval)) * 1000;
+  if (window && atol(window) > 0) c.repeat_window_ms = uint32_t(atol(window)) * 1000;
+  portal_count.setConfig(c);
+  has_count_interval = false;
+  count_active = true;
+  Serial.printf("COUNT STARTED, exact up to %u, interval %lu s, repeat window %lu s\n",
+                c.exact_cap, (unsigned long)(c.interval_ms / 1000), (unsigned long)(c.repeat_window_ms / 1000));
+}
+
+// MULTI tourne dans loop() : un tour de tous les modules par passage, comme
+// l'encodeur ; M5.update() et la console continuent entre deux tours
+static uint32_t multi_t0 = 0;
+static uint32_t multi_ms = 0;
+
+static void finishMulti() {
+  multi_reader.stop();
+  const uint32_t elapsed = max<uint32_t>(millis() - multi_t0, 1);
+  for (uint8_t r = 0; r < multi_reader.readerCount(); r++) {
+    const UhfMultiReaderStats& st = multi_reader.readerStats(r);
+    Serial.printf("MULTI module %u: %u rounds, %u reads (%u /s), %u first, %u shared, %u heap allocations\n", r,
+                  (unsigned)st.rounds, (unsigned)st.tag_reads,
+                  (unsigned)(uint64_t(st.tag_reads) * 1000 / elapsed), (unsigned)st.first_reads,
+                  (unsigned)st.shared_reads, (unsigned)multi_reader.reader(r).allocStats().allocs);
+  }
+  Serial.printf("MULTI %u tags in %lu ms\n", multi_reader.table().size(), (unsigned long)elapsed);
+}
+
+static void serviceMulti() {
+  multi_reader.step();
+  UhfMultiEvent ev[8];
+  uint8_t n;
+  while ((n = multi_reader.poll(ev, 8)) > 0) {
+    for (uint8_t i = 0; i < n; i++) {
+      if (ev[i].kind != UHF_TAG_NEW) continue;
+      char hex[EPC_HEX_SIZE];
+      _toHex(ev[i].epc, ev[i].epc_len, hex, sizeof(hex));
+      Serial.printf("MULTI NEW %s module %u %d dBm\n", hex, ev[i].reader, ev[i].rssi);
+    }
+  }
+  if (millis() - multi_t0 >= multi_ms) finishMulti();
+}
+
+static void handleMultiCommand(char* args) {
+  char* save = nullptr;
+  const char* secs = strtok_r(args, " ", &save);
+  if (secs && strcmp(secs, "STOP") == 0) {
+    if (multi_reader.running()) finishMulti();
+    else Serial.println("MULTI not running");
+    return;
+  }
+  if (multi_reader.running()) {
+    Serial.println("MULTI ERR already running");
+    return;
+  }
+  // Les modules ne doivent pas croiser la tâche de parsing
+  if (continuous_scan_active) {
+    Serial.println("MULTI ERR stop continuous mode first");
+    return;
+  }
+  const char* mode = strtok_r(nullptr, " ", &save);
+  const long sec = secs && atol(secs) > 0 ? min(atol(secs), 30L) : 5L;
+  multi_ms = uint32_t(sec) * 1000;
+  UhfMultiConfig c;
+  c.mode          = (mode && strcmp(mode, "STREAM") == 0) ? UHF_MULTI_STREAM : UHF_MULTI_INTERLEAVED;
+  c.tag_expiry_ms = multi_ms;                           // un tag compte une fois sur la durée
+  c.multi_poll_rounds = MULTI_POLL_ROUNDS;
+  c.rearm_ms      = MULTI_POLL_REARM_MS;
+  multi_reader.setConfig(c);
+  multi_reader.resetStats();
+  for (uint8_t r = 0; r < multi_reader.readerCount(); r++) multi_reader.reader(r).resetAllocStats();
+
+  multi_reader.start(pipeline.lendTable());            // pipeline arrêté : sa table est libre
+  multi_t0 = millis();
+  Serial.printf("MULTI STARTED %ld s, %s (A or MULTI STOP ends it)\n", sec,
+                c.mode == UHF_MULTI_STREAM ? "STREAM" : "INTERLEAVED");
+}
+
+static void printBulkJob() {
+  const UhfBulkJob& j = bulk_job;
+  Serial.printf("BULK %s %u/%u bytes, %lu ms, %lu B/s, %u commands, %u shrinks, %u reselects, %u resumes, %u rewrites",
+                uhfBulkStatusName(j.status), j.done_words * 2, j.words * 2, (unsigned long)(j.busy_us / 1000),
+                (unsigned long)j.bytesPerSecond(), j.commands, j.shrinks, j.reselects, j.resumes, j.rewrites);
+  if (j.status == UHF_BULK_END_OF_MEMORY) Serial.printf(", bank ends at word %u", j.end_word);
+  if (j.module_error) Serial.printf(", err=0x%02X", j.module_error);
+  Serial.println();
+  if (bulk_is_write || j.done_words == 0) return;
+  // Lecture : 16 mots par ligne, adresse en mots
+  char hex[65];
+  for (uint16_t w = 0; w < j.done_words; w += 16) {
+    const uint16_t n = min<uint16_t>(16, uint16_t(j.done_words - w));
+    _toHex(j.data + size_t(w) * 2, size_t(n) * 2, hex, sizeof(hex));
+    Serial.printf("BULK DATA %u %s\n", j.word_ptr + w, hex);
+  }
+}
+
+static void runBulkJob() {
+  uhfStopMultiInventory();
+  if (bulk_is_write) bulk.write(bulk_job);
+  else               bulk.read(bulk_job);
+  printBulkJob();
+}
+
+static void handleBulkCommand(char* args) {
+  char* save = nullptr;
+  const char* verb = strtok_r(args, " ", &save);
+  if (verb && strcmp(verb, "MODELS") == 0) {
+    for (uint8_t i = 0; i < UHF_BULK_MODELS; i++) {
+      const UhfBulkModel& m = bulk.models()[i];
+      if (m.model) Serial.printf("BULK MODEL %08lX write %u words, read %u words\n",
+                                 (unsigned long)m.model, m.write_words, m.read_words);
+    }
+    return;
+  }
+  // Le module appartient à la tâche de parsing pendant le mode continu
+  if (continuous_scan_active) {
+    Serial.println("BULK ERR stop continuous mode first");
+    return;
+  }
+  if (!verb) {
+    Serial.println("BULK ERR missing command");
+    return;
+  }
+  if (strcmp(verb, "RESUME") == 0) {
+    if (!bulk_job.data || bulk_job.finished()) Serial.println("BULK ERR nothing to resume");
+    else runBulkJob();
+    return;
+  }
+  const bool is_read = strcmp(verb, "READ") == 0;
+  const bool is_write = strcmp(verb, "WRITE") == 0;
+  const bool is_fill = strcmp(verb, "FILL") == 0;
+  if (!is_read && !is_write && !is_fill) {
+    Serial.printf("BULK ERR unknown command %s\n", verb);
+    return;
+  }
+  const char* bank = strtok_r(nullptr, " ", &save);
+  const char* word = strtok_r(nullptr, " ", &save);
+  const char* arg = strtok_r(nullptr, " ", &save);
+  if (!bank || !word || !arg) {
+    Serial.printf("BULK ERR usage: BULK %s <bank> <word> %s\n", verb, is_write ? "<hex>" : "<words>");
+    return;
+  }
+  uint16_t words = 0;
+  if (is_write) {
+    const size_t n = parseHexEpc(arg, bulk_buf, sizeof(bulk_buf));
+    words = (n % 2) ? 0 : uint16_t(n / 2);
+  } else {
+    words = uint16_t(min(atol(arg), long(sizeof(bulk_buf) / 2)));
+    if (is_fill) {
+      const char* fill = strtok_r(nullptr, " ", &save);
+      memset(bulk_buf, fill ? int(strtoul(fill, nullptr, 16) & 0xFF) : 0, size_t(words) * 2);
+    }
+  }
+  if (words == 0) {
+    Serial.println("BULK ERR no data (hex in whole words, 256 words at most)");
+    return;
+  }
+  if (current_tag.epc_len == 0) {
+    Serial.println("BULK ERR no tag, scan first");
+    return;
+  }
+  bulk.setTag(current_tag.epc, uint8_t(current_tag.epc_len), current_tag.has_tid ? current_tag.tid : nullptr);
+  bulk_job.begin(uint8_t(atoi(bank)), uint16_t(atol(word)), bulk_buf, words);
+  bulk_is_write = !is_read;
+  runBulkJob();
+}
+
+static void printDutyState() {
+  const UhfDutyConfig& c = duty.config();
+  const UhfDutyStats st = duty.stats();
+  Serial.printf("DUTY %s, %s now, backoff after %lu ms, sleep after %lu s, %lu ms windows every %lu..%lu ms, "
+                "first read within %lu ms\n",
+                c.enabled ? "ON" : "OFF", uhfDutyStateName(duty.state()), (unsigned long)c.idle_after_ms,
+                (unsigned long)(c.sleep_after_ms / 1000), (unsigned long)c.burst_ms,
+                (unsigned long)c.min_off_ms, (unsigned long)c.max_off_ms,
+                (unsigned long)(c.max_off_ms + UHF_DUTY_FIRST_READ_MS));
+  const uint32_t total = st.totalMs();
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) {
+    Serial.printf("DUTY %-7s %lu s (%u%%), radio %lu s, %lu reads, %lu mAs\n", uhfDutyStateName(s),
+                  (unsigned long)(st.ms[s] / 1000), (unsigned)(total ? uint64_t(st.ms[s]) * 100 / total : 0),
+                  (unsigned long)(st.radio_ms[s] / 1000), (unsigned long)st.reads[s],
+                  (unsigned long)(st.charge_mams[s] / 1000));
+  }
+  Serial.printf("DUTY %lu windows, %lu wakeups (read %lu ms max into a window), %lu light sleeps (%lu s), "
+                "radio on %u%%\n",
+                (unsigned long)st.windows, (unsigned long)st.wakeups, (unsigned long)st.window_read_max_ms,
+                (unsigned long)st.sleeps, (unsigned long)(st.slept_ms / 1000),
+                (unsigned)(total ? uint64_t(st.radioMs()) * 100 / total : 0));
+  const uint32_t reads = st.totalReads();
+  const uint64_t mams = st.totalChargeMams();
+  if (mams == 0) Serial.println("DUTY charge n/a (USB power)");
+  else           Serial.printf("DUTY %lu mA avg, %lu.%03lu mAs per read\n",
+                               (unsigned long)(total ? mams / total : 0),
+                               (unsigned long)(reads ? mams / reads / 1000 : 0),
+                               (unsigned long)(reads ? mams / reads % 1000 : 0));
+}
+
+static void handleDutyCommand(char* args) {
+  char* save = nullptr;
+  const char* verb = strtok_r(args, " ", &save);
+  if (!verb || strcmp(verb, "SHOW") == 0) {
+    printDutyState();
+    return;
+  }
+  // La tâche de parsing lit la configuration pendant le mode continu
+  if (continuous_scan_active) {
+    Serial.println("DUTY ERR stop continuous mode first");
+    return;
+  }
+  if (strcmp(verb, "ON") == 0) {
+    const char* latency = strtok_r(nullptr, " ", &save);
+    UhfDutyConfig c;
+    if (latency && atol(latency) > 0) c = uhfDutyForLatency(uint32_t(atol(latency)), c);
+    duty.setConfig(c);
+    printDutyState();
+  } else if (strcmp(verb, "OFF") == 0) {
+    UhfDutyConfig c = duty.config();
+    c.enabled = false;
+    duty.setConfig(c);
+    Serial.println("DUTY OFF");
+  } else if (strcmp(verb, "RESET") == 0) {
+    duty.resetStats();
+    Serial.println("DUTY RESET");
+  } else {
+    Serial.printf("DUTY ERR unknown command %s\n", verb);
+  }
+}
+
+// Lecture non bloquante de la console : 'C' seul garde son effet immédiat
+static void pollConsole() {
+  while (Serial.available()) {
+    const char c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      console_line[console_len] = '\0';
+      if (console_len > 0) {
+        // Pendant MULTI les modules appartiennent à l'ordonnanceur
+        const bool multi_cmd = strncmp(console_line, "MULTI", 5) == 0 && (console_line[5] == ' ' || console_line[5] == '\0');
+        if (multi_reader.running() && !multi_cmd) {
+          Serial.println("MULTI ERR running, MULTI STOP first");
+        } else if (strncmp(console_line, "ENC", 3) == 0 && (console_line[3] == ' ' || console_line[3] == '\0')) {
+          handleEncoderCommand(console_line + 3);
+        } else if (strncmp(console_line, "CAL", 3) == 0 && (console_line[3] == ' ' || console_line[3] == '\0')) {
+          handleCalCommand(console_line + 3);
+        } else if (strncmp(console_line, "QUERY", 5) == 0 && (console_line[5] == ' ' || console_line[5] == '\0')) {
+          handleQueryCommand(console_line + 5);
+        } else if (strncmp(console_line, "POWER", 5) == 0 && (console_line[5] == ' ' || console_line[5] == '\0')) {
+          handlePowerCommand(console_line + 5);
+        } else if (strncmp(console_line, "TID", 3) == 0 && (console_line[3] == ' ' || console_line[3] == '\0')) {
+          handleTidCommand(console_line + 3);
+        } else if (strncmp(console_line, "COUNT", 5) == 0 && (console_line[5] == ' ' || console_line[5] == '\0')) {
+          handleCountCommand(console_line + 5);
+        } else if (multi_cmd) {
+          handleMultiCommand(console_line + 5);
+        } else if (strncmp(console_line, "BULK", 4) == 0 && (console_line[4] == ' ' || console_line[4] == '\0')) {
+          handleBulkCommand(console_line + 4);
+        } else if (strncmp(console_line, "DUTY", 4) == 0 && (console_line[4] == ' ' || console_line[4] == '\0')) {
+          handleDutyCommand(console_line + 4);
+        } else if (strncmp(console_line, "LOG", 3) == 0 && (console_line[3] == ' ' || console_line[3] == '\0')) {
+          handleLogCommand(console_line + 3);
+        } else if (strcmp(console_line, "OUT BIN") == 0) {
+          Serial.println("OUT BIN");
+          Serial.flush();
+          report_binary = true;
+        } else if (strcmp(console_line, "OUT TEXT") == 0) {
+          report_binary = false;
+          Serial.printf("OUT TEXT %u records sent, %u dropped\n",
+                        (unsigned)report_sent.load(), (unsigned)report_dropped.load());
+        } else if (strcmp(console_line, "TRACE ON") == 0) {
+          // Les tâches du pipeline écrivent dans les anneaux pendant le mode continu
+          if (continuous_scan_active) {
+            Serial.println("TRACE ERR stop continuous mode first");
+          } else {
+            uart_trace.start();
+            Serial.println("TRACE ON");
+          }
+        } else if (strcmp(console_line, "TRACE DUMP") == 0) {
+          if (continuous_scan_active) {
+            Serial.println("TRACE ERR stop continuous mode first");
+          } else {
+            uart_trace.stop();
+            uhfTraceDumpHex(uart_trace, printTraceLine, nullptr);
+          }
+        } else if (strcmp(console_line, "TRACE OFF") == 0) {
+          uart_trace.stop();
+          printTraceStats();
+        } else if (strcmp(console_line, "TRACE STAT") == 0) {
+          printTraceStats();
+        } else if (strcmp(console_line, "UHF STAT") == 0) {
+          uhfPrintLinkStats();
+        } else if (strcmp(console_line, "UHF RESET") == 0) {
+          // La tâche de parsing écrit ces compteurs pendant le mode continu
+          if (continuous_scan_active) {
+            Serial.println("UHF ERR stop continuous mode first");
+          } else {
+            uhfResetLinkStats();
+            Serial.println("UHF RESET");
+          }
+        } else {
+          Serial.printf("Unknown command: %s\n", console_line);
+        }
+      }
+      console_len = 0;
+    } else if (c == 'C' && console_len == 0) {
+      testWrite128();
+    } else if (console_len + 1 < sizeof(console_line)) {
+      console_line[console_len++] = c;
+    }
+  }
+}
+
 // === Setup ===
 void setup() {
   auto cfg = M5.config();
   cfg.output_power = true;
   M5.begin(cfg);
-  Serial.begin(115200);
+  Serial.setTxBufferSize(CONSOLE_TX_BUFFER);  // AVANT begin()
+  Serial.begin(CONSOLE_BAUD);
   
   displayStatus("UHF Init...", "RX=33 TX=32");
   
@@ -1365,6 +2106,46 @@ void setup() {
   Serial2.begin(115200, SERIAL_8N1, RX_PIN, TX_PIN);
   Serial2.setTimeout(300);
   uhfAttachSerial(&Serial2);
+  uart_trace.attach(uhfAttachedTransport());   // enregistreur entre le protocole et Serial2
+  uhfAttachTransport(&uart_trace);
+  multi_reader.add(uhfDefaultReader());
+#if UHF_SECOND_MODULE
+  Serial1.setRxBufferSize(RX_BUFFER_SIZE);
+  Serial1.begin(115200, SERIAL_8N1, RX2_PIN, TX2_PIN);
+  second_reader.attachSerial(&Serial1);
+  second_reader.stopMultiInventory();
+  multi_reader.add(second_reader);
+#endif
+  
+  // Tâches du mode continu (inactives jusqu'à pipeline.start())
+  UhfPipelineConfig pcfg;
+  pcfg.multi_poll_rounds = MULTI_POLL_ROUNDS;
+  pcfg.rearm_ms          = MULTI_POLL_REARM_MS;
+  pcfg.tag_expiry_ms     = TAG_EXPIRY_MS;
+  pcfg.tid_reader        = readTid;
+  pcfg.tid_cache         = &tid_cache;
+  pcfg.on_read           = onTagRead;
+  pcfg.query             = &query_ctl;
+  pcfg.duty              = &duty;
+  UhfDutyConfig dcfg;
+  dcfg.enabled = DUTY_CYCLE;
+  duty.setConfig(dcfg);
+  duty_bright_full = M5.Display.getBrightness();
+  if (!pipeline.begin(*uhfAttachedTransport(), pcfg)) {
+    Serial.println("Pipeline tasks not created");
+  }
+  Serial.printf("Static UHF RAM: %u of %u bytes\n", (unsigned)STATIC_UHF_BYTES, (unsigned)STATIC_UHF_BUDGET);
+  
+  // Table RSSI calibrée sur le terrain (CAL SAVE), sinon profil CURVED
+  if (uhfRssiLoadCalibration()) Serial.println("RSSI calibration loaded from NVS");
+  if (TID_CACHE_PERSIST && uhfTidCacheLoad(tid_cache)) {
+    Serial.printf("TID cache: %u tags loaded from NVS\n", tid_cache.size());
+  }
+  
+  // Encodage en série (jobs chargés par la console, voir pollConsole())
+  encoder.setAccessPassword(ACCESS_PWD);
+  encoder.setResultHandler(onEncodeResult, nullptr);
+  encoder.setPowerPolicy(&tx_power);
   
   // uhf.begin(&Serial2, 115200, RX_PIN, TX_PIN, false);  // Remplacé par raw
   
@@ -1392,7 +2173,11 @@ void setup() {
     return;
   }
   
-  // uhf.setTxPower(TX_PWR_DBM10);  // Géré par raw
+  // Puissance de départ (mode continu) ; le poste d'encodage suit tx_power
+  if (!uhfSetTxPower(TX_PWR_DBM10)) Serial.println("TX power not set (0xB6 refused)");
+  
+  // Paramètres Query du préréglage (le module démarre en Q=4, S0)
+  uhfSetQueryParams(query_ctl.startParams());
   
   // Mode "need select" (optionnel - commenter si problème)
   // setSelectMode(0x01);  // 0x00=pas de select requis, 0x01=select requis
@@ -1404,55 +2189,37 @@ void setup() {
 void loop() {
   M5.update();
   
-  // === TEST: Write EPC 128-bit fixe avec touche 'C' ===
-  if (Serial.available()) {
-    char cmd = Serial.read();
-    
-    if (cmd == 'C') {
-      uint8_t epc128[16] = {
-        0x30, 0x08, 0x33, 0xB2,
-        0xDD, 0xD9, 0x01, 0x40,
-        0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x01
-      };
-      Serial.println(F("🔹 TEST WRITE EPC 128 bits..."));
-      
-      // Sécurisation : arrêter multi-inventory et sélectionner un tag
-      uhfStopMultiInventory();
-      delay(20);
-      
-      bool tag_selected = false;
-      if (current_tag.epc_len > 0) {
-        // Utiliser le tag scanné précédemment
-        Serial.println(F("📍 Using previously scanned tag for selection"));
-        tag_selected = rawSelect(current_tag.epc, current_tag.epc_len)
-                       || uhfSelectEpc(current_tag.epc, current_tag.epc_len); // fallback EPC raw
-      } else {
-        // Fallback: poll 1 tag et select
-        Serial.println(F("📍 No previous tag - scanning for selection"));
-        RawTagData one[1];
-        if (rawInventoryWithRssi(one, 1) > 0) {
-          uint8_t b[62]; 
-          size_t L = one[0].epc.length() / 2;
-          if (hexToBytes(one[0].epc, b, sizeof(b))) {
-            tag_selected = rawSelect(b, L) || uhfSelectEpc(b, L); // fallback EPC raw
-          }
-        }
-      }
-      
-      if (tag_selected) {
-        Serial.println(F("✅ Tag selected - proceeding with write"));
-        // → Ecriture + reselect (full→96→TID) + read-back EPC via rawRead()
-        WriteError result = writeEpcVariableSafeWithVerifyRaw(epc128, sizeof(epc128), ACCESS_PWD);
-        if (result == WRITE_OK) {
-          Serial.println(F("✅ Write 128-bit + verify OK !"));
-        } else {
-          Serial.println(F("❌ Write 128-bit FAIL !"));
-        }
-      } else {
-        Serial.println(F("❌ No tag selected - write aborted"));
-      }
+  // === Commandes non bloquantes : l'étape suivante part dès la réponse ===
+  // Tant qu'une séquence tourne, rien d'autre ne parle au module
+  uhf_async.poll();
+  drainLog();
+  if (uhf_async.busy()) return;
+  
+  // === Console série : 'C' (test 128 bits) ou lignes "ENC ..." ===
+  pollConsole();
+  
+  // === MULTI : un tour de tous les modules par passage, A l'arrête ===
+  if (multi_reader.running()) {
+    if (M5.BtnA.wasPressed()) finishMulti();
+    else serviceMulti();
+    return;
+  }
+  
+  // === Encodage en série : tant que le lot tourne, la boucle ne fait que ça ===
+  if (encoder.running()) {
+    if (M5.BtnA.wasPressed()) {
+      encoder.stop();
+      Serial.println("ENC STOPPED");
+      printEncoderStats();
+      displayStatus("ENCODING", "Stopped", String(encoder.pending()) + " jobs left");
+      return;
     }
+    encoder.step();
+    if (!encoder.running()) {
+      Serial.println("ENC DONE");
+      printEncoderStats();
+    }
+    return;
   }
   
   // === Gestion du mode scan continu (appui long sur A) ===
@@ -1471,16 +2238,20 @@ void loop() {
         displayStatus("CONTINUOUS SCAN", "Active...", "Press A short to stop");
         if (startContinuousInventory()) {
           M5.Speaker.tone(1000, 200, 0, false);  // Bip de démarrage
-          Serial.println("=== CONTINUOUS SCAN STARTED ===");
+          if (!report_binary) Serial.println("=== CONTINUOUS SCAN STARTED ===");
         } else {
           continuous_scan_active = false;
           displayStatus("ERROR", "Failed to start", "continuous mode");
         }
       } else {
-        uhfStopMultiInventory();
+        pipeline.stop();
+        persistTidCache();
         displayStatus("CONTINUOUS SCAN", "Stopped", "Back to normal mode");
         M5.Speaker.tone(800, 200, 0, false);  // Bip d'arrêt
-        Serial.println("=== CONTINUOUS SCAN STOPPED ===");
+        if (!report_binary) {
+          Serial.println("=== CONTINUOUS SCAN STOPPED ===");
+          printInventoryAllocStats();
+        }
       }
     }
   } else {
@@ -1490,51 +2261,27 @@ void loop() {
   
   // Traitement du mode continu
   processContinuousScan();
+  serviceDutyCycle();
+  serviceModeBanner();
   
   // === Mode scan simple (appui court) ===
   if (M5.BtnA.wasPressed() && !button_was_long_pressed) {
     // Si en mode continu, A court l'arrête
     if (continuous_scan_active) {
       continuous_scan_active = false;
-      uhfStopMultiInventory();
+      pipeline.stop();
+      persistTidCache();
       displayStatus("SCAN STOPPED", "Continuous mode", "disabled");
+      if (!report_binary) printInventoryAllocStats();
       M5.Speaker.tone(800, 100, 0, false);  // Bip d'arrêt
       return;
     }
     
-    // Sinon, scan normal
-    uhfStopMultiInventory();
-    
-    // Utiliser notre parser universel au lieu de uhf.pollingOnce()
-    RawTagData raw_tags[8];
-    uint8_t n = rawInventoryWithRssi(raw_tags, 8);
-    
-    if (n == 0) {
-      displayStatus("Scan: 0", "No tags");
-      return;
-    }
-    
-    // Lire le premier tag (avec RSSI réel !)
-    String epc_str = raw_tags[0].epc;
-    current_tag.epc_len = epc_str.length() / 2;
-    hexToBytes(epc_str, current_tag.epc, sizeof(current_tag.epc));
-    
-    // Sélectionner et lire TID
-    if (rawSelect(current_tag.epc, current_tag.epc_len)) {
-      current_tag.has_tid = readTid(current_tag.tid);
-      
-      String tid_str = current_tag.has_tid ? bytesToHex(current_tag.tid, 8) : "N/A";
-      
-      displayStatus(
-        "Tag found",
-        "EPC: " + String(current_tag.epc_len * 8) + "b RSSI: " + String(raw_tags[0].rssi_dbm) + "dBm",
-        "Data: " + String(epc_str.length() > 36 ? epc_str.substring(0, 36) + ".." : epc_str),
-        "TID: " + tid_str.substring(0, 16),
-        getEpcWordsText()
-      );
-    } else {
-      displayStatus("Scan OK", "Select failed");
-    }
+    // Sinon, scan normal : stop + puissance + inventaire en une séquence,
+    // la suite (TID) part du callback ; loop() continue de tourner
+    UhfAsyncSeq seq;
+    seq.stop().power(tx_power.base(UHF_POWER_INVENTORY)).inventory();
+    if (!uhf_async.submit(seq, onScanDone)) displayStatus("Scan", "Busy");
   }
   
   // Bouton B : long press = change longueur EPC (6/7/8/…),
@@ -1546,12 +2293,17 @@ void loop() {
     }
   } else {
     if (M5.BtnB.pressedFor(800)) {        // ~0.8s pour changer la longueur EPC
-      cycleEpcWords();
-      // Anti-rebond long press : attendre release avant autre action
-      while (M5.BtnB.isPressed()) { M5.update(); delay(5); }
-      return; // <-- évite que le wasReleased() du même cycle déclenche un write
+      // Une fois par appui ; loop() continue de tourner jusqu'au relâchement
+      if (!btn_b_long_handled) {
+        cycleEpcWords();
+        btn_b_long_handled = true;
+      }
     } else if (M5.BtnB.wasReleased()) {   // Short press → write
-      performEpcWrite();
+      // Le relâchement d'un appui long ne déclenche pas de write
+      if (!btn_b_long_handled) performEpcWrite();
+      btn_b_long_handled = false;
+    } else if (!M5.BtnB.isPressed()) {
+      btn_b_long_handled = false;         // relâché pendant une séquence
     }
   }
 }
@@ -0,0 +1,281 @@
+#include "uhf_async.h"
+#include "uhf_power.h"
+
+// ---------- Sequences ----------
+
+UhfAsyncStep* UhfAsyncSeq::add(uint8_t op, uint32_t tout_ms) {
+  if (n_ == UHF_ASYNC_MAX_STEPS) { ok_ = false; return nullptr; }
+  UhfAsyncStep* s = &steps_[n_++];
+  s->op       = op;
+  s->bank     = 0;
+  s->word_ptr = 0;
+  s->words    = 0;
+  s->len      = 0;
+  s->value    = 0;
+  s->pwd      = 0;
+  s->tout_ms  = tout_ms;
+  return s;
+}
+
+// Ceilings: those of the blocking calls
+UhfAsyncSeq& UhfAsyncSeq::inventory() {
+  add(UHF_OP_INVENTORY, 200);
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::selectEpc(const uint8_t* epc, size_t len) {
+  if (!epc || len == 0) { ok_ = false; return *this; }
+  UhfAsyncStep* s = add(UHF_OP_SELECT_EPC, 300);
+  if (!s) return *this;
+  s->len = uint8_t(len > 31 ? 31 : len);       // max 31 bytes, as uhfSelectEpc
+  memcpy(s->data, epc, s->len);
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::selectTid64(const uint8_t tid[8]) {
+  if (!tid) { ok_ = false; return *this; }
+  UhfAsyncStep* s = add(UHF_OP_SELECT_TID, 300);
+  if (!s) return *this;
+  s->len = 8;
+  memcpy(s->data, tid, 8);
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::read(uint8_t bank, uint16_t word_ptr, uint8_t words, uint32_t pwd) {
+  if (words == 0 || words > EPC_MAX_BYTES / 2) { ok_ = false; return *this; }
+  UhfAsyncStep* s = add(UHF_OP_READ, 500);
+  if (!s) return *this;
+  s->bank = bank; s->word_ptr = word_ptr; s->words = words; s->pwd = pwd;
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::write(uint8_t bank, uint16_t word_ptr, const uint8_t* data, size_t len,
+                                uint32_t pwd) {
+  if (!data || len == 0 || len > EPC_MAX_BYTES) { ok_ = false; return *this; }
+  UhfAsyncStep* s = add(UHF_OP_WRITE, 1000);
+  if (!s) return *this;
+  s->bank = bank; s->word_ptr = word_ptr; s->pwd = pwd;
+  s->len = uint8_t(len);
+  s->words = uint8_t((len + 1) / 2);           // odd length: zero-padded
+  memcpy(s->data, data, len);
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::writePc(uint16_t pc, uint32_t pwd) {
+  UhfAsyncStep* s = add(UHF_OP_WRITE_PC, 500);
+  if (!s) return *this;
+  s->value = pc; s->pwd = pwd;
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::power(uint16_t dbm100) {
+  if (dbm100 < UHF_POWER_MIN_DBM100 || dbm100 > UHF_POWER_MAX_DBM100) { ok_ = false; return *this; }
+  UhfAsyncStep* s = add(UHF_OP_POWER, 200);
+  if (s) s->value = dbm100;
+  return *this;
+}
+
+UhfAsyncSeq& UhfAsyncSeq::stop() {
+  add(UHF_OP_STOP, 200);
+  return *this;
+}
+
+// ---------- Engine ----------
+
+void UhfAsync::clear() {
+  head_ = count_ = 0;
+  next_id_ = 1;
+  running_ = false;
+  cancel_running_ = false;
+  step_ = 0;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+uint16_t UhfAsync::submit(const UhfAsyncSeq& seq, UhfAsyncDoneFn done, void* ctx) {
+  if (!seq.valid() || count_ == UHF_ASYNC_QUEUE) { stats_.rejected++; return 0; }
+  Job& j = queue_[(head_ + count_) % UHF_ASYNC_QUEUE];
+  j.id = next_id_++;
+  if (next_id_ == 0) next_id_ = 1;
+  j.seq = seq;
+  j.done = done;
+  j.ctx = ctx;
+  j.submit_us = micros();
+  count_++;
+  return j.id;
+}
+
+bool UhfAsync::pending(uint16_t id) const {
+  if (running_ && job_.id == id) return true;
+  for (uint8_t i = 0; i < count_; i++) if (queue_[(head_ + i) % UHF_ASYNC_QUEUE].id == id) return true;
+  return false;
+}
+
+bool UhfAsync::cancel(uint16_t id) {
+  if (running_ && job_.id == id) { cancel_running_ = true; return true; }
+  for (uint8_t i = 0; i < count_; i++) {
+    if (queue_[(head_ + i) % UHF_ASYNC_QUEUE].id != id) continue;
+    const Job dropped = queue_[(head_ + i) % UHF_ASYNC_QUEUE];
+    for (uint8_t k = i; k + 1 < count_; k++) {
+      queue_[(head_ + k) % UHF_ASYNC_QUEUE] = queue_[(head_ + k + 1) % UHF_ASYNC_QUEUE];
+    }
+    count_--;
+    stats_.cancelled++;
+    if (dropped.done) {
+      // Not result_: it belongs to the job that may be running
+      UhfAsyncResult r;
+      memset(&r, 0, sizeof(r));
+      r.id = id;
+      r.status = UHF_ASYNC_CANCELLED;
+      if (dropped.seq.size()) r.op = dropped.seq.step(0).op;
+      dropped.done(r, dropped.ctx);
+    }
+    return true;
+  }
+  return false;
+}
+
+bool UhfAsync::startNext() {
+  if (count_ == 0) return false;
+  job_ = queue_[head_];
+  head_ = (head_ + 1) % UHF_ASYNC_QUEUE;
+  count_--;
+  running_ = true;
+  cancel_running_ = false;
+  step_ = 0;
+  memset(&result_, 0, sizeof(result_));
+  result_.id = job_.id;
+  start_us_ = micros();
+  result_.wait_us = start_us_ - job_.submit_us;
+  stats_.jobs++;
+  return true;
+}
+
+bool UhfAsync::sendStep() {
+  const UhfAsyncStep& s = job_.seq.step(step_);
+  UhfFrameWriter& tx = reader_->txFrame();
+  result_.op = s.op;
+  size_t n = 0;
+  switch (s.op) {
+    case UHF_OP_INVENTORY:
+      result_.tag_count = 0;
+      stats_.steps++;
+      return reader_->beginInventory(s.tout_ms);
+    case UHF_OP_SELECT_EPC:
+      // SelParam: target S0, action 0, bank EPC; EPC starts after CRC+PC (0x20 bits)
+      n = uhfFrameSelect(tx, 0x01, 0x20, s.data, s.len);
+      break;
+    case UHF_OP_SELECT_TID:
+      n = uhfFrameSelect(tx, 0x02, 0, s.data, 8);
+      break;
+    case UHF_OP_READ:
+      n = uhfFrameRead(tx, s.pwd, s.bank, s.word_ptr, s.words);
+      break;
+    case UHF_OP_WRITE:
+      n = uhfFrameWrite(tx, s.pwd, s.bank, s.word_ptr, s.data, s.len, s.words);
+      break;
+    case UHF_OP_WRITE_PC: {
+      const uint8_t pcb[2] = { uint8_t(s.value >> 8), uint8_t(s.value) };
+      n = uhfFrameWrite(tx, s.pwd, 0x01, 1, pcb, 2, 1);   // EPC bank, word 1
+      break;
+    }
+    case UHF_OP_POWER:
+      n = uhfFrameSetPower(tx, s.value);
+      break;
+    case UHF_OP_STOP:
+      stats_.steps++;
+      return reader_->request(UhfStopFrame::bytes, UhfStopFrame::SIZE, s.tout_ms);
+  }
+  stats_.steps++;
+  return n > 0 && reader_->request(tx.data(), n, s.tout_ms);
+}
+
+int8_t UhfAsync::advance() {
+  const UhfAsyncStep& s = job_.seq.step(step_);
+  if (s.op == UHF_OP_INVENTORY) {
+    bool done = false;
+    if (result_.tag_count < UHF_ASYNC_MAX_TAGS) {
+      result_.tag_count += reader_->pollRound(result_.tags + result_.tag_count,
+                                              uint8_t(UHF_ASYNC_MAX_TAGS - result_.tag_count),
+                                              UHF_ROUND_GAP_MS, done);
+    } else {
+      done = true;                     // enough tags: the rest of the round is dropped
+    }
+    return done ? 1 : 0;
+  }
+
+  UhfFrame f;
+  const int8_t r = reader_->pollReply(f, s.op == UHF_OP_STOP);
+  if (r == 0) return 0;
+  if (r < 0) {
+    result_.status = UHF_ASYNC_TIMEOUT;
+    if (s.op == UHF_OP_POWER) reader_->noteTxPower(0);   // may or may not have taken it
+    return -1;
+  }
+  bool ok = false;
+  switch (s.op) {
+    case UHF_OP_SELECT_EPC:
+    case UHF_OP_SELECT_TID: ok = uhfReplyOk(f, 0x0C); break;
+    case UHF_OP_WRITE:
+    case UHF_OP_WRITE_PC:   ok = uhfReplyOk(f, 0x49); break;
+    case UHF_OP_STOP:       ok = f.cmd() == 0x28; break;
+    case UHF_OP_POWER:
+      ok = uhfReplyOk(f, 0xB6);
+      reader_->noteTxPower(ok ? s.value : 0);
+      break;
+    case UHF_OP_READ: {
+      UhfReadReply rd;
+      ok = uhfDecodeRead(f, s.words, rd);
+      if (ok) {
+        result_.data_len = uint8_t(min<size_t>(rd.len, sizeof(result_.data)));
+        memcpy(result_.data, rd.data, result_.data_len);
+      }
+      break;
+    }
+  }
+  if (ok) return 1;
+  result_.status = UHF_ASYNC_ERROR;
+  result_.module_error = reader_->lastErrorCode();
+  return -1;
+}
+
+void UhfAsync::finish(uint8_t status) {
+  result_.status = status;
+  result_.steps_done = step_;
+  result_.run_us = micros() - start_us_;
+  running_ = false;
+  stats_.busy_us += result_.run_us;
+  if (status == UHF_ASYNC_OK)             stats_.ok++;
+  else if (status == UHF_ASYNC_CANCELLED) stats_.cancelled++;
+  else                                    stats_.failed++;
+  if (job_.done) job_.done(result_, job_.ctx);
+}
+
+uint8_t UhfAsync::poll() {
+  const uint32_t t0 = micros();
+  uint8_t completed = 0;
+  for (;;) {
+    if (!running_) {
+      if (!startNext()) break;
+      // Steps with nothing to send (power already set) complete at once
+      while (step_ < job_.seq.size() && job_.seq.step(step_).op == UHF_OP_POWER &&
+             reader_->txPower() == job_.seq.step(step_).value) step_++;
+      if (step_ == job_.seq.size()) { finish(UHF_ASYNC_OK); completed++; continue; }
+      if (!sendStep()) { finish(UHF_ASYNC_TIMEOUT); completed++; continue; }
+    }
+    const int8_t r = advance();
+    if (r == 0) break;
+    if (r < 0) { finish(result_.status); completed++; continue; }
+    step_++;
+    while (step_ < job_.seq.size() && job_.seq.step(step_).op == UHF_OP_POWER &&
+           reader_->txPower() == job_.seq.step(step_).value) step_++;
+    if (step_ == job_.seq.size()) { finish(UHF_ASYNC_OK); completed++; continue; }
+    // Only a step still to send is cancelled: a job whose last reply came in
+    // (a write, its read-back) did run, and must not be reported otherwise
+    if (cancel_running_) { finish(UHF_ASYNC_CANCELLED); completed++; continue; }
+    // Back to back: the next command leaves in the poll() that took the reply
+    if (!sendStep()) { finish(UHF_ASYNC_TIMEOUT); completed++; }
+  }
+  const uint32_t us = micros() - t0;
+  if (us > stats_.poll_max_us) stats_.poll_max_us = us;
+  return completed;
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+
+/*
+  ---------------------------------------------------------
+  Non-blocking commands
+  - A job is a sequence of up to UHF_ASYNC_MAX_STEPS steps
+    (inventory, select, read, write, PC write, power, stop)
+    run back to back on one reader: select -> read TID,
+    PC write -> EPC write -> reselect -> read back, ...
+  - submit() queues it and returns a handle; poll() moves
+    it on as bytes arrive and never waits: loop() calls it
+    between M5.update() and the display
+  - The next step (or the next job) goes out from the same
+    poll() that took the previous reply: the module is not
+    left idle while work is queued. A reply itself waits
+    for the next poll(), so each step costs the loop() time
+    between two polls on top of the module's
+  - A failed step ends its job (the rest is skipped); the
+    completion callback gets the status, the failed step,
+    the module error code, the tags of the last inventory
+    step and the data of the last read step
+  - One task only (loop()). While a job runs, the reader
+    belongs to the engine: no blocking uhf* call on it
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_ASYNC_QUEUE
+#define UHF_ASYNC_QUEUE 4                // jobs waiting behind the running one
+#endif
+#ifndef UHF_ASYNC_MAX_STEPS
+#define UHF_ASYNC_MAX_STEPS 6
+#endif
+#ifndef UHF_ASYNC_MAX_TAGS
+#define UHF_ASYNC_MAX_TAGS 8             // tags kept from an inventory step
+#endif
+
+enum UhfAsyncOp : uint8_t {
+  UHF_OP_INVENTORY,      // one 0x22 round (no 0x27 fallback); no tag is not a failure
+  UHF_OP_SELECT_EPC,
+  UHF_OP_SELECT_TID,     // 64-bit TID
+  UHF_OP_READ,
+  UHF_OP_WRITE,
+  UHF_OP_WRITE_PC,       // EPC bank word 1
+  UHF_OP_POWER,          // 0xB6; done at once if the module is already there
+  UHF_OP_STOP            // 0x28; stream notifications ahead of the reply are skipped
+};
+
+enum UhfAsyncStatus : uint8_t {
+  UHF_ASYNC_OK,
+  UHF_ASYNC_ERROR,       // 0xFF reply (module_error) or an unexpected reply
+  UHF_ASYNC_TIMEOUT,     // no reply, or a corrupted one
+  UHF_ASYNC_CANCELLED
+};
+
+struct UhfAsyncStep {
+  uint8_t  op;           // UhfAsyncOp
+  uint8_t  bank;
+  uint16_t word_ptr;
+  uint8_t  words;        // READ: words to read; WRITE: words written
+  uint8_t  len;          // bytes in data
+  uint16_t value;        // WRITE_PC: PC word; POWER: 0.01 dBm
+  uint32_t pwd;
+  uint32_t tout_ms;      // ceiling, as for the blocking call
+  uint8_t  data[EPC_MAX_BYTES];   // select mask / data to write
+};
+
+// A job under construction: each call appends one step. Too many steps (or
+// bad arguments) mark it invalid, and submit() refuses it.
+class UhfAsyncSeq {
+public:
+  UhfAsyncSeq() : n_(0), ok_(true) {}
+
+  UhfAsyncSeq& inventory();
+  UhfAsyncSeq& selectEpc(const uint8_t* epc, size_t len);
+  UhfAsyncSeq& selectTid64(const uint8_t tid[8]);
+  UhfAsyncSeq& read(uint8_t bank, uint16_t word_ptr, uint8_t words, uint32_t pwd = 0);
+  UhfAsyncSeq& write(uint8_t bank, uint16_t word_ptr, const uint8_t* data, size_t len, uint32_t pwd = 0);
+  UhfAsyncSeq& writePc(uint16_t pc, uint32_t pwd = 0);
+  UhfAsyncSeq& power(uint16_t dbm100);
+  UhfAsyncSeq& stop();
+
+  uint8_t size() const { return n_; }
+  bool    valid() const { return ok_ && n_ > 0; }
+  const UhfAsyncStep& step(uint8_t i) const { return steps_[i]; }
+
+private:
+  UhfAsyncStep* add(uint8_t op, uint32_t tout_ms);
+
+  UhfAsyncStep steps_[UHF_ASYNC_MAX_STEPS];
+  uint8_t      n_;
+  bool         ok_;
+};
+
+struct UhfAsyncResult {
+  uint16_t   id;           // handle returned by submit()
+  uint8_t    status;       // UhfAsyncStatus
+  uint8_t    steps_done;   // index of the failed step when not OK
+  uint8_t    op;           // op of the failed (or last) step
+  uint8_t    module_error; // 0xFF code, 0 if none
+  uint8_t    tag_count;    // last inventory step
+  RawTagData tags[UHF_ASYNC_MAX_TAGS];
+  uint8_t    data_len;     // last read step
+  uint8_t    data[EPC_MAX_BYTES];
+  uint32_t   wait_us;      // submit -> first step sent
+  uint32_t   run_us;       // first step sent -> done
+};
+
+// On the polling task, from poll(). May submit the next job.
+typedef void (*UhfAsyncDoneFn)(const UhfAsyncResult& r, void* ctx);
+
+struct UhfAsyncStats {
+  uint32_t jobs;
+  uint32_t ok;
+  uint32_t failed;         // error, timeout
+  uint32_t cancelled;
+  uint32_t steps;          // commands sent
+  uint32_t rejected;       // submit() with a full queue or an invalid job
+  uint32_t busy_us;        // a job was running
+  uint32_t poll_max_us;    // longest poll() call
+};
+
+class UhfAsync {
+public:
+  explicit UhfAsync(UhfReader& reader) : reader_(&reader) { clear(); }
+
+  void       setReader(UhfReader& reader) { if (!busy()) reader_ = &reader; }
+  UhfReader& reader() { return *reader_; }
+
+  // Handle (never 0), or 0 when the queue is full or the job invalid. The
+  // job is copied.
+  uint16_t submit(const UhfAsyncSeq& seq, UhfAsyncDoneFn done = nullptr, void* ctx = nullptr);
+  // A queued job is dropped (its callback gets CANCELLED); a running one
+  // stops after its current step, unless that was its last: then it ran,
+  // and completes OK
+  bool     cancel(uint16_t id);
+
+  // Moves the running job on, starts the next ones. Never waits. Returns
+  // the number of jobs completed during this call.
+  uint8_t  poll();
+
+  bool     busy() const { return running_ || count_ > 0; }
+  bool     pending(uint16_t id) const;           // queued or running
+  uint8_t  queued() const { return count_; }
+
+  const UhfAsyncStats& stats() const { return stats_; }
+  void     resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+private:
+  struct Job {
+    uint16_t       id;
+    UhfAsyncSeq    seq;
+    UhfAsyncDoneFn done;
+    void*          ctx;
+    uint32_t       submit_us;
+  };
+
+  void    clear();
+  bool    startNext();
+  bool    sendStep();                  // false: could not be sent
+  int8_t  advance();                   // 1 step done, 0 waiting, -1 failed
+  void    finish(uint8_t status);
+
+  UhfReader*     reader_;
+  Job            queue_[UHF_ASYNC_QUEUE];
+  uint8_t        head_, count_;
+  uint16_t       next_id_;
+  bool           running_;
+  bool           cancel_running_;
+  Job            job_;                 // the running one
+  uint8_t        step_;
+  uint32_t       start_us_;
+  UhfAsyncResult result_;
+  UhfAsyncStats  stats_;
+};
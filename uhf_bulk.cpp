@@ -0,0 +1,255 @@
+#include "uhf_bulk.h"
+
+static_assert(UHF_BULK_MAX_WORDS >= 1 && UHF_BULK_MAX_WORDS <= 127, "chunk word count is a uint8_t");
+
+namespace {
+// Learned timeouts off for the length of a transfer (see uhf_bulk.h)
+struct FixedTimeouts {
+  UhfReader& reader;
+  bool       was;
+  explicit FixedTimeouts(UhfReader& r) : reader(r), was(r.adaptiveTimeouts()) { r.setAdaptiveTimeouts(false); }
+  ~FixedTimeouts() { reader.setAdaptiveTimeouts(was); }
+};
+
+uint8_t clampWords(uint8_t w) {
+  if (w == 0) return 1;
+  return w > UHF_BULK_MAX_WORDS ? uint8_t(UHF_BULK_MAX_WORDS) : w;
+}
+}  // namespace
+
+const char* uhfBulkStatusName(uint8_t status) {
+  switch (status) {
+    case UHF_BULK_OK:            return "OK";
+    case UHF_BULK_TAG_LOST:      return "tag lost";
+    case UHF_BULK_END_OF_MEMORY: return "end of memory";
+    case UHF_BULK_VERIFY_FAILED: return "verify failed";
+    case UHF_BULK_ERROR:         return "error";
+    default:                     return "?";
+  }
+}
+
+UhfBulk::UhfBulk()
+  : epc_len_(0), has_tid_(false), model_id_(0), next_model_(0), tx_(tx_buf_, sizeof(tx_buf_)) {
+  forgetModels();
+}
+
+void UhfBulk::forgetModels() {
+  memset(models_, 0, sizeof(models_));
+  memset(&unknown_, 0, sizeof(unknown_));
+  next_model_ = 0;
+}
+
+void UhfBulk::setTag(const uint8_t* epc, uint8_t epc_len, const uint8_t* tid8) {
+  epc_len_ = epc ? uint8_t(min<size_t>(epc_len, sizeof(epc_))) : 0;
+  if (epc_len_) memcpy(epc_, epc, epc_len_);
+  has_tid_ = tid8 != nullptr;
+  if (has_tid_) memcpy(tid_, tid8, 8);
+  model_id_ = 0;
+}
+
+bool UhfBulk::select() {
+  if (epc_len_ && uhfSelectEpc(epc_, epc_len_)) return true;
+  return has_tid_ && uhfSelectTid64(tid_);
+}
+
+// The select mask stays set in the module: a tag that drops out only needs
+// to be powered again. Each call is one more try for the chunk that failed.
+bool UhfBulk::findTag(UhfBulkJob& job, uint8_t& lost) {
+  if (lost++ >= cfg_.retries) return false;
+  uhfNoteRetry(0x0C);
+  RawTagData tmp[1];
+  (void)rawInventoryWithRssi(tmp, 1);   // wake the tag
+  if (!select()) return false;
+  job.reselects++;
+  return true;
+}
+
+UhfBulkModel& UhfBulk::model() {
+  if (model_id_ == 0) return unknown_;
+  for (uint8_t i = 0; i < UHF_BULK_MODELS; i++) {
+    if (models_[i].model == model_id_) return models_[i];
+  }
+  UhfBulkModel& m = models_[next_model_];
+  next_model_ = uint8_t((next_model_ + 1) % UHF_BULK_MODELS);
+  m.model = model_id_;
+  m.write_words = clampWords(cfg_.max_write_words);
+  m.read_words = clampWords(cfg_.max_read_words);
+  return m;
+}
+
+// 0xFF reply -> chunk result (see writeChunk)
+static int8_t classifyError(UhfBulkJob& job, const UhfFrame& r) {
+  const uint8_t code = (r.isError() && r.pl() > 0) ? r.errorCode() : 0;
+  job.module_error = code;
+  if (code == 0xA3) return 0;
+  if (code == 0x09 || code == 0) return -1;
+  return -2;
+}
+
+int8_t UhfBulk::writeChunk(UhfBulkJob& job, uint16_t word, uint8_t n, const uint8_t* src) {
+  const size_t len = uhfFrameWrite(tx_, job.pwd, job.bank, word, src, size_t(n) * 2, n);
+  UhfFrame r;
+  job.commands++;
+  if (!uhfTransact(tx_.data(), len, r, UHF_BULK_TIMEOUT_MS + uint32_t(n) * UHF_BULK_WRITE_WORD_MS)) {
+    job.module_error = 0;
+    return -1;
+  }
+  if (uhfReplyOk(r, 0x49)) return 1;
+  return classifyError(job, r);
+}
+
+int8_t UhfBulk::readChunk(UhfBulkJob& job, uint16_t word, uint8_t n, uint8_t* dst) {
+  const size_t len = uhfFrameRead(tx_, job.pwd, job.bank, word, n);
+  UhfFrame r;
+  job.commands++;
+  if (!uhfTransact(tx_.data(), len, r, UHF_BULK_TIMEOUT_MS)) {
+    job.module_error = 0;
+    return -1;
+  }
+  if (r.isError()) return classifyError(job, r);
+  UhfReadReply rd;
+  if (!uhfDecodeRead(r, n, rd) || rd.len != size_t(n) * 2) {
+    job.module_error = 0;
+    return -1;                         // short answer: as if the tag went away mid-read
+  }
+  memcpy(dst, rd.data, rd.len);
+  return 1;
+}
+
+uint8_t UhfBulk::fail(UhfBulkJob& job, uint8_t status, uint8_t code) {
+  job.status = status;
+  job.module_error = code;
+  return status;
+}
+
+uint8_t UhfBulk::transfer(UhfBulkJob& job, bool write) {
+  UhfBulkModel& m = model();
+  uint8_t& cap = write ? m.write_words : m.read_words;
+  // At the end of the bank, 0xA3 comes from the address, not the length:
+  // what was learned on the way there does not count
+  const uint8_t cap_at_start = cap;
+  uint8_t lost = 0;
+  while (job.done_words < job.words) {
+    const uint16_t word = job.done_words;
+    const uint8_t  n = uint8_t(min<uint16_t>(cap, uint16_t(job.words - word)));
+    uint8_t* p = job.data + size_t(word) * 2;
+    const int8_t r = write ? writeChunk(job, uint16_t(job.word_ptr + word), n, p)
+                           : readChunk(job, uint16_t(job.word_ptr + word), n, p);
+    if (r == 1) {
+      job.done_words = uint16_t(word + n);
+      lost = 0;
+      if (cfg_.on_chunk) cfg_.on_chunk(job, false, cfg_.on_chunk_ctx);
+    } else if (r == 0 && n > 1) {
+      cap = uint8_t(n / 2);
+      job.shrinks++;
+    } else if (r == 0) {
+      cap = cap_at_start;
+      job.end_word = uint16_t(job.word_ptr + word);
+      return fail(job, UHF_BULK_END_OF_MEMORY, 0xA3);
+    } else if (r == -1) {
+      if (!findTag(job, lost)) return fail(job, UHF_BULK_TAG_LOST, job.module_error);
+    } else {
+      return fail(job, UHF_BULK_ERROR, job.module_error);
+    }
+  }
+  return UHF_BULK_OK;
+}
+
+// Reads back [verified_words, done_words). A chunk that differs is written
+// again once, in write-sized pieces, then read again.
+uint8_t UhfBulk::verify(UhfBulkJob& job) {
+  UhfBulkModel& m = model();
+  uint8_t buf[UHF_BULK_MAX_WORDS * 2];
+  uint8_t lost = 0;
+  bool rewritten = false;
+  while (job.verified_words < job.done_words) {
+    const uint16_t word = job.verified_words;
+    const uint8_t  n = uint8_t(min<uint16_t>(m.read_words, uint16_t(job.done_words - word)));
+    const uint8_t* want = job.data + size_t(word) * 2;
+    const int8_t r = readChunk(job, uint16_t(job.word_ptr + word), n, buf);
+    if (r == 0 && n > 1) { m.read_words = uint8_t(n / 2); job.shrinks++; continue; }
+    if (r == -1) {
+      if (!findTag(job, lost)) return fail(job, UHF_BULK_TAG_LOST, job.module_error);
+      continue;
+    }
+    if (r != 1) return fail(job, UHF_BULK_ERROR, job.module_error);
+    lost = 0;
+    if (memcmp(buf, want, size_t(n) * 2) == 0) {
+      job.verified_words = uint16_t(word + n);
+      rewritten = false;
+      if (cfg_.on_chunk) cfg_.on_chunk(job, true, cfg_.on_chunk_ctx);
+      continue;
+    }
+    if (rewritten) return fail(job, UHF_BULK_VERIFY_FAILED, 0);
+    for (uint8_t off = 0; off < n; ) {
+      const uint8_t k = uint8_t(min<uint8_t>(m.write_words, uint8_t(n - off)));
+      const int8_t w = writeChunk(job, uint16_t(job.word_ptr + word + off), k, want + size_t(off) * 2);
+      if (w == 1)               { off = uint8_t(off + k); lost = 0; }
+      else if (w == 0 && k > 1) { m.write_words = uint8_t(k / 2); job.shrinks++; }
+      else if (w == -1)         { if (!findTag(job, lost)) return fail(job, UHF_BULK_TAG_LOST, job.module_error); }
+      else                      return fail(job, UHF_BULK_ERROR, job.module_error);
+    }
+    job.rewrites++;
+    rewritten = true;
+  }
+  return UHF_BULK_OK;
+}
+
+uint8_t UhfBulk::write(UhfBulkJob& job) {
+  if (!job.data || job.words == 0 || job.bank < 1 || job.bank > 3 || job.bank == 2 ||
+      uint32_t(job.word_ptr) + job.words > 0x10000) {
+    return fail(job, UHF_BULK_ERROR, 0);
+  }
+  return run(job, true);
+}
+
+uint8_t UhfBulk::read(UhfBulkJob& job) {
+  if (!job.data || job.words == 0 || job.bank < 1 || job.bank > 3 ||
+      uint32_t(job.word_ptr) + job.words > 0x10000) {
+    return fail(job, UHF_BULK_ERROR, 0);
+  }
+  return run(job, false);
+}
+
+uint8_t UhfBulk::run(UhfBulkJob& job, bool write) {
+  FixedTimeouts fixed(uhfReader());
+  const uint32_t t0 = micros();
+  if (job.done_words > 0) job.resumes++;
+  job.module_error = 0;
+  job.end_word = 0;
+
+  uint8_t lost = 0;
+  bool found = select();
+  while (!found && findTag(job, lost)) found = true;
+  if (!found) {
+    job.busy_us += micros() - t0;
+    return fail(job, UHF_BULK_TAG_LOST, 0);
+  }
+
+  // Model from TID words 0-1, read once per tag
+  if (model_id_ == 0) {
+    uint8_t tid[4];
+    bool ok = has_tid_;
+    if (ok) {
+      memcpy(tid, tid_, 4);
+    } else {
+      UhfBulkJob probe;
+      probe.begin(0x02, 0, tid, 2, job.pwd);
+      ok = readChunk(probe, 0, 2, tid) == 1;
+      job.commands = uint16_t(job.commands + probe.commands);
+    }
+    if (ok) model_id_ = (uint32_t(tid[0]) << 24) | (uint32_t(tid[1] & 0x1F) << 16) |
+                        (uint32_t(tid[2]) << 8) | tid[3];
+  }
+
+  unknown_.model = 0;
+  unknown_.write_words = clampWords(cfg_.max_write_words);
+  unknown_.read_words = clampWords(cfg_.max_read_words);
+
+  uint8_t st = transfer(job, write);
+  if (st == UHF_BULK_OK && write && cfg_.verify) st = verify(job);
+  job.status = st;
+  if (st == UHF_BULK_OK) job.module_error = 0;
+  job.busy_us += micros() - t0;
+  return st;
+}
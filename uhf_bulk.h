@@ -0,0 +1,154 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+
+/*
+  ---------------------------------------------------------
+  Bulk memory transfers (EPC, TID, user banks)
+  - A job moves `words` words from/to word_ptr of one bank
+    of one tag (select by EPC, TID as fallback), in chunks
+    of as many words as the tag takes per command
+  - Chunk size learned per tag model (TID class + MDID +
+    TMN): a transfer starts at the learned size (or the
+    configured maximum) and halves it on 0xA3 overrun; a
+    1-word chunk still refused means the end of the bank
+    (END_OF_MEMORY, end_word)
+  - Resumable: done_words only counts words the module
+    confirmed. A lost tag (0x09, no reply) is reselected up
+    to `retries` times, then the call returns TAG_LOST; the
+    same job passed again goes on from done_words
+  - Writes are verified with reads of the learned read
+    size; a differing chunk is rewritten once
+  - Learned timeouts are off during a transfer: a 32-word
+    write takes far longer than the EPC writes they were
+    learned on. Each chunk gets its own ceiling instead.
+  - Blocking, on the current reader (uhfReader()), one
+    command in flight, no fixed delays
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_BULK_MAX_WORDS
+#define UHF_BULK_MAX_WORDS 32            // largest chunk ever sent
+#endif
+#ifndef UHF_BULK_MODELS
+#define UHF_BULK_MODELS 8                // tag models with learned chunk sizes
+#endif
+#ifndef UHF_BULK_TIMEOUT_MS
+#define UHF_BULK_TIMEOUT_MS 200          // per chunk, plus the per-word time
+#endif
+#ifndef UHF_BULK_WRITE_WORD_MS
+#define UHF_BULK_WRITE_WORD_MS 20        // Gen2 write of one word, worst case
+#endif
+
+enum UhfBulkStatus : uint8_t {
+  UHF_BULK_OK,
+  UHF_BULK_TAG_LOST,       // gone for `retries` reselects; pass the job again to resume
+  UHF_BULK_END_OF_MEMORY,  // bank ends at end_word
+  UHF_BULK_VERIFY_FAILED,  // read-back differs after a rewrite
+  UHF_BULK_ERROR           // module error (locked, password, power, ...) or bad job
+};
+
+const char* uhfBulkStatusName(uint8_t status);
+
+struct UhfBulkJob {
+  uint8_t  bank;           // 1 EPC, 2 TID (read only), 3 user
+  uint16_t word_ptr;
+  uint16_t words;
+  uint8_t* data;           // words * 2 bytes: source (write), destination (read)
+  uint32_t pwd;
+
+  // Progress, kept between calls
+  uint16_t done_words;     // confirmed by the module
+  uint16_t verified_words; // writes: read back and equal
+  uint8_t  status;         // UhfBulkStatus of the last call
+  uint8_t  module_error;   // 0xFF code that ended it, 0 if none
+  uint16_t end_word;       // END_OF_MEMORY: first word past the bank
+
+  // Counters over all calls
+  uint32_t busy_us;        // time spent transferring, verify included
+  uint16_t commands;
+  uint16_t shrinks;        // chunk halved on 0xA3
+  uint16_t reselects;      // tag lost and found again within a call
+  uint16_t resumes;        // calls that went on from done_words > 0
+  uint16_t rewrites;       // chunks written again after verify
+
+  UhfBulkJob() { begin(0, 0, nullptr, 0); }
+  // New transfer: progress and counters cleared
+  void begin(uint8_t bank_, uint16_t word_ptr_, uint8_t* data_, uint16_t words_, uint32_t pwd_ = 0) {
+    bank = bank_; word_ptr = word_ptr_; data = data_; words = words_; pwd = pwd_;
+    done_words = verified_words = 0;
+    status = module_error = 0;
+    end_word = 0;
+    busy_us = 0;
+    commands = shrinks = reselects = resumes = rewrites = 0;
+  }
+  bool     finished() const { return status == UHF_BULK_OK && done_words == words; }
+  uint32_t bytesPerSecond() const {
+    return busy_us ? uint32_t(uint64_t(done_words) * 2 * 1000000 / busy_us) : 0;
+  }
+};
+
+// After each confirmed chunk (written, read, or verified)
+typedef void (*UhfBulkChunkFn)(const UhfBulkJob& job, bool verify, void* ctx);
+
+struct UhfBulkConfig {
+  uint8_t        max_write_words;   // first try for an unknown model
+  uint8_t        max_read_words;
+  bool           verify;            // read writes back
+  uint8_t        retries;           // reselects per call before TAG_LOST
+  UhfBulkChunkFn on_chunk;
+  void*          on_chunk_ctx;
+
+  UhfBulkConfig()
+    : max_write_words(16), max_read_words(UHF_BULK_MAX_WORDS), verify(true), retries(3),
+      on_chunk(nullptr), on_chunk_ctx(nullptr) {}
+};
+
+struct UhfBulkModel {
+  uint32_t model;          // TID bytes 0-3, XTID/S/F flags cleared; 0 = free
+  uint8_t  write_words;    // largest chunk known to pass
+  uint8_t  read_words;
+};
+
+class UhfBulk {
+public:
+  UhfBulk();
+
+  void setConfig(const UhfBulkConfig& cfg) { cfg_ = cfg; }
+  const UhfBulkConfig& config() const { return cfg_; }
+
+  // Tag of the next transfers. Without a TID, the first transfer reads TID
+  // words 0-1 for the model.
+  void setTag(const uint8_t* epc, uint8_t epc_len, const uint8_t* tid8 = nullptr);
+
+  // Both go on from job.done_words; return job.status
+  uint8_t write(UhfBulkJob& job);
+  uint8_t read(UhfBulkJob& job);
+
+  const UhfBulkModel* models() const { return models_; }
+  void  forgetModels();
+
+private:
+  bool     select();
+  bool     findTag(UhfBulkJob& job, uint8_t& lost);   // reselect after a loss
+  UhfBulkModel& model();
+  uint8_t  run(UhfBulkJob& job, bool write);
+  // 1 done, 0 chunk too long (0xA3), -1 tag lost, -2 other error
+  int8_t   writeChunk(UhfBulkJob& job, uint16_t word, uint8_t n, const uint8_t* src);
+  int8_t   readChunk(UhfBulkJob& job, uint16_t word, uint8_t n, uint8_t* dst);
+  uint8_t  transfer(UhfBulkJob& job, bool write);
+  uint8_t  verify(UhfBulkJob& job);
+  uint8_t  fail(UhfBulkJob& job, uint8_t status, uint8_t code);
+
+  UhfBulkConfig  cfg_;
+  uint8_t        epc_[EPC_MAX_BYTES];
+  uint8_t        epc_len_;
+  uint8_t        tid_[8];
+  bool           has_tid_;
+  uint32_t       model_id_;            // 0 until known
+  UhfBulkModel   models_[UHF_BULK_MODELS];
+  UhfBulkModel   unknown_;             // TID unreadable: this transfer only
+  uint8_t        next_model_;          // round-robin replacement
+  uint8_t        tx_buf_[7 + 9 + UHF_BULK_MAX_WORDS * 2];
+  UhfFrameWriter tx_;
+};
@@ -0,0 +1,137 @@
+#include "uhf_count.h"
+#include <math.h>
+
+// FNV-1a 64 then the murmur3 finalizer: HyperLogLog reads the top bits and
+// the leading zeros, so every input bit has to reach all of them
+static uint64_t epcHash64(const uint8_t* epc, uint8_t len) {
+  uint64_t h = 14695981039346656037ull;
+  for (uint8_t i = 0; i < len; i++) { h ^= epc[i]; h *= 1099511628211ull; }
+  h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h ? h : 1;                     // 0 marks an empty exact bucket
+}
+
+UhfCountConfig uhfCountDefaults() {
+  UhfCountConfig c;
+  c.exact_cap        = UHF_COUNT_EXACT_MAX;
+  c.repeat_window_ms = 60000;
+  c.interval_ms      = 10000;
+  return c;
+}
+
+UhfUniqueCounter::UhfUniqueCounter() {
+  setConfig(uhfCountDefaults());
+}
+
+void UhfUniqueCounter::setConfig(const UhfCountConfig& cfg) {
+  cfg_ = cfg;
+  if (cfg_.exact_cap > UHF_COUNT_EXACT_MAX) cfg_.exact_cap = UHF_COUNT_EXACT_MAX;
+  if (cfg_.repeat_window_ms == 0) cfg_.repeat_window_ms = 1;
+  if (cfg_.interval_ms == 0) cfg_.interval_ms = 1;
+  reset(millis());
+}
+
+// Only while no add() runs (the pipeline stopped): drains the interval ring
+void UhfUniqueCounter::reset(uint32_t now_ms) {
+  memset(&stats_, 0, sizeof(stats_));
+  memset(exact_, 0, sizeof(exact_));
+  exact_n_  = 0;
+  overflow_ = cfg_.exact_cap == 0;
+  memset(hll_, 0, sizeof(hll_));
+  memset(bloom_, 0, sizeof(bloom_));
+  gen_       = 0;
+  gen_start_ = now_ms;
+  memset(&cur_, 0, sizeof(cur_));
+  cur_.start_ms = now_ms;
+  UhfCountInterval drop[8];
+  while (closed_.popSome(drop, 8) > 0) {}
+}
+
+// False once the cap is reached: from then on the sketch counts
+bool UhfUniqueCounter::exactInsert(uint64_t h) {
+  uint32_t b = uint32_t(h) & (EXACT_BUCKETS - 1);
+  while (exact_[b] != 0) {
+    if (exact_[b] == h) return true;
+    b = (b + 1) & (EXACT_BUCKETS - 1);
+  }
+  if (exact_n_ >= cfg_.exact_cap) return false;
+  exact_[b] = h;
+  exact_n_++;
+  return true;
+}
+
+// Register = index from the top bits, rank of the first 1 in the rest.
+// Small counts (many empty registers) use linear counting instead.
+uint32_t UhfUniqueCounter::hllEstimate() const {
+  float sum = 0;
+  uint32_t zeros = 0;
+  for (uint32_t i = 0; i < HLL_REGS; i++) {
+    sum += ldexpf(1.0f, -int(hll_[i]));
+    if (hll_[i] == 0) zeros++;
+  }
+  const float m = float(HLL_REGS);
+  const float alpha = 0.7213f / (1.0f + 1.079f / m);
+  const float e = alpha * m * m / sum;
+  if (e <= 2.5f * m && zeros > 0) return uint32_t(lroundf(m * logf(m / float(zeros))));
+  return uint32_t(lroundf(e));
+}
+
+uint32_t UhfUniqueCounter::distinct() const {
+  if (!overflow_) return exact_n_;
+  // At least one tag more than the cap was seen, whatever the sketch says
+  const uint32_t e = hllEstimate();
+  return e > cfg_.exact_cap ? e : uint32_t(cfg_.exact_cap) + 1;
+}
+
+// Double hashing: k positions from the two halves of the hash
+bool UhfUniqueCounter::bloomSeen(uint64_t h) {
+  const uint32_t h1 = uint32_t(h), h2 = uint32_t(h >> 32) | 1;
+  bool in_cur = true, in_old = true;
+  uint8_t* cur = bloom_[gen_];
+  const uint8_t* old = bloom_[gen_ ^ 1];
+  for (uint8_t k = 0; k < BLOOM_K; k++) {
+    const uint32_t bit = (h1 + k * h2) & (UHF_COUNT_BLOOM_BITS - 1);
+    const uint8_t mask = uint8_t(1u << (bit & 7));
+    if (!(cur[bit >> 3] & mask)) { in_cur = false; cur[bit >> 3] |= mask; }
+    if (!(old[bit >> 3] & mask)) in_old = false;
+  }
+  return in_cur || in_old;
+}
+
+void UhfUniqueCounter::advance(uint32_t now_ms) {
+  // The older generation covered one to two windows back: it goes. After two
+  // silent windows, both do.
+  const uint32_t age = now_ms - gen_start_;
+  if (age >= cfg_.repeat_window_ms) {
+    gen_ ^= 1;
+    memset(bloom_[gen_], 0, BLOOM_BYTES);
+    if (age >= 2 * cfg_.repeat_window_ms) memset(bloom_[gen_ ^ 1], 0, BLOOM_BYTES);
+    gen_start_ = now_ms;
+    stats_.rotations++;
+  }
+  if (now_ms - cur_.start_ms < cfg_.interval_ms) return;
+  cur_.length_ms = now_ms - cur_.start_ms;
+  cur_.distinct  = distinct();
+  cur_.exact     = !overflow_;
+  stats_.intervals++;
+  if (!closed_.push(cur_)) stats_.intervals_dropped++;
+  memset(&cur_, 0, sizeof(cur_));
+  cur_.start_ms = now_ms;
+}
+
+bool UhfUniqueCounter::add(const uint8_t* epc, uint8_t len, uint32_t now_ms) {
+  advance(now_ms);
+  const uint64_t h = epcHash64(epc, len);
+  if (!overflow_ && !exactInsert(h)) overflow_ = true;
+  const uint32_t reg  = uint32_t(h >> (64 - UHF_COUNT_HLL_BITS));
+  const uint64_t rest = h << UHF_COUNT_HLL_BITS;
+  const uint8_t  rank = rest ? uint8_t(__builtin_clzll(rest) + 1) : uint8_t(64 - UHF_COUNT_HLL_BITS + 1);
+  if (rank > hll_[reg]) hll_[reg] = rank;
+
+  const bool is_new = !bloomSeen(h);
+  stats_.reads++;
+  cur_.reads++;
+  if (is_new) { stats_.new_tags++; cur_.new_tags++; }
+  return is_new;
+}
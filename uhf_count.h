@@ -0,0 +1,111 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "uhf_spsc_ring.h"
+#include "uhf_tag_table.h"
+
+/*
+  ---------------------------------------------------------
+  Distinct tag counting for long-running portals
+  - "How many different EPCs passed since the shift began",
+    in fixed memory however many reads come in
+  - Distinct count: exact (a hash set of 64-bit EPC hashes)
+    up to exact_cap tags, then a HyperLogLog sketch of
+    2^UHF_COUNT_HLL_BITS registers. The sketch is fed from
+    the first read, so the switch costs nothing.
+  - New vs repeat: a rotating Bloom filter of two
+    generations. A tag is a repeat if it was read within the
+    last repeat window (one to two windows back); false
+    positives make a few new tags look like repeats.
+  - Per-interval stats (reads, new tags, reads/s, distinct
+    so far) are closed by add() and handed to another task
+    through an SPSC ring: add() runs on one task, the
+    interval reader on one other
+  - A silent field closes no interval: the next read closes
+    it with its real length
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_COUNT_EXACT_MAX
+#define UHF_COUNT_EXACT_MAX 1024         // tags counted exactly, at most (16 KB of hashes)
+#endif
+#ifndef UHF_COUNT_HLL_BITS
+#define UHF_COUNT_HLL_BITS 11            // 2048 registers, ~2.3 % standard error
+#endif
+#ifndef UHF_COUNT_BLOOM_BITS
+#define UHF_COUNT_BLOOM_BITS 16384       // per generation; ~0.4 % false repeats at 1000 tags per window
+#endif
+
+struct UhfCountConfig {
+  uint16_t exact_cap;         // 0..UHF_COUNT_EXACT_MAX; above it the sketch counts
+  uint32_t repeat_window_ms;  // a tag read again within this is a repeat
+  uint32_t interval_ms;       // stats interval
+};
+
+// Exact up to UHF_COUNT_EXACT_MAX, 60 s repeat window, 10 s intervals
+UhfCountConfig uhfCountDefaults();
+
+struct UhfCountInterval {
+  uint32_t start_ms;
+  uint32_t length_ms;
+  uint32_t reads;
+  uint32_t new_tags;          // reads of tags outside the repeat window
+  uint32_t distinct;          // since reset, when the interval closed
+  bool     exact;             // distinct is still an exact count
+};
+
+struct UhfCountStats {
+  uint32_t reads;
+  uint32_t new_tags;
+  uint32_t intervals;
+  uint32_t intervals_dropped; // interval ring full: the reader fell behind
+  uint32_t rotations;         // Bloom generations cleared
+};
+
+class UhfUniqueCounter {
+public:
+  UhfUniqueCounter();
+
+  void setConfig(const UhfCountConfig& cfg);    // clamped; counts reset
+  const UhfCountConfig& config() const { return cfg_; }
+  void reset(uint32_t now_ms);
+
+  // One tag read. True when the tag is new within the repeat window.
+  bool add(const uint8_t* epc, uint8_t len, uint32_t now_ms);
+
+  // Distinct EPCs since reset: exact while exact(), else the estimate
+  uint32_t distinct() const;
+  bool     exact() const { return !overflow_; }
+  const UhfCountStats& stats() const { return stats_; }
+
+  // Reader side: closed intervals, oldest first, never blocks
+  uint8_t pollIntervals(UhfCountInterval* out, uint8_t max) {
+    return uint8_t(closed_.popSome(out, max));
+  }
+
+private:
+  static constexpr uint32_t EXACT_BUCKETS = _uhfCeilPow2(2u * UHF_COUNT_EXACT_MAX);
+  static constexpr uint32_t HLL_REGS      = 1u << UHF_COUNT_HLL_BITS;
+  static constexpr uint32_t BLOOM_BYTES   = UHF_COUNT_BLOOM_BITS / 8;
+  static constexpr uint8_t  BLOOM_K       = 4;
+  static_assert((UHF_COUNT_BLOOM_BITS & (UHF_COUNT_BLOOM_BITS - 1)) == 0,
+                "UHF_COUNT_BLOOM_BITS must be a power of two");
+  static_assert(UHF_COUNT_HLL_BITS >= 4 && UHF_COUNT_HLL_BITS <= 16, "HLL precision out of range");
+
+  bool     exactInsert(uint64_t h);
+  uint32_t hllEstimate() const;
+  bool     bloomSeen(uint64_t h);           // tests both generations, sets the current one
+  void     advance(uint32_t now_ms);        // closes the interval, rotates the filter
+
+  UhfCountConfig cfg_;
+  UhfCountStats  stats_;
+  uint64_t exact_[EXACT_BUCKETS];           // 0 = empty
+  uint16_t exact_n_;
+  bool     overflow_;
+  uint8_t  hll_[HLL_REGS];
+  uint8_t  bloom_[2][BLOOM_BYTES];
+  uint8_t  gen_;                            // current generation
+  uint32_t gen_start_;
+  UhfCountInterval cur_;
+  UhfSpscRing<UhfCountInterval, 8> closed_;
+};
@@ -0,0 +1,160 @@
+#include "uhf_duty.h"
+
+const char* uhfDutyStateName(uint8_t state) {
+  switch (state) {
+    case UHF_DUTY_ACTIVE:  return "active";
+    case UHF_DUTY_BACKOFF: return "backoff";
+    case UHF_DUTY_SLEEP:   return "sleep";
+    default:               return "?";
+  }
+}
+
+UhfDutyConfig uhfDutyForLatency(uint32_t target_ms, const UhfDutyConfig& cfg, uint32_t first_read_ms) {
+  UhfDutyConfig c = cfg;
+  c.burst_ms   = 2 * first_read_ms;
+  c.max_off_ms = target_ms > 2 * first_read_ms ? target_ms - first_read_ms : first_read_ms;
+  if (c.min_off_ms > c.max_off_ms) c.min_off_ms = c.max_off_ms;
+  return c;
+}
+
+uint32_t UhfDutyStats::totalMs() const {
+  uint32_t t = 0;
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) t += ms[s];
+  return t;
+}
+
+uint32_t UhfDutyStats::radioMs() const {
+  uint32_t t = 0;
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) t += radio_ms[s];
+  return t;
+}
+
+uint32_t UhfDutyStats::totalReads() const {
+  uint32_t t = 0;
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) t += reads[s];
+  return t;
+}
+
+uint64_t UhfDutyStats::totalChargeMams() const {
+  uint64_t t = 0;
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) t += charge_mams[s];
+  return t;
+}
+
+UhfDutyCycle::UhfDutyCycle()
+  : state_(UHF_DUTY_ACTIVE), radio_(true), next_on_ms_(0), off_since_ms_(0),
+    last_read_ms_(0), window_start_ms_(0), off_ms_(0), last_account_ms_(0) {
+  resetStats();
+}
+
+void UhfDutyCycle::reset(uint32_t now_ms) {
+  setState(UHF_DUTY_ACTIVE);
+  radio_.store(true, std::memory_order_relaxed);
+  last_read_ms_ = now_ms;
+  window_start_ms_ = now_ms;
+  off_ms_ = cfg_.min_off_ms;
+  last_account_ms_ = now_ms;
+}
+
+void UhfDutyCycle::resetStats() {
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) {
+    ms_[s] = 0; radio_ms_[s] = 0; reads_[s] = 0; charge_[s] = 0;
+  }
+  windows_ = 0; wakeups_ = 0; window_read_max_ms_ = 0; window_read_total_ms_ = 0;
+  sleeps_ = 0; slept_ms_ = 0;
+}
+
+void UhfDutyCycle::account(uint32_t now_ms) {
+  const uint32_t dt = now_ms - last_account_ms_;
+  last_account_ms_ = now_ms;
+  const uint8_t s = state();
+  bump(ms_[s], dt);
+  if (radio()) bump(radio_ms_[s], dt);
+}
+
+void UhfDutyCycle::setRadio(bool on, uint32_t now_ms) {
+  if (on) {
+    window_start_ms_ = now_ms;
+    bump(windows_, 1);
+  } else {
+    off_since_ms_.store(now_ms, std::memory_order_relaxed);
+    next_on_ms_.store(now_ms + off_ms_, std::memory_order_relaxed);
+  }
+  radio_.store(on, std::memory_order_relaxed);
+}
+
+bool UhfDutyCycle::radioOn(uint32_t now_ms) {
+  account(now_ms);
+  if (!cfg_.enabled) return true;
+
+  const uint32_t idle = now_ms - last_read_ms_;
+  if (state() == UHF_DUTY_ACTIVE) {
+    if (idle < cfg_.idle_after_ms) return true;
+    setState(UHF_DUTY_BACKOFF);
+    off_ms_ = cfg_.min_off_ms;
+    setRadio(false, now_ms);
+    return false;
+  }
+
+  if (radio()) {
+    // Window over without a read: longer gap next time
+    if (now_ms - window_start_ms_ < cfg_.burst_ms) return true;
+    if (state() == UHF_DUTY_BACKOFF && idle >= cfg_.sleep_after_ms) setState(UHF_DUTY_SLEEP);
+    const uint32_t grown = off_ms_ + off_ms_ * cfg_.growth_pct / 100;
+    off_ms_ = state() == UHF_DUTY_SLEEP ? cfg_.max_off_ms : min(max(grown, off_ms_ + 1), cfg_.max_off_ms);
+    setRadio(false, now_ms);
+    return false;
+  }
+
+  if (int32_t(now_ms - next_on_ms_.load(std::memory_order_relaxed)) < 0) return false;
+  setRadio(true, now_ms);
+  return true;
+}
+
+void UhfDutyCycle::noteRead(uint32_t now_ms) {
+  bump(reads_[state()], 1);
+  last_read_ms_ = now_ms;
+  if (state() == UHF_DUTY_ACTIVE) return;
+  account(now_ms);
+  const uint32_t waited = now_ms - window_start_ms_;
+  bump(wakeups_, 1);
+  bump(window_read_total_ms_, waited);
+  if (waited > window_read_max_ms_.load(std::memory_order_relaxed)) {
+    window_read_max_ms_.store(waited, std::memory_order_relaxed);
+  }
+  setState(UHF_DUTY_ACTIVE);
+  off_ms_ = cfg_.min_off_ms;
+}
+
+uint32_t UhfDutyCycle::sleepBudgetMs(uint32_t now_ms) const {
+  if (state() != UHF_DUTY_SLEEP || radio()) return 0;
+  if (now_ms - off_since_ms_.load(std::memory_order_relaxed) < UHF_DUTY_SETTLE_MS) return 0;
+  const int32_t left = int32_t(next_on_ms_.load(std::memory_order_relaxed) - now_ms) - int32_t(cfg_.wake_margin_ms);
+  return left > 0 ? uint32_t(left) : 0;
+}
+
+void UhfDutyCycle::addCharge(uint8_t state, uint32_t ma, uint32_t ms) {
+  if (state < UHF_DUTY_STATES) bump(charge_[state], uint64_t(ma) * ms);
+}
+
+void UhfDutyCycle::noteSleep(uint32_t ms) {
+  bump(sleeps_, 1);
+  bump(slept_ms_, ms);
+}
+
+UhfDutyStats UhfDutyCycle::stats() const {
+  UhfDutyStats st;
+  for (uint8_t s = 0; s < UHF_DUTY_STATES; s++) {
+    st.ms[s]          = ms_[s].load();
+    st.radio_ms[s]    = radio_ms_[s].load();
+    st.reads[s]       = reads_[s].load();
+    st.charge_mams[s] = charge_[s].load();
+  }
+  st.windows              = windows_.load();
+  st.wakeups              = wakeups_.load();
+  st.window_read_max_ms   = window_read_max_ms_.load();
+  st.window_read_total_ms = window_read_total_ms_.load();
+  st.sleeps               = sleeps_.load();
+  st.slept_ms             = slept_ms_.load();
+  return st;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+/*
+  ---------------------------------------------------------
+  Duty-cycled continuous inventory
+  - ACTIVE   stream runs flat out, display at full
+             brightness; any tag read brings this back
+  - BACKOFF  nothing read for idle_after_ms: the radio
+             only listens in windows of burst_ms, the gap
+             between windows grows from min_off_ms by
+             growth_pct per empty window up to max_off_ms;
+             display dimmed
+  - SLEEP    nothing read for sleep_after_ms: same windows
+             at the longest gap, display off, and the UI
+             may light-sleep the CPU between two windows
+             (sleepBudgetMs)
+  - Latency to first read for a tag that walks in is at
+    most one gap plus the first round of the next window:
+    uhfDutyForLatency() sizes max_off_ms for a target
+  - Owned by the pipeline's parse task (radioOn, noteRead)
+    while running; the UI reads state() and the sleep
+    budget and adds charge samples (addCharge). Counters
+    are atomics with a single writer each.
+  - Per state: time, radio-on time, reads and charge, for
+    energy per read (battery current samples, or a model
+    on the host)
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_DUTY_FIRST_READ_MS
+#define UHF_DUTY_FIRST_READ_MS 40        // stream start -> first notification, worst case
+#endif
+#ifndef UHF_DUTY_SETTLE_MS
+#define UHF_DUTY_SETTLE_MS 20            // radio off -> stop reply surely in, before sleeping
+#endif
+
+enum UhfDutyState : uint8_t {
+  UHF_DUTY_ACTIVE,
+  UHF_DUTY_BACKOFF,
+  UHF_DUTY_SLEEP,
+  UHF_DUTY_STATES
+};
+
+const char* uhfDutyStateName(uint8_t state);
+
+struct UhfDutyConfig {
+  bool     enabled;          // false: always ACTIVE, radio always on
+  uint32_t idle_after_ms;    // ACTIVE -> BACKOFF without a read
+  uint32_t sleep_after_ms;   // -> SLEEP without a read
+  uint32_t burst_ms;         // radio on per listen window
+  uint32_t min_off_ms;       // first gap after ACTIVE
+  uint32_t max_off_ms;       // longest gap (latency bound)
+  uint16_t growth_pct;       // gap grows by this much per empty window
+  uint32_t wake_margin_ms;   // sleep budget stops this long before a window
+
+  UhfDutyConfig()
+    : enabled(true), idle_after_ms(5000), sleep_after_ms(60000), burst_ms(2 * UHF_DUTY_FIRST_READ_MS),
+      min_off_ms(100), max_off_ms(900), growth_pct(50), wake_margin_ms(10) {}
+};
+
+// max_off_ms so that a tag is read within target_ms of walking in, the rest
+// of cfg kept. Windows last two first reads.
+UhfDutyConfig uhfDutyForLatency(uint32_t target_ms, const UhfDutyConfig& cfg = UhfDutyConfig(),
+                                uint32_t first_read_ms = UHF_DUTY_FIRST_READ_MS);
+
+struct UhfDutyStats {
+  uint32_t ms[UHF_DUTY_STATES];           // time in each state
+  uint32_t radio_ms[UHF_DUTY_STATES];     // of which with the stream running
+  uint32_t reads[UHF_DUTY_STATES];        // tag reads made in that state
+  uint64_t charge_mams[UHF_DUTY_STATES];  // mA x ms (addCharge); 32 bits wrap in 8 h at 150 mA
+  uint32_t windows;                       // listen windows opened
+  uint32_t wakeups;                       // windows that read a tag (-> ACTIVE)
+  uint32_t window_read_max_ms;            // window open -> first read, worst
+  uint32_t window_read_total_ms;          // sum over wakeups
+  uint32_t sleeps;                        // light sleeps (noteSleep)
+  uint32_t slept_ms;
+
+  uint32_t totalMs() const;
+  uint32_t radioMs() const;
+  uint32_t totalReads() const;
+  uint64_t totalChargeMams() const;
+};
+
+class UhfDutyCycle {
+public:
+  UhfDutyCycle();
+
+  void setConfig(const UhfDutyConfig& cfg) { cfg_ = cfg; }   // while stopped
+  const UhfDutyConfig& config() const { return cfg_; }
+
+  // ACTIVE, radio on, counters kept (resetStats clears them)
+  void reset(uint32_t now_ms);
+
+  // Parse task: whether the stream should run now; moves the state on
+  bool radioOn(uint32_t now_ms);
+  void noteRead(uint32_t now_ms);
+
+  // Any task
+  uint8_t state() const { return state_.load(std::memory_order_relaxed); }
+  bool    radio() const { return radio_.load(std::memory_order_relaxed); }
+  // SLEEP with the radio off and settled: ms the CPU may sleep, else 0
+  uint32_t sleepBudgetMs(uint32_t now_ms) const;
+
+  // UI: current drawn over the last ms, charged to state; a light sleep taken
+  void addCharge(uint8_t state, uint32_t ma, uint32_t ms);
+  void noteSleep(uint32_t ms);
+
+  UhfDutyStats stats() const;
+  void resetStats();
+
+private:
+  void account(uint32_t now_ms);
+  void setState(uint8_t s) { state_.store(s, std::memory_order_relaxed); }
+  void setRadio(bool on, uint32_t now_ms);
+  static void bump(std::atomic<uint32_t>& c, uint32_t v) {
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);   // single writer
+  }
+  static void bump(std::atomic<uint64_t>& c, uint64_t v) {
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+  UhfDutyConfig cfg_;
+  std::atomic<uint8_t>  state_;
+  std::atomic<bool>     radio_;
+  std::atomic<uint32_t> next_on_ms_;      // BACKOFF / SLEEP with the radio off
+  std::atomic<uint32_t> off_since_ms_;
+  uint32_t last_read_ms_;
+  uint32_t window_start_ms_;
+  uint32_t off_ms_;                       // current gap
+  uint32_t last_account_ms_;
+
+  // Parse task
+  std::atomic<uint32_t> ms_[UHF_DUTY_STATES], radio_ms_[UHF_DUTY_STATES], reads_[UHF_DUTY_STATES];
+  std::atomic<uint32_t> windows_, wakeups_, window_read_max_ms_, window_read_total_ms_;
+  // UI
+  std::atomic<uint64_t> charge_[UHF_DUTY_STATES];   // not lock-free on the ESP32, UI only
+  std::atomic<uint32_t> sleeps_, slept_ms_;
+};
@@ -0,0 +1,255 @@
+#include "uhf_encoder.h"
+
+const char* uhfEncodePhaseName(uint8_t phase) {
+  switch (phase) {
+    case UHF_ENC_ACQUIRE: return "acquire";
+    case UHF_ENC_SELECT:  return "select";
+    case UHF_ENC_WRITE:   return "write";
+    case UHF_ENC_VERIFY:  return "verify";
+    default:              return "?";
+  }
+}
+
+const char* uhfEncodeStatusName(uint8_t status) {
+  switch (status) {
+    case UHF_ENC_OK:            return "OK";
+    case UHF_ENC_SELECT_FAILED: return "select failed";
+    case UHF_ENC_WRITE_FAILED:  return "write failed";
+    case UHF_ENC_VERIFY_FAILED: return "verify failed";
+    default:                    return "?";
+  }
+}
+
+// Worth the slow path: tag not matched (0x09) or no/corrupted reply.
+// Access, lock and overrun errors would fail the same way again; power
+// errors are the power policy's.
+static bool recoverable(uint8_t module_error) {
+  return module_error == 0 || module_error == 0x09;
+}
+
+UhfEncoder::UhfEncoder()
+  : head_(0), queued_(0), tpl_len_(0), tpl_serial_bytes_(0), tpl_next_(0), tpl_left_(0),
+    pwd_(0), running_(false), job_no_(0), last_len_(0), on_result_(nullptr), ctx_(nullptr),
+    power_(nullptr) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool UhfEncoder::addEpc(const uint8_t* epc, uint8_t len) {
+  if (!epc || len == 0 || len > EPC_MAX_BYTES || queued_ == UHF_ENCODER_QUEUE) return false;
+  Job& j = queue_[(head_ + queued_) % UHF_ENCODER_QUEUE];
+  memcpy(j.epc, epc, len);
+  if (len & 1) j.epc[len++] = 0x00;
+  j.len = len;
+  queued_++;
+  return true;
+}
+
+bool UhfEncoder::setTemplate(const uint8_t* base, uint8_t len, uint8_t serial_bytes,
+                             uint32_t first, uint32_t count) {
+  if (!base || len == 0 || len > EPC_MAX_BYTES) return false;
+  if (serial_bytes == 0 || serial_bytes > 4 || serial_bytes > len) return false;
+  if (serial_bytes < 4 && uint64_t(first) + count > (uint64_t(1) << (8 * serial_bytes))) return false;
+  memcpy(tpl_, base, len);
+  if (len & 1) tpl_[len++] = 0x00;
+  tpl_len_          = len;
+  tpl_serial_bytes_ = serial_bytes;
+  tpl_next_         = first;
+  tpl_left_         = count;
+  return true;
+}
+
+void UhfEncoder::clear() {
+  head_ = queued_ = 0;
+  tpl_left_ = 0;
+  running_ = false;
+}
+
+bool UhfEncoder::start() {
+  if (pending() == 0) return false;
+  uhfStopMultiInventory();
+  memset(&stats_, 0, sizeof(stats_));
+  job_no_   = 0;
+  last_len_ = 0;
+  running_  = true;
+  return true;
+}
+
+uint32_t UhfEncoder::tagsPerMinute() const {
+  const uint32_t elapsed = stats_.last_ms - stats_.first_ms;
+  if (stats_.ok == 0 || elapsed == 0) return 0;
+  return uint32_t(uint64_t(stats_.ok) * 60000u / elapsed);
+}
+
+bool UhfEncoder::nextJob(Job& out) const {
+  if (queued_) {
+    out = queue_[head_];
+    return true;
+  }
+  if (!tpl_left_) return false;
+  memcpy(out.epc, tpl_, tpl_len_);
+  out.len = tpl_len_;
+  for (uint8_t i = 0; i < tpl_serial_bytes_; i++) {
+    out.epc[tpl_len_ - 1 - i] = uint8_t(tpl_next_ >> (8 * i));
+  }
+  return true;
+}
+
+void UhfEncoder::popJob() {
+  if (queued_) {
+    head_ = (head_ + 1) % UHF_ENCODER_QUEUE;
+    queued_--;
+  } else if (tpl_left_) {
+    tpl_next_++;
+    tpl_left_--;
+  }
+}
+
+void UhfEncoder::notePhase(UhfEncodeResult& r, uint8_t phase, uint32_t t0) {
+  const uint32_t us = micros() - t0;
+  r.phase_us[phase] = us;
+  UhfEncodePhaseStats& p = stats_.phase[phase];
+  p.count++;
+  p.total_us += us;
+  if (us > p.max_us) p.max_us = us;
+}
+
+bool UhfEncoder::step() {
+  if (!running_) return false;
+  Job job;
+  if (!nextJob(job)) { running_ = false; return false; }
+
+  const uint32_t t0 = micros();
+  if (power_) uhfApplyTxPower(power_->base(UHF_POWER_INVENTORY));
+  RawTagData tags[2];
+  const uint8_t n = rawInventoryWithRssi(tags, 2);
+  if (n == 0) { last_len_ = 0; return false; }        // field clear: any tag is new again
+  if (n > 1)  { stats_.collisions++; return false; }
+  const RawTagData& tag = tags[0];
+  // Still the tag handled last (inventory may report only a 96-bit prefix)
+  const uint8_t cmp = tag.epc_len < last_len_ ? tag.epc_len : last_len_;
+  if (last_len_ && memcmp(tag.epc_raw, last_epc_, cmp) == 0) return false;
+
+  if (stats_.ok + stats_.failed == 0) stats_.first_ms = millis();
+  UhfEncodeResult r;
+  memset(&r, 0, sizeof(r));
+  r.job     = job_no_ + 1;
+  r.epc_len = job.len;
+  memcpy(r.epc, job.epc, job.len);
+  notePhase(r, UHF_ENC_ACQUIRE, t0);
+
+  const bool ok = encode(tag, job, r);
+  r.total_us = micros() - t0;
+  stats_.last_ms = millis();
+  if (r.fallback) stats_.fallbacks++;
+  stats_.power_steps += r.power_steps;
+  if (ok) {
+    stats_.ok++;
+    job_no_++;
+    popJob();
+    memcpy(last_epc_, job.epc, job.len);
+    last_len_ = job.len;
+  } else {
+    stats_.failed++;
+    memcpy(last_epc_, tag.epc_raw, tag.epc_len);
+    last_len_ = tag.epc_len;
+  }
+  if (pending() == 0) running_ = false;
+  if (on_result_) on_result_(r, ctx_);
+  return true;
+}
+
+// Write or read-back at the policy's level for the tag (epc: what it answers
+// to now). A tag that did not answer gets the slow path once; after that,
+// each power error steps up while the policy allows it. The level that worked is
+// cached under the job's EPC, which the tag answers to afterwards.
+template <class F>
+bool UhfEncoder::runPhase(UhfPowerOp op, uint8_t cmd, const uint8_t* epc, uint8_t len,
+                          const Job& job, UhfEncodeResult& r, F attempt) {
+  uint16_t level = power_ ? power_->begin(op, epc, len) : 0;
+  if (level) uhfApplyTxPower(level);
+  bool slow = false;
+  while (!attempt()) {
+    const uint8_t err = uhfLastErrorCode();
+    if (!slow && recoverable(err)) {
+      slow = true;
+      r.fallback = true;
+      recover(epc, len);
+    } else {
+      level = level ? power_->escalate(op, level, err) : 0;
+      if (!level) return false;
+      uhfApplyTxPower(level);
+      r.power_steps++;
+    }
+    uhfNoteRetry(cmd);
+  }
+  if (level) {
+    power_->succeeded(op, job.epc, job.len, level);
+    r.power = level;
+  }
+  return true;
+}
+
+bool UhfEncoder::encode(const RawTagData& tag, const Job& job, UhfEncodeResult& r) {
+  uint32_t t = micros();
+  if (!uhfSelectEpc(tag.epc_raw, tag.epc_len)) {
+    r.module_error = uhfLastErrorCode();
+    notePhase(r, UHF_ENC_SELECT, t);
+    r.status = UHF_ENC_SELECT_FAILED;
+    return false;
+  }
+  notePhase(r, UHF_ENC_SELECT, t);
+
+  t = micros();
+  bool ok = runPhase(UHF_POWER_WRITE, 0x49, tag.epc_raw, tag.epc_len, job, r,
+                     [&] { return writeEpc(tag, job); });
+  notePhase(r, UHF_ENC_WRITE, t);
+  if (!ok) {
+    r.module_error = uhfLastErrorCode();
+    r.status = UHF_ENC_WRITE_FAILED;
+    return false;
+  }
+
+  t = micros();
+  ok = runPhase(UHF_POWER_READ, 0x39, job.epc, job.len, job, r, [&] { return verifyEpc(job); });
+  notePhase(r, UHF_ENC_VERIFY, t);
+  if (!ok) {
+    r.module_error = uhfLastErrorCode();
+    r.status = UHF_ENC_VERIFY_FAILED;
+    return false;
+  }
+  r.status = UHF_ENC_OK;
+  return true;
+}
+
+// PC word only when the EPC length changes (its other bits are kept), then
+// the EPC words; the select set on the old EPC still matches in between
+bool UhfEncoder::writeEpc(const RawTagData& tag, const Job& job) {
+  const uint8_t words = job.len / 2;
+  if (tag.epc_len_total / 2 != words) {
+    uint8_t pcb[2];
+    uint16_t pc = 0x3000;
+    if (uhfRead(0x01, 1, pcb, sizeof(pcb), 1, pwd_) == 2) pc = (uint16_t(pcb[0]) << 8) | pcb[1];
+    if (!uhfWritePcWord((pc & 0x07FF) | (uint16_t(words) << 11), pwd_)) return false;
+  }
+  return uhfWrite(0x01, 2, job.epc, job.len, pwd_);
+}
+
+// Select on the new EPC and read PC + EPC in one command
+bool UhfEncoder::verifyEpc(const Job& job) {
+  if (!uhfSelectEpc(job.epc, job.len)) return false;
+  const uint8_t words = job.len / 2;
+  uint8_t rb[2 + EPC_MAX_BYTES];
+  const int n = uhfRead(0x01, 1, rb, 2 + job.len, words + 1, pwd_);
+  if (n != 2 + job.len) return false;
+  const uint16_t pc = (uint16_t(rb[0]) << 8) | rb[1];
+  return ((pc >> 11) & 0x1F) == words && memcmp(&rb[2], job.epc, job.len) == 0;
+}
+
+// Slow path, as the single-tag writer does it: stop, wake the tag with an
+// inventory round, reselect on the full EPC then on its 96-bit prefix
+void UhfEncoder::recover(const uint8_t* epc, uint8_t len) {
+  uhfStopMultiInventory();
+  RawTagData tmp[1];
+  (void)rawInventoryWithRssi(tmp, 1);
+  if (!uhfSelectEpc(epc, len) && len > 12) uhfSelectEpc(epc, 12);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+#include "uhf_power.h"
+
+/*
+  ---------------------------------------------------------
+  Batch EPC encoding engine (production line)
+  - Jobs: a FIFO of explicit EPCs, then an optional serial
+    template (base EPC + big-endian serial in its last
+    bytes, count values from `first`)
+  - One tag at a time: step() runs one 0x22 round; exactly
+    one tag whose EPC differs from the last handled tag
+    gets the next job
+  - Fast path, no fixed delays and no stop/wake cycle:
+      select(old EPC) -> [PC word if the length changes]
+      -> write EPC -> select(new EPC) -> read PC+EPC back
+    The module keeps the select mask between commands, so
+    each step reuses it. Only a failed write or read-back
+    falls back to the slow path (stop, wake inventory,
+    reselect) and is retried once.
+  - With a power policy (uhf_power.h): acquire rounds at
+    its low inventory level, write and read-back at the
+    level cached for the tag or the base, one step up per
+    power error once the slow path did not help
+  - A failed job stays at the head of the queue: the next
+    tag gets the same EPC, so serials have no holes
+  - Per-phase latency (micros) and tags/min
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_ENCODER_QUEUE
+#define UHF_ENCODER_QUEUE 32             // explicit EPC jobs
+#endif
+
+enum UhfEncodePhase : uint8_t {
+  UHF_ENC_ACQUIRE,       // inventory round that found the tag
+  UHF_ENC_SELECT,        // select on the current EPC
+  UHF_ENC_WRITE,         // PC word (if needed) + EPC write
+  UHF_ENC_VERIFY,        // reselect on the new EPC + read-back
+  UHF_ENC_PHASES
+};
+
+enum UhfEncodeStatus : uint8_t {
+  UHF_ENC_OK,
+  UHF_ENC_SELECT_FAILED,
+  UHF_ENC_WRITE_FAILED,
+  UHF_ENC_VERIFY_FAILED  // no read-back, or it differs from the job
+};
+
+struct UhfEncodeResult {
+  uint32_t job;                       // 1-based position in the batch
+  uint8_t  status;                    // UhfEncodeStatus
+  uint8_t  module_error;              // 0xFF reply code, 0 if none
+  bool     fallback;                  // slow reselect path was needed
+  uint8_t  power_steps;               // power steps up (write + read-back)
+  uint16_t power;                     // last level used, 0.01 dBm (0: no policy)
+  uint8_t  epc_len;
+  uint8_t  epc[EPC_MAX_BYTES];        // EPC written (or attempted)
+  uint32_t phase_us[UHF_ENC_PHASES];
+  uint32_t total_us;
+};
+
+struct UhfEncodePhaseStats {
+  uint32_t count;
+  uint32_t total_us;
+  uint32_t max_us;
+};
+
+struct UhfEncoderStats {
+  uint32_t ok;
+  uint32_t failed;
+  uint32_t fallbacks;                 // jobs that needed the slow path
+  uint32_t collisions;                // rounds with several tags in the field
+  uint32_t power_steps;               // power steps up, all jobs
+  uint32_t first_ms;                  // first job started (rate window)
+  uint32_t last_ms;                   // last job finished
+  UhfEncodePhaseStats phase[UHF_ENC_PHASES];
+};
+
+typedef void (*UhfEncodeResultFn)(const UhfEncodeResult& r, void* ctx);
+
+const char* uhfEncodePhaseName(uint8_t phase);
+const char* uhfEncodeStatusName(uint8_t status);
+
+class UhfEncoder {
+public:
+  UhfEncoder();
+
+  void setAccessPassword(uint32_t pwd) { pwd_ = pwd; }
+  void setResultHandler(UhfEncodeResultFn fn, void* ctx) { on_result_ = fn; ctx_ = ctx; }
+  // nullptr: the module's power is left alone
+  void setPowerPolicy(UhfPowerPolicy* policy) { power_ = policy; }
+
+  // Job loading (odd lengths are padded with a zero byte to a word)
+  bool addEpc(const uint8_t* epc, uint8_t len);
+  bool setTemplate(const uint8_t* base, uint8_t len, uint8_t serial_bytes,
+                   uint32_t first, uint32_t count);
+  void clear();
+  uint32_t pending() const { return queued_ + tpl_left_; }
+
+  // start() stops any multi-poll and resets the stats; the caller owns the
+  // UART (continuous pipeline stopped) until stop()
+  bool start();
+  void stop() { running_ = false; }
+  bool running() const { return running_; }
+
+  // One inventory round, and one job if a new tag is alone in the field.
+  // Returns true when a job finished (result handler called). Stops by
+  // itself when no job is left.
+  bool step();
+
+  const UhfEncoderStats& stats() const { return stats_; }
+  uint32_t tagsPerMinute() const;
+
+private:
+  struct Job { uint8_t len; uint8_t epc[EPC_MAX_BYTES]; };
+
+  bool nextJob(Job& out) const;
+  void popJob();
+  bool encode(const RawTagData& tag, const Job& job, UhfEncodeResult& r);
+  bool writeEpc(const RawTagData& tag, const Job& job);
+  bool verifyEpc(const Job& job);
+  void recover(const uint8_t* epc, uint8_t len);
+  template <class F>
+  bool runPhase(UhfPowerOp op, uint8_t cmd, const uint8_t* epc, uint8_t len, const Job& job,
+                UhfEncodeResult& r, F attempt);
+  void notePhase(UhfEncodeResult& r, uint8_t phase, uint32_t t0);
+
+  Job      queue_[UHF_ENCODER_QUEUE];
+  uint16_t head_, queued_;
+
+  uint8_t  tpl_[EPC_MAX_BYTES];
+  uint8_t  tpl_len_, tpl_serial_bytes_;
+  uint32_t tpl_next_, tpl_left_;
+
+  uint32_t pwd_;
+  bool     running_;
+  uint32_t job_no_;                   // jobs completed OK so far
+  uint8_t  last_epc_[EPC_MAX_BYTES];  // tag handled last: ignored until it leaves
+  uint8_t  last_len_;
+
+  UhfEncodeResultFn on_result_;
+  void*    ctx_;
+  UhfPowerPolicy*   power_;
+  UhfEncoderStats stats_;
+};
@@ -0,0 +1,103 @@
+#include "uhf_frame_decoder.h"
+
+static_assert((UhfFrameDecoder::RING_SIZE & (UhfFrameDecoder::RING_SIZE - 1)) == 0,
+              "RING_SIZE must be a power of two");
+static_assert(UhfFrameDecoder::MAX_FRAME <= UhfFrameDecoder::RING_SIZE,
+              "a frame must fit in the ring");
+
+constexpr size_t UhfFrameDecoder::RING_SIZE;
+constexpr size_t UhfFrameDecoder::MAX_PAYLOAD;
+constexpr size_t UhfFrameDecoder::MAX_FRAME;
+
+void UhfFrameDecoder::reset() {
+  head_ = tail_ = 0;
+  held_ = 0;
+  cut_ = false;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+size_t UhfFrameDecoder::pump(UhfTransport& t) {
+  release();
+  size_t total = 0;
+  int avail = t.available();
+  while (avail > 0) {
+    const size_t free_bytes = RING_SIZE - buffered();
+    if (free_bytes == 0) { stats_.overflows++; break; }
+
+    // Contiguous space up to the physical end of the ring
+    const uint32_t wpos = head_ & MASK;
+    size_t chunk = RING_SIZE - wpos;
+    if (chunk > free_bytes) chunk = free_bytes;
+    if (chunk > size_t(avail)) chunk = size_t(avail);
+
+    const size_t n = t.readAvailable(&buf_[wpos], chunk);
+    if (n == 0) break;
+    if (wpos < MAX_FRAME) {
+      const size_t m = (wpos + n <= MAX_FRAME) ? n : MAX_FRAME - wpos;
+      memcpy(&buf_[RING_SIZE + wpos], &buf_[wpos], m);
+    }
+    head_ += uint32_t(n);
+    total += n;
+    avail -= int(n);
+  }
+  return total;
+}
+
+// A candidate at tail_ failed: skip its 0xBB. Right after a discard() it is
+// most likely a 0xBB inside the cut frame's data, not a damaged frame.
+void UhfFrameDecoder::reject(uint32_t& counter) {
+  if (cut_) stats_.resync_bytes++;
+  else      counter++;
+  tail_++;
+}
+
+bool UhfFrameDecoder::next(UhfFrame& out) {
+  release();
+  for (;;) {
+    // HUNT: skip to the next header, memchr over each contiguous span
+    while (tail_ != head_ && at(tail_) != 0xBB) {
+      const uint8_t* p = &buf_[tail_ & MASK];
+      size_t span = RING_SIZE - (tail_ & MASK);
+      if (span > buffered()) span = buffered();
+      const uint8_t* hit = static_cast<const uint8_t*>(memchr(p, 0xBB, span));
+      const uint32_t skip = hit ? uint32_t(hit - p) : uint32_t(span);
+      tail_ += skip;
+      stats_.resync_bytes += skip;
+    }
+    if (buffered() < 7) return false;
+
+    const uint16_t pl = (uint16_t(at(tail_ + 3)) << 8) | at(tail_ + 4);
+    if (pl > MAX_PAYLOAD) {
+      reject(stats_.bad_length);           // resync on the next 0xBB
+      continue;
+    }
+    const size_t flen = 5 + size_t(pl) + 2;
+    if (buffered() < flen) return false;   // resume when more bytes arrive
+
+    const uint8_t* f = &buf_[tail_ & MASK];
+    if (f[flen - 1] != 0x7E) {
+      reject(stats_.bad_trailer);
+      continue;
+    }
+    uint32_t s = 0;
+    for (size_t i = 1; i < flen - 2; i++) s += f[i];
+    if (uint8_t(s) != f[flen - 2]) {
+      reject(stats_.bad_checksum);
+      continue;
+    }
+
+    out.data = f;
+    out.len  = uint16_t(flen);
+    held_    = uint16_t(flen);
+    cut_     = false;
+    stats_.frames++;
+    return true;
+  }
+}
+
+void UhfFrameDecoder::discard() {
+  held_ = 0;
+  stats_.discarded += uint32_t(buffered());
+  cut_ = cut_ || buffered() > 0;
+  tail_ = head_;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <Arduino.h>
+#include "uhf_transport.h"
+
+/*
+  ---------------------------------------------------------
+  Streaming frame decoder for EL-UHF / JRD-4035
+  - Bulk reads from the transport into a persistent ring
+  - Resumable: a partial frame simply waits for more bytes
+  - Frames are validated (length, trailer, checksum) and
+    handed out as views into the ring: no copy
+  - A bad frame costs one byte: decoding resumes at the
+    next 0xBB instead of dropping the whole buffer
+  - discard() may cut a frame in two: until the next valid
+    frame, false headers in its tail count as resync bytes,
+    not as bad frames (they say nothing about the link)
+  ---------------------------------------------------------
+*/
+
+// View of one validated frame inside the decoder ring.
+// Valid until the next call to next(), pump() or discard().
+struct UhfFrame {
+  const uint8_t* data;   // data[0] == 0xBB
+  uint16_t       len;    // 5 + PL + 2
+
+  uint8_t        type() const    { return data[1]; }
+  uint8_t        cmd() const     { return data[2]; }
+  uint16_t       pl() const      { return (uint16_t(data[3]) << 8) | data[4]; }
+  const uint8_t* payload() const { return data + 5; }
+  bool           isError() const { return data[2] == 0xFF; }
+  uint8_t        errorCode() const { return pl() > 0 ? data[5] : 0; }
+};
+
+struct UhfDecoderStats {
+  uint32_t frames;          // valid frames emitted
+  uint32_t bad_checksum;
+  uint32_t bad_trailer;
+  uint32_t bad_length;      // PL beyond MAX_PAYLOAD
+  uint32_t resync_bytes;    // bytes skipped while hunting for 0xBB (or in a cut frame)
+  uint32_t overflows;       // pump() found the ring full
+  uint32_t discarded;       // bytes dropped by discard()
+};
+
+class UhfFrameDecoder {
+public:
+  static constexpr size_t RING_SIZE   = 1024;            // power of two
+  static constexpr size_t MAX_PAYLOAD = 505;
+  static constexpr size_t MAX_FRAME   = 5 + MAX_PAYLOAD + 2;
+
+  UhfFrameDecoder() { reset(); }
+
+  void   reset();
+  size_t pump(UhfTransport& t);      // move whatever the UART holds into the ring
+  bool   next(UhfFrame& out);        // next valid frame, false if none complete yet
+  void   discard();                  // drop everything buffered (stale replies)
+  size_t buffered() const { return size_t(head_ - tail_); }
+
+  const UhfDecoderStats& stats() const { return stats_; }
+  void   resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+private:
+  static constexpr uint32_t MASK = RING_SIZE - 1;
+
+  uint8_t at(uint32_t pos) const { return buf_[pos & MASK]; }
+  void    release() { tail_ += held_; held_ = 0; }
+  void    reject(uint32_t& counter);
+
+  // Mirror of the first MAX_FRAME bytes after the end, so any frame that
+  // starts in the ring is contiguous in memory.
+  uint8_t  buf_[RING_SIZE + MAX_FRAME];
+  uint32_t head_;     // total bytes written
+  uint32_t tail_;     // first byte not yet consumed
+  uint16_t held_;     // length of the frame last returned by next()
+  bool     cut_;      // discard() since the last valid frame
+  UhfDecoderStats stats_;
+};
@@ -0,0 +1,175 @@
+#pragma once
+#include <Arduino.h>
+#include "uhf_frame_decoder.h"
+
+/*
+  ---------------------------------------------------------
+  JRD-4035 command frames and typed replies
+  - Frames without parameters (inventory, stop, ...) are
+    built by the compiler, checksum included:
+    UhfStaticFrame<cmd, payload...>::bytes
+  - Frames with parameters are written field by field into
+    a TX buffer owned by the caller (UhfFrameWriter): the
+    checksum is summed as bytes go in, PL is patched last
+  - One builder per command, shared by the library and
+    the sketch
+  - Replies are views over the RX ring frame (UhfFrame):
+    nothing is copied until the caller takes the data
+  ---------------------------------------------------------
+*/
+
+// ---------- Compile-time frames ----------
+constexpr uint8_t uhfSum8() { return 0; }
+template <typename... T>
+constexpr uint8_t uhfSum8(uint8_t b, T... rest) { return uint8_t(b + uhfSum8(rest...)); }
+
+template <uint8_t Cmd, uint8_t... Payload>
+struct UhfStaticFrame {
+  static constexpr uint16_t PL   = sizeof...(Payload);
+  static constexpr size_t   SIZE = 7 + sizeof...(Payload);
+  static constexpr uint8_t  bytes[7 + sizeof...(Payload)] = {
+    0xBB, 0x00, Cmd, uint8_t(sizeof...(Payload) >> 8), uint8_t(sizeof...(Payload)),
+    Payload...,
+    uhfSum8(0x00, Cmd, uint8_t(sizeof...(Payload) >> 8), uint8_t(sizeof...(Payload)), Payload...),
+    0x7E
+  };
+};
+template <uint8_t Cmd, uint8_t... Payload>
+constexpr uint8_t UhfStaticFrame<Cmd, Payload...>::bytes[];
+
+typedef UhfStaticFrame<0x22> UhfInventoryFrame;      // single poll
+typedef UhfStaticFrame<0x27> UhfMultiPollOnceFrame;  // 0x27 without count: one round
+typedef UhfStaticFrame<0x28> UhfStopFrame;           // stop multi-poll
+typedef UhfStaticFrame<0x0D> UhfGetQueryFrame;       // read the Gen2 query parameters
+typedef UhfStaticFrame<0xB7> UhfGetPowerFrame;       // read the RF output power
+
+static_assert(UhfStopFrame::bytes[5] == 0x28 && UhfStopFrame::bytes[6] == 0x7E, "stop frame");
+static_assert(UhfInventoryFrame::SIZE == 7 && UhfInventoryFrame::bytes[5] == 0x22, "inventory frame");
+
+// ---------- Variable frames ----------
+class UhfFrameWriter {
+public:
+  UhfFrameWriter(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap), n_(0), sum_(0), ok_(true) {}
+
+  // Header, type 0x00 (command), cmd, PL placeholder
+  UhfFrameWriter& begin(uint8_t cmd) {
+    n_ = 0; sum_ = 0; ok_ = cap_ >= 7;
+    if (ok_) { buf_[0] = 0xBB; buf_[1] = 0x00; buf_[2] = cmd; buf_[3] = 0; buf_[4] = 0; n_ = 5; sum_ = cmd; }
+    return *this;
+  }
+  UhfFrameWriter& u8(uint8_t v) {
+    if (!room(1)) return *this;
+    buf_[n_++] = v; sum_ += v;
+    return *this;
+  }
+  UhfFrameWriter& u16(uint16_t v) { return u8(uint8_t(v >> 8)).u8(uint8_t(v)); }
+  UhfFrameWriter& u32(uint32_t v) { return u16(uint16_t(v >> 16)).u16(uint16_t(v)); }
+  UhfFrameWriter& bytes(const uint8_t* p, size_t n) {
+    if (!room(n)) return *this;
+    for (size_t i = 0; i < n; i++) { buf_[n_ + i] = p[i]; sum_ += p[i]; }
+    n_ += n;
+    return *this;
+  }
+  UhfFrameWriter& zeros(size_t n) {
+    if (!room(n)) return *this;
+    memset(&buf_[n_], 0, n);
+    n_ += n;
+    return *this;
+  }
+
+  // PL, checksum and trailer. Frame length, 0 if it did not fit.
+  size_t finish() {
+    if (!ok_ || !room(2)) return 0;
+    const uint16_t pl = uint16_t(n_ - 5);
+    buf_[3] = uint8_t(pl >> 8); buf_[4] = uint8_t(pl);
+    sum_ += buf_[3] + buf_[4];
+    buf_[n_++] = sum_;
+    buf_[n_++] = 0x7E;
+    return n_;
+  }
+
+  const uint8_t* data() const { return buf_; }
+  size_t size() const { return n_; }
+
+private:
+  bool room(size_t n) {
+    if (ok_ && n_ + n > cap_) ok_ = false;
+    return ok_;
+  }
+
+  uint8_t* buf_;
+  size_t   cap_, n_;
+  uint8_t  sum_;
+  bool     ok_;
+};
+
+// ---------- Command builders (return the frame length, 0 if too long) ----------
+
+// 0x27 multi-poll of `rounds` rounds
+inline size_t uhfFrameMultiPoll(UhfFrameWriter& w, uint16_t rounds) {
+  return w.begin(0x27).u8(0x22).u16(rounds).finish();
+}
+
+// 0x0C select: SelParam (target/action/bank), pointer and mask in bits,
+// truncate off
+inline size_t uhfFrameSelect(UhfFrameWriter& w, uint8_t sel_param, uint32_t ptr_bits,
+                             const uint8_t* mask, uint8_t mask_bytes) {
+  return w.begin(0x0C).u8(sel_param).u32(ptr_bits).u8(uint8_t(mask_bytes * 8)).u8(0x00)
+          .bytes(mask, mask_bytes).finish();
+}
+
+// 0x0E Gen2 query parameters, packed as UhfQueryParams::word() does
+inline size_t uhfFrameSetQuery(UhfFrameWriter& w, uint16_t query) {
+  return w.begin(0x0E).u16(query).finish();
+}
+
+// 0xB6 RF output power in 0.01 dBm (2600 = 26 dBm)
+inline size_t uhfFrameSetPower(UhfFrameWriter& w, uint16_t dbm100) {
+  return w.begin(0xB6).u16(dbm100).finish();
+}
+
+// 0x12 select mode
+inline size_t uhfFrameSetSelectMode(UhfFrameWriter& w, uint8_t mode) {
+  return w.begin(0x12).u8(mode).finish();
+}
+
+// 0x39 read of `words` words
+inline size_t uhfFrameRead(UhfFrameWriter& w, uint32_t pwd, uint8_t bank,
+                           uint16_t word_ptr, uint16_t words) {
+  return w.begin(0x39).u32(pwd).u8(bank).u16(word_ptr).u16(words).finish();
+}
+
+// 0x49 write of `words` words; data shorter than that is zero-padded
+inline size_t uhfFrameWrite(UhfFrameWriter& w, uint32_t pwd, uint8_t bank, uint16_t word_ptr,
+                            const uint8_t* data, size_t data_len, uint16_t words) {
+  const size_t bytes = size_t(words) * 2;
+  if (data_len > bytes) data_len = bytes;
+  return w.begin(0x49).u32(pwd).u8(bank).u16(word_ptr).u16(words)
+          .bytes(data, data_len).zeros(bytes - data_len).finish();
+}
+
+// ---------- Typed replies ----------
+
+// Plain acknowledgement (select, select mode, write, stop): the command's
+// own reply, with a 0x00 status byte when it carries just one
+inline bool uhfReplyOk(const UhfFrame& f, uint8_t cmd) {
+  return f.cmd() == cmd && (f.pl() != 1 || f.payload()[0] == 0x00);
+}
+
+// 0x39 reply. Depending on the firmware the payload is the data alone, or
+// UL + PC/EPC of the tag (UL bytes) + the data.
+struct UhfReadReply {
+  const uint8_t* data;
+  uint16_t       len;
+};
+
+inline bool uhfDecodeRead(const UhfFrame& f, uint16_t words, UhfReadReply& out) {
+  out.data = nullptr; out.len = 0;
+  if (f.cmd() != 0x39 || f.pl() == 0) return false;
+  const uint16_t want = uint16_t(words * 2);
+  const uint16_t pl = f.pl();
+  const uint8_t* p = f.payload();
+  if (pl != want && pl >= 1 + p[0] + want) { out.data = p + 1 + p[0]; out.len = want; }
+  else                                      { out.data = p;            out.len = pl; }
+  return true;
+}
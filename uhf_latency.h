@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  ---------------------------------------------------------
+  Fixed-bucket latency histogram
+  - Constant memory and O(buckets) insert, no allocation:
+    cheap enough to stay enabled on the device
+  - Bucket bounds cover 250 us .. 1 s (UART round trips up
+    to long writes); the last bucket counts everything above
+  - percentileUs() answers with the upper bound of the
+    bucket holding the requested rank (conservative)
+  ---------------------------------------------------------
+*/
+
+static constexpr uint32_t UHF_LAT_BOUNDS_US[] = {
+  250, 500, 1000, 2000, 3000, 5000, 7500, 10000, 15000, 20000,
+  30000, 50000, 75000, 100000, 150000, 200000, 300000, 500000, 1000000
+};
+static constexpr uint8_t UHF_LAT_BUCKETS =
+  uint8_t(sizeof(UHF_LAT_BOUNDS_US) / sizeof(UHF_LAT_BOUNDS_US[0])) + 1;
+
+struct UhfLatencyHistogram {
+  uint32_t bucket[UHF_LAT_BUCKETS];
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t total_us;
+
+  void reset() { memset(this, 0, sizeof(*this)); }
+
+  void add(uint32_t us) {
+    uint8_t b = 0;
+    while (b < UHF_LAT_BUCKETS - 1 && us > UHF_LAT_BOUNDS_US[b]) b++;
+    bucket[b]++;
+    count++;
+    total_us += us;
+    if (us > max_us) max_us = us;
+  }
+
+  // per_mille: 500 = median, 990 = p99. 0 when empty.
+  uint32_t percentileUs(uint16_t per_mille) const {
+    if (count == 0) return 0;
+    const uint64_t rank = (uint64_t(count) * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint8_t b = 0; b < UHF_LAT_BUCKETS - 1; b++) {
+      seen += bucket[b];
+      if (seen >= rank) return UHF_LAT_BOUNDS_US[b] < max_us ? UHF_LAT_BOUNDS_US[b] : max_us;
+    }
+    return max_us;
+  }
+
+  uint32_t meanUs() const { return count ? uint32_t(total_us / count) : 0; }
+};
@@ -0,0 +1,230 @@
+#include "uhf_log.h"
+#include <atomic>
+
+static_assert((UHF_LOG_RECORDS & (UHF_LOG_RECORDS - 1)) == 0, "UHF_LOG_RECORDS must be a power of two");
+
+#define UHF_LOG_FORMAT_STR(name, fmt) fmt,
+static const char* const kFormats[UHF_LOG_IDS] = { UHF_LOG_FORMATS(UHF_LOG_FORMAT_STR) };
+#undef UHF_LOG_FORMAT_STR
+
+const char* uhfLogLevelName(uint8_t level) {
+  switch (level) {
+    case UHF_LOG_ERROR: return "E";
+    case UHF_LOG_WARN:  return "W";
+    case UHF_LOG_INFO:  return "I";
+    case UHF_LOG_DEBUG: return "D";
+    default:            return "?";
+  }
+}
+
+const char* uhfLogCategoryName(uint8_t cat) {
+  switch (cat) {
+    case UHF_LOG_CAT_LINK:   return "LINK";
+    case UHF_LOG_CAT_FRAMES: return "FRAMES";
+    case UHF_LOG_CAT_RSSI:   return "RSSI";
+    case UHF_LOG_CAT_SELECT: return "SELECT";
+    case UHF_LOG_CAT_WRITE:  return "WRITE";
+    default:                 return "?";
+  }
+}
+
+const char* uhfLogFormat(uint16_t id) {
+  return id < UHF_LOG_IDS ? kFormats[id] : nullptr;
+}
+
+uint32_t uhfLogFormatsHash() {
+  uint32_t h = 2166136261u;
+  for (uint16_t i = 0; i < UHF_LOG_IDS; i++) {
+    for (const char* p = kFormats[i]; ; p++) {     // NUL included: separates the entries
+      h = (h ^ uint8_t(*p)) * 16777619u;
+      if (!*p) break;
+    }
+  }
+  return h;
+}
+
+// ---------- Ring ----------
+// Bounded multi-producer, single-consumer. A producer reserves n slots at
+// once by moving head_ (CAS, refused when the consumer is n slots behind),
+// fills them, and publishes each one by storing its position + 1 in seq_.
+// The consumer stops at the first slot not published yet.
+
+static UhfLogRecord          s_rec[UHF_LOG_RECORDS];
+static std::atomic<uint32_t> s_seq[UHF_LOG_RECORDS];
+static std::atomic<uint32_t> s_head(0), s_tail(0), s_written(0), s_dropped(0);
+
+static bool reserve(uint32_t n, uint32_t& at) {
+  uint32_t h = s_head.load(std::memory_order_relaxed);
+  do {
+    if (h + n - s_tail.load(std::memory_order_acquire) > UHF_LOG_RECORDS) {
+      s_dropped.fetch_add(n, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!s_head.compare_exchange_weak(h, h + n, std::memory_order_relaxed));
+  at = h;
+  return true;
+}
+
+static void publish(uint32_t pos) {
+  s_seq[pos & (UHF_LOG_RECORDS - 1)].store(pos + 1, std::memory_order_release);
+}
+
+void uhfLogPut(uint8_t level, uint8_t cat, uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+  uint32_t at;
+  if (!reserve(1, at)) return;
+  UhfLogRecord& r = s_rec[at & (UHF_LOG_RECORDS - 1)];
+  r.t_us = micros();
+  r.id = id; r.level = level; r.cat = cat;
+  r.arg[0] = a0; r.arg[1] = a1; r.arg[2] = a2; r.arg[3] = a3;
+  publish(at);
+  s_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void uhfLogBytes(uint8_t level, uint8_t cat, uint16_t id, const uint8_t* data, size_t len,
+                 uint32_t a1, uint32_t a2, uint32_t a3) {
+  const size_t kept = data ? min<size_t>(len, UHF_LOG_BYTES_MAX) : 0;
+  const uint32_t n = 1 + uint32_t((kept + UHF_LOG_CHUNK - 1) / UHF_LOG_CHUNK);
+  uint32_t at;
+  if (!reserve(n, at)) return;
+  const uint32_t t = micros();
+  UhfLogRecord& r = s_rec[at & (UHF_LOG_RECORDS - 1)];
+  r.t_us = t;
+  r.id = id; r.level = level; r.cat = cat;
+  r.arg[0] = uint32_t(len); r.arg[1] = a1; r.arg[2] = a2; r.arg[3] = a3;
+  publish(at);
+  for (uint32_t i = 1; i < n; i++) {
+    UhfLogRecord& c = s_rec[(at + i) & (UHF_LOG_RECORDS - 1)];
+    const size_t off = (i - 1) * UHF_LOG_CHUNK;
+    const uint8_t k = uint8_t(min<size_t>(UHF_LOG_CHUNK, kept - off));
+    c.t_us = t;
+    c.id = UHF_LOG_ID_BYTES; c.level = 0; c.cat = k;
+    memset(c.arg, 0, sizeof(c.arg));
+    memcpy(c.arg, data + off, k);
+    publish(at + i);
+  }
+  s_written.fetch_add(n, std::memory_order_relaxed);
+}
+
+// Next published record, or false
+static bool take(UhfLogRecord& r) {
+  const uint32_t t = s_tail.load(std::memory_order_relaxed);
+  const uint32_t i = t & (UHF_LOG_RECORDS - 1);
+  if (s_seq[i].load(std::memory_order_acquire) != t + 1) return false;
+  r = s_rec[i];
+  s_tail.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+size_t uhfLogFormatRecord(const UhfLogRecord& r, char* out, size_t cap) {
+  if (!out || cap == 0) return 0;
+  static const char digits[] = "0123456789ABCDEF";
+  if (r.id == UHF_LOG_ID_BYTES) {
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(r.arg);
+    size_t n = 0;
+    while (n < 13 && n + 1 < cap) out[n++] = ' ';   // under the time stamp
+    for (uint8_t i = 0; i < r.cat && i < UHF_LOG_CHUNK && n + 4 < cap; i++) {
+      out[n++] = ' ';
+      out[n++] = digits[b[i] >> 4];
+      out[n++] = digits[b[i] & 0x0F];
+    }
+    out[n] = '\0';
+    return n;
+  }
+  int n = snprintf(out, cap, "[%7u.%03u] %s %-6s ", (unsigned)(r.t_us / 1000), (unsigned)(r.t_us % 1000),
+                   uhfLogLevelName(r.level), uhfLogCategoryName(r.cat));
+  if (n < 0) return 0;
+  if (size_t(n) >= cap) return cap - 1;
+  const char* fmt = uhfLogFormat(r.id);
+  const int m = fmt ? snprintf(out + n, cap - n, fmt, r.arg[0], r.arg[1], r.arg[2], r.arg[3])
+                    : snprintf(out + n, cap - n, "format %u: %08X %08X %08X %08X", (unsigned)r.id,
+                               (unsigned)r.arg[0], (unsigned)r.arg[1], (unsigned)r.arg[2], (unsigned)r.arg[3]);
+  if (m > 0) n += m;
+  return min<size_t>(size_t(n), cap - 1);
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+  p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); p[2] = uint8_t(v >> 16); p[3] = uint8_t(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+void uhfLogEncode(const UhfLogRecord& r, uint8_t out[UHF_LOG_RECORD_SIZE]) {
+  putU32(out, r.t_us);
+  out[4] = uint8_t(r.id); out[5] = uint8_t(r.id >> 8);
+  out[6] = r.level;
+  out[7] = r.cat;
+  if (r.id == UHF_LOG_ID_BYTES) memcpy(out + 8, r.arg, 16);   // bytes as they came
+  else for (size_t i = 0; i < UHF_LOG_ARGS; i++) putU32(out + 8 + 4 * i, r.arg[i]);
+}
+
+bool uhfLogDecode(const uint8_t in[UHF_LOG_RECORD_SIZE], UhfLogRecord& r) {
+  r.t_us  = getU32(in);
+  r.id    = uint16_t(in[4] | (in[5] << 8));
+  r.level = in[6];
+  r.cat   = in[7];
+  if (r.id == UHF_LOG_ID_BYTES) memcpy(r.arg, in + 8, 16);
+  else for (size_t i = 0; i < UHF_LOG_ARGS; i++) r.arg[i] = getU32(in + 8 + 4 * i);
+  return r.id < UHF_LOG_IDS && (r.id == UHF_LOG_ID_BYTES ? r.cat <= UHF_LOG_CHUNK : r.level <= UHF_LOG_DEBUG);
+}
+
+size_t uhfLogDrain(UhfLogLineFn fn, void* ctx, size_t max_records) {
+  char line[UHF_LOG_LINE_MAX];
+  UhfLogRecord r;
+  size_t n = 0;
+  while (n < max_records && take(r)) {
+    n++;
+    if (!fn) continue;
+    uhfLogFormatRecord(r, line, sizeof(line));
+    fn(line, ctx);
+  }
+  return n;
+}
+
+size_t uhfLogDrainHex(UhfLogLineFn fn, void* ctx, size_t max_records) {
+  static const char digits[] = "0123456789ABCDEF";
+  char line[5 + 2 * UHF_LOG_RECORD_SIZE];
+  uint8_t b[UHF_LOG_RECORD_SIZE];
+  UhfLogRecord r;
+  size_t n = 0;
+  memcpy(line, "LOG ", 4);
+  while (n < max_records && take(r)) {
+    n++;
+    if (!fn) continue;
+    uhfLogEncode(r, b);
+    for (size_t i = 0; i < UHF_LOG_RECORD_SIZE; i++) {
+      line[4 + 2 * i] = digits[b[i] >> 4];
+      line[5 + 2 * i] = digits[b[i] & 0x0F];
+    }
+    line[4 + 2 * UHF_LOG_RECORD_SIZE] = '\0';
+    fn(line, ctx);
+  }
+  return n;
+}
+
+size_t uhfLogDumpHex(UhfLogLineFn fn, void* ctx) {
+  char line[80];
+  const UhfLogStats st = uhfLogStats();
+  snprintf(line, sizeof(line), "LOG BEGIN %u records, %u dropped, formats %08X", (unsigned)st.pending,
+           (unsigned)st.dropped, (unsigned)uhfLogFormatsHash());
+  fn(line, ctx);
+  const size_t n = uhfLogDrainHex(fn, ctx, st.pending);
+  fn("LOG END", ctx);
+  return n;
+}
+
+void uhfLogClear() {
+  uhfLogDrain(nullptr, nullptr, UHF_LOG_RECORDS);
+  s_written.store(0, std::memory_order_relaxed);
+  s_dropped.store(0, std::memory_order_relaxed);
+}
+
+UhfLogStats uhfLogStats() {
+  UhfLogStats st;
+  st.written = s_written.load(std::memory_order_relaxed);
+  st.dropped = s_dropped.load(std::memory_order_relaxed);
+  // Reserved but not yet published slots count as pending
+  st.pending = s_head.load(std::memory_order_relaxed) - s_tail.load(std::memory_order_relaxed);
+  return st;
+}
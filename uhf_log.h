@@ -0,0 +1,191 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  ---------------------------------------------------------
+  Deferred binary log
+  - Levels and categories are fixed at compile time
+    (UHF_LOG_LEVEL, UHF_LOG_CATEGORIES): a call below the
+    level expands to ((void)0), a call in a masked-out
+    category to a constant-false branch. Arguments of
+    disabled calls are not evaluated.
+  - An enabled call stores one fixed-size record in a RAM
+    ring: micros(), format id, level, category and up to
+    four 32-bit arguments. No formatting, no Serial, no
+    lock: the cost no longer depends on the console baud
+    rate, so logging does not move the timings it reports.
+  - Byte dumps (frames, EPCs) follow their record in
+    continuation records, 16 bytes each, UHF_LOG_BYTES_MAX
+    bytes at most
+  - Any task may log (a CAS reserves the slots); a single
+    consumer drains, in idle time: uhfLogDrain() formats
+    lines, uhfLogDrainHex() sends the raw records for
+    host/log_decode, which has the same format table
+  - Full ring: new records are dropped and counted, the
+    oldest ones (what led to the problem) are kept
+  - Formats are listed once below (UHF_LOG_FORMATS); their
+    arguments are 32-bit, signed values print with %d
+  ---------------------------------------------------------
+
+  Hex dump (uhfLogDumpHex):
+    LOG BEGIN <records> records, <dropped> dropped, formats <hash>
+    LOG <48 hex digits>      one record, 24 bytes little-endian:
+                             t_us u32, id u16, level u8, cat u8,
+                             arg u32 x 4
+    LOG END
+  Continuation records have id 0 (BYTES), level 0 and the
+  number of bytes they carry (1..16) in cat.
+*/
+
+// Levels: a call is compiled in if its level <= UHF_LOG_LEVEL
+#define UHF_LOG_OFF   0
+#define UHF_LOG_ERROR 1
+#define UHF_LOG_WARN  2
+#define UHF_LOG_INFO  3
+#define UHF_LOG_DEBUG 4
+
+// Categories
+#define UHF_LOG_CAT_LINK   0x01    // command / reply problems
+#define UHF_LOG_CAT_FRAMES 0x02    // every frame sent and received, in hex
+#define UHF_LOG_CAT_RSSI   0x04    // inventory rounds and payload parsing
+#define UHF_LOG_CAT_SELECT 0x08
+#define UHF_LOG_CAT_WRITE  0x10    // EPC write, reselect and read-back
+#define UHF_LOG_CAT_ALL    0x1F
+
+#ifndef UHF_LOG_LEVEL
+#define UHF_LOG_LEVEL UHF_LOG_INFO       // DEBUG adds frame dumps and parser traces
+#endif
+#ifndef UHF_LOG_CATEGORIES
+#define UHF_LOG_CATEGORIES UHF_LOG_CAT_ALL
+#endif
+#ifndef UHF_LOG_RECORDS
+#define UHF_LOG_RECORDS 256              // ring slots, power of two (24 bytes each)
+#endif
+#ifndef UHF_LOG_BYTES_MAX
+#define UHF_LOG_BYTES_MAX 64             // bytes kept per dump, the rest only counted
+#endif
+
+static constexpr size_t  UHF_LOG_ARGS        = 4;
+static constexpr size_t  UHF_LOG_RECORD_SIZE = 24;     // serialized
+static constexpr size_t  UHF_LOG_LINE_MAX    = 128;    // formatted line, NUL included
+static constexpr uint8_t UHF_LOG_CHUNK       = 16;     // bytes per continuation record
+
+// X(name, format). Append only: ids are what the records and host dumps carry.
+#define UHF_LOG_FORMATS(X)                                                                   \
+  X(BYTES,             "")                                                                   \
+  X(CORRUPTED_REPLY,   "corrupted reply to cmd 0x%02X")                                      \
+  X(LENGTH_MISMATCH,   "frame length mismatch: got %u, buffer %u")                           \
+  X(FRAME_TX,          "TX %u bytes")                                                        \
+  X(FRAME_RX,          "RX %u bytes")                                                        \
+  X(INV_START,         "inventory start")                                                    \
+  X(INV_FALLBACK,      "fallback to 0x27 (multi-poll)")                                      \
+  X(INV_DONE,          "inventory done, found=%u")                                           \
+  X(PARSE_PAYLOAD,     "parse payload plen=%u, cap=%u")                                      \
+  X(PARSE_M5,          "M5 format EPC (%u bytes), RSSI %d dBm")                              \
+  X(PARSE_RAW,         "raw EPC (%u bytes, %u bits), RSSI %d dBm")                           \
+  X(PARSE_NONE,        "no valid tags in this payload")                                      \
+  X(SELECT_EPC,        "select EPC (%u bytes)")                                              \
+  X(SELECT_OK,         "select OK")                                                          \
+  X(SELECT_ERROR,      "select error 0x%02X")                                                \
+  X(SELECT_FAILED,     "select failed, no reply")                                            \
+  X(WRITE_BEGIN,       "write EPC: %u bytes requested")                                      \
+  X(WRITE_PC_CURRENT,  "current PC 0x%04X")                                                  \
+  X(WRITE_PC_DEFAULT,  "PC unreadable, using 0x3000")                                        \
+  X(WRITE_ATTEMPT,     "attempt %u: %u words (%u bits), PC 0x%04X")                          \
+  X(WRITE_PC_FAILED,   "PC write failed, writing the EPC anyway")                            \
+  X(WRITE_NO_REPLY,    "EPC write: no reply from the module")                                \
+  X(WRITE_OK,          "EPC written: %u words (%u bits)")                                    \
+  X(WRITE_ERROR,       "EPC write error 0x%02X")                                             \
+  X(WRITE_OVERRUN,     "memory overrun, %u -> %u words")                                     \
+  X(WRITE_UNEXPECTED,  "EPC write: unexpected reply cmd 0x%02X")                             \
+  X(WRITE_GAVE_UP,     "EPC write failed after %u attempts")                                 \
+  X(WRITE_POWER,       "TX power %u -> %u (0.01 dBm)")                                       \
+  X(RESELECT_PREFIX,   "post-write reselect: full EPC failed, trying the 96-bit prefix")     \
+  X(RESELECT_TID,      "post-write reselect: prefix failed, trying the TID")                 \
+  X(RESELECT_FAILED,   "post-write reselect failed (EPC / TID)")                             \
+  X(RESELECT_OK,       "post-write reselect OK")                                             \
+  X(READBACK,          "read-back EPC (%u bytes), PC 0x%04X (%u words)")                     \
+  X(READBACK_FAILED,   "read-back failed (module busy or tag moved?)")                       \
+  X(TEST_SELECT_LAST,  "128-bit test write: selecting the last scanned tag")                \
+  X(TEST_SELECT_SCAN,  "128-bit test write: no scanned tag, scanning for one")
+
+#define UHF_LOG_ID_ENUM(name, fmt) UHF_LOG_ID_##name,
+enum UhfLogId : uint16_t {
+  UHF_LOG_FORMATS(UHF_LOG_ID_ENUM)
+  UHF_LOG_IDS
+};
+#undef UHF_LOG_ID_ENUM
+
+struct UhfLogRecord {
+  uint32_t t_us;
+  uint16_t id;             // UhfLogId
+  uint8_t  level;
+  uint8_t  cat;            // category bit; BYTES: bytes carried
+  uint32_t arg[UHF_LOG_ARGS];
+};
+
+struct UhfLogStats {
+  uint32_t written;        // records stored (continuations included)
+  uint32_t dropped;        // records lost to a full ring
+  uint32_t pending;        // waiting to be drained
+};
+
+const char* uhfLogLevelName(uint8_t level);
+const char* uhfLogCategoryName(uint8_t cat);
+const char* uhfLogFormat(uint16_t id);          // nullptr if unknown
+uint32_t    uhfLogFormatsHash();                // FNV-1a over the table, for dumps
+
+// Producers (any task)
+void uhfLogPut(uint8_t level, uint8_t cat, uint16_t id, uint32_t a0 = 0, uint32_t a1 = 0,
+               uint32_t a2 = 0, uint32_t a3 = 0);
+// arg 0 is `len`; the first UHF_LOG_BYTES_MAX bytes follow in continuations
+void uhfLogBytes(uint8_t level, uint8_t cat, uint16_t id, const uint8_t* data, size_t len,
+                 uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0);
+
+// Consumer (one task). Lines go to fn; each returns the records taken.
+typedef void (*UhfLogLineFn)(const char* line, void* ctx);
+size_t uhfLogDrain(UhfLogLineFn fn, void* ctx, size_t max_records);
+size_t uhfLogDrainHex(UhfLogLineFn fn, void* ctx, size_t max_records);   // "LOG <hex>" lines
+size_t uhfLogDumpHex(UhfLogLineFn fn, void* ctx);                        // BEGIN, all, END
+void   uhfLogClear();
+UhfLogStats uhfLogStats();
+
+// Formatting, shared with the host decoder. A BYTES record gives its hex.
+size_t uhfLogFormatRecord(const UhfLogRecord& r, char* out, size_t cap);
+void   uhfLogEncode(const UhfLogRecord& r, uint8_t out[UHF_LOG_RECORD_SIZE]);
+bool   uhfLogDecode(const uint8_t in[UHF_LOG_RECORD_SIZE], UhfLogRecord& r);
+
+// ---------- Call sites ----------
+//   UHF_LOGW(LINK, CORRUPTED_REPLY, cmd);
+//   UHF_LOGD_BYTES(FRAMES, FRAME_TX, frame, len);
+#define UHF_LOG_PUT(level, cat, id, ...)                                                       \
+  ((UHF_LOG_CATEGORIES & UHF_LOG_CAT_##cat)                                                    \
+     ? uhfLogPut(level, UHF_LOG_CAT_##cat, UHF_LOG_ID_##id, ##__VA_ARGS__) : (void)0)
+#define UHF_LOG_PUT_BYTES(level, cat, id, data, len, ...)                                      \
+  ((UHF_LOG_CATEGORIES & UHF_LOG_CAT_##cat)                                                    \
+     ? uhfLogBytes(level, UHF_LOG_CAT_##cat, UHF_LOG_ID_##id, data, len, ##__VA_ARGS__) : (void)0)
+
+#if UHF_LOG_LEVEL >= UHF_LOG_ERROR
+#define UHF_LOGE(cat, id, ...) UHF_LOG_PUT(UHF_LOG_ERROR, cat, id, ##__VA_ARGS__)
+#else
+#define UHF_LOGE(cat, id, ...) ((void)0)
+#endif
+#if UHF_LOG_LEVEL >= UHF_LOG_WARN
+#define UHF_LOGW(cat, id, ...) UHF_LOG_PUT(UHF_LOG_WARN, cat, id, ##__VA_ARGS__)
+#else
+#define UHF_LOGW(cat, id, ...) ((void)0)
+#endif
+#if UHF_LOG_LEVEL >= UHF_LOG_INFO
+#define UHF_LOGI(cat, id, ...) UHF_LOG_PUT(UHF_LOG_INFO, cat, id, ##__VA_ARGS__)
+#define UHF_LOGI_BYTES(cat, id, data, len, ...) UHF_LOG_PUT_BYTES(UHF_LOG_INFO, cat, id, data, len, ##__VA_ARGS__)
+#else
+#define UHF_LOGI(cat, id, ...) ((void)0)
+#define UHF_LOGI_BYTES(cat, id, data, len, ...) ((void)0)
+#endif
+#if UHF_LOG_LEVEL >= UHF_LOG_DEBUG
+#define UHF_LOGD(cat, id, ...) UHF_LOG_PUT(UHF_LOG_DEBUG, cat, id, ##__VA_ARGS__)
+#define UHF_LOGD_BYTES(cat, id, data, len, ...) UHF_LOG_PUT_BYTES(UHF_LOG_DEBUG, cat, id, data, len, ##__VA_ARGS__)
+#else
+#define UHF_LOGD(cat, id, ...) ((void)0)
+#define UHF_LOGD_BYTES(cat, id, data, len, ...) ((void)0)
+#endif
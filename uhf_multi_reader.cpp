@@ -0,0 +1,151 @@
+#include "uhf_multi_reader.h"
+
+static_assert(UHF_MULTI_MAX_READERS >= 1 && UHF_MULTI_MAX_READERS <= 8, "reader masks are 8 bits");
+
+UhfMultiReader::UhfMultiReader() : count_(0), running_(false), table_(nullptr), events_dropped_(0) {
+  for (uint8_t i = 0; i < UHF_MULTI_MAX_READERS; i++) readers_[i] = nullptr;
+  resetStats();
+}
+
+int8_t UhfMultiReader::add(UhfReader& reader) {
+  if (count_ == UHF_MULTI_MAX_READERS || running_) return -1;
+  readers_[count_] = &reader;
+  return int8_t(count_++);
+}
+
+void UhfMultiReader::resetStats() {
+  memset(stats_, 0, sizeof(stats_));
+  events_dropped_.store(0, std::memory_order_relaxed);
+}
+
+void UhfMultiReader::start(Table& table) {
+  table_ = &table;
+  table_->clear();
+  const uint32_t now = millis();
+  for (uint8_t r = 0; r < count_; r++) {
+    last_rx_ms_[r] = now;
+    if (cfg_.mode == UHF_MULTI_STREAM) readers_[r]->startMultiPoll(cfg_.multi_poll_rounds);
+  }
+  running_ = true;
+}
+
+void UhfMultiReader::stop() {
+  if (!running_) return;
+  for (uint8_t r = 0; r < count_; r++) {
+    if (cfg_.mode == UHF_MULTI_STREAM) readers_[r]->stopMultiInventory();
+  }
+  running_ = false;
+}
+
+uint16_t UhfMultiReader::step() {
+  if (!running_ || count_ == 0) return 0;
+  uint16_t n;
+  switch (cfg_.mode) {
+    case UHF_MULTI_SEQUENTIAL: n = stepSequential(); break;
+    case UHF_MULTI_STREAM:     n = stepStream(); break;
+    default:                   n = stepInterleaved(); break;
+  }
+  const uint32_t now = millis();
+  table_->expire(now, cfg_.tag_expiry_ms, [&](const UhfTagEntry& e) {
+    const uint16_t slot = uint16_t(&e - &table_->at(0));
+    publish(UHF_TAG_GONE, last_by_[slot], slot);
+  });
+  return n;
+}
+
+uint16_t UhfMultiReader::stepSequential() {
+  RawTagData out[16];
+  uint16_t total = 0;
+  for (uint8_t r = 0; r < count_; r++) {
+    if (!readers_[r]->beginInventory(cfg_.round_timeout_ms)) continue;
+    bool done = false;
+    while (!done) {
+      const uint8_t n = readers_[r]->pollRound(out, 16, UHF_ROUND_GAP_MS, done);
+      merge(r, out, n, millis());
+      total += n;
+    }
+    stats_[r].rounds++;
+  }
+  return total;
+}
+
+// Every module gets its request before any reply is awaited; the replies are
+// then taken from whichever UART has some until every round is over
+uint16_t UhfMultiReader::stepInterleaved() {
+  RawTagData out[16];
+  uint16_t total = 0;
+  uint8_t open = 0;
+  for (uint8_t r = 0; r < count_; r++) {
+    if (readers_[r]->beginInventory(cfg_.round_timeout_ms)) open |= uint8_t(1u << r);
+  }
+  while (open) {
+    for (uint8_t r = 0; r < count_; r++) {
+      if (!(open & (1u << r))) continue;
+      bool done = false;
+      const uint8_t n = readers_[r]->pollRound(out, 16, UHF_ROUND_GAP_MS, done);
+      merge(r, out, n, millis());
+      total += n;
+      if (done) { open &= uint8_t(~(1u << r)); stats_[r].rounds++; }
+    }
+  }
+  return total;
+}
+
+uint16_t UhfMultiReader::stepStream() {
+  RawTagData out[16];
+  uint16_t total = 0;
+  for (uint8_t r = 0; r < count_; r++) {
+    const uint8_t n = readers_[r]->pollInventory(out, 16);
+    const uint32_t now = millis();
+    if (n > 0) {
+      last_rx_ms_[r] = now;
+    } else if (now - last_rx_ms_[r] > cfg_.rearm_ms) {
+      // The module stops by itself after multi_poll_rounds rounds
+      readers_[r]->startMultiPoll(cfg_.multi_poll_rounds);
+      last_rx_ms_[r] = now;
+      stats_[r].rearms++;
+    }
+    merge(r, out, n, now);
+    total += n;
+  }
+  return total;
+}
+
+void UhfMultiReader::merge(uint8_t r, const RawTagData* reads, uint8_t n, uint32_t now) {
+  const uint8_t bit = uint8_t(1u << r);
+  stats_[r].tag_reads += n;
+  for (uint8_t i = 0; i < n; i++) {
+    bool is_new = false;
+    const uint16_t slot = table_->upsert(reads[i].epc_raw, reads[i].epc_len, now, &is_new);
+    UhfTagEntry& e = table_->at(slot);
+    if (reads[i].rssi_dbm != 0) {
+      e.rssi_f.add(reads[i].rssi_dbm);
+      e.rssi = e.rssi_f.dbm();
+    }
+    if (is_new) {
+      seen_by_[slot] = bit;
+      stats_[r].first_reads++;
+    } else {
+      seen_by_[slot] |= bit;
+    }
+    if (seen_by_[slot] != bit) stats_[r].shared_reads++;
+    last_by_[slot] = r;
+    if (is_new) publish(UHF_TAG_NEW, r, slot);
+    if (cfg_.on_read) cfg_.on_read(r, reads[i], e, cfg_.on_read_ctx);
+  }
+}
+
+void UhfMultiReader::publish(uint8_t kind, uint8_t reader, uint16_t slot) {
+  const UhfTagEntry& e = table_->at(slot);
+  UhfMultiEvent ev;
+  ev.kind    = kind;
+  ev.reader  = reader;
+  ev.readers = seen_by_[slot];
+  ev.epc_len = e.epc_len;
+  memcpy(ev.epc, e.epc, e.epc_len);
+  ev.rssi    = e.rssi;
+  ev.t_ms    = e.last_seen;
+  ev.reads   = e.reads;
+  ev.total   = uint16_t(table_->size() - (kind == UHF_TAG_GONE ? 1 : 0));   // GONE: still in the table
+  if (!events_.push(ev)) events_dropped_.fetch_add(1, std::memory_order_relaxed);
+}
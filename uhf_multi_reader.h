@@ -0,0 +1,140 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "universal_inventory.h"
+#include "uhf_spsc_ring.h"
+#include "uhf_tag_table.h"
+#include "uhf_pipeline.h"
+
+/*
+  ---------------------------------------------------------
+  Several JRD-4035 modules on one controller
+  - Each module is a UhfReader on its own UART; one task
+    drives them all through step(), no task per module: the
+    modules inventory on their own once asked, the
+    controller only sends requests and drains replies
+  - Modes:
+      SEQUENTIAL  : one 0x22 round per module in turn, one
+                    module on air at a time (baseline)
+      INTERLEAVED : 0x22 to every module, then the replies
+                    of all of them as they come; the rounds
+                    overlap
+      STREAM      : a 0x27 stream on every module, drained
+                    in turn; each stream is restarted after
+                    rearm_ms of silence
+  - Merge: one tag table for all modules, each entry keeps
+    the mask of modules that read it. NEW when the first
+    module reads a tag, GONE when none has read it for
+    tag_expiry_ms: one deduplicated stream of events
+  - The table is borrowed at start(), not owned: on the
+    sketch it is the stopped pipeline's (lendTable()), so
+    the 1024 tags are in RAM once
+  - step() runs on one task; events go to another through
+    an SPSC ring (poll()), like UhfPipeline's
+  - Co-located antennas hear each other: mount them apart
+    or give the modules different channels
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_MULTI_MAX_READERS
+#define UHF_MULTI_MAX_READERS 3
+#endif
+
+enum UhfMultiMode : uint8_t {
+  UHF_MULTI_SEQUENTIAL,
+  UHF_MULTI_INTERLEAVED,
+  UHF_MULTI_STREAM
+};
+
+struct UhfMultiEvent {
+  uint8_t  kind;          // UHF_TAG_NEW or UHF_TAG_GONE
+  uint8_t  reader;        // NEW: module that read it first; GONE: last one
+  uint8_t  readers;       // bit n: module n read it while present
+  uint8_t  epc_len;
+  uint8_t  epc[EPC_MAX_BYTES];
+  int16_t  rssi;          // dBm, smoothed over all modules
+  uint32_t t_ms;
+  uint32_t reads;         // all modules
+  uint16_t total;         // tags present after this event
+};
+
+// Every tag read, on the stepping task, once the merged entry is updated
+typedef void (*UhfMultiReadFn)(uint8_t reader, const RawTagData& read, const UhfTagEntry& tag, void* ctx);
+
+struct UhfMultiConfig {
+  uint8_t        mode;              // UhfMultiMode
+  uint32_t       tag_expiry_ms;
+  uint32_t       round_timeout_ms;  // 0x22 without any reply
+  uint16_t       multi_poll_rounds; // STREAM
+  uint32_t       rearm_ms;          // STREAM
+  UhfMultiReadFn on_read;
+  void*          on_read_ctx;
+
+  UhfMultiConfig()
+    : mode(UHF_MULTI_INTERLEAVED), tag_expiry_ms(500), round_timeout_ms(200),
+      multi_poll_rounds(10000), rearm_ms(2000), on_read(nullptr), on_read_ctx(nullptr) {}
+};
+
+struct UhfMultiReaderStats {
+  uint32_t rounds;        // 0x22 rounds closed (SEQUENTIAL, INTERLEAVED)
+  uint32_t tag_reads;
+  uint32_t first_reads;   // tags this module was the first to read
+  uint32_t shared_reads;  // reads of tags another module also read
+  uint32_t rearms;        // streams restarted after silence
+};
+
+class UhfMultiReader {
+public:
+  typedef UhfTagTable<UHF_TAG_TABLE_CAPACITY> Table;
+
+  UhfMultiReader();
+
+  // Index of the new module, -1 when full. Readers are not copied.
+  int8_t     add(UhfReader& reader);
+  uint8_t    readerCount() const { return count_; }
+  UhfReader& reader(uint8_t i) { return *readers_[i]; }
+
+  // Only while stopped
+  void setConfig(const UhfMultiConfig& cfg) { cfg_ = cfg; }
+  const UhfMultiConfig& config() const { return cfg_; }
+
+  // start() clears table and merges into it until stop(); stop() ends the
+  // streams (STREAM), so the readers can take commands again. table()
+  // reads it until its owner takes it back.
+  void start(Table& table);
+  void stop();
+  bool running() const { return running_; }
+
+  // One scheduling pass over every module: a full round each (SEQUENTIAL,
+  // INTERLEAVED) or one drain each (STREAM). Returns the tags read.
+  uint16_t step();
+
+  // Event side: drain up to max events, never blocks
+  uint8_t poll(UhfMultiEvent* out, uint8_t max) { return uint8_t(events_.popSome(out, max)); }
+  uint32_t eventsDropped() const { return events_dropped_.load(std::memory_order_relaxed); }
+
+  // Stepping task only (or while stopped)
+  const Table& table() const { return *table_; }
+  uint8_t      readersOf(uint16_t slot) const { return seen_by_[slot]; }
+  const UhfMultiReaderStats& readerStats(uint8_t i) const { return stats_[i]; }
+  void         resetStats();
+
+private:
+  uint16_t stepSequential();
+  uint16_t stepInterleaved();
+  uint16_t stepStream();
+  void     merge(uint8_t r, const RawTagData* reads, uint8_t n, uint32_t now);
+  void     publish(uint8_t kind, uint8_t reader, uint16_t slot);
+
+  UhfReader*          readers_[UHF_MULTI_MAX_READERS];
+  UhfMultiReaderStats stats_[UHF_MULTI_MAX_READERS];
+  uint32_t            last_rx_ms_[UHF_MULTI_MAX_READERS];   // STREAM
+  uint8_t             count_;
+  UhfMultiConfig      cfg_;
+  bool                running_;
+  Table*              table_;                               // borrowed, see start()
+  uint8_t             seen_by_[UHF_TAG_TABLE_CAPACITY];     // per slot: reader mask
+  uint8_t             last_by_[UHF_TAG_TABLE_CAPACITY];     // per slot: last reader
+  UhfSpscRing<UhfMultiEvent, UHF_PIPELINE_EVENT_RING> events_;
+  std::atomic<uint32_t> events_dropped_;
+};
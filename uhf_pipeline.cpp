@@ -0,0 +1,262 @@
+#include "uhf_pipeline.h"
+#include "universal_inventory.h"
+
+#if !defined(ARDUINO)
+#include <chrono>
+#endif
+
+// Yield the CPU when a stage has nothing to do (real time, not the host's
+// virtual clock: on Linux the stages are real threads).
+static void idleTick() {
+#if defined(ARDUINO)
+  vTaskDelay(1);
+#else
+  std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+}
+
+UhfPipeline::UhfPipeline()
+  : port_(nullptr), ring_tx_(*this), tid_(table_, nullptr),
+    state_(IDLE), ingest_ack_(IDLE), parse_ack_(IDLE), quit_(false),
+    streaming_(false), table_lent_(false), last_rx_ms_(0),
+    rx_bytes_(0), rx_stalls_(0), tag_reads_(0), tags_expired_(0),
+    events_out_(0), events_dropped_(0), query_updates_(0)
+#if defined(ARDUINO)
+    , ingest_task_(nullptr), parse_task_(nullptr)
+#endif
+{}
+
+bool UhfPipeline::begin(UhfTransport& port, const UhfPipelineConfig& cfg) {
+  port_ = &port;
+  cfg_  = cfg;
+  tid_.setReader(cfg.tid_reader);
+  tid_.setCache(cfg.tid_cache);
+  quit_ = false;
+#if defined(ARDUINO)
+  // Ingest above parse: moving bytes out of the UART must never wait on parsing
+  if (xTaskCreatePinnedToCore(ingestEntry, "uhf_ingest", 3072, this, 6,
+                              &ingest_task_, UHF_PIPELINE_IO_CORE) != pdPASS) return false;
+  if (xTaskCreatePinnedToCore(parseEntry, "uhf_parse", 8192, this, 4,
+                              &parse_task_, UHF_PIPELINE_IO_CORE) != pdPASS) return false;
+#else
+  ingest_thread_ = std::thread(ingestEntry, this);
+  parse_thread_  = std::thread(parseEntry, this);
+#endif
+  return true;
+}
+
+void UhfPipeline::end() {
+  if (running()) stop();
+  quit_ = true;
+#if !defined(ARDUINO)
+  if (ingest_thread_.joinable()) ingest_thread_.join();
+  if (parse_thread_.joinable())  parse_thread_.join();
+#endif
+}
+
+void UhfPipeline::waitAck(const std::atomic<uint8_t>& ack, uint8_t s) {
+  while (ack.load() != s) idleTick();
+}
+
+bool UhfPipeline::start(bool clear_tags) {
+  if (!port_ || running()) return false;
+  // Both tasks are parked: rings and table can be reset from here
+  rx_.reset();
+  if (clear_tags || table_lent_) {
+    table_.clear();
+    tid_.clear();
+    events_.reset();
+    table_lent_ = false;
+  }
+  if (cfg_.query) cfg_.query->reset(millis());
+  if (cfg_.duty) cfg_.duty->reset(millis());
+  uhfAttachTransport(&ring_tx_);
+  state_ = RUN;
+  waitAck(ingest_ack_, RUN);
+  waitAck(parse_ack_, RUN);
+  return true;
+}
+
+UhfPipeline::Table& UhfPipeline::lendTable() {
+  table_lent_ = true;   // another owner's tags and slots: the TID queue must not see them
+  return table_;
+}
+
+void UhfPipeline::stop() {
+  if (!running()) return;
+  state_ = STOP;
+  waitAck(parse_ack_, STOP);     // stream stopped, parse task off the port
+  waitAck(ingest_ack_, STOP);
+  uhfAttachTransport(port_);
+  state_ = IDLE;
+}
+
+UhfPipelineStats UhfPipeline::stats() const {
+  UhfPipelineStats s;
+  s.rx_bytes        = rx_bytes_.load();
+  s.rx_stalls       = rx_stalls_.load();
+  s.rx_ring_high    = rx_.highWater();
+  s.tag_reads       = tag_reads_.load();
+  s.tags_expired    = tags_expired_.load();
+  s.events          = events_out_.load();
+  s.events_dropped  = events_dropped_.load();
+  s.event_ring_high = events_.highWater();
+  s.query_updates   = query_updates_.load();
+  return s;
+}
+
+void UhfPipeline::resetStats() {
+  rx_bytes_ = 0; rx_stalls_ = 0; tag_reads_ = 0; tags_expired_ = 0;
+  events_out_ = 0; events_dropped_ = 0; query_updates_ = 0;
+  tid_.resetStats();
+}
+
+// ---------- Ingest: UART -> byte ring ----------
+void UhfPipeline::ingestEntry(void* self) {
+  static_cast<UhfPipeline*>(self)->ingestLoop();
+#if defined(ARDUINO)
+  vTaskDelete(nullptr);
+#endif
+}
+
+void UhfPipeline::ingestLoop() {
+  while (!quit_) {
+    const uint8_t s = state_.load();
+    // Keep draining while the parse task stops the stream: it needs the replies
+    if (s == RUN || (s == STOP && parse_ack_.load() != STOP)) {
+      if (ingest_ack_.load() != s) ingest_ack_ = (s == STOP) ? uint8_t(RUN) : s;
+      if (!ingestOnce()) idleTick();
+      continue;
+    }
+    ingest_ack_ = s;
+    idleTick();
+  }
+}
+
+bool UhfPipeline::ingestOnce() {
+  const int avail = port_->available();
+  if (avail <= 0) return false;
+  uint32_t room = rx_.freeSpace();
+  if (room == 0) {                   // back-pressure: bytes wait in the UART driver
+    rx_stalls_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  uint8_t chunk[256];
+  if (room > sizeof(chunk)) room = sizeof(chunk);
+  if (room > uint32_t(avail)) room = uint32_t(avail);
+  const size_t n = port_->readAvailable(chunk, room);
+  rx_.pushSome(chunk, uint32_t(n));
+  rx_bytes_.fetch_add(uint32_t(n), std::memory_order_relaxed);
+  return n > 0;
+}
+
+// ---------- Parse: byte ring -> tag table -> events ----------
+void UhfPipeline::parseEntry(void* self) {
+  static_cast<UhfPipeline*>(self)->parseLoop();
+#if defined(ARDUINO)
+  vTaskDelete(nullptr);
+#endif
+}
+
+void UhfPipeline::parseLoop() {
+  while (!quit_) {
+    const uint8_t s = state_.load();
+    if (s == RUN) {
+      if (parse_ack_.load() != RUN) parse_ack_ = RUN;
+      if (!parseOnce()) idleTick();
+      continue;
+    }
+    if (s == STOP && parse_ack_.load() != STOP) {
+      if (streaming_) uhfStopMultiInventory();
+      // Single polls after this must not inherit a Q or target B tuned for the stream
+      if (cfg_.query) uhfSetQueryParams(cfg_.query->startParams());
+      streaming_ = false;
+      parse_ack_ = STOP;
+      continue;
+    }
+    if (s == IDLE) parse_ack_ = IDLE;
+    idleTick();
+  }
+}
+
+void UhfPipeline::publish(uint8_t kind, const UhfTagEntry& e) {
+  UhfTagEvent ev;
+  ev.kind    = kind;
+  ev.epc_len = e.epc_len;
+  memcpy(ev.epc, e.epc, e.epc_len);
+  ev.has_tid = e.has_tid;
+  if (e.has_tid) memcpy(ev.tid, e.tid, sizeof(ev.tid));
+  ev.rssi    = e.rssi;
+  ev.t_ms    = e.last_seen;
+  ev.total   = uint16_t(table_.size() - (kind == UHF_TAG_GONE ? 1 : 0));   // GONE: still in the table
+  if (events_.push(ev)) events_out_.fetch_add(1, std::memory_order_relaxed);
+  else                  events_dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void UhfPipeline::expireTags(uint32_t now) {
+  const uint16_t gone = table_.expire(now, cfg_.tag_expiry_ms, [this](const UhfTagEntry& e) {
+    if (cfg_.tid_cache && e.has_tid) cfg_.tid_cache->noteRssi(e.epc, e.epc_len, e.rssi);
+    publish(UHF_TAG_GONE, e);
+  });
+  if (gone) tags_expired_.fetch_add(gone, std::memory_order_relaxed);
+}
+
+bool UhfPipeline::parseOnce() {
+  // Between two listen windows: stream stopped, tags still expire
+  if (cfg_.duty && !cfg_.duty->radioOn(millis())) {
+    if (streaming_) uhfStopMultiInventory();
+    streaming_ = false;
+    expireTags(millis());
+    return false;
+  }
+  if (!streaming_) {
+    if (cfg_.query) uhfSetQueryParams(cfg_.query->params());
+    streaming_ = uhfStartMultiPoll(cfg_.multi_poll_rounds);
+    last_rx_ms_ = millis();
+  }
+
+  RawTagData out[16];
+  const uint8_t n = uhfPollInventory(out, 16);
+  uint32_t now = millis();
+  if (n > 0) {
+    last_rx_ms_ = now;
+    tag_reads_.fetch_add(n, std::memory_order_relaxed);
+  } else if (now - last_rx_ms_ > cfg_.rearm_ms) {
+    // The module stops by itself after multi_poll_rounds rounds
+    uhfStartMultiPoll(cfg_.multi_poll_rounds);
+    last_rx_ms_ = now;
+  }
+
+  for (uint8_t i = 0; i < n; i++) {
+    bool is_new = false;
+    const uint16_t slot = table_.upsert(out[i].epc_raw, out[i].epc_len, now, &is_new);
+    UhfTagEntry& e = table_.at(slot);
+    if (cfg_.query) cfg_.query->noteRead(out[i].epc_raw, out[i].epc_len);
+    if (out[i].rssi_dbm != 0) {
+      e.rssi_f.add(out[i].rssi_dbm);
+      e.rssi = e.rssi_f.dbm();
+    }
+    if (is_new) tid_.push(slot, now);
+    if (cfg_.duty) cfg_.duty->noteRead(now);
+    if (cfg_.on_read) cfg_.on_read(out[i], e, cfg_.on_read_ctx);
+    publish(is_new ? UHF_TAG_NEW : UHF_TAG_SEEN, e);
+  }
+
+  expireTags(now);
+
+  // TID batch between two streams; the batch stopped the stream
+  if (tid_.service(now) > 0) {
+    uhfStartMultiPoll(cfg_.multi_poll_rounds);
+    last_rx_ms_ = millis();
+  }
+
+  // New Q / target: the module only takes them between two streams
+  if (cfg_.query && cfg_.query->update(now)) {
+    uhfStopMultiInventory();
+    uhfSetQueryParams(cfg_.query->params());
+    uhfStartMultiPoll(cfg_.multi_poll_rounds);
+    last_rx_ms_ = millis();
+    query_updates_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return n > 0;
+}
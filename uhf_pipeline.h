@@ -0,0 +1,188 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "uhf_transport.h"
+#include "uhf_spsc_ring.h"
+#include "uhf_tag_table.h"
+#include "uhf_tid_queue.h"
+#include "uhf_query.h"
+#include "uhf_duty.h"
+
+#if defined(ARDUINO)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+/*
+  ---------------------------------------------------------
+  Pipelined continuous inventory
+    ingest task : UART -> byte ring (nothing else, never parses)
+    parse task  : byte ring -> decoder -> tag table (dedup),
+                  TID queue, multi-poll stream control,
+                  query parameters (UhfQueryController),
+                  listen windows (UhfDutyCycle);
+                  publishes fixed-size tag events
+    UI          : the caller (loop() on the ESP32) drains the
+                  events with poll(); it never touches the UART
+  - Stages are linked by SPSC lock-free rings (uhf_spsc_ring.h)
+  - The parse task runs the regular uhf* API: while running,
+    the attached transport is a view of the byte ring whose
+    writes go straight to the real port
+  - Back-pressure: a full byte ring leaves bytes in the UART
+    driver buffer (rx_stalls); a full event ring drops the
+    event (events_dropped), the next sighting repairs the UI
+  - ESP32: ingest and parse tasks pinned to
+    UHF_PIPELINE_IO_CORE, loop() keeps the other core.
+    Host: std::thread, for stress tests on Linux.
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_PIPELINE_RX_RING
+#define UHF_PIPELINE_RX_RING 2048        // bytes, power of two
+#endif
+#ifndef UHF_PIPELINE_EVENT_RING
+#define UHF_PIPELINE_EVENT_RING 64       // tag events, power of two
+#endif
+#ifndef UHF_PIPELINE_IO_CORE
+#define UHF_PIPELINE_IO_CORE 0
+#endif
+
+enum UhfTagEventKind : uint8_t {
+  UHF_TAG_NEW,     // first sighting
+  UHF_TAG_SEEN,    // refresh (RSSI, TID once read)
+  UHF_TAG_GONE     // expired from the parser's table
+};
+
+struct UhfTagEvent {
+  uint8_t  kind;          // UhfTagEventKind
+  uint8_t  epc_len;
+  uint8_t  epc[EPC_MAX_BYTES];
+  uint8_t  tid[8];
+  bool     has_tid;
+  int16_t  rssi;          // dBm, smoothed over the last reads
+  uint32_t t_ms;          // millis() when the parser saw it
+  uint16_t total;         // tags tracked by the parser after this event
+};
+
+// Every tag read, on the parse task, once the table entry (TID if known) is
+// updated. Must not block: it runs between two UART drains.
+typedef void (*UhfTagReadFn)(const RawTagData& read, const UhfTagEntry& tag, void* ctx);
+
+struct UhfPipelineConfig {
+  uint16_t     multi_poll_rounds;
+  uint32_t     rearm_ms;          // restart the stream after this much silence
+  uint32_t     tag_expiry_ms;
+  UhfTidReader tid_reader;        // nullptr: no TID enrichment
+  UhfTidCache* tid_cache;         // nullptr: every new tag is read; else owned
+                                  // by the parse task while running
+  UhfTagReadFn on_read;           // nullptr: events only
+  void*        on_read_ctx;
+  UhfQueryController* query;      // nullptr: the module keeps its query
+                                  // parameters; else owned by the parse task
+                                  // while running, changes sent between
+                                  // streams, start values sent back on stop()
+  UhfDutyCycle* duty;             // nullptr: the stream never pauses; else
+                                  // the stream only runs when radioOn() says
+                                  // so, parse task side owned while running
+
+  UhfPipelineConfig()
+    : multi_poll_rounds(10000), rearm_ms(2000), tag_expiry_ms(500), tid_reader(nullptr),
+      tid_cache(nullptr), on_read(nullptr), on_read_ctx(nullptr), query(nullptr), duty(nullptr) {}
+};
+
+struct UhfPipelineStats {
+  uint32_t rx_bytes;          // UART -> byte ring
+  uint32_t rx_stalls;         // ingest found the byte ring full
+  uint32_t rx_ring_high;      // byte ring high-water mark
+  uint32_t tag_reads;         // notifications parsed
+  uint32_t tags_expired;
+  uint32_t events;            // published to the UI
+  uint32_t events_dropped;    // event ring full
+  uint32_t event_ring_high;
+  uint32_t query_updates;     // query parameters sent between two streams
+};
+
+class UhfPipeline {
+public:
+  typedef UhfTagTable<UHF_TAG_TABLE_CAPACITY> Table;
+
+  UhfPipeline();
+
+  // Creates the tasks (idle). port is the transport the pipeline takes
+  // over while running and hands back on stop().
+  bool begin(UhfTransport& port, const UhfPipelineConfig& cfg = UhfPipelineConfig());
+  void end();
+
+  // start() attaches the ring view and starts the stream; stop() stops the
+  // stream, waits for both tasks to park and re-attaches the port. Only
+  // call the uhf* API directly while stopped.
+  bool start(bool clear_tags = true);
+  void stop();
+  bool running() const { return state_.load() != IDLE; }
+
+  // While stopped: the tag table, for an inventory that never runs at the
+  // same time as the pipeline (UhfMultiReader), so the sketch holds one
+  // table, not two. The next start() clears it whatever clear_tags says.
+  Table& lendTable();
+
+  // UI side: drain up to max events, never blocks
+  uint8_t poll(UhfTagEvent* out, uint8_t max) { return uint8_t(events_.popSome(out, max)); }
+
+  UhfPipelineStats stats() const;
+  void resetStats();
+  const UhfTidQueueStats& tidStats() const { return tid_.stats(); }   // read while stopped
+
+private:
+  enum State : uint8_t { IDLE, RUN, STOP };
+
+  // What the parse task sees as "the UART" while running
+  class RingTransport : public UhfTransport {
+  public:
+    explicit RingTransport(UhfPipeline& p) : p_(p) {}
+    int    available() override { return int(p_.rx_.size()); }
+    int    read() override { uint8_t b; return p_.rx_.pop(b) ? b : -1; }
+    size_t readAvailable(uint8_t* buf, size_t n) override { return p_.rx_.popSome(buf, uint32_t(n)); }
+    size_t write(const uint8_t* data, size_t len) override { return p_.port_->write(data, len); }
+    void   flush() override { p_.port_->flush(); }
+  private:
+    UhfPipeline& p_;
+  };
+
+  static void ingestEntry(void* self);
+  static void parseEntry(void* self);
+  void ingestLoop();
+  void parseLoop();
+  bool ingestOnce();
+  bool parseOnce();
+  void expireTags(uint32_t now);
+  void publish(uint8_t kind, const UhfTagEntry& e);
+  void waitAck(const std::atomic<uint8_t>& ack, uint8_t s);
+
+  UhfTransport*     port_;
+  UhfPipelineConfig cfg_;
+  RingTransport     ring_tx_;
+  UhfSpscRing<uint8_t, UHF_PIPELINE_RX_RING>       rx_;
+  UhfSpscRing<UhfTagEvent, UHF_PIPELINE_EVENT_RING> events_;
+  Table             table_;
+  UhfTidQueue<UHF_TAG_TABLE_CAPACITY> tid_;
+
+  std::atomic<uint8_t> state_;
+  std::atomic<uint8_t> ingest_ack_;    // last state fully handled by each task
+  std::atomic<uint8_t> parse_ack_;
+  std::atomic<bool>    quit_;
+  bool     streaming_;                 // parse task only
+  bool     table_lent_;                // lendTable() since the last start()
+  uint32_t last_rx_ms_;
+
+  // Each counter has a single writer
+  std::atomic<uint32_t> rx_bytes_, rx_stalls_, tag_reads_, tags_expired_, events_out_, events_dropped_,
+                        query_updates_;
+
+#if defined(ARDUINO)
+  TaskHandle_t ingest_task_, parse_task_;
+#else
+  std::thread  ingest_thread_, parse_thread_;
+#endif
+};
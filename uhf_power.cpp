@@ -0,0 +1,146 @@
+#include "uhf_power.h"
+#include "uhf_tag_table.h"
+
+bool uhfSetTxPower(uint16_t dbm100) {
+  if (dbm100 < UHF_POWER_MIN_DBM100 || dbm100 > UHF_POWER_MAX_DBM100) return false;
+  UhfFrameWriter& tx = uhfTxFrame();
+  const size_t n = uhfFrameSetPower(tx, dbm100);
+  UhfFrame r;
+  if (!uhfTransact(tx.data(), n, r, 200) || !uhfReplyOk(r, 0xB6)) {
+    uhfReader().noteTxPower(0);       // the module may or may not have taken it
+    return false;
+  }
+  uhfReader().noteTxPower(dbm100);
+  return true;
+}
+
+bool uhfGetTxPower(uint16_t& dbm100) {
+  UhfFrame r;
+  if (!uhfTransact(UhfGetPowerFrame::bytes, UhfGetPowerFrame::SIZE, r, 200)) return false;
+  if (r.cmd() != 0xB7 || r.pl() < 2) return false;
+  dbm100 = uint16_t((uint16_t(r.payload()[0]) << 8) | r.payload()[1]);
+  uhfReader().noteTxPower(dbm100);
+  return true;
+}
+
+bool uhfApplyTxPower(uint16_t dbm100) {
+  return dbm100 == uhfTxPower() || uhfSetTxPower(dbm100);
+}
+
+uint16_t uhfTxPower() { return uhfReader().txPower(); }
+
+void uhfForgetTxPower() { uhfReader().noteTxPower(0); }
+
+// ---------- Policy ----------
+
+UhfPowerConfig uhfPowerDefaults() {
+  UhfPowerConfig c;
+  c.base[UHF_POWER_INVENTORY] = 2000;
+  c.base[UHF_POWER_READ]      = 2000;
+  c.base[UHF_POWER_WRITE]     = 2200;   // a write needs a few dB more than a read
+  c.max  = 3000;
+  c.step = 200;
+  c.no_tag_steps_up = true;
+  return c;
+}
+
+const char* uhfPowerOpName(uint8_t op) {
+  switch (op) {
+    case UHF_POWER_INVENTORY: return "inventory";
+    case UHF_POWER_READ:      return "read";
+    case UHF_POWER_WRITE:     return "write";
+    default:                  return "?";
+  }
+}
+
+static uint16_t clampPower(uint16_t v) {
+  return v < UHF_POWER_MIN_DBM100 ? UHF_POWER_MIN_DBM100 : v > UHF_POWER_MAX_DBM100 ? UHF_POWER_MAX_DBM100 : v;
+}
+
+UhfPowerPolicy::UhfPowerPolicy() : clock_(0), saved_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+  memset(cache_, 0, sizeof(cache_));
+  setConfig(uhfPowerDefaults());
+}
+
+void UhfPowerPolicy::setConfig(const UhfPowerConfig& cfg) {
+  cfg_ = cfg;
+  cfg_.max = clampPower(cfg_.max);
+  for (uint8_t op = 0; op < UHF_POWER_OPS; op++) {
+    cfg_.base[op] = clampPower(cfg_.base[op]);
+    if (cfg_.base[op] > cfg_.max) cfg_.base[op] = cfg_.max;
+  }
+  if (cfg_.step == 0) cfg_.step = 100;
+}
+
+UhfPowerPolicy::Entry* UhfPowerPolicy::find(uint32_t hash) {
+  for (uint8_t i = 0; i < UHF_POWER_CACHE; i++) {
+    if (cache_[i].used && cache_[i].hash == hash) return &cache_[i];
+  }
+  return nullptr;
+}
+
+uint16_t UhfPowerPolicy::begin(UhfPowerOp op, const uint8_t* epc, uint8_t len) {
+  saved_ = 0;
+  uint16_t level = cfg_.base[op];
+  if (op == UHF_POWER_INVENTORY) return level;
+  stats_.ops++;
+  if (!epc || len == 0) return level;
+  Entry* e = find(uhfEpcHash(epc, len));
+  if (!e || e->level[op - 1] <= level) return level;
+  // Each step between base and the cached level is one attempt that would
+  // have failed first
+  const uint16_t cached = e->level[op - 1] > cfg_.max ? cfg_.max : e->level[op - 1];
+  const uint32_t steps  = (uint32_t(cached - level) + cfg_.step - 1) / cfg_.step;
+  saved_ = steps > 0xFF ? 0xFF : uint8_t(steps);
+  e->used = ++clock_;
+  stats_.cache_hits++;
+  return cached;
+}
+
+uint16_t UhfPowerPolicy::escalate(UhfPowerOp op, uint16_t level, uint8_t err) {
+  if (op == UHF_POWER_INVENTORY) return 0;
+  const bool power = err == 0xB3 || (err == 0x09 && cfg_.no_tag_steps_up);
+  if (!power) return 0;
+  if (level >= cfg_.max) {
+    stats_.at_max++;
+    return 0;
+  }
+  stats_.escalations++;
+  return uint32_t(level) + cfg_.step >= cfg_.max ? cfg_.max : uint16_t(level + cfg_.step);
+}
+
+void UhfPowerPolicy::succeeded(UhfPowerOp op, const uint8_t* epc, uint8_t len, uint16_t level) {
+  if (op == UHF_POWER_INVENTORY) return;
+  stats_.retries_saved += saved_;
+  saved_ = 0;
+  if (!epc || len == 0) return;
+  const uint32_t hash = uhfEpcHash(epc, len);
+  Entry* e = find(hash);
+  if (level <= cfg_.base[op]) {
+    if (e) e->level[op - 1] = 0;     // base is enough for this one now
+    return;
+  }
+  if (!e) {
+    // Free slot, else the least recently used tag
+    e = &cache_[0];
+    for (uint8_t i = 0; i < UHF_POWER_CACHE && e->used; i++) {
+      if (!cache_[i].used || cache_[i].used < e->used) e = &cache_[i];
+    }
+    memset(e, 0, sizeof(*e));
+    e->hash = hash;
+  }
+  e->level[op - 1] = level;
+  e->used = ++clock_;
+}
+
+uint8_t UhfPowerPolicy::cached() const {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < UHF_POWER_CACHE; i++) if (cache_[i].used) n++;
+  return n;
+}
+
+void UhfPowerPolicy::clearCache() {
+  memset(cache_, 0, sizeof(cache_));
+  clock_ = 0;
+}
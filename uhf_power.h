@@ -0,0 +1,122 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+
+/*
+  ---------------------------------------------------------
+  RF output power and per-operation power policy
+  - 0xB6 / 0xB7 set and read the module's output power in
+    0.01 dBm (2600 = 26 dBm). The level the module last
+    accepted is remembered: uhfApplyTxPower only sends 0xB6
+    when it changes, so callers apply before every command
+  - UhfPowerPolicy picks the level per operation:
+      inventory  low on the encode station, so the tags on
+                 the reel or the desk next to it stay out
+      read/write start at their own base; only errors that
+                 say the tag lacks power (0xB3, and 0x09 "no
+                 tag" on a tag just inventoried) step up, one
+                 step at a time, up to max
+  - The level a tag needed above base is cached (EPC hash,
+    LRU of UHF_POWER_CACHE): the next operation on it
+    starts there, the steps skipped are counted as retries
+    saved. A hash collision only costs a start one level
+    too high.
+  - Not thread safe: whoever owns the UART owns the policy
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_POWER_CACHE
+#define UHF_POWER_CACHE 32               // tags whose working level is kept
+#endif
+
+static constexpr uint16_t UHF_POWER_MIN_DBM100 = 1000;
+static constexpr uint16_t UHF_POWER_MAX_DBM100 = 3000;
+
+// 0xB6 / 0xB7 on the attached transport, not while a multi-poll stream runs.
+// Levels outside UHF_POWER_MIN..MAX are refused without being sent.
+bool     uhfSetTxPower(uint16_t dbm100);
+bool     uhfGetTxPower(uint16_t& dbm100);
+// 0xB6 only if the module is not known to be at that level already
+bool     uhfApplyTxPower(uint16_t dbm100);
+// Last level the module accepted (or reported), 0 if unknown
+uint16_t uhfTxPower();
+// Module reset or replaced: the next apply always sends
+void     uhfForgetTxPower();
+
+// ---------- Policy ----------
+enum UhfPowerOp : uint8_t {
+  UHF_POWER_INVENTORY,   // acquire rounds on the encode station
+  UHF_POWER_READ,        // read, read-back
+  UHF_POWER_WRITE,       // PC / EPC / user writes
+  UHF_POWER_OPS
+};
+
+struct UhfPowerConfig {
+  uint16_t base[UHF_POWER_OPS];  // start level per operation
+  uint16_t max;                  // read / write never go above
+  uint16_t step;
+  bool     no_tag_steps_up;      // 0x09 on an access counts as a power error
+};
+
+// Inventory 20 dBm, read 20 dBm, write 22 dBm, up to 30 dBm by 2 dB
+UhfPowerConfig uhfPowerDefaults();
+const char*    uhfPowerOpName(uint8_t op);
+
+struct UhfPowerStats {
+  uint32_t ops;              // read / write operations started
+  uint32_t escalations;      // steps up after a power error
+  uint32_t at_max;           // still short of power at max: given up
+  uint32_t cache_hits;       // started above base from the cache
+  uint32_t retries_saved;    // failed attempts the cache hits skipped
+};
+
+class UhfPowerPolicy {
+public:
+  UhfPowerPolicy();
+
+  void setConfig(const UhfPowerConfig& cfg);        // clamped, cache kept
+  const UhfPowerConfig& config() const { return cfg_; }
+  uint16_t base(UhfPowerOp op) const { return cfg_.base[op]; }
+
+  // Level to start `op` at: the tag's cached level, else the base.
+  // epc is what the tag answers to now (nullptr: no tag yet).
+  uint16_t begin(UhfPowerOp op, const uint8_t* epc, uint8_t len);
+  // After a failed attempt at `level` with module error `err`: the next
+  // level to try, 0 when the error is not about power or max is reached
+  uint16_t escalate(UhfPowerOp op, uint16_t level, uint8_t err);
+  // The attempt at `level` worked. epc is what the tag answers to after it
+  // (the new EPC after an EPC write).
+  void     succeeded(UhfPowerOp op, const uint8_t* epc, uint8_t len, uint16_t level);
+
+  // begin / apply / attempt / escalate until it works or the policy gives up
+  template <class F>
+  bool run(UhfPowerOp op, const uint8_t* epc, uint8_t len, F attempt) {
+    uint16_t level = begin(op, epc, len);
+    for (;;) {
+      uhfApplyTxPower(level);
+      if (attempt()) { succeeded(op, epc, len, level); return true; }
+      level = escalate(op, level, uhfLastErrorCode());
+      if (!level) return false;
+    }
+  }
+
+  uint8_t cached() const;
+  void    clearCache();
+  const UhfPowerStats& stats() const { return stats_; }
+  void    resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+private:
+  struct Entry {
+    uint32_t hash;
+    uint32_t used;               // LRU stamp, 0 = free
+    uint16_t level[2];           // READ, WRITE; 0 = base was enough
+  };
+
+  Entry* find(uint32_t hash);
+
+  UhfPowerConfig cfg_;
+  UhfPowerStats  stats_;
+  Entry    cache_[UHF_POWER_CACHE];
+  uint32_t clock_;
+  uint8_t  saved_;               // steps skipped by the last begin()
+};
@@ -0,0 +1,257 @@
+#include "uhf_query.h"
+#include <math.h>
+#include "universal_inventory.h"
+#include "uhf_tag_table.h"
+
+bool uhfSetQueryParams(const UhfQueryParams& p) {
+  UhfFrameWriter& tx = uhfTxFrame();
+  const size_t n = uhfFrameSetQuery(tx, p.word());
+  UhfFrame r;
+  return uhfTransact(tx.data(), n, r, 200) && uhfReplyOk(r, 0x0E);
+}
+
+bool uhfGetQueryParams(UhfQueryParams& out) {
+  UhfFrame r;
+  if (!uhfTransact(UhfGetQueryFrame::bytes, UhfGetQueryFrame::SIZE, r, 200)) return false;
+  if (r.cmd() != 0x0D || r.pl() < 2) return false;
+  out = UhfQueryParams::fromWord(uint16_t((uint16_t(r.payload()[0]) << 8) | r.payload()[1]));
+  return true;
+}
+
+// ---------- Policy ----------
+
+UhfQueryPolicy uhfQueryPolicy(UhfQueryPreset preset) {
+  UhfQueryPolicy p;
+  p.preset      = preset;
+  p.q_start     = 4;
+  p.q_min       = 0;
+  p.q_max       = 9;
+  p.session     = 0;
+  p.dual_target = false;
+  p.adaptive    = true;
+  p.window_ms   = 250;
+  switch (preset) {
+    case UHF_QUERY_FIXED:
+      p.adaptive = false;
+      break;
+    case UHF_QUERY_ENCODE:
+      // One tag: a single slot answers it straight away; a second tag on the
+      // station still gets separated within a few rounds
+      p.q_start = 0; p.q_max = 3; p.window_ms = 200;
+      break;
+    case UHF_QUERY_PORTAL:
+      // Read tags stay quiet in S1 for a while: the weak ones get the slots.
+      // Short windows, since every silent one delays the A/B flip.
+      p.q_start = 6; p.q_min = 2; p.q_max = 9; p.session = 1; p.dual_target = true;
+      p.window_ms = 100;
+      break;
+    default:
+      break;
+  }
+  return p;
+}
+
+const char* uhfQueryPresetName(uint8_t preset) {
+  switch (preset) {
+    case UHF_QUERY_FIXED:  return "FIXED";
+    case UHF_QUERY_AUTO:   return "AUTO";
+    case UHF_QUERY_ENCODE: return "ENCODE";
+    case UHF_QUERY_PORTAL: return "PORTAL";
+    default:               return "?";
+  }
+}
+
+// ---------- Controller ----------
+
+// Linear counting: n = m ln(m / empty bits)
+static uint16_t sketchCount(const uint8_t* bits, uint16_t bytes) {
+  uint32_t zeros = 0;
+  for (uint16_t i = 0; i < bytes; i++) zeros += 8 - __builtin_popcount(bits[i]);
+  const float m = float(bytes) * 8.0f;
+  if (zeros == 0) return uint16_t(m * logf(m));      // saturated
+  return uint16_t(lroundf(m * logf(m / float(zeros))));
+}
+
+UhfQueryController::UhfQueryController(UhfQueryPreset preset) {
+  setPolicy(uhfQueryPolicy(preset));
+}
+
+void UhfQueryController::setPolicy(const UhfQueryPolicy& policy) {
+  policy_ = policy;
+  if (policy_.q_max > 15) policy_.q_max = 15;
+  if (policy_.q_min > policy_.q_max) policy_.q_min = policy_.q_max;
+  if (policy_.q_start < policy_.q_min) policy_.q_start = policy_.q_min;
+  if (policy_.q_start > policy_.q_max) policy_.q_start = policy_.q_max;
+  if (policy_.window_ms == 0) policy_.window_ms = 1;
+  reset(millis());
+}
+
+UhfQueryParams UhfQueryController::startParams() const {
+  UhfQueryParams p = UhfQueryParams::fromWord(UHF_QUERY_DEFAULT_WORD);
+  if (policy_.preset != UHF_QUERY_FIXED) {
+    p.q       = policy_.q_start;
+    p.session = policy_.session & 3;
+    p.target  = 0;
+  }
+  return p;
+}
+
+void UhfQueryController::reset(uint32_t now_ms) {
+  params_ = startParams();
+  memset(&stats_, 0, sizeof(stats_));
+  memset(cur_, 0, sizeof(cur_));
+  memset(prev_, 0, sizeof(prev_));
+  memset(pass_, 0, sizeof(pass_));
+  win_start_ = now_ms;
+  reads_ = 0; rounds_ = 0; empty_rounds_ = 0;
+  silent_ = 0;
+  hold_score_ = 0; hold_windows_ = 0; hold_len_ = HOLD_MIN;
+  probe_from_ = NO_PROBE;
+}
+
+void UhfQueryController::noteRead(const uint8_t* epc, uint8_t len) {
+  const uint32_t bit = uhfEpcHash(epc, len) % UHF_QUERY_SKETCH_BITS;
+  cur_[bit >> 3] |= uint8_t(1u << (bit & 7));
+  if (reads_ < 0xFFFF) reads_++;
+}
+
+void UhfQueryController::noteRound(uint8_t reads) {
+  if (rounds_ < 0xFFFF) rounds_++;
+  if (reads == 0 && empty_rounds_ < 0xFFFF) empty_rounds_++;
+}
+
+// Framed ALOHA, n tags over L slots: a slot reads one tag with probability
+// n/L (1 - 1/L)^(n-1) and stays empty with (1 - 1/L)^n. One slot per tag
+// reads the most tags per slot, but not per second: empty and collided
+// slots cost a fraction of a read and the round set-up is paid once, so a
+// small population wants the larger frame (4 tags: Q 3, 16 tags: Q 5).
+uint8_t UhfQueryController::targetQ(uint16_t population) const {
+  if (population == 0) return policy_.q_min;
+  const float n = float(population);
+  uint8_t best_q = policy_.q_min;
+  float   best   = 0;
+  for (uint8_t q = policy_.q_min; q <= policy_.q_max; q++) {
+    const float slots = float(1u << q);
+    const float keep  = 1.0f - 1.0f / slots;
+    const float p0    = powf(keep, n);
+    const float p1    = n / slots * powf(keep, n - 1.0f);
+    const float air   = UHF_QUERY_ROUND_US + slots * (p0 * UHF_QUERY_EMPTY_SLOT_US +
+                        (1.0f - p0 - p1) * UHF_QUERY_COLLISION_SLOT_US + p1 * UHF_QUERY_READ_SLOT_US);
+    const float rate  = slots * p1 / air;
+    if (rate > best) { best = rate; best_q = q; }
+  }
+  return best_q;
+}
+
+// One step at a time: measure the held Q for hold_len_ windows, try one
+// step for one window, keep it if it read 1/8 more (down: not 1/8 less),
+// else go back and wait twice as long before the next try. Tags read less than twice per window
+// are not getting enough slots: the step goes up. Otherwise it goes down,
+// but not under the floor the population sets: a few tags read many times
+// over would probe into a frame too small for them, and an up probe from
+// the floor only costs two stream restarts.
+void UhfQueryController::hillClimb(uint32_t score, bool undersampled, uint8_t floor_q) {
+  if (probe_from_ != NO_PROBE) {
+    stats_.probes++;
+    // A step up has to pay for its longer rounds; a step down, towards the
+    // population's own Q, only has to not lose
+    const bool down = params_.q < probe_from_;
+    if (down ? score * 8 >= hold_score_ * 7 : score * 8 > hold_score_ * 9) {
+      stats_.probes_kept++;
+      hold_score_ = score;
+      hold_len_   = HOLD_MIN;
+    } else {
+      params_.q = probe_from_;
+      hold_len_ = hold_len_ >= HOLD_MAX / 2 ? HOLD_MAX : uint8_t(hold_len_ * 2);
+    }
+    probe_from_   = NO_PROBE;
+    hold_windows_ = 0;
+    return;
+  }
+  hold_score_ = hold_windows_ ? (hold_score_ * 3 + score) / 4 : score;
+  if (++hold_windows_ < hold_len_) return;
+  const bool up = undersampled;
+  if (up ? params_.q >= policy_.q_max : params_.q <= floor_q) return;
+  probe_from_ = params_.q;
+  params_.q   = uint8_t(up ? params_.q + 1 : params_.q - 1);
+}
+
+bool UhfQueryController::update(uint32_t now_ms) {
+  // At least two rounds at the current Q, so a window is never empty just
+  // because one round has not finished
+  const uint32_t elapsed = now_ms - win_start_;
+  const uint32_t span    = uint32_t(2) << params_.q;
+  if (elapsed < policy_.window_ms || elapsed < span) return false;
+  win_start_ = now_ms;
+
+  uint8_t both[SKETCH_BYTES];
+  for (uint16_t i = 0; i < SKETCH_BYTES; i++) {
+    both[i]   = uint8_t(cur_[i] | prev_[i]);
+    pass_[i] |= cur_[i];
+  }
+  const uint16_t distinct   = sketchCount(cur_, SKETCH_BYTES);
+  const uint16_t population = sketchCount(both, SKETCH_BYTES);
+  memcpy(prev_, cur_, sizeof(prev_));
+  memset(cur_, 0, sizeof(cur_));
+  const uint16_t reads = reads_, rounds = rounds_, empty = empty_rounds_;
+  reads_ = 0; rounds_ = 0; empty_rounds_ = 0;
+
+  stats_.windows++;
+  stats_.last_reads    = reads;
+  stats_.last_distinct = distinct;
+  stats_.population    = population;
+  if (!policy_.adaptive) return false;
+
+  const UhfQueryParams before = params_;
+  const bool dual = policy_.dual_target && params_.session > 0;
+  if (reads == 0) {
+    stats_.silent_windows++;
+    if (silent_ < 0xFF) silent_++;
+    if (probe_from_ != NO_PROBE) {              // the probe read nothing at all
+      params_.q   = probe_from_;
+      probe_from_ = NO_PROBE;
+    } else if (dual && (silent_ & 1)) {
+      // Every tag in the field sits on the other side; the pass just ended
+      // read each of them once
+      const uint16_t pass = sketchCount(pass_, SKETCH_BYTES);
+      if (pass > 0) params_.q = targetQ(pass);
+      memset(pass_, 0, sizeof(pass_));
+      params_.target ^= 1;
+      stats_.target_flips++;
+    } else if (silent_ >= 2) {
+      // Empty field, or every slot collides: probe upwards, wrap to q_start
+      params_.q = params_.q + 2 > policy_.q_max ? policy_.q_start : uint8_t(params_.q + 2);
+    }
+  } else {
+    silent_ = 0;
+    // Tags read twice or more in the window: few were missed, and unlike the
+    // two-window population its distinct count drops tags that left. Three
+    // times or more: the count is exact.
+    const bool sampled = !dual && reads >= uint32_t(distinct) * SAMPLED_READS;
+    const bool exact   = !dual && reads >= uint32_t(distinct) * EXACT_READS;
+    // With dual target, the tags read since the flip are a lower bound too
+    const uint16_t pass  = dual ? sketchCount(pass_, SKETCH_BYTES) : 0;
+    const uint16_t count = sampled ? distinct : (pass > population ? pass : population);
+    uint8_t floor_q = targetQ(count);
+    // An empty single-poll round with tags known: every slot collided
+    if (rounds >= 4 && uint32_t(empty) * 2 > rounds && population > 1 && params_.q < policy_.q_max) {
+      stats_.collision_windows++;
+      if (floor_q <= params_.q) floor_q = uint8_t(params_.q + 1);
+    }
+    if (floor_q > params_.q) {
+      params_.q = floor_q;
+      probe_from_ = NO_PROBE; hold_windows_ = 0; hold_len_ = HOLD_MIN;
+    } else if (!dual) {
+      if (exact) {
+        // So is its Q: nothing to probe, a probe under way is dropped
+        params_.q = floor_q;
+        probe_from_ = NO_PROBE; hold_windows_ = 0;
+      } else {
+        hillClimb(uint32_t(reads) * 1000 / elapsed, !sampled, floor_q);
+      }
+    }
+  }
+  if (params_.word() == before.word()) return false;
+  if (before.q != params_.q) stats_.q_changes++;
+  return true;
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  ---------------------------------------------------------
+  Gen2 query parameters and adaptive anti-collision
+  - 0x0E / 0x0D set and read the Query the module sends at
+    the start of every inventory round: Q (2^Q slots),
+    session, target, Sel, link settings
+  - UhfQueryController watches time windows of reads
+    (streams and single polls alike) and decides between
+    two windows whether Q / target must change
+  - The module does not report collisions or empty slots.
+    They are inferred:
+      population  distinct EPCs over the last two windows
+                  (linear counting on a small bitmap): a
+                  lower bound, Q is raised to it at once
+      collisions  single-poll rounds that came back empty
+                  while tags are known
+      empty field a window without a single read
+  - Q for a population: the frame that reads the most tags
+    per second, from the slot costs below. The round set-up
+    is paid once per round and empty slots are cheap, so a
+    few tags get about 2.5 slots each, hundreds about one.
+  - S0: above that floor, Q hill-climbs on reads/s (probe
+    one step, up when tags are read less than twice per
+    window, keep it if it reads 1/8 more, a step down if it
+    reads no less than 7/8, else back off and probe less
+    often; never below the floor). A population read 4+ times per window is
+    counted exactly: Q drops straight to it.
+  - Sessions 1..3 with dual target: a silent window means
+    every tag sits on the other side, so the target flips
+    and the tags read during that pass size Q for the next
+  - A window lasts at least two rounds (~1 ms per slot)
+  - Presets: AUTO (general), ENCODE (one tag on the
+    station, Q 0..3) and PORTAL (dense, S1 dual target)
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_QUERY_SKETCH_BITS
+#define UHF_QUERY_SKETCH_BITS 512        // linear counting bitmap, per window
+#endif
+// Air time per slot and per round, to size Q. A read slot carries the EPC
+// and its notification on the UART; an empty one is a QueryRep.
+#ifndef UHF_QUERY_READ_SLOT_US
+#define UHF_QUERY_READ_SLOT_US 2500
+#endif
+#ifndef UHF_QUERY_EMPTY_SLOT_US
+#define UHF_QUERY_EMPTY_SLOT_US 250
+#endif
+#ifndef UHF_QUERY_COLLISION_SLOT_US
+#define UHF_QUERY_COLLISION_SLOT_US 600
+#endif
+#ifndef UHF_QUERY_ROUND_US
+#define UHF_QUERY_ROUND_US 4000          // Query, Select, stream bookkeeping
+#endif
+
+// Query fields as the module packs them in one 16-bit word:
+// DR[15] M[14:13] TRext[12] Sel[11:10] Session[9:8] Target[7] Q[6:3]
+struct UhfQueryParams {
+  uint8_t q;          // 0..15
+  uint8_t session;    // 0..3 (S0..S3)
+  uint8_t target;     // 0 = A, 1 = B
+  uint8_t sel;        // 0/1 all tags, 2 ~SL, 3 SL
+  uint8_t dr;         // divide ratio: 0 = 8, 1 = 64/3
+  uint8_t m;          // 0 FM0, 1 Miller 2, 2 Miller 4, 3 Miller 8
+  uint8_t trext;      // 1: pilot tone
+
+  uint16_t word() const {
+    return uint16_t((dr & 1) << 15 | (m & 3) << 13 | (trext & 1) << 12 | (sel & 3) << 10 |
+                    (session & 3) << 8 | (target & 1) << 7 | (q & 15) << 3);
+  }
+  static UhfQueryParams fromWord(uint16_t w) {
+    UhfQueryParams p;
+    p.dr = (w >> 15) & 1; p.m = (w >> 13) & 3; p.trext = (w >> 12) & 1; p.sel = (w >> 10) & 3;
+    p.session = (w >> 8) & 3; p.target = (w >> 7) & 1; p.q = (w >> 3) & 15;
+    return p;
+  }
+};
+
+// Module power-on value: Q 4, S0, target A, Miller 1 (FM0), TRext
+static constexpr uint16_t UHF_QUERY_DEFAULT_WORD = 0x1020;
+
+// 0x0E / 0x0D on the attached transport. Not while a multi-poll stream runs
+// (the pipeline applies its controller's changes between two streams).
+bool uhfSetQueryParams(const UhfQueryParams& p);
+bool uhfGetQueryParams(UhfQueryParams& out);
+
+// ---------- Policy ----------
+enum UhfQueryPreset : uint8_t {
+  UHF_QUERY_FIXED,    // module default, never changed
+  UHF_QUERY_AUTO,     // S0, Q 0..9 from the population
+  UHF_QUERY_ENCODE,   // encode station: one tag expected, Q 0..3
+  UHF_QUERY_PORTAL,   // dense population passing by: S1, dual target, Q 2..9
+  UHF_QUERY_PRESETS
+};
+
+struct UhfQueryPolicy {
+  uint8_t  preset;        // UhfQueryPreset it came from
+  uint8_t  q_start, q_min, q_max;
+  uint8_t  session;
+  bool     dual_target;   // flip A/B on a silent window (session > 0)
+  bool     adaptive;      // false: q_start and target A stay
+  uint16_t window_ms;
+};
+
+UhfQueryPolicy uhfQueryPolicy(UhfQueryPreset preset);
+const char*    uhfQueryPresetName(uint8_t preset);
+
+struct UhfQueryStats {
+  uint32_t windows;
+  uint32_t silent_windows;
+  uint32_t q_changes;
+  uint32_t target_flips;
+  uint32_t collision_windows;   // window judged collision-bound
+  uint32_t probes;              // hill-climb steps tried
+  uint32_t probes_kept;
+  uint16_t last_reads;          // last closed window
+  uint16_t last_distinct;
+  uint16_t population;          // estimate over the last two windows
+};
+
+class UhfQueryController {
+public:
+  explicit UhfQueryController(UhfQueryPreset preset = UHF_QUERY_AUTO);
+
+  // Back to q_start / target A, counters cleared
+  void setPolicy(const UhfQueryPolicy& policy);
+  void reset(uint32_t now_ms);
+
+  // Every tag read, streams and single polls
+  void noteRead(const uint8_t* epc, uint8_t len);
+  // A single-poll round and its tag count (0: the module found nothing)
+  void noteRound(uint8_t reads);
+
+  // Closes the window once window_ms have passed. True when params()
+  // changed: the caller sends them (uhfSetQueryParams) before the next round.
+  bool update(uint32_t now_ms);
+
+  const UhfQueryParams& params() const { return params_; }
+  UhfQueryParams        startParams() const;      // what reset() goes back to
+  const UhfQueryPolicy& policy() const { return policy_; }
+  const UhfQueryStats&  stats() const { return stats_; }
+
+private:
+  static constexpr uint16_t SKETCH_BYTES = UHF_QUERY_SKETCH_BITS / 8;
+  static constexpr uint8_t  NO_PROBE     = 0xFF;
+  static constexpr uint8_t  HOLD_MIN     = 2;     // windows between probes, doubles
+  static constexpr uint8_t  HOLD_MAX     = 32;    // after each probe that lost
+  static constexpr uint8_t  SAMPLED_READS = 2;    // reads per distinct tag in a window
+  static constexpr uint8_t  EXACT_READS   = 3;
+
+  uint8_t targetQ(uint16_t population) const;
+  void    hillClimb(uint32_t score, bool undersampled, uint8_t floor_q);
+
+  UhfQueryPolicy policy_;
+  UhfQueryParams params_;
+  UhfQueryStats  stats_;
+  uint8_t  cur_[SKETCH_BYTES];    // this window
+  uint8_t  prev_[SKETCH_BYTES];   // the one before
+  uint8_t  pass_[SKETCH_BYTES];   // since the last target flip
+  uint32_t win_start_;
+  uint16_t reads_;
+  uint16_t rounds_, empty_rounds_;
+  uint8_t  silent_;               // silent windows in a row
+  // Hill climb (S0)
+  uint32_t hold_score_;           // reads/s at the held Q, smoothed
+  uint8_t  hold_windows_;         // windows measured at the held Q
+  uint8_t  hold_len_;             // windows between two probes
+  uint8_t  probe_from_;           // held Q while probing, NO_PROBE
+};
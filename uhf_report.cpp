@@ -0,0 +1,141 @@
+#include "uhf_report.h"
+
+// CRC-8, poly 0x07, init 0 (flash table: one lookup per byte on the parse task)
+static const uint8_t kCrc8[256] = {
+  0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+  0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+  0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+  0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+  0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+  0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+  0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+  0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+  0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+  0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+  0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+  0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+  0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+  0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+  0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+  0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+uint8_t uhfReportCrc8(const uint8_t* p, size_t n) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < n; i++) crc = kCrc8[crc ^ p[i]];
+  return crc;
+}
+
+size_t uhfCobsEncode(const uint8_t* in, size_t n, uint8_t* out) {
+  size_t code_at = 0, o = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < n; i++) {
+    if (in[i] == 0) {
+      out[code_at] = code;
+      code_at = o++;
+      code = 1;
+      continue;
+    }
+    out[o++] = in[i];
+    if (++code == 0xFF) {
+      out[code_at] = code;
+      code_at = o++;
+      code = 1;
+    }
+  }
+  out[code_at] = code;
+  out[o++] = 0x00;
+  return o;
+}
+
+size_t uhfCobsDecode(const uint8_t* in, size_t n, uint8_t* out, size_t cap) {
+  size_t i = 0, o = 0;
+  while (i < n) {
+    const uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > n) return 0;
+    for (uint8_t k = 1; k < code; k++) {
+      if (o == cap) return 0;
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < n) {
+      if (o == cap) return 0;
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+size_t uhfReportEncode(const UhfTagRecord& r, uint8_t* out) {
+  if (r.epc_len > EPC_MAX_BYTES) return 0;
+  uint8_t raw[UHF_REPORT_MAX_RAW];
+  size_t n = 0;
+  raw[n++] = UHF_REPORT_TAG;
+  raw[n++] = uint8_t(r.seq);       raw[n++] = uint8_t(r.seq >> 8);
+  raw[n++] = uint8_t(r.t_ms);      raw[n++] = uint8_t(r.t_ms >> 8);
+  raw[n++] = uint8_t(r.t_ms >> 16); raw[n++] = uint8_t(r.t_ms >> 24);
+  raw[n++] = uint8_t(r.rssi_dbm);
+  raw[n++] = r.antenna;
+  raw[n++] = r.phase;
+  raw[n++] = r.has_tid ? UHF_REPORT_FLAG_TID : 0;
+  raw[n++] = r.epc_len;
+  memcpy(&raw[n], r.epc, r.epc_len); n += r.epc_len;
+  if (r.has_tid) { memcpy(&raw[n], r.tid, 8); n += 8; }
+  raw[n] = uhfReportCrc8(raw, n); n++;
+  out[0] = 0x00;
+  return 1 + uhfCobsEncode(raw, n, out + 1);
+}
+
+void UhfReportDecoder::reset() {
+  len_ = 0;
+  overflow_ = false;
+  have_seq_ = false;
+  next_seq_ = 0;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool UhfReportDecoder::push(uint8_t b, UhfTagRecord& out) {
+  if (b != 0x00) {
+    if (len_ == sizeof(buf_)) {
+      if (!overflow_) stats_.oversize++;
+      overflow_ = true;          // text or garbage: wait for the next delimiter
+      return false;
+    }
+    buf_[len_++] = b;
+    return false;
+  }
+  const bool ok = !overflow_ && len_ > 0 && decode(out);
+  len_ = 0;
+  overflow_ = false;
+  return ok;
+}
+
+bool UhfReportDecoder::decode(UhfTagRecord& out) {
+  uint8_t raw[UHF_REPORT_MAX_RAW];
+  const size_t n = uhfCobsDecode(buf_, len_, raw, sizeof(raw));
+  if (n == 0) { stats_.bad_cobs++; return false; }
+  if (n < UHF_REPORT_HEADER + 1) { stats_.bad_layout++; return false; }
+  if (uhfReportCrc8(raw, n - 1) != raw[n - 1]) { stats_.bad_crc++; return false; }
+
+  const bool has_tid = raw[10] & UHF_REPORT_FLAG_TID;
+  const uint8_t epc_len = raw[11];
+  if (raw[0] != UHF_REPORT_TAG || epc_len > EPC_MAX_BYTES ||
+      n != UHF_REPORT_HEADER + epc_len + (has_tid ? 8 : 0) + 1) {
+    stats_.bad_layout++;
+    return false;
+  }
+  out.seq      = uint16_t(raw[1] | (raw[2] << 8));
+  out.t_ms     = uint32_t(raw[3]) | (uint32_t(raw[4]) << 8) | (uint32_t(raw[5]) << 16) | (uint32_t(raw[6]) << 24);
+  out.rssi_dbm = int8_t(raw[7]);
+  out.antenna  = raw[8];
+  out.phase    = raw[9];
+  out.has_tid  = has_tid;
+  out.epc_len  = epc_len;
+  memcpy(out.epc, &raw[UHF_REPORT_HEADER], epc_len);
+  if (has_tid) memcpy(out.tid, &raw[UHF_REPORT_HEADER + epc_len], 8);
+
+  if (have_seq_) stats_.lost += uint16_t(out.seq - next_seq_);
+  have_seq_ = true;
+  next_seq_ = uint16_t(out.seq + 1);
+  stats_.records++;
+  return true;
+}
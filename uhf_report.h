@@ -0,0 +1,110 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+
+/*
+  ---------------------------------------------------------
+  Binary tag report stream (serial console, host collector)
+  - One record per tag read, COBS-framed: frames start and
+    end with a 0x00 byte and contain none, so a text line
+    printed in between is rejected on its own and never
+    takes the following record with it
+  - Record (little-endian), then CRC-8 (poly 0x07) of it:
+      0  type         UHF_REPORT_TAG
+      1  seq     u16  +1 per record written (gaps = losses)
+      3  t_ms    u32  millis() of the read
+      7  rssi    i8   dBm
+      8  antenna u8
+      9  phase   u8
+      10 flags   u8   bit 0: TID present
+      11 epc_len u8
+      12 epc[epc_len], then tid[8] if flagged
+  - Encoder and decoder are plain C++: the decoder builds
+    on Linux for the collector (host/report_decode)
+  ---------------------------------------------------------
+*/
+
+static constexpr uint8_t UHF_REPORT_TAG       = 0x01;
+static constexpr uint8_t UHF_REPORT_FLAG_TID  = 0x01;
+static constexpr size_t  UHF_REPORT_HEADER    = 12;
+static constexpr size_t  UHF_REPORT_MAX_RAW   = UHF_REPORT_HEADER + EPC_MAX_BYTES + 8 + 1;
+// COBS adds one byte per 254 (one here), plus the two 0x00 delimiters
+static constexpr size_t  UHF_REPORT_MAX_FRAME = UHF_REPORT_MAX_RAW + 3;
+
+struct UhfTagRecord {
+  uint16_t seq;
+  uint32_t t_ms;
+  int8_t   rssi_dbm;
+  uint8_t  antenna;
+  uint8_t  phase;
+  bool     has_tid;
+  uint8_t  epc_len;
+  uint8_t  epc[EPC_MAX_BYTES];
+  uint8_t  tid[8];
+};
+
+uint8_t uhfReportCrc8(const uint8_t* p, size_t n);
+
+// COBS-encodes n bytes into out (needs n + n/254 + 2), delimiter included.
+// Returns the frame length.
+size_t uhfCobsEncode(const uint8_t* in, size_t n, uint8_t* out);
+
+// Decodes one frame without its delimiter; 0 if malformed or > cap
+size_t uhfCobsDecode(const uint8_t* in, size_t n, uint8_t* out, size_t cap);
+
+// Record -> 0x00, COBS bytes, 0x00 (out: UHF_REPORT_MAX_FRAME); 0 if the EPC is too long
+size_t uhfReportEncode(const UhfTagRecord& r, uint8_t* out);
+
+// Numbers records and frames them
+class UhfReportWriter {
+public:
+  UhfReportWriter() : seq_(0) {}
+
+  size_t frame(const RawTagData& tag, const uint8_t* tid, uint32_t t_ms, uint8_t* out) {
+    UhfTagRecord r;
+    r.seq      = seq_++;
+    r.t_ms     = t_ms;
+    r.rssi_dbm = tag.rssi_dbm;
+    r.antenna  = tag.antenna;
+    r.phase    = tag.phase;
+    r.has_tid  = tid != nullptr;
+    r.epc_len  = tag.epc_len;
+    memcpy(r.epc, tag.epc_raw, tag.epc_len);
+    if (tid) memcpy(r.tid, tid, 8);
+    return uhfReportEncode(r, out);
+  }
+  void reset() { seq_ = 0; }
+
+private:
+  uint16_t seq_;
+};
+
+struct UhfReportDecoderStats {
+  uint32_t records;
+  uint32_t lost;            // records missing according to seq
+  uint32_t bad_cobs;
+  uint32_t bad_crc;
+  uint32_t bad_layout;      // unknown type, lengths that do not add up
+  uint32_t oversize;        // no delimiter within a frame's worth of bytes
+};
+
+// Byte-at-a-time decoder: push() returns true when `out` holds a record
+class UhfReportDecoder {
+public:
+  UhfReportDecoder() { reset(); }
+
+  void reset();
+  bool push(uint8_t b, UhfTagRecord& out);
+
+  const UhfReportDecoderStats& stats() const { return stats_; }
+
+private:
+  bool decode(UhfTagRecord& out);
+
+  uint8_t  buf_[UHF_REPORT_MAX_FRAME];
+  size_t   len_;
+  bool     overflow_;
+  bool     have_seq_;
+  uint16_t next_seq_;
+  UhfReportDecoderStats stats_;
+};
@@ -0,0 +1,146 @@
+#include "uhf_rssi.h"
+#include <math.h>
+
+#if defined(ARDUINO)
+#include <Preferences.h>
+#endif
+
+static constexpr UhfRssiTable kLinear       = uhfRssiFormulaTable(RSSI_LINEAR);
+static constexpr UhfRssiTable kCurved       = uhfRssiFormulaTable(RSSI_CURVED);
+static constexpr UhfRssiTable kCustomDefault = uhfRssiFormulaTable(RSSI_CUSTOM);
+
+static_assert(kLinear.dbm[0] == -95 && kLinear.dbm[255] == -10, "LINEAR spans -95..-10 dBm");
+static_assert(kCurved.dbm[0] == -95 && kCurved.dbm[200] == -30 && kCurved.dbm[255] == -10,
+              "CURVED keeps its -95 / -30 / -10 dBm knots");
+
+static UhfRssiTable custom_table = kCustomDefault;
+
+const int8_t* const _uhf_rssi_tables[RSSI_PROFILE_COUNT] = {kLinear.dbm, kCurved.dbm, custom_table.dbm};
+volatile RssiProfile _uhf_rssi_profile = RSSI_CURVED;
+
+void uhfRssiSetProfile(RssiProfile p) {
+  if (p < RSSI_PROFILE_COUNT) _uhf_rssi_profile = p;
+}
+
+RssiProfile uhfRssiProfile() { return _uhf_rssi_profile; }
+
+void uhfRssiSetCustomTable(const int8_t table[256]) {
+  memcpy(custom_table.dbm, table, sizeof(custom_table.dbm));
+  _uhf_rssi_profile = RSSI_CUSTOM;
+}
+
+void uhfRssiResetCustomTable() {
+  custom_table = kCustomDefault;
+  _uhf_rssi_profile = RSSI_CURVED;
+}
+
+// ---------- Calibration ----------
+
+int8_t UhfRssiCalibration::modelDbm(uint16_t distance_cm) {
+  const float d = float(distance_cm) / 100.0f;
+  const float dbm = float(UHF_RSSI_CAL_REF_DBM) - float(UHF_RSSI_CAL_PATH_LOSS_X10) * log10f(d);
+  return int8_t(_uhfClampDbm(int16_t(lroundf(dbm))));
+}
+
+bool UhfRssiCalibration::addPoint(uint16_t distance_cm, const uint8_t* raw, size_t n) {
+  if (distance_cm == 0 || !raw || n == 0) return false;
+  uint8_t i = 0;
+  while (i < n_ && pts_[i].distance_cm != distance_cm) i++;
+  if (i == n_) {
+    if (n_ == UHF_RSSI_CAL_POINTS) return false;
+    n_++;
+  }
+
+  // Median by counting: raw bytes only take 256 values
+  uint16_t hist[256] = {0};
+  for (size_t k = 0; k < n; k++) hist[raw[k]]++;
+  size_t seen = 0;
+  uint16_t v = 0;
+  for (; v < 255; v++) {
+    seen += hist[v];
+    if (seen * 2 > n) break;
+  }
+
+  pts_[i].distance_cm = distance_cm;
+  pts_[i].raw         = uint8_t(v);
+  pts_[i].dbm         = modelDbm(distance_cm);
+  return true;
+}
+
+bool UhfRssiCalibration::build(int8_t out[256]) const {
+  // Sorted by raw byte; points sharing a byte are averaged
+  struct Knot { int16_t raw, dbm; };
+  Knot k[UHF_RSSI_CAL_POINTS];
+  uint8_t m = 0;
+  UhfRssiCalPoint p[UHF_RSSI_CAL_POINTS];
+  memcpy(p, pts_, n_ * sizeof(p[0]));
+  for (uint8_t i = 1; i < n_; i++) {
+    for (uint8_t j = i; j > 0 && p[j].raw < p[j - 1].raw; j--) {
+      const UhfRssiCalPoint t = p[j]; p[j] = p[j - 1]; p[j - 1] = t;
+    }
+  }
+  for (uint8_t i = 0; i < n_; ) {
+    uint8_t j = i;
+    int16_t sum = 0;
+    while (j < n_ && p[j].raw == p[i].raw) sum = int16_t(sum + p[j++].dbm);
+    k[m].raw = p[i].raw;
+    k[m].dbm = int16_t(sum / (j - i));
+    m++;
+    i = j;
+  }
+  if (m < 2) return false;
+  for (uint8_t i = 1; i < m; i++) {
+    if (k[i].dbm <= k[i - 1].dbm) return false;     // stronger byte, not a closer tag
+  }
+
+  uint8_t seg = 0;
+  for (int16_t v = 0; v < 256; v++) {
+    while (seg + 2 < m && v > k[seg + 1].raw) seg++;
+    const Knot& a = k[seg];
+    const Knot& b = k[seg + 1];
+    const int32_t num = int32_t(v - a.raw) * (b.dbm - a.dbm);
+    const int32_t den = b.raw - a.raw;
+    // Rounded to nearest, also for negative offsets below the first knot
+    const int32_t step = (num >= 0 ? num + den / 2 : num - den / 2) / den;
+    out[v] = int8_t(_uhfClampDbm(int16_t(a.dbm + step)));
+  }
+  return true;
+}
+
+// ---------- NVS ----------
+
+#if defined(ARDUINO)
+static constexpr uint8_t kNvsVersion = 1;
+
+bool uhfRssiSaveCalibration() {
+  Preferences prefs;
+  if (!prefs.begin("uhf_rssi", false)) return false;
+  const bool ok = prefs.putUChar("version", kNvsVersion) == 1 &&
+                  prefs.putBytes("table", custom_table.dbm, sizeof(custom_table.dbm)) == sizeof(custom_table.dbm);
+  prefs.end();
+  return ok;
+}
+
+bool uhfRssiLoadCalibration() {
+  Preferences prefs;
+  if (!prefs.begin("uhf_rssi", true)) return false;
+  int8_t table[256];
+  const bool ok = prefs.getUChar("version", 0) == kNvsVersion &&
+                  prefs.getBytes("table", table, sizeof(table)) == sizeof(table);
+  prefs.end();
+  if (ok) uhfRssiSetCustomTable(table);
+  return ok;
+}
+
+bool uhfRssiEraseCalibration() {
+  Preferences prefs;
+  if (!prefs.begin("uhf_rssi", false)) return false;
+  const bool ok = prefs.clear();
+  prefs.end();
+  return ok;
+}
+#else
+bool uhfRssiSaveCalibration()  { return false; }
+bool uhfRssiLoadCalibration()  { return false; }
+bool uhfRssiEraseCalibration() { return false; }
+#endif
@@ -0,0 +1,152 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  ---------------------------------------------------------
+  RSSI byte -> dBm, calibration and per-tag smoothing
+  - One 256-entry table per profile: conversion is a single
+    load. LINEAR and CURVED are built at compile time from
+    the original piecewise formulas (flash)
+  - RSSI_CUSTOM lives in RAM: the constexpr default until a
+    field calibration replaces it (stored in NVS, loaded at
+    boot by uhfRssiLoadCalibration)
+  - Calibration: median raw byte of a tag at a few known
+    distances, mapped to a log-distance path loss model and
+    interpolated over the 256 bytes
+  - UhfRssiFilter: median of 3 then EWMA, in 1/16 dBm
+    integers, so a ranking by strength does not jitter
+  ---------------------------------------------------------
+*/
+
+enum RssiProfile : uint8_t { RSSI_LINEAR, RSSI_CURVED, RSSI_CUSTOM };
+static constexpr uint8_t RSSI_PROFILE_COUNT = 3;
+
+// ---------- Formulas (compile time only) ----------
+constexpr int16_t _uhfClampDbm(int16_t d) { return d > -5 ? int16_t(-5) : d < -100 ? int16_t(-100) : d; }
+
+constexpr int16_t _uhfRssiFormula(RssiProfile p, int16_t v) {
+  return _uhfClampDbm(
+    p == RSSI_LINEAR ? int16_t(-95 + (v * 85) / 255) :
+    p == RSSI_CURVED ? (v > 200 ? int16_t(-10 - ((255 - v) * 20) / 55)     // -10..-30
+                      : v > 100 ? int16_t(-30 - ((200 - v) * 40) / 100)    // -30..-70
+                      :           int16_t(-70 - ((100 - v) * 25) / 100))   // -70..-95
+                     : int16_t(-50 - ((255 - v) * 45) / 255));             // uncalibrated custom
+}
+
+struct UhfRssiTable { int8_t dbm[256]; };
+
+template <size_t... I> struct _UhfIndexSeq {};
+template <size_t N, size_t... I> struct _UhfMakeSeq : _UhfMakeSeq<N - 1, N - 1, I...> {};
+template <size_t... I> struct _UhfMakeSeq<0, I...> { typedef _UhfIndexSeq<I...> type; };
+
+template <size_t... I>
+constexpr UhfRssiTable _uhfRssiBuild(RssiProfile p, _UhfIndexSeq<I...>) {
+  return UhfRssiTable{{ int8_t(_uhfRssiFormula(p, int16_t(I)))... }};
+}
+constexpr UhfRssiTable uhfRssiFormulaTable(RssiProfile p) {
+  return _uhfRssiBuild(p, _UhfMakeSeq<256>::type());
+}
+
+// ---------- Conversion ----------
+// Tables indexed by RssiProfile; the RSSI_CUSTOM one is the RAM copy
+extern const int8_t* const _uhf_rssi_tables[RSSI_PROFILE_COUNT];
+extern volatile RssiProfile _uhf_rssi_profile;
+
+static inline int8_t _rssibyte_to_dbm(uint8_t v, RssiProfile profile) {
+  return _uhf_rssi_tables[profile][v];
+}
+// Active profile (CURVED unless a calibration was loaded)
+static inline int8_t _rssibyte_to_dbm(uint8_t v) {
+  return _uhf_rssi_tables[_uhf_rssi_profile][v];
+}
+
+void        uhfRssiSetProfile(RssiProfile p);
+RssiProfile uhfRssiProfile();
+
+// ---------- Calibration ----------
+#ifndef UHF_RSSI_CAL_POINTS
+#define UHF_RSSI_CAL_POINTS 8
+#endif
+// Path loss model: dBm(d) = REF_DBM - 10 * n * log10(d / 1 m), n = PATH_LOSS_X10 / 10
+#ifndef UHF_RSSI_CAL_REF_DBM
+#define UHF_RSSI_CAL_REF_DBM -45
+#endif
+#ifndef UHF_RSSI_CAL_PATH_LOSS_X10
+#define UHF_RSSI_CAL_PATH_LOSS_X10 20
+#endif
+
+struct UhfRssiCalPoint {
+  uint16_t distance_cm;
+  uint8_t  raw;           // median RSSI byte at that distance
+  int8_t   dbm;           // model value for the distance
+};
+
+// Collects points, builds the custom table. Not thread-safe: calibrate with
+// continuous mode stopped.
+class UhfRssiCalibration {
+public:
+  UhfRssiCalibration() : n_(0) {}
+
+  // Median of `n` raw bytes read at `distance_cm`. Replaces a point at the
+  // same distance. False if full, n == 0 or distance 0.
+  bool addPoint(uint16_t distance_cm, const uint8_t* raw, size_t n);
+  void clear() { n_ = 0; }
+
+  uint8_t                size() const { return n_; }
+  const UhfRssiCalPoint& point(uint8_t i) const { return pts_[i]; }
+
+  // Piecewise-linear table through the points (sorted by raw byte), the end
+  // segments extended, clamped to -100..-5 dBm. False with fewer than two
+  // distinct raw bytes or when a closer tag read weaker (not monotonic).
+  bool build(int8_t out[256]) const;
+
+  static int8_t modelDbm(uint16_t distance_cm);
+
+private:
+  UhfRssiCalPoint pts_[UHF_RSSI_CAL_POINTS];
+  uint8_t         n_;
+};
+
+// Installs a table as RSSI_CUSTOM and makes it the active profile
+void uhfRssiSetCustomTable(const int8_t table[256]);
+// Back to the constexpr custom default and the CURVED profile
+void uhfRssiResetCustomTable();
+
+// NVS ("uhf_rssi" namespace) on the ESP32; false elsewhere. Load installs
+// the stored table (uhfRssiSetCustomTable) when there is one.
+bool uhfRssiSaveCalibration();
+bool uhfRssiLoadCalibration();
+bool uhfRssiEraseCalibration();
+
+// ---------- Smoothing ----------
+#ifndef UHF_RSSI_EWMA_SHIFT
+#define UHF_RSSI_EWMA_SHIFT 2            // weight of a new sample: 1/4
+#endif
+
+struct UhfRssiFilter {
+  int16_t q4;             // smoothed dBm x 16
+  int8_t  hist[3];        // last samples, for the median
+  uint8_t count;          // samples seen, saturates at 3
+  uint8_t at;             // next hist slot
+
+  void reset() { q4 = 0; count = 0; at = 0; }
+
+  void add(int8_t dbm) {
+    hist[at] = dbm;
+    at = at == 2 ? 0 : uint8_t(at + 1);
+    if (count < 3) count++;
+    const int16_t target = int16_t(median() * 16);
+    if (count == 1) q4 = target;
+    else            q4 = int16_t(q4 + (target - q4) / (1 << UHF_RSSI_EWMA_SHIFT));
+  }
+
+  // Rounded dBm, 0 before the first sample
+  int8_t dbm() const { return count ? int8_t((q4 + (q4 < 0 ? -8 : 8)) / 16) : 0; }
+
+private:
+  int8_t median() const {
+    if (count < 3) return hist[at == 0 ? 2 : at - 1];     // newest
+    const int8_t a = hist[0], b = hist[1], c = hist[2];
+    return a > b ? (b > c ? b : a > c ? c : a) : (a > c ? a : b > c ? c : b);
+  }
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+/*
+  ---------------------------------------------------------
+  Single-producer / single-consumer lock-free ring
+  - Fixed capacity (power of two), no allocation
+  - head_ is written by the producer only, tail_ by the
+    consumer only; acquire/release ordering publishes the
+    slot contents with the index
+  - push()/pop() never block: a full ring is reported to the
+    producer, which decides between back-pressure and drop
+  ---------------------------------------------------------
+*/
+
+template <typename T, uint32_t Capacity>
+class UhfSpscRing {
+public:
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  UhfSpscRing() : head_(0), tail_(0), high_water_(0) {}
+
+  // ---- Producer side ----
+  bool push(const T& v) {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    const uint32_t used = h - tail_.load(std::memory_order_acquire);
+    if (used == Capacity) return false;
+    buf_[h & MASK] = v;
+    head_.store(h + 1, std::memory_order_release);
+    noteFill(used + 1);
+    return true;
+  }
+
+  // Copies as many of n items as fit, returns how many
+  uint32_t pushSome(const T* v, uint32_t n) {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    const uint32_t used = h - tail_.load(std::memory_order_acquire);
+    if (n > Capacity - used) n = Capacity - used;
+    for (uint32_t i = 0; i < n; i++) buf_[(h + i) & MASK] = v[i];
+    head_.store(h + n, std::memory_order_release);
+    noteFill(used + n);
+    return n;
+  }
+
+  uint32_t freeSpace() const {
+    return Capacity - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+  }
+
+  // ---- Consumer side ----
+  bool pop(T& out) {
+    const uint32_t t = tail_.load(std::memory_order_relaxed);
+    if (t == head_.load(std::memory_order_acquire)) return false;
+    out = buf_[t & MASK];
+    tail_.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t popSome(T* out, uint32_t n) {
+    const uint32_t t = tail_.load(std::memory_order_relaxed);
+    const uint32_t avail = head_.load(std::memory_order_acquire) - t;
+    if (n > avail) n = avail;
+    for (uint32_t i = 0; i < n; i++) out[i] = buf_[(t + i) & MASK];
+    tail_.store(t + n, std::memory_order_release);
+    return n;
+  }
+
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+  }
+
+  // Drops everything; only safe while the producer is idle
+  void reset() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+  static constexpr uint32_t capacity() { return Capacity; }
+  uint32_t highWater() const { return high_water_.load(std::memory_order_relaxed); }
+
+private:
+  static constexpr uint32_t MASK = Capacity - 1;
+
+  void noteFill(uint32_t used) {
+    if (used > high_water_.load(std::memory_order_relaxed))
+      high_water_.store(used, std::memory_order_relaxed);
+  }
+
+  T buf_[Capacity];
+  std::atomic<uint32_t> head_;
+  std::atomic<uint32_t> tail_;
+  std::atomic<uint32_t> high_water_;   // written by the producer only
+};
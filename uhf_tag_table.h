@@ -0,0 +1,259 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+
+/*
+  ---------------------------------------------------------
+  Tag table for continuous inventory
+  - Fixed pool of Capacity entries: no allocation after
+    construction, entry indices stay stable while a tag is
+    present (usable as a handle for TID reads / display)
+  - Open addressing, linear probing, load factor <= 1/2,
+    keyed by EPC bytes; the FNV-1a hash is kept in the entry
+    so probes compare 32 bits before touching the EPC and
+    deletion (backward shift) never rehashes
+  - Intrusive doubly linked list ordered by last sighting:
+    a refresh moves the entry to the tail, expiry pops from
+    the head, and a full table evicts the stalest tag
+    instead of dropping the new one
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_TAG_TABLE_CAPACITY
+#define UHF_TAG_TABLE_CAPACITY 1024
+#endif
+
+// FNV-1a over the EPC bytes
+inline uint32_t uhfEpcHash(const uint8_t* epc, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) { h ^= epc[i]; h *= 16777619u; }
+  return h;
+}
+
+constexpr uint32_t _uhfCeilPow2(uint32_t v, uint32_t p = 1) {
+  return p >= v ? p : _uhfCeilPow2(v, p << 1);
+}
+
+struct UhfTagEntry {
+  uint8_t  epc[EPC_MAX_BYTES];
+  uint8_t  epc_len;
+  uint8_t  tid[8];
+  bool     has_tid;
+  bool     is_new;        // not displayed yet
+  bool     used;
+  int16_t  rssi;          // dBm, smoothed (rssi_f) where readings are fed, else last one
+  UhfRssiFilter rssi_f;   // fed by the parser for each non-zero reading
+  uint32_t first_seen;    // millis()
+  uint32_t last_seen;
+  uint32_t reads;
+  uint32_t hash;          // uhfEpcHash(epc, epc_len)
+  uint16_t prev, next;    // age list (next doubles as free-list link)
+};
+
+struct UhfTagTableStats {
+  uint32_t inserts;
+  uint32_t evictions;     // stalest tag dropped to make room
+  uint32_t expired;
+  uint32_t lookups;
+  uint32_t probes;        // buckets visited by all lookups
+  uint16_t max_probe;
+};
+
+template <uint16_t Capacity>
+class UhfTagTable {
+public:
+  static constexpr uint16_t NONE = 0xFFFF;
+
+  UhfTagTable() { clear(); }
+
+  void clear() {
+    for (uint32_t b = 0; b < BUCKETS; b++) buckets_[b] = NONE;
+    for (uint16_t i = 0; i < Capacity; i++) {
+      entries_[i].used = false;
+      entries_[i].next = (i + 1 < Capacity) ? uint16_t(i + 1) : NONE;
+    }
+    free_ = 0;
+    oldest_ = newest_ = NONE;
+    size_ = 0;
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  // Index of the entry holding this EPC, or NONE
+  uint16_t find(const uint8_t* epc, uint8_t len, uint32_t hash) {
+    uint32_t b;
+    return lookup(epc, len, hash, &b);
+  }
+  uint16_t find(const uint8_t* epc, uint8_t len) { return find(epc, len, uhfEpcHash(epc, len)); }
+
+  // Refresh a known tag or insert a new one (evicting the stalest if full).
+  // Returns the entry index; *is_new tells which case happened.
+  uint16_t upsert(const uint8_t* epc, uint8_t len, uint32_t hash, uint32_t now, bool* is_new) {
+    if (len > EPC_MAX_BYTES) { len = EPC_MAX_BYTES; hash = uhfEpcHash(epc, len); }
+    uint32_t b;
+    uint16_t i = lookup(epc, len, hash, &b);
+    if (i != NONE) {
+      UhfTagEntry& e = entries_[i];
+      e.last_seen = now;
+      e.reads++;
+      unlinkAge(i);
+      linkNewest(i);
+      if (is_new) *is_new = false;
+      return i;
+    }
+
+    if (free_ == NONE) {
+      remove(oldest_);
+      stats_.evictions++;
+      lookup(epc, len, hash, &b);   // backward shift may have moved the free bucket
+    }
+    i = free_;
+    UhfTagEntry& e = entries_[i];
+    free_ = e.next;
+
+    memcpy(e.epc, epc, len);
+    e.epc_len    = len;
+    e.has_tid    = false;
+    e.is_new     = true;
+    e.used       = true;
+    e.rssi       = 0;
+    e.rssi_f.reset();
+    e.first_seen = now;
+    e.last_seen  = now;
+    e.reads      = 1;
+    e.hash       = hash;
+    buckets_[b] = i;
+    linkNewest(i);
+    size_++;
+    stats_.inserts++;
+    if (is_new) *is_new = true;
+    return i;
+  }
+  uint16_t upsert(const uint8_t* epc, uint8_t len, uint32_t now, bool* is_new) {
+    return upsert(epc, len, uhfEpcHash(epc, len), now, is_new);
+  }
+
+  void remove(uint16_t i) {
+    if (i >= Capacity || !entries_[i].used) return;
+    eraseBucket(i);
+    unlinkAge(i);
+    entries_[i].used = false;
+    entries_[i].next = free_;
+    free_ = i;
+    size_--;
+  }
+
+  // Drop every tag not seen for max_age_ms; stops at the first fresh one.
+  // on_expire(const UhfTagEntry&) is called before each removal.
+  template <typename F>
+  uint16_t expire(uint32_t now, uint32_t max_age_ms, F on_expire) {
+    uint16_t n = 0;
+    while (oldest_ != NONE && now - entries_[oldest_].last_seen >= max_age_ms) {
+      on_expire(entries_[oldest_]);
+      remove(oldest_);
+      n++;
+    }
+    stats_.expired += n;
+    return n;
+  }
+  uint16_t expire(uint32_t now, uint32_t max_age_ms) {
+    return expire(now, max_age_ms, [](const UhfTagEntry&) {});
+  }
+
+  uint16_t size() const { return size_; }
+  bool     full() const { return free_ == NONE; }
+  static constexpr uint16_t capacity() { return Capacity; }
+
+  // Iteration: by index (stable slots) or by age (oldest -> newest)
+  bool               used(uint16_t i) const { return entries_[i].used; }
+  UhfTagEntry&       at(uint16_t i) { return entries_[i]; }
+  const UhfTagEntry& at(uint16_t i) const { return entries_[i]; }
+  uint16_t           oldest() const { return oldest_; }
+  uint16_t           newer(uint16_t i) const { return entries_[i].next; }
+
+  const UhfTagTableStats& stats() const { return stats_; }
+  void resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+private:
+  static constexpr uint32_t BUCKETS = _uhfCeilPow2(uint32_t(Capacity) * 2);
+  static constexpr uint32_t MASK    = BUCKETS - 1;
+  static_assert(Capacity > 0 && Capacity <= 16384, "Capacity must fit 16-bit indices at load 1/2");
+
+  // Returns the entry index or NONE; *bucket is where it is / would go
+  uint16_t lookup(const uint8_t* epc, uint8_t len, uint32_t hash, uint32_t* bucket) {
+    uint32_t b = hash & MASK;
+    uint16_t probe = 1;
+    for (;; b = (b + 1) & MASK, probe++) {
+      const uint16_t i = buckets_[b];
+      if (i == NONE) break;
+      const UhfTagEntry& e = entries_[i];
+      if (e.hash == hash && e.epc_len == len && memcmp(e.epc, epc, len) == 0) break;
+    }
+    stats_.lookups++;
+    stats_.probes += probe;
+    if (probe > stats_.max_probe) stats_.max_probe = probe;
+    *bucket = b;
+    return buckets_[b];
+  }
+
+  // Backward-shift deletion: keeps probe chains intact without tombstones
+  void eraseBucket(uint16_t i) {
+    uint32_t b = entries_[i].hash & MASK;
+    while (buckets_[b] != i) b = (b + 1) & MASK;
+    for (;;) {
+      buckets_[b] = NONE;
+      uint32_t j = b;
+      for (;;) {
+        j = (j + 1) & MASK;
+        const uint16_t k = buckets_[j];
+        if (k == NONE) return;
+        const uint32_t home = entries_[k].hash & MASK;
+        // k may fill the hole unless its home lies cyclically in (b, j]
+        const bool stays = (b < j) ? (home > b && home <= j) : (home > b || home <= j);
+        if (!stays) { buckets_[b] = k; b = j; break; }
+      }
+    }
+  }
+
+  void unlinkAge(uint16_t i) {
+    UhfTagEntry& e = entries_[i];
+    if (e.prev != NONE) entries_[e.prev].next = e.next; else oldest_ = e.next;
+    if (e.next != NONE) entries_[e.next].prev = e.prev; else newest_ = e.prev;
+  }
+
+  void linkNewest(uint16_t i) {
+    UhfTagEntry& e = entries_[i];
+    e.prev = newest_;
+    e.next = NONE;
+    if (newest_ != NONE) entries_[newest_].next = i; else oldest_ = i;
+    newest_ = i;
+  }
+
+  UhfTagEntry entries_[Capacity];
+  uint16_t    buckets_[BUCKETS];
+  uint16_t    free_;
+  uint16_t    oldest_, newest_;
+  uint16_t    size_;
+  UhfTagTableStats stats_;
+};
+
+// Tag with the strongest RSSI (0 = no reading, skipped), or NONE. `current`
+// stays the pick unless another tag beats it by more than margin_db, so two
+// tags at about the same distance do not take turns.
+template <uint16_t Capacity>
+uint16_t uhfNearestTag(const UhfTagTable<Capacity>& t, uint16_t current, int16_t margin_db) {
+  const uint16_t NONE = UhfTagTable<Capacity>::NONE;
+  uint16_t best = NONE;
+  for (uint16_t i = t.oldest(); i != NONE; i = t.newer(i)) {
+    const int16_t r = t.at(i).rssi;
+    if (r != 0 && (best == NONE || r > t.at(best).rssi)) best = i;
+  }
+  if (current < Capacity && t.used(current) && t.at(current).rssi != 0 && best != NONE &&
+      t.at(best).rssi - t.at(current).rssi <= margin_db) {
+    return current;
+  }
+  return best;
+}
+
+template <uint16_t Capacity> constexpr uint16_t UhfTagTable<Capacity>::NONE;
+template <uint16_t Capacity> constexpr uint32_t UhfTagTable<Capacity>::BUCKETS;
+template <uint16_t Capacity> constexpr uint32_t UhfTagTable<Capacity>::MASK;
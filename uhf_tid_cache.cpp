@@ -0,0 +1,238 @@
+#include "uhf_tid_cache.h"
+
+#if defined(ARDUINO)
+#include <Preferences.h>
+#endif
+
+// Image: "TC" magic, version, reserved, then one RECORD_BYTES record per entry
+static constexpr uint8_t kImageVersion = 1;
+static constexpr uint8_t kNvsVersion   = 1;
+
+// FNV-1a (the tag table's hash) in the high half, Jenkins one-at-a-time in
+// the low half: two EPCs would have to collide in both to share an entry
+uint64_t uhfTidCacheKey(const uint8_t* epc, uint8_t len) {
+  uint32_t h = 0;
+  for (uint8_t i = 0; i < len; i++) { h += epc[i]; h += h << 10; h ^= h >> 6; }
+  h += h << 3; h ^= h >> 11; h += h << 15;
+  return (uint64_t(uhfEpcHash(epc, len)) << 32) | h;
+}
+
+void UhfTidCache::clear() {
+  for (uint32_t b = 0; b < BUCKETS; b++) buckets_[b] = NONE;
+  for (uint16_t i = 0; i < CAPACITY; i++) {
+    entries_[i].used = false;
+    entries_[i].next = (i + 1 < CAPACITY) ? uint16_t(i + 1) : NONE;
+  }
+  free_ = 0;
+  oldest_ = newest_ = NONE;
+  size_ = 0;
+  dirty_ = true;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+uint16_t UhfTidCache::find(uint64_t key, uint32_t* bucket) const {
+  uint32_t b = uint32_t(key) & MASK;
+  while (buckets_[b] != NONE && entries_[buckets_[b]].key != key) b = (b + 1) & MASK;
+  if (bucket) *bucket = b;
+  return buckets_[b];
+}
+
+uint16_t UhfTidCache::insert(uint64_t key) {
+  if (free_ == NONE) {
+    erase(oldest_);
+    stats_.evictions++;
+  }
+  uint32_t b;
+  find(key, &b);
+  const uint16_t i = free_;
+  UhfTidCacheEntry& e = entries_[i];
+  free_ = e.next;
+  memset(&e, 0, sizeof(e));
+  e.key  = key;
+  e.used = true;
+  buckets_[b] = i;
+  linkNewest(i);
+  size_++;
+  return i;
+}
+
+void UhfTidCache::erase(uint16_t i) {
+  eraseBucket(i);
+  unlink(i);
+  entries_[i].used = false;
+  entries_[i].next = free_;
+  free_ = i;
+  size_--;
+}
+
+// Backward-shift deletion, as in UhfTagTable
+void UhfTidCache::eraseBucket(uint16_t i) {
+  uint32_t b = uint32_t(entries_[i].key) & MASK;
+  while (buckets_[b] != i) b = (b + 1) & MASK;
+  for (;;) {
+    buckets_[b] = NONE;
+    uint32_t j = b;
+    for (;;) {
+      j = (j + 1) & MASK;
+      const uint16_t k = buckets_[j];
+      if (k == NONE) return;
+      const uint32_t home = uint32_t(entries_[k].key) & MASK;
+      const bool stays = (b < j) ? (home > b && home <= j) : (home > b || home <= j);
+      if (!stays) { buckets_[b] = k; b = j; break; }
+    }
+  }
+}
+
+void UhfTidCache::unlink(uint16_t i) {
+  UhfTidCacheEntry& e = entries_[i];
+  if (e.prev != NONE) entries_[e.prev].next = e.next; else oldest_ = e.next;
+  if (e.next != NONE) entries_[e.next].prev = e.prev; else newest_ = e.prev;
+}
+
+void UhfTidCache::linkNewest(uint16_t i) {
+  UhfTidCacheEntry& e = entries_[i];
+  e.prev = newest_;
+  e.next = NONE;
+  if (newest_ != NONE) entries_[newest_].next = i; else oldest_ = i;
+  newest_ = i;
+}
+
+bool UhfTidCache::lookup(const uint8_t* epc, uint8_t len, uint8_t tid[8]) {
+  stats_.lookups++;
+  const uint16_t i = find(uhfTidCacheKey(epc, len));
+  if (i == NONE) return false;
+  stats_.hits++;
+  memcpy(tid, entries_[i].tid, 8);
+  if (i != newest_) { unlink(i); linkNewest(i); }
+  return true;
+}
+
+const UhfTidCacheEntry* UhfTidCache::peek(const uint8_t* epc, uint8_t len) const {
+  const uint16_t i = find(uhfTidCacheKey(epc, len));
+  return i == NONE ? nullptr : &entries_[i];
+}
+
+void UhfTidCache::put(const uint8_t* epc, uint8_t len, const uint8_t tid[8]) {
+  const uint64_t key = uhfTidCacheKey(epc, len);
+  uint16_t i = find(key);
+  if (i == NONE) {
+    i = insert(key);
+    stats_.inserts++;
+  } else if (i != newest_) {
+    unlink(i);
+    linkNewest(i);
+  }
+  if (memcmp(entries_[i].tid, tid, 8) != 0) {
+    memcpy(entries_[i].tid, tid, 8);
+    dirty_ = true;
+  }
+}
+
+bool UhfTidCache::forget(const uint8_t* epc, uint8_t len) {
+  const uint16_t i = find(uhfTidCacheKey(epc, len));
+  if (i == NONE) return false;
+  erase(i);
+  dirty_ = true;
+  return true;
+}
+
+bool UhfTidCache::setUser(const uint8_t* epc, uint8_t len, const uint8_t user[4]) {
+  const uint16_t i = find(uhfTidCacheKey(epc, len));
+  if (i == NONE) return false;
+  memcpy(entries_[i].user, user, 4);
+  entries_[i].has_user = true;
+  dirty_ = true;
+  return true;
+}
+
+// Not marked dirty: an RSSI alone is not worth a flash write
+void UhfTidCache::noteRssi(const uint8_t* epc, uint8_t len, int16_t dbm) {
+  if (dbm == 0) return;
+  const uint16_t i = find(uhfTidCacheKey(epc, len));
+  if (i == NONE) return;
+  entries_[i].rssi = int8_t(dbm < -128 ? -128 : dbm > 127 ? 127 : dbm);
+}
+
+// ---------- Image ----------
+
+size_t UhfTidCache::serialize(uint8_t* out, size_t cap) {
+  const size_t n = 4 + size_t(size_) * RECORD_BYTES;
+  if (cap < n) return 0;
+  out[0] = 'T'; out[1] = 'C'; out[2] = kImageVersion; out[3] = 0;
+  uint8_t* p = out + 4;
+  for (uint16_t i = oldest_; i != NONE; i = entries_[i].next) {
+    const UhfTidCacheEntry& e = entries_[i];
+    for (uint8_t k = 0; k < 8; k++) *p++ = uint8_t(e.key >> (56 - 8 * k));
+    memcpy(p, e.tid, 8);  p += 8;
+    memcpy(p, e.user, 4); p += 4;
+    *p++ = e.has_user ? 1 : 0;
+    *p++ = uint8_t(e.rssi);
+  }
+  dirty_ = false;
+  return n;
+}
+
+bool UhfTidCache::deserialize(const uint8_t* in, size_t len) {
+  if (len < 4 || in[0] != 'T' || in[1] != 'C' || in[2] != kImageVersion) return false;
+  if ((len - 4) % RECORD_BYTES != 0) return false;
+  clear();
+  const uint8_t* p = in + 4;
+  // A larger image (saved with a bigger capacity) keeps its most recent ones
+  size_t records = (len - 4) / RECORD_BYTES;
+  if (records > CAPACITY) { p += (records - CAPACITY) * RECORD_BYTES; records = CAPACITY; }
+  for (size_t r = 0; r < records; r++, p += RECORD_BYTES) {
+    uint64_t key = 0;
+    for (uint8_t k = 0; k < 8; k++) key = (key << 8) | p[k];
+    if (find(key) != NONE) continue;
+    UhfTidCacheEntry& e = entries_[insert(key)];
+    memcpy(e.tid, p + 8, 8);
+    memcpy(e.user, p + 16, 4);
+    e.has_user = p[20] != 0;
+    e.rssi     = int8_t(p[21]);
+    stats_.loaded++;
+  }
+  dirty_ = false;
+  return true;
+}
+
+// ---------- NVS ----------
+
+#if defined(ARDUINO)
+// Static: a 2.8 KB image does not belong on the caller's stack
+static uint8_t nvs_image[UhfTidCache::IMAGE_MAX];
+
+bool uhfTidCacheSave(UhfTidCache& cache) {
+  const size_t n = cache.serialize(nvs_image, sizeof(nvs_image));
+  if (n == 0) return false;
+  Preferences prefs;
+  if (!prefs.begin("uhf_tid", false)) return false;
+  const bool ok = prefs.putUChar("version", kNvsVersion) == 1 &&
+                  prefs.putBytes("cache", nvs_image, n) == n;
+  prefs.end();
+  return ok;
+}
+
+bool uhfTidCacheLoad(UhfTidCache& cache) {
+  Preferences prefs;
+  if (!prefs.begin("uhf_tid", true)) return false;
+  size_t n = 0;
+  if (prefs.getUChar("version", 0) == kNvsVersion) {
+    n = prefs.getBytesLength("cache");
+    if (n > sizeof(nvs_image) || prefs.getBytes("cache", nvs_image, n) != n) n = 0;
+  }
+  prefs.end();
+  return n > 0 && cache.deserialize(nvs_image, n);
+}
+
+bool uhfTidCacheErase() {
+  Preferences prefs;
+  if (!prefs.begin("uhf_tid", false)) return false;
+  const bool ok = prefs.clear();
+  prefs.end();
+  return ok;
+}
+#else
+bool uhfTidCacheSave(UhfTidCache&) { return false; }
+bool uhfTidCacheLoad(UhfTidCache&) { return false; }
+bool uhfTidCacheErase() { return false; }
+#endif
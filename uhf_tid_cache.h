@@ -0,0 +1,115 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+#include "uhf_tag_table.h"
+
+/*
+  ---------------------------------------------------------
+  EPC -> TID cache, kept across tag expiry and reboots
+  - The tag table forgets a tag tag_expiry_ms after its
+    last read; a tag flickering at the edge of the field
+    comes back as new. The cache remembers its TID, so the
+    TID queue answers from memory instead of stopping the
+    stream for a select + read
+  - Fixed memory: UHF_TID_CACHE_CAPACITY entries, open
+    addressing on a 64-bit EPC key (two 32-bit hashes, the
+    EPC itself is not kept), LRU list for eviction
+  - Also keeps the last RSSI and, when a caller read it,
+    the first two user memory words
+  - Persistence: a versioned byte image (serialize /
+    deserialize), stored in NVS by uhfTidCacheSave /
+    uhfTidCacheLoad on the ESP32
+  - An EPC stands for one tag: blanks that share a factory
+    EPC must not go through the cache. Whoever rewrites an
+    EPC forget()s the old one.
+  - Not thread safe: the pipeline's parse task owns it while
+    continuous mode runs; stats() is a snapshot then
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_TID_CACHE_CAPACITY
+#define UHF_TID_CACHE_CAPACITY 128       // entries; 32 bytes of RAM each, 22 in the image
+#endif
+
+struct UhfTidCacheEntry {
+  uint64_t key;           // uhfTidCacheKey(epc)
+  uint8_t  tid[8];
+  uint8_t  user[4];       // user memory words 0..1, if has_user
+  bool     has_user;
+  int8_t   rssi;          // dBm when last seen, 0 if never noted
+  uint16_t prev, next;    // LRU list (next doubles as free-list link)
+  bool     used;
+};
+
+struct UhfTidCacheStats {
+  uint32_t lookups;
+  uint32_t hits;          // TID reads avoided
+  uint32_t inserts;
+  uint32_t evictions;     // least recently used entry dropped for a new one
+  uint16_t loaded;        // entries restored by deserialize()
+};
+
+uint64_t uhfTidCacheKey(const uint8_t* epc, uint8_t len);
+
+class UhfTidCache {
+public:
+  static constexpr uint16_t NONE = 0xFFFF;
+  static constexpr uint16_t CAPACITY = UHF_TID_CACHE_CAPACITY;
+
+  UhfTidCache() { clear(); }
+
+  void clear();
+
+  // TID known for this EPC: copied out, the entry becomes the most recent
+  bool lookup(const uint8_t* epc, uint8_t len, uint8_t tid[8]);
+  // Entry for this EPC or nullptr; no stats, no LRU move
+  const UhfTidCacheEntry* peek(const uint8_t* epc, uint8_t len) const;
+
+  // A TID was read: insert or refresh, evicting the least recently used
+  void put(const uint8_t* epc, uint8_t len, const uint8_t tid[8]);
+  // The tag behind this EPC changed it (EPC write): its TID goes with it
+  bool forget(const uint8_t* epc, uint8_t len);
+  // Extras for a cached EPC (ignored when it is not cached)
+  bool setUser(const uint8_t* epc, uint8_t len, const uint8_t user[4]);
+  void noteRssi(const uint8_t* epc, uint8_t len, int16_t dbm);
+
+  uint16_t size() const { return size_; }
+  bool     dirty() const { return dirty_; }          // changed since the last (de)serialize
+  const UhfTidCacheStats& stats() const { return stats_; }
+  void     resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+  // Hits per 1000 lookups
+  uint16_t hitRatePermille() const {
+    return stats_.lookups ? uint16_t(uint64_t(stats_.hits) * 1000 / stats_.lookups) : 0;
+  }
+
+  // Byte image, least recently used first: loading it back restores the
+  // order. serialize returns the length (0 if cap is too small);
+  // deserialize replaces the content, false on a bad or foreign image.
+  static constexpr size_t RECORD_BYTES = 22;
+  static constexpr size_t IMAGE_MAX    = 4 + size_t(CAPACITY) * RECORD_BYTES;
+  size_t serialize(uint8_t* out, size_t cap);
+  bool   deserialize(const uint8_t* in, size_t len);
+
+private:
+  static constexpr uint32_t BUCKETS = _uhfCeilPow2(uint32_t(CAPACITY) * 2);
+  static constexpr uint32_t MASK    = BUCKETS - 1;
+  static_assert(CAPACITY > 0 && CAPACITY <= 16384, "capacity must fit 16-bit indices at load 1/2");
+
+  uint16_t find(uint64_t key, uint32_t* bucket = nullptr) const;
+  uint16_t insert(uint64_t key);          // new entry, most recent; evicts if full
+  void     erase(uint16_t i);
+  void     eraseBucket(uint16_t i);
+  void     unlink(uint16_t i);
+  void     linkNewest(uint16_t i);
+
+  UhfTidCacheEntry entries_[CAPACITY];
+  uint16_t buckets_[BUCKETS];
+  uint16_t free_, oldest_, newest_, size_;
+  bool     dirty_;
+  UhfTidCacheStats stats_;
+};
+
+// NVS (ESP32 only, false on the host build)
+bool uhfTidCacheSave(UhfTidCache& cache);
+bool uhfTidCacheLoad(UhfTidCache& cache);
+bool uhfTidCacheErase();
@@ -0,0 +1,180 @@
+#pragma once
+#include <Arduino.h>
+#include "universal_inventory.h"
+#include "uhf_tag_table.h"
+#include "uhf_tid_cache.h"
+
+/*
+  ---------------------------------------------------------
+  Deferred TID enrichment for continuous inventory
+  - New EPCs are queued instead of being selected and read
+    inline, so a burst of new tags does not freeze the stream
+  - Bounded max-heap on RSSI: the strongest (closest) tag is
+    read first; when full, the weakest request is dropped
+  - service() runs at most one batch per interval, within a
+    time budget, between multi-poll streams
+  - Requests refer to tag table slots; a slot that was
+    expired/reused or already has its TID counts as stale
+  - With a UhfTidCache attached, push() answers tags seen
+    before from the cache (no request queued) and every TID
+    read is stored in it
+  ---------------------------------------------------------
+*/
+
+#ifndef UHF_TID_QUEUE_CAPACITY
+#define UHF_TID_QUEUE_CAPACITY 32
+#endif
+
+// Reads the 64-bit TID of the currently selected tag
+typedef bool (*UhfTidReader)(uint8_t tid[8]);
+
+struct UhfTidSchedule {
+  uint32_t interval_ms;   // minimum time between two batches (stream time)
+  uint32_t budget_ms;     // no new read is started once reads took this long
+  uint8_t  max_per_batch;
+};
+
+struct UhfTidQueueStats {
+  uint32_t pushed;
+  uint32_t cached;        // answered by the TID cache, never queued
+  uint32_t dropped;       // queue full: weakest request discarded
+  uint32_t stale;         // tag gone or already enriched when its turn came
+  uint32_t served;        // TID read
+  uint32_t failed;        // select or read failed (not re-queued)
+  uint32_t batches;
+  uint32_t wait_total_ms; // queue time of served + failed requests
+  uint32_t wait_max_ms;
+  uint32_t batch_max_ms;  // whole stream interruption, stop included
+  uint16_t max_depth;
+};
+
+template <uint16_t TableCap, uint16_t Capacity = UHF_TID_QUEUE_CAPACITY>
+class UhfTidQueue {
+public:
+  UhfTidQueue(UhfTagTable<TableCap>& table, UhfTidReader reader)
+    : table_(table), reader_(reader), cache_(nullptr), count_(0), last_batch_(0) {
+    sched_.interval_ms   = 250;
+    sched_.budget_ms     = 40;
+    sched_.max_per_batch = 8;
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  void clear() { count_ = 0; }
+  void setReader(UhfTidReader reader) { reader_ = reader; }
+  void setCache(UhfTidCache* cache) { cache_ = cache; }
+
+  // Queue a table slot for a TID read (priority = its current RSSI)
+  void push(uint16_t slot, uint32_t now) {
+    if (!reader_) return;
+    UhfTagEntry& e = table_.at(slot);
+    if (cache_ && cache_->lookup(e.epc, e.epc_len, e.tid)) {
+      e.has_tid = true;
+      stats_.cached++;
+      return;
+    }
+    Item it = { slot, e.rssi, e.hash, now };
+    stats_.pushed++;
+    if (count_ == Capacity) {
+      const uint16_t w = weakest();
+      stats_.dropped++;
+      if (heap_[w].rssi >= it.rssi) return;   // the new one is the weakest
+      removeAt(w);
+    }
+    heap_[count_] = it;
+    siftUp(count_++);
+    if (count_ > stats_.max_depth) stats_.max_depth = count_;
+  }
+
+  // Run one batch if due. Stops the multi-poll stream before the first
+  // read: returns the number of reads attempted, > 0 means the caller has
+  // to restart the stream.
+  uint8_t service(uint32_t now) {
+    if (count_ == 0 || now - last_batch_ < sched_.interval_ms) return 0;
+    const uint32_t t0 = millis();
+    uint32_t reads_t0 = t0;
+    uint8_t attempted = 0;
+    while (count_ > 0 && attempted < sched_.max_per_batch &&
+           (attempted == 0 || millis() - reads_t0 < sched_.budget_ms)) {
+      Item it = heap_[0];
+      removeAt(0);
+      UhfTagEntry& e = table_.at(it.slot);
+      if (!e.used || e.hash != it.hash || e.has_tid) { stats_.stale++; continue; }
+
+      if (attempted == 0) { uhfStopMultiInventory(); reads_t0 = millis(); }
+      attempted++;
+      const uint32_t wait = millis() - it.queued_ms;
+      stats_.wait_total_ms += wait;
+      if (wait > stats_.wait_max_ms) stats_.wait_max_ms = wait;
+      if (uhfSelectEpc(e.epc, e.epc_len) && reader_(e.tid)) {
+        e.has_tid = true;
+        stats_.served++;
+        if (cache_) cache_->put(e.epc, e.epc_len, e.tid);
+      } else {
+        stats_.failed++;
+      }
+    }
+    if (attempted > 0) {
+      stats_.batches++;
+      const uint32_t took = millis() - t0;
+      if (took > stats_.batch_max_ms) stats_.batch_max_ms = took;
+      last_batch_ = millis();
+    }
+    return attempted;
+  }
+
+  uint16_t depth() const { return count_; }
+  UhfTidSchedule& schedule() { return sched_; }
+  const UhfTidQueueStats& stats() const { return stats_; }
+  void resetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+private:
+  struct Item { uint16_t slot; int16_t rssi; uint32_t hash; uint32_t queued_ms; };
+
+  // Max-heap on RSSI, earliest first on ties
+  bool before(const Item& a, const Item& b) const {
+    return a.rssi != b.rssi ? a.rssi > b.rssi : int32_t(a.queued_ms - b.queued_ms) < 0;
+  }
+
+  void siftUp(uint16_t i) {
+    while (i > 0) {
+      const uint16_t p = (i - 1) / 2;
+      if (!before(heap_[i], heap_[p])) break;
+      Item t = heap_[i]; heap_[i] = heap_[p]; heap_[p] = t;
+      i = p;
+    }
+  }
+
+  void siftDown(uint16_t i) {
+    for (;;) {
+      uint16_t m = i;
+      const uint16_t l = 2 * i + 1, r = l + 1;
+      if (l < count_ && before(heap_[l], heap_[m])) m = l;
+      if (r < count_ && before(heap_[r], heap_[m])) m = r;
+      if (m == i) return;
+      Item t = heap_[i]; heap_[i] = heap_[m]; heap_[m] = t;
+      i = m;
+    }
+  }
+
+  void removeAt(uint16_t i) {
+    heap_[i] = heap_[--count_];
+    if (i < count_) { siftDown(i); siftUp(i); }
+  }
+
+  // The weakest request is one of the leaves
+  uint16_t weakest() const {
+    uint16_t w = count_ / 2;
+    for (uint16_t i = w + 1; i < count_; i++)
+      if (before(heap_[w], heap_[i])) w = i;
+    return w;
+  }
+
+  UhfTagTable<TableCap>& table_;
+  UhfTidReader   reader_;
+  UhfTidCache*   cache_;
+  Item           heap_[Capacity];
+  uint16_t       count_;
+  uint32_t       last_batch_;
+  UhfTidSchedule sched_;
+  UhfTidQueueStats stats_;
+};
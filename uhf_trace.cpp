@@ -0,0 +1,295 @@
+#include "uhf_trace.h"
+
+static size_t putVarint(uint8_t* out, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) { out[n++] = uint8_t(v | 0x80); v >>= 7; }
+  out[n++] = uint8_t(v);
+  return n;
+}
+
+static inline void putU32(uint8_t* p, uint32_t v) {
+  p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); p[2] = uint8_t(v >> 16); p[3] = uint8_t(v >> 24);
+}
+
+static inline uint32_t getU32(const uint8_t* p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+// ---------- UhfTraceRing ----------
+
+void UhfTraceRing::clear(uint32_t now_us) {
+  head_ = tail_ = used_ = 0;
+  base_us_ = last_us_ = now_us;
+  events_ = overwritten_ = truncated_ = 0;
+}
+
+void UhfTraceRing::copyIn(const uint8_t* p, size_t n) {
+  const size_t first = min<size_t>(n, cap_ - head_);
+  memcpy(buf_ + head_, p, first);
+  memcpy(buf_, p + first, n - first);
+  head_ = uint32_t((head_ + n) % cap_);
+  used_ += uint32_t(n);
+}
+
+uint32_t UhfTraceRing::readVarint(uint32_t& pos) const {
+  uint32_t v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    const uint8_t b = buf_[pos];
+    pos = pos + 1 == cap_ ? 0 : pos + 1;
+    v |= uint32_t(b & 0x7F) << shift;
+    if (!(b & 0x80)) break;
+  }
+  return v;
+}
+
+void UhfTraceRing::dropOldest() {
+  uint32_t p = tail_;
+  const uint32_t delta = readVarint(p);
+  const uint32_t len   = readVarint(p);
+  const uint32_t total = distance(tail_, p) + len;
+  tail_ = (tail_ + total) % cap_;
+  used_ -= total;
+  base_us_ += delta;
+  events_--;
+  overwritten_++;
+}
+
+void UhfTraceRing::put(uint32_t now_us, const uint8_t* data, size_t len) {
+  if (len > cap_ / 2) {
+    truncated_ += uint32_t(len - cap_ / 2);
+    len = cap_ / 2;
+  }
+  uint8_t hdr[10];
+  size_t h = putVarint(hdr, now_us - last_us_);
+  h += putVarint(hdr + h, uint32_t(len));
+  while (cap_ - used_ < h + len) dropOldest();
+  copyIn(hdr, h);
+  copyIn(data, len);
+  last_us_ = now_us;
+  events_++;
+}
+
+bool UhfTraceRing::next(Cursor& c) const {
+  if (c.left == 0) return false;
+  uint32_t p = c.pos;
+  c.t_us += readVarint(p);
+  c.len  = readVarint(p);
+  c.data = p;
+  const uint32_t total = distance(c.pos, p) + c.len;
+  c.pos   = (c.pos + total) % cap_;
+  c.left -= total;
+  return true;
+}
+
+void UhfTraceRing::emit(const Cursor& c, UhfTraceWriteFn fn, void* ctx) const {
+  const uint32_t first = min(c.len, cap_ - c.data);
+  fn(buf_ + c.data, first, ctx);
+  if (c.len > first) fn(buf_, c.len - first, ctx);
+}
+
+// ---------- UhfTraceRecorder ----------
+
+UhfTraceRecorder::UhfTraceRecorder()
+  : inner_(nullptr), on_(false), rx_(rx_buf_, sizeof(rx_buf_)), tx_(tx_buf_, sizeof(tx_buf_)),
+    rx_bytes_(0), tx_bytes_(0) {}
+
+void UhfTraceRecorder::clear() {
+  const uint32_t now = micros();
+  rx_.clear(now);
+  tx_.clear(now);
+  rx_bytes_ = tx_bytes_ = 0;
+}
+
+void UhfTraceRecorder::start() {
+  clear();
+  on_.store(true, std::memory_order_relaxed);
+}
+
+int UhfTraceRecorder::read() {
+  const int b = inner_ ? inner_->read() : -1;
+  if (b >= 0 && recording()) {
+    const uint8_t v = uint8_t(b);
+    rx_.put(micros(), &v, 1);
+    rx_bytes_++;
+  }
+  return b;
+}
+
+size_t UhfTraceRecorder::readAvailable(uint8_t* buf, size_t n) {
+  const size_t got = inner_ ? inner_->readAvailable(buf, n) : 0;
+  if (got && recording()) {
+    rx_.put(micros(), buf, got);
+    rx_bytes_ += uint32_t(got);
+  }
+  return got;
+}
+
+size_t UhfTraceRecorder::write(const uint8_t* data, size_t len) {
+  // Stamped before the driver may block on a full TX FIFO: replies are
+  // timed from the moment the command was handed over
+  if (recording()) {
+    tx_.put(micros(), data, len);
+    tx_bytes_ += uint32_t(len);
+  }
+  return inner_ ? inner_->write(data, len) : 0;
+}
+
+UhfTraceStats UhfTraceRecorder::stats() const {
+  UhfTraceStats s;
+  s.rx_events   = rx_.events();
+  s.tx_events   = tx_.events();
+  s.rx_bytes    = rx_bytes_;
+  s.tx_bytes    = tx_bytes_;
+  s.overwritten = rx_.overwritten() + tx_.overwritten();
+  s.truncated   = rx_.truncated() + tx_.truncated();
+  return s;
+}
+
+// Both rings in time order; an RX chunk stamped with the same micros() as a
+// command went out before it (pumped and discarded ahead of the write).
+// Once a ring has wrapped, events older than its oldest one are skipped:
+// replies without their command, or commands without their replies.
+size_t UhfTraceRecorder::merge(UhfTraceWriteFn fn, void* ctx, uint32_t& events, uint32_t& bytes,
+                               uint32_t& start_us) const {
+  bool     trim = false;
+  uint32_t from = 0;
+  const UhfTraceRing* rings[2] = {&rx_, &tx_};
+  for (uint8_t i = 0; i < 2; i++) {
+    UhfTraceRing::Cursor c = rings[i]->begin();
+    if (rings[i]->overwritten() && rings[i]->next(c) && (!trim || int32_t(c.t_us - from) > 0)) {
+      from = c.t_us;
+      trim = true;
+    }
+  }
+
+  UhfTraceRing::Cursor a = rx_.begin(), b = tx_.begin();
+  bool has_a = rx_.next(a), has_b = tx_.next(b);
+  bool first = true;
+  uint32_t prev = 0;
+  size_t size = 0;
+  events = bytes = start_us = 0;
+  while (has_a || has_b) {
+    const bool tx = has_b && (!has_a || int32_t(b.t_us - a.t_us) < 0);
+    const UhfTraceRing::Cursor& c = tx ? b : a;
+    if (!trim || int32_t(c.t_us - from) >= 0) {
+      if (first) { start_us = prev = c.t_us; first = false; }
+      uint8_t hdr[10];
+      size_t h = putVarint(hdr, c.t_us - prev);
+      h += putVarint(hdr + h, (c.len << 1) | (tx ? UHF_TRACE_TX : UHF_TRACE_RX));
+      if (fn) {
+        fn(hdr, h, ctx);
+        (tx ? tx_ : rx_).emit(c, fn, ctx);
+      }
+      prev = c.t_us;
+      events++;
+      bytes += c.len;
+      size += h + c.len;
+    }
+    if (tx) has_b = tx_.next(b);
+    else    has_a = rx_.next(a);
+  }
+  return size;
+}
+
+size_t UhfTraceRecorder::exportTrace(UhfTraceWriteFn fn, void* ctx) const {
+  uint32_t events, bytes, start_us;
+  const size_t body = merge(nullptr, nullptr, events, bytes, start_us);
+  if (!fn) return UHF_TRACE_HEADER + body;
+
+  uint8_t hdr[UHF_TRACE_HEADER] = {'U', 'H', 'F', 'T', UHF_TRACE_VERSION, 0, 0, 0};
+  if (rx_.overwritten() || tx_.overwritten()) hdr[5] |= UHF_TRACE_FLAG_WRAPPED;
+  putU32(hdr + 8, start_us);
+  putU32(hdr + 12, events);
+  putU32(hdr + 16, bytes);
+  fn(hdr, sizeof(hdr), ctx);
+  merge(fn, ctx, events, bytes, start_us);
+  return UHF_TRACE_HEADER + body;
+}
+
+// ---------- Console dump ----------
+
+struct HexDump {
+  UhfTraceLineFn fn;
+  void*    ctx;
+  uint32_t offset;      // file offset of the first byte of `line`
+  size_t   n;           // bytes in the current line
+  size_t   prefix;      // length of "TRACE <offset> "
+  char     line[20 + 2 * UHF_TRACE_HEX_LINE];
+
+  void flushLine() {
+    if (n) fn(line, ctx);
+    offset += uint32_t(n);
+    n = 0;
+  }
+};
+
+static void hexSink(const uint8_t* p, size_t len, void* ctx) {
+  static const char digits[] = "0123456789ABCDEF";
+  HexDump& d = *static_cast<HexDump*>(ctx);
+  for (size_t i = 0; i < len; i++) {
+    if (d.n == 0) d.prefix = size_t(snprintf(d.line, sizeof(d.line), "TRACE %04X ", (unsigned)d.offset));
+    char* at = d.line + d.prefix + 2 * d.n;
+    at[0] = digits[p[i] >> 4];
+    at[1] = digits[p[i] & 0x0F];
+    at[2] = '\0';
+    if (++d.n == UHF_TRACE_HEX_LINE) d.flushLine();
+  }
+}
+
+size_t uhfTraceDumpHex(const UhfTraceRecorder& rec, UhfTraceLineFn fn, void* ctx) {
+  char line[32];
+  const size_t size = rec.exportTrace(nullptr, nullptr);
+  snprintf(line, sizeof(line), "TRACE BEGIN %u bytes", (unsigned)size);
+  fn(line, ctx);
+  HexDump d;
+  d.fn = fn; d.ctx = ctx; d.offset = 0; d.n = 0; d.prefix = 0;
+  rec.exportTrace(hexSink, &d);
+  d.flushLine();
+  fn("TRACE END", ctx);
+  return size;
+}
+
+// ---------- UhfTraceReader ----------
+
+bool UhfTraceReader::open(const uint8_t* data, size_t len) {
+  bad_ = false;
+  if (!data || len < UHF_TRACE_HEADER || memcmp(data, "UHFT", 4) != 0 || data[4] != UHF_TRACE_VERSION) {
+    bad_ = true;
+    return false;
+  }
+  p_        = data;
+  n_        = len;
+  pos_      = UHF_TRACE_HEADER;
+  t_us_     = 0;
+  flags_    = data[5];
+  start_us_ = getU32(data + 8);
+  events_   = getU32(data + 12);
+  return true;
+}
+
+bool UhfTraceReader::varint(uint32_t& v) {
+  v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (pos_ >= n_) return false;
+    const uint8_t b = p_[pos_++];
+    v |= uint32_t(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+bool UhfTraceReader::next(UhfTraceEvent& ev) {
+  if (bad_ || !p_ || pos_ >= n_) return false;
+  uint32_t delta, lendir;
+  if (!varint(delta) || !varint(lendir) || (lendir >> 1) > n_ - pos_) {
+    bad_ = true;
+    return false;
+  }
+  t_us_   += delta;
+  ev.dir   = uint8_t(lendir & 1);
+  ev.t_us  = t_us_;
+  ev.len   = lendir >> 1;
+  ev.data  = p_ + pos_;
+  pos_    += ev.len;
+  return true;
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "uhf_transport.h"
+
+/*
+  ---------------------------------------------------------
+  UART traffic recorder (field captures for host replay)
+  - UhfTraceRecorder decorates the module transport: every
+    chunk read from or written to the UART is stored with
+    its micros() timestamp in a RAM ring
+  - One ring per direction, each with a single writer: RX
+    is filled by whoever drains the UART (ingest task while
+    the pipeline runs), TX by whoever sends commands. No
+    lock between the two
+  - Full ring: the oldest events are overwritten, so a dump
+    holds the traffic that led to the problem
+  - Export (recording stopped, UART quiet): both rings are
+    merged by time into a trace file (format below), which
+    host/trace_replay feeds back through the protocol code
+  - Timestamps are per chunk, as the UART driver hands them
+    out, not per byte
+  ---------------------------------------------------------
+
+  Trace file (little-endian):
+    0   "UHFT"
+    4   version u8 (UHF_TRACE_VERSION)
+    5   flags   u8  bit 0: older traffic was overwritten
+    6   reserved u16
+    8   start_us u32  micros() of the first event
+    12  events   u32
+    16  bytes    u32  payload bytes in all events
+    20  events: varint delta_us (from the previous event),
+        varint (len << 1 | dir), len bytes; dir 0 = RX, 1 = TX
+*/
+
+#ifndef UHF_TRACE_RX_BYTES
+#define UHF_TRACE_RX_BYTES 12288
+#endif
+#ifndef UHF_TRACE_TX_BYTES
+#define UHF_TRACE_TX_BYTES 4096
+#endif
+
+static constexpr uint8_t UHF_TRACE_VERSION      = 1;
+static constexpr size_t  UHF_TRACE_HEADER       = 20;
+static constexpr uint8_t UHF_TRACE_FLAG_WRAPPED = 0x01;
+
+enum UhfTraceDir : uint8_t { UHF_TRACE_RX = 0, UHF_TRACE_TX = 1 };
+
+// Receives the trace file in pieces
+typedef void (*UhfTraceWriteFn)(const uint8_t* data, size_t len, void* ctx);
+
+// Variable-length events in a byte ring, oldest dropped when full.
+// One writer; read it only while that writer is idle.
+class UhfTraceRing {
+public:
+  UhfTraceRing(uint8_t* buf, uint32_t cap) : buf_(buf), cap_(cap) { clear(0); }
+
+  void clear(uint32_t now_us);
+  void put(uint32_t now_us, const uint8_t* data, size_t len);
+
+  uint32_t events() const      { return events_; }
+  uint32_t overwritten() const { return overwritten_; }
+  uint32_t truncated() const   { return truncated_; }     // bytes cut from oversize chunks
+  uint32_t used() const        { return used_; }
+
+  // Walk from the oldest event
+  struct Cursor {
+    uint32_t pos;       // next event header
+    uint32_t left;      // ring bytes not walked yet
+    uint32_t t_us;      // time of the event last returned
+    uint32_t data;      // its payload position
+    uint32_t len;
+  };
+  Cursor begin() const { Cursor c = {tail_, used_, base_us_, 0, 0}; return c; }
+  bool   next(Cursor& c) const;
+  void   emit(const Cursor& c, UhfTraceWriteFn fn, void* ctx) const;   // c's payload
+
+private:
+  uint32_t readVarint(uint32_t& pos) const;
+  uint32_t distance(uint32_t from, uint32_t to) const { return to >= from ? to - from : to + cap_ - from; }
+  void     copyIn(const uint8_t* p, size_t n);
+  void     dropOldest();
+
+  uint8_t* buf_;
+  uint32_t cap_;
+  uint32_t head_, tail_;   // positions in buf_
+  uint32_t used_;
+  uint32_t base_us_;       // time the oldest event's delta counts from
+  uint32_t last_us_;       // time of the newest event
+  uint32_t events_;
+  uint32_t overwritten_;
+  uint32_t truncated_;
+};
+
+struct UhfTraceStats {
+  uint32_t rx_events, tx_events;
+  uint32_t rx_bytes, tx_bytes;       // traffic recorded (before overwrite)
+  uint32_t overwritten;              // events lost to the ring wrapping
+  uint32_t truncated;
+};
+
+class UhfTraceRecorder : public UhfTransport {
+public:
+  UhfTraceRecorder();
+
+  void attach(UhfTransport* inner) { inner_ = inner; }
+  UhfTransport* inner() const { return inner_; }
+
+  // start() clears the rings. start(), clear() and exportTrace() only while
+  // no other task uses the transport; stop() at any time.
+  void start();
+  void stop() { on_.store(false, std::memory_order_relaxed); }
+  bool recording() const { return on_.load(std::memory_order_relaxed); }
+  void clear();
+
+  UhfTraceStats stats() const;
+
+  // Writes the trace file, returns its size. Pass nullptr to only size it.
+  size_t exportTrace(UhfTraceWriteFn fn, void* ctx) const;
+
+  // ---- UhfTransport ----
+  int    available() override { return inner_ ? inner_->available() : 0; }
+  int    read() override;
+  size_t readAvailable(uint8_t* buf, size_t n) override;
+  size_t write(const uint8_t* data, size_t len) override;
+  void   flush() override { if (inner_) inner_->flush(); }
+
+private:
+  size_t merge(UhfTraceWriteFn fn, void* ctx, uint32_t& events, uint32_t& bytes, uint32_t& start_us) const;
+
+  UhfTransport*     inner_;
+  std::atomic<bool> on_;
+  uint8_t      rx_buf_[UHF_TRACE_RX_BYTES];
+  uint8_t      tx_buf_[UHF_TRACE_TX_BYTES];
+  UhfTraceRing rx_;
+  UhfTraceRing tx_;
+  uint32_t     rx_bytes_, tx_bytes_;    // one writer each, like the rings
+};
+
+// Console form of a trace, one line per call (no newline):
+//   "TRACE BEGIN <size> bytes"
+//   "TRACE <offset, hex> <UHF_TRACE_HEX_LINE bytes in hex>"   ...
+//   "TRACE END"
+// host/trace_replay reads it back from a console capture.
+static constexpr size_t UHF_TRACE_HEX_LINE = 32;
+typedef void (*UhfTraceLineFn)(const char* line, void* ctx);
+size_t uhfTraceDumpHex(const UhfTraceRecorder& rec, UhfTraceLineFn fn, void* ctx);
+
+// One event of a trace file, data points into the file buffer
+struct UhfTraceEvent {
+  uint8_t        dir;       // UhfTraceDir
+  uint32_t       t_us;      // since the first event
+  const uint8_t* data;
+  uint32_t       len;
+};
+
+// Reads a trace file held in memory
+class UhfTraceReader {
+public:
+  UhfTraceReader() : p_(nullptr), n_(0), pos_(0), t_us_(0), start_us_(0), events_(0), flags_(0), bad_(false) {}
+
+  bool open(const uint8_t* data, size_t len);   // false: not a trace / wrong version
+  bool next(UhfTraceEvent& ev);                  // false at the end or on a bad event
+  bool bad() const { return bad_; }
+
+  uint32_t startUs() const { return start_us_; }
+  uint32_t events() const  { return events_; }
+  uint8_t  flags() const   { return flags_; }
+
+private:
+  bool varint(uint32_t& v);
+
+  const uint8_t* p_;
+  size_t   n_, pos_;
+  uint32_t t_us_, start_us_, events_;
+  uint8_t  flags_;
+  bool     bad_;
+};
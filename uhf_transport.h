@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  ---------------------------------------------------------
+  Byte transport between the controller and a JRD-4035
+  - Firmware: thin adapter over HardwareSerial (Serial2)
+  - Host: implemented by the software module emulator
+    (host/jrd4035_sim.*) so the protocol core can run and
+    be benchmarked on Linux
+  ---------------------------------------------------------
+*/
+
+class UhfTransport {
+public:
+  virtual ~UhfTransport() {}
+  virtual int    available() = 0;
+  virtual int    read() = 0;                     // -1 if nothing pending
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+  virtual void   flush() = 0;                    // wait until TX is on the wire
+
+  // Non-blocking bulk read of up to n already-received bytes
+  virtual size_t readAvailable(uint8_t* buf, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+      int b = read();
+      if (b < 0) break;
+      buf[i++] = uint8_t(b);
+    }
+    return i;
+  }
+};
+
+#if defined(ARDUINO)
+class HardwareSerialTransport : public UhfTransport {
+public:
+  explicit HardwareSerialTransport(HardwareSerial* port = nullptr) : port_(port) {}
+  void attach(HardwareSerial* port) { port_ = port; }
+  HardwareSerial* port() const { return port_; }
+
+  int    available() override { return port_ ? port_->available() : 0; }
+  int    read() override { return port_ ? port_->read() : -1; }
+  size_t write(const uint8_t* data, size_t len) override { return port_ ? port_->write(data, len) : 0; }
+  void   flush() override { if (port_) port_->flush(); }
+  size_t readAvailable(uint8_t* buf, size_t n) override { return port_ ? port_->read(buf, n) : 0; }
+
+private:
+  HardwareSerial* port_;
+};
+#endif
@@ -1,201 +1,517 @@
 #include "universal_inventory.h"
 
-HardwareSerial* gUhf = nullptr;  // define the global here
+#if defined(ARDUINO)
+#include <esp_heap_caps.h>
+#endif
 
-// Utils
-static inline uint8_t cs8_local(const uint8_t* p, size_t n) {
-  uint32_t s=0; for (size_t i=0;i<n;i++) s+=p[i]; return uint8_t(s&0xFF);
+// Reply opcode for a request (0x27 notifications come back as 0x22)
+static inline uint8_t replyCmdFor(uint8_t cmd) {
+  return cmd == CMD_MULTI_POLL ? CMD_INVENTORY : cmd;
 }
 
-static void clearRx(uint32_t timeout_ms=50) {
-  if (!gUhf) return;
-  uint32_t t0=millis();
-  while (millis()-t0<timeout_ms) {
-    while (gUhf->available()) { gUhf->read(); t0=millis(); }
-    delay(1);
+
+// ---------- Reader ----------
+
+UhfReader::UhfReader()
+    : port_(nullptr), tx_(tx_buf_, sizeof(tx_buf_)), last_error_(0), timing_used_(0),
+      adaptive_(true), link_{0, 0, 0, 0}, alloc_{0, 0, 0}, tx_power_(0), sent_cmd_(0), sent_timing_(nullptr), sent_us_(0),
+      sent_tout_us_(0), sent_got_byte_(false), round_open_(false), round_replied_(false), round_last_us_(0) {}
+
+#if defined(ARDUINO)
+void UhfReader::attachSerial(HardwareSerial* port) {
+  serial_.attach(port);
+  port_ = port ? &serial_ : nullptr;
+}
+#endif
+
+UhfCmdTiming* UhfReader::timingFor(uint8_t cmd) {
+  for (uint8_t i = 0; i < timing_used_; i++) if (timing_[i].cmd == cmd) return &timing_[i];
+  if (timing_used_ == TIMING_SLOTS) return nullptr;
+  UhfCmdTiming& t = timing_[timing_used_++];
+  memset(&t, 0, sizeof(t));
+  t.cmd = cmd;
+  return &t;
+}
+
+const UhfCmdTiming* UhfReader::commandTiming(uint8_t cmd) const {
+  for (uint8_t i = 0; i < timing_used_; i++) if (timing_[i].cmd == cmd) return &timing_[i];
+  return nullptr;
+}
+
+void UhfReader::noteRetry(uint8_t cmd) {
+  UhfCmdTiming* t = timingFor(cmd);
+  if (t) t->retries++;
+}
+
+void UhfReader::noteTagReads(uint8_t n, bool single_poll) {
+  if (single_poll) link_.inventory_rounds++;
+  link_.tag_reads += n;
+}
+
+void UhfReader::noteError(UhfCmdTiming* t, uint8_t code) {
+  if (!t) return;
+  t->errors++;
+  uint8_t i = 0;
+  while (i < UHF_TRACKED_ERROR_COUNT && UHF_TRACKED_ERRORS[i] != code) i++;
+  t->error_code[i]++;
+}
+
+uint32_t UhfReader::commandTimeout(uint8_t cmd, uint32_t ceiling_ms) const {
+  const UhfCmdTiming* t = commandTiming(cmd);
+  if (!adaptive_ || !t || t->reply.count < UHF_TIMEOUT_WARMUP) return ceiling_ms;
+  const uint64_t us = uint64_t(t->reply.percentileUs(990)) * UHF_TIMEOUT_MARGIN_PCT / 100;
+  uint32_t ms = uint32_t((us + 999) / 1000);
+  if (ms < UHF_TIMEOUT_FLOOR_MS) ms = UHF_TIMEOUT_FLOOR_MS;
+  return ms < ceiling_ms ? ms : ceiling_ms;
+}
+
+bool UhfReader::nextFrame(UhfFrame& out, uint32_t tout_ms) {
+  if (!port_) return false;
+  uint32_t t0 = millis();
+  for (;;) {
+    if (rx_.next(out)) return true;
+    rx_.pump(*port_);
+    if (rx_.next(out)) return true;
+    if (millis() - t0 >= tout_ms) return false;
   }
 }
 
-// sendCmdRaw implémentée dans le .ino car utilise Serial2 directement
-
-// Multi-frame frame reader (uses attached port)
-static bool readOneFrame(HardwareSerial* port, uint8_t* buf, size_t& len, uint32_t tout_ms) {
-  if (!port || !buf || len < 7) return false;
-  size_t idx = 0; bool started = false; uint32_t t0 = millis();
-  while (millis() - t0 < tout_ms && idx < len) {
-    if (port->available()) {
-      uint8_t b = (uint8_t)port->read();
-      if (!started) {
-        if (b == 0xBB) { started = true; buf[idx++] = b; }
-      } else {
-        buf[idx++] = b;
-        if (idx >= 5) {
-          uint16_t pl = (uint16_t(buf[3]) << 8) | buf[4];
-          size_t expected = 5 + pl + 2;
-          if (idx >= expected) break;
-        }
+bool UhfReader::send(const uint8_t* frame, size_t len, uint32_t ceiling_ms) {
+  if (!port_ || !frame || len < 7) return false;
+
+  // Stale replies (late answer to a timed-out command, leftover inventory
+  // notifications) must not be taken for this command's answer. Drop what is
+  // already here; no need to wait for the line to go quiet.
+  rx_.pump(*port_);
+  rx_.discard();
+
+  UHF_LOGD_BYTES(FRAMES, FRAME_TX, frame, len);
+  port_->write(frame, len);
+  port_->flush();
+
+  sent_cmd_ = frame[2];
+  sent_timing_ = timingFor(sent_cmd_);
+  sent_tout_us_ = commandTimeout(sent_cmd_, ceiling_ms) * 1000;
+  if (sent_timing_) sent_timing_->sent++;
+  sent_got_byte_ = false;
+  last_error_ = 0;
+  sent_us_ = micros();
+  return true;
+}
+
+// streaming: inventory notifications may still arrive ahead of the reply
+// (stop of a multi-poll), so neither a corrupted frame nor an error frame
+// can be taken for it
+int8_t UhfReader::checkReply(UhfFrame& resp, bool streaming) {
+  if (!port_) return -1;
+  const uint8_t expect = replyCmdFor(sent_cmd_);
+  const bool    notify = streaming || expect == CMD_INVENTORY;
+  UhfCmdTiming* timing = sent_timing_;
+  const uint32_t bad_before = rx_.stats().bad_checksum + rx_.stats().bad_trailer;
+  if (rx_.pump(*port_) && !sent_got_byte_) {
+    sent_got_byte_ = true;
+    if (timing) timing->first_byte.add(micros() - sent_us_);
+  }
+  while (rx_.next(resp)) {
+    if (resp.cmd() == expect || (resp.isError() && !streaming)) {
+      UHF_LOGD_BYTES(FRAMES, FRAME_RX, resp.data, resp.len);
+      if (resp.isError()) {
+        last_error_ = resp.errorCode();
+        noteError(timing, last_error_);
+      } else if (timing) {
+        timing->reply.add(micros() - sent_us_);
       }
+      return 1;
     }
   }
-  if (idx < 7 || buf[0] != 0xBB) return false;
-  uint16_t pl = (uint16_t(buf[3]) << 8) | buf[4];
-  size_t expected = 5 + pl + 2;
-  if (idx != expected || buf[idx-1] != 0x7E) return false;
-  if (cs8_local(&buf[1], expected - 3) != buf[idx-2]) return false;
-  len = idx;
+  // A corrupted frame right after a plain command is our reply: fail now
+  // rather than waiting for the timeout.
+  if (!notify && rx_.stats().bad_checksum + rx_.stats().bad_trailer != bad_before) {
+    UHF_LOGW(LINK, CORRUPTED_REPLY, sent_cmd_);
+    if (timing) timing->corrupted++;
+    return -1;
+  }
+  if (micros() - sent_us_ >= sent_tout_us_) {
+    if (timing) { timing->timeouts++; timing->reply.add(sent_tout_us_); }
+    return -1;
+  }
+  return 0;
+}
+
+bool UhfReader::transactImpl(const uint8_t* frame, size_t len, UhfFrame& resp, uint32_t ceiling_ms,
+                             bool streaming) {
+  if (!send(frame, len, ceiling_ms)) return false;
+  int8_t r;
+  while ((r = checkReply(resp, streaming)) == 0) {}
+  return r > 0;
+}
+
+static void printHistogram(const char* label, const UhfLatencyHistogram& h) {
+  Serial.printf(" %s p50 %u p99 %u max %u us", label, (unsigned)h.percentileUs(500),
+                (unsigned)h.percentileUs(990), (unsigned)h.max_us);
+}
+
+void UhfReader::printLinkStats() {
+  const uint32_t ms = millis() - link_.since_ms;
+  const uint32_t div = ms ? ms : 1;
+  Serial.printf("UHF LINK %u ms: %u rounds (%u /s), %u tag reads (%u /s), %u streams\n",
+                (unsigned)ms, (unsigned)link_.inventory_rounds,
+                (unsigned)(uint64_t(link_.inventory_rounds) * 1000 / div),
+                (unsigned)link_.tag_reads, (unsigned)(uint64_t(link_.tag_reads) * 1000 / div),
+                (unsigned)link_.stream_starts);
+  const UhfDecoderStats& rx = rx_.stats();
+  Serial.printf("UHF RX %u frames, %u bad checksum, %u bad trailer, %u bad length, "
+                "%u resync bytes, %u overflows, %u discarded\n",
+                (unsigned)rx.frames, (unsigned)rx.bad_checksum, (unsigned)rx.bad_trailer,
+                (unsigned)rx.bad_length, (unsigned)rx.resync_bytes, (unsigned)rx.overflows,
+                (unsigned)rx.discarded);
+  for (uint8_t i = 0; i < timing_used_; i++) {
+    const UhfCmdTiming& t = timing_[i];
+    Serial.printf("UHF CMD 0x%02X sent %u,", t.cmd, (unsigned)t.sent);
+    printHistogram("first", t.first_byte);
+    Serial.print(",");
+    printHistogram("reply", t.reply);
+    Serial.printf(", timeout %u ms\n", (unsigned)commandTimeout(t.cmd, 1000));
+    Serial.printf("UHF CMD 0x%02X %u timeouts, %u corrupted, %u retries, %u errors",
+                  t.cmd, (unsigned)t.timeouts, (unsigned)t.corrupted, (unsigned)t.retries,
+                  (unsigned)t.errors);
+    for (uint8_t e = 0; e < UHF_TRACKED_ERROR_COUNT; e++) {
+      if (t.error_code[e]) Serial.printf(" %02X:%u", UHF_TRACKED_ERRORS[e], (unsigned)t.error_code[e]);
+    }
+    if (t.error_code[UHF_TRACKED_ERROR_COUNT]) {
+      Serial.printf(" other:%u", (unsigned)t.error_code[UHF_TRACKED_ERROR_COUNT]);
+    }
+    Serial.println();
+  }
+}
+
+void UhfReader::resetLinkStats() {
+  resetCommandTiming();
+  rx_.resetStats();
+  link_ = UhfLinkStats{millis(), 0, 0, 0};
+}
+
+// ---------- Reader commands ----------
+
+bool UhfReader::stopMultiInventory() {
+  // Confirmed by the 0x28 reply: notifications queued ahead of it are
+  // skipped, and none follow it
+  UhfFrame r;
+  return transactImpl(UhfStopFrame::bytes, UhfStopFrame::SIZE, r, 200, true);
+}
+
+bool UhfReader::startMultiPoll(uint16_t rounds) {
+  if (!port_) return false;
+  const size_t n = uhfFrameMultiPoll(tx_, rounds);
+  rx_.pump(*port_);
+  rx_.discard();
+  link_.stream_starts++;
+  UHF_LOGD_BYTES(FRAMES, FRAME_TX, tx_.data(), n);
+  port_->write(tx_.data(), n);
+  port_->flush();
   return true;
 }
 
-bool sendCmdRawMultiFrame(const uint8_t* frame, size_t len,
-                          uint8_t* resp, size_t& rlen,
-                          uint32_t tout_ms) {
-  if (!gUhf || !frame || !resp || rlen < 7) return false;
+uint8_t UhfReader::pollInventory(RawTagData* out, uint8_t maxItems) {
+  if (!port_ || !out || maxItems==0) return 0;
+  const uint32_t a0 = uhfAllocCount();
+  _initRawTagData(out, maxItems);
+  rx_.pump(*port_);
+  uint8_t found=0;
+  UhfFrame f;
+  while (found<maxItems && rx_.next(f)) {
+    if (f.cmd()==CMD_INVENTORY && f.pl()>0) {
+      found += _parseInventoryPayload(f.payload(), f.pl(), out+found, maxItems-found);
+    }
+  }
+  noteInventoryRound(uhfAllocCount() - a0);
+  noteTagReads(found, false);
+  return found;
+}
 
-  // first frame via existing sendCmdRaw (from the sketch)
-  size_t first_len = rlen;
-  if (!sendCmdRaw(frame, len, resp, first_len, tout_ms)) return false;
-  size_t total = first_len;
+uint8_t UhfReader::inventoryRound(RawTagData* out, uint8_t maxItems) {
+  if (!out || maxItems == 0) return 0;
+  _initRawTagData(out, maxItems);
 
-  // subsequent frames until timeout
-  uint32_t t0 = millis();
-  while (millis() - t0 < tout_ms && total + 7 < rlen) {
-    size_t slot = rlen - total;
-    if (!readOneFrame(gUhf, resp + total, slot, 40)) break;
-    total += slot;
+  UHF_LOGD(RSSI, INV_START);
+
+  // First try 0x22 (reply frames are parsed in place in the RX ring)
+  UhfFrame f;
+  if (!transact(UhfInventoryFrame::bytes, UhfInventoryFrame::SIZE, f, 200)) return 0;
+
+  // If error 0x17, fallback to 0x27 with multi-frame read
+  bool used_multi = false;
+  if (f.isError() && f.errorCode() == 0x17) {
+    UHF_LOGD(RSSI, INV_FALLBACK);
+    if (!transact(UhfMultiPollOnceFrame::bytes, UhfMultiPollOnceFrame::SIZE, f, 200)) return 0;
+    used_multi = true;
   }
 
-  rlen = total;
-  return total > 0;
+  // Parse this frame and the ones following it: up to 200 ms / 40 ms gaps for
+  // multi-poll, only what has already arrived for a single poll
+  uint8_t total_found = 0;
+  const uint32_t t0 = millis();
+  const uint32_t gap_ms = used_multi ? 40 : 0;
+  do {
+    uint8_t cmd = f.cmd();
+    if (cmd != CMD_ERROR && (cmd == CMD_INVENTORY || cmd == CMD_MULTI_POLL || used_multi)) {
+      if (f.pl() > 0) {
+        total_found += _parseInventoryPayload(f.payload(), f.pl(), out + total_found, maxItems - total_found);
+      }
+    }
+  } while (total_found < maxItems && (!used_multi || millis() - t0 < 200) && nextFrame(f, gap_ms));
+
+  UHF_LOGD(RSSI, INV_DONE, total_found);
+  return total_found;
+}
+
+uint8_t UhfReader::inventory(RawTagData* out, uint8_t maxItems) {
+  const uint32_t a0 = uhfAllocCount();
+  uint8_t n = inventoryRound(out, maxItems);
+  noteInventoryRound(uhfAllocCount() - a0);
+  noteTagReads(n, true);
+  return n;
 }
 
-// API
-void uhfAttachSerial(HardwareSerial* port) { gUhf = port; }
+bool UhfReader::beginInventory(uint32_t tout_ms) {
+  round_open_ = send(UhfInventoryFrame::bytes, UhfInventoryFrame::SIZE, tout_ms);
+  round_replied_ = false;
+  return round_open_;
+}
 
-void uhfStopMultiInventory() {
-  static const uint8_t stop[] = {0xBB,0x00,0x28,0x00,0x00,0x28,0x7E};
-  if (!gUhf) return;
-  clearRx(20);
-  gUhf->write(stop, sizeof(stop));
-  gUhf->flush();
-  delay(60);
-  clearRx(30);
+// A 0x22 round has no end marker: tag frames follow one another a slot
+// apart, so the round is over once the line stays quiet for gap_ms
+uint8_t UhfReader::pollRound(RawTagData* out, uint8_t maxItems, uint32_t gap_ms, bool& done) {
+  done = true;
+  if (!port_ || !out || maxItems == 0 || !round_open_) return 0;
+  const uint32_t a0 = uhfAllocCount();
+  _initRawTagData(out, maxItems);
+  rx_.pump(*port_);
+  const uint32_t now = micros();
+  uint8_t found = 0;
+  UhfFrame f;
+  while (round_open_ && found < maxItems && rx_.next(f)) {
+    if (f.isError()) {                 // 0x15: no tag answered
+      last_error_ = f.errorCode();
+      noteError(sent_timing_, last_error_);
+      round_open_ = false;
+    } else if (f.cmd() == CMD_INVENTORY) {
+      if (!round_replied_ && sent_timing_) sent_timing_->reply.add(now - sent_us_);
+      round_replied_ = true;
+      round_last_us_ = now;
+      if (f.pl() > 0) found += _parseInventoryPayload(f.payload(), f.pl(), out + found, maxItems - found);
+    }
+  }
+  if (round_open_ && round_replied_ && now - round_last_us_ >= gap_ms * 1000) {
+    round_open_ = false;
+  } else if (round_open_ && !round_replied_ && now - sent_us_ >= sent_tout_us_) {
+    if (sent_timing_) { sent_timing_->timeouts++; sent_timing_->reply.add(sent_tout_us_); }
+    round_open_ = false;
+  }
+  done = !round_open_;
+  noteInventoryRound(uhfAllocCount() - a0);
+  noteTagReads(found, done);
+  return found;
 }
 
-bool uhfSelectEpc(const uint8_t* epc, size_t epc_len) {
+bool UhfReader::selectEpc(const uint8_t* epc, size_t epc_len) {
   if (!epc || epc_len==0) return false;
   size_t clip = epc_len>31 ? 31 : epc_len;   // max 31 bytes
-  uint8_t f[96]; size_t i=0;
-  f[i++]=0xBB; f[i++]=0x00; f[i++]=0x0C;            // SELECT
-  const uint16_t pl = 11 + clip;
-  f[i++]=pl>>8; f[i++]=pl&0xFF;
-  f[i++]=0x01;                 // target S0
-  f[i++]=0x00;                 // action
-  f[i++]=0x01;                 // bank EPC
-  f[i++]=0x00; f[i++]=0x00; f[i++]=0x00; f[i++]=0x20; // pointer=0x20 bits
-  f[i++]=uint8_t(clip*8);      // length in bits
-  f[i++]=0x00;                 // truncate=No
-  memcpy(&f[i], epc, clip); i+=clip;
-  f[i++]=cs8_local(&f[1], i-1); f[i++]=0x7E;
-  uint8_t resp[64]; size_t r=sizeof(resp);
-  bool ok = sendCmdRaw(f, i, resp, r, 300);
-  return ok && r>=6 && resp[2]==0x0C;
-}
-
-bool uhfSelectTid64(const uint8_t tid[8]) {
+  // SelParam: target S0, action 0, bank EPC; EPC starts after CRC+PC (0x20 bits)
+  const size_t n = uhfFrameSelect(tx_, 0x01, 0x20, epc, uint8_t(clip));
+  UhfFrame r;
+  return transact(tx_.data(), n, r, 300) && uhfReplyOk(r, 0x0C);
+}
+
+bool UhfReader::selectTid64(const uint8_t tid[8]) {
   if (!tid) return false;
-  uint8_t f[40]; size_t i=0;
-  f[i++]=0xBB; f[i++]=0x00; f[i++]=0x0C;
-  f[i++]=0x00; f[i++]=0x13; // PL=19
-  f[i++]=0x01; f[i++]=0x00; f[i++]=0x02; // target, action, bank=TID
-  f[i++]=0x00; f[i++]=0x00; f[i++]=0x00; f[i++]=0x00; // pointer=0
-  f[i++]=0x40; // 64 bits
-  f[i++]=0x00; // truncate
-  memcpy(&f[i], tid, 8); i+=8;
-  f[i++]=cs8_local(&f[1], i-1); f[i++]=0x7E;
-  uint8_t resp[64]; size_t r=sizeof(resp);
-  bool ok = sendCmdRaw(f, i, resp, r, 300);
-  return ok && r>=6 && resp[2]==0x0C;
+  // SelParam: target S0, action 0, bank TID; 64 bits from bit 0
+  const size_t n = uhfFrameSelect(tx_, 0x02, 0, tid, 8);
+  UhfFrame r;
+  return transact(tx_.data(), n, r, 300) && uhfReplyOk(r, 0x0C);
 }
 
-int uhfRead(uint8_t bank, uint16_t word_ptr, uint8_t* data,
-            size_t max_len, uint8_t word_count, uint32_t pwd) {
+int UhfReader::read(uint8_t bank, uint16_t word_ptr, uint8_t* data,
+                    size_t max_len, uint8_t word_count, uint32_t pwd) {
   if (!data || max_len==0) return -1;
-  uint8_t f[32]; size_t i=0;
-  f[i++]=0xBB; f[i++]=0x00; f[i++]=0x39;
-  f[i++]=0x00; f[i++]=0x09; // PL=9
-  f[i++]=uint8_t(pwd>>24); f[i++]=uint8_t(pwd>>16);
-  f[i++]=uint8_t(pwd>>8);  f[i++]=uint8_t(pwd);
-  f[i++]=bank;
-  f[i++]=uint8_t(word_ptr>>8); f[i++]=uint8_t(word_ptr);
-  f[i++]=word_count;
-  f[i++]=cs8_local(&f[1], i-1); f[i++]=0x7E;
-  uint8_t resp[128]; size_t r=sizeof(resp);
-  if (!sendCmdRaw(f, i, resp, r, 500)) return -1;
-  if (resp[2]==0x39 && r>7) {
-    uint16_t pl=(resp[3]<<8)|resp[4];
-    size_t n = min((size_t)pl, max_len);
-    n = min(n, r-7);
-    memcpy(data, &resp[5], n);
-    return (int)n;
-  }
-  if (resp[2]==0xFF && r>5) return -1;
-  return -1;
+  const size_t len = uhfFrameRead(tx_, pwd, bank, word_ptr, word_count);
+  UhfFrame r;
+  UhfReadReply rd;
+  if (!transact(tx_.data(), len, r, 500) || !uhfDecodeRead(r, word_count, rd)) return -1;
+  size_t n = min((size_t)rd.len, max_len);
+  memcpy(data, rd.data, n);
+  return (int)n;
 }
 
-bool uhfWrite(uint8_t bank, uint16_t word_ptr, const uint8_t* data,
-              size_t data_len, uint32_t pwd) {
+bool UhfReader::write(uint8_t bank, uint16_t word_ptr, const uint8_t* data,
+                      size_t data_len, uint32_t pwd) {
   if (!data || data_len==0 || data_len>62) return false;
-  uint8_t f[128]; size_t i=0;
-  f[i++]=0xBB; f[i++]=0x00; f[i++]=0x49;
-  uint16_t pl = 4+1+2+1 + data_len;
-  f[i++]=pl>>8; f[i++]=pl&0xFF;
-  f[i++]=uint8_t(pwd>>24); f[i++]=uint8_t(pwd>>16);
-  f[i++]=uint8_t(pwd>>8);  f[i++]=uint8_t(pwd);
-  f[i++]=bank;
-  f[i++]=uint8_t(word_ptr>>8); f[i++]=uint8_t(word_ptr);
-  f[i++]=uint8_t(data_len/2);
-  memcpy(&f[i], data, data_len); i+=data_len;
-  f[i++]=cs8_local(&f[1], i-1); f[i++]=0x7E;
-  uint8_t resp[64]; size_t r=sizeof(resp);
-  if (!sendCmdRaw(f, i, resp, r, 1000)) return false;
-  return resp[2]==0x49;
-}
-
-bool uhfWritePcWord(uint16_t pc, uint32_t pwd) {
-  uint8_t f[32]; size_t i=0;
-  f[i++]=0xBB; f[i++]=0x00; f[i++]=0x49;
-  f[i++]=0x00; f[i++]=0x0B; // PL=11
-  f[i++]=uint8_t(pwd>>24); f[i++]=uint8_t(pwd>>16);
-  f[i++]=uint8_t(pwd>>8);  f[i++]=uint8_t(pwd);
-  f[i++]=0x01; // EPC
-  f[i++]=0x00; f[i++]=0x01; // word 1
-  f[i++]=0x00; f[i++]=0x01; // 1 word
-  f[i++]=uint8_t(pc>>8); f[i++]=uint8_t(pc);
-  f[i++]=cs8_local(&f[1], i-1); f[i++]=0x7E;
-  uint8_t resp[64]; size_t r=sizeof(resp);
-  if (!sendCmdRaw(f, i, resp, r, 500)) return false;
-  return resp[2]==0x49;
+  const size_t n = uhfFrameWrite(tx_, pwd, bank, word_ptr, data, data_len, uint16_t(data_len/2));
+  UhfFrame r;
+  return transact(tx_.data(), n, r, 1000) && uhfReplyOk(r, 0x49);
 }
 
-bool uhfReadEpcViaPc(uint8_t* epc_buf, size_t& epc_len, uint16_t& out_pc, uint32_t pwd) {
+bool UhfReader::writePcWord(uint16_t pc, uint32_t pwd) {
+  const uint8_t pcb[2] = { uint8_t(pc>>8), uint8_t(pc) };
+  const size_t n = uhfFrameWrite(tx_, pwd, 0x01, 1, pcb, 2, 1);   // EPC bank, word 1
+  UhfFrame r;
+  return transact(tx_.data(), n, r, 500) && uhfReplyOk(r, 0x49);
+}
+
+bool UhfReader::readEpcViaPc(uint8_t* epc_buf, size_t& epc_len, uint16_t& out_pc, uint32_t pwd) {
   epc_len=0; out_pc=0;
   uint8_t pc_bytes[2]={0};
-  int n = uhfRead(0x01, 1, pc_bytes, sizeof(pc_bytes), 1, pwd);
+  int n = read(0x01, 1, pc_bytes, sizeof(pc_bytes), 1, pwd);
   if (n<2) return false;
   out_pc = (uint16_t(pc_bytes[0])<<8) | pc_bytes[1];
   uint8_t words = (out_pc>>11)&0x1F;
   if (words==0 || words>31) return false;
   size_t need = size_t(words)*2; if (need>62) need=62;
-  n = uhfRead(0x01, 2, epc_buf, need, words, pwd);
+  n = read(0x01, 2, epc_buf, need, words, pwd);
   if (n<=0) return false;
   epc_len = size_t(n);
   return true;
 }
 
-bool uhfWritePcAndEpc(uint16_t new_pc, const uint8_t* epc, uint8_t words, uint32_t pwd) {
+bool UhfReader::writePcAndEpc(uint16_t new_pc, const uint8_t* epc, uint8_t words, uint32_t pwd) {
   // 1) Écrire PC
-  if (!uhfWritePcWord(new_pc, pwd)) return false;
+  if (!writePcWord(new_pc, pwd)) return false;
   // 2) Écrire EPC (à partir de word 2)
   const size_t bytes = size_t(words)*2;
-  return uhfWrite(0x01, 2, epc, bytes, pwd);
-}
\ No newline at end of file
+  return write(0x01, 2, epc, bytes, pwd);
+}
+
+// ---------- Current reader ----------
+// Per task: the pipeline's parse task and a scheduler task each talk to
+// their own module without passing a reader through every call
+
+static UhfReader gDefaultReader;
+static thread_local UhfReader* gCurrent = nullptr;
+
+UhfReader& uhfDefaultReader() { return gDefaultReader; }
+UhfReader& uhfReader() { return gCurrent ? *gCurrent : gDefaultReader; }
+void uhfUseReader(UhfReader* reader) { gCurrent = reader; }
+
+// ---------- Free API (current reader) ----------
+
+#if defined(ARDUINO)
+void uhfAttachSerial(HardwareSerial* port) { uhfReader().attachSerial(port); }
+#endif
+
+void uhfAttachTransport(UhfTransport* transport) { uhfReader().attach(transport); }
+UhfTransport* uhfAttachedTransport() { return uhfReader().transport(); }
+
+UhfFrameWriter& uhfTxFrame() { return uhfReader().txFrame(); }
+
+bool uhfNextFrame(UhfFrame& out, uint32_t tout_ms) { return uhfReader().nextFrame(out, tout_ms); }
+
+bool uhfTransact(const uint8_t* frame, size_t len, UhfFrame& resp, uint32_t tout_ms) {
+  return uhfReader().transact(frame, len, resp, tout_ms);
+}
+
+const UhfDecoderStats& uhfRxStats() { return uhfReader().rxStats(); }
+uint8_t uhfLastErrorCode() { return uhfReader().lastErrorCode(); }
+
+uint32_t uhfCommandTimeout(uint8_t cmd, uint32_t ceiling_ms) {
+  return uhfReader().commandTimeout(cmd, ceiling_ms);
+}
+const UhfCmdTiming* uhfCommandTiming(uint8_t cmd) { return uhfReader().commandTiming(cmd); }
+void uhfSetAdaptiveTimeouts(bool on) { uhfReader().setAdaptiveTimeouts(on); }
+void uhfResetCommandTiming() { uhfReader().resetCommandTiming(); }
+void uhfNoteRetry(uint8_t cmd) { uhfReader().noteRetry(cmd); }
+void uhfNoteTagReads(uint8_t n, bool single_poll) { uhfReader().noteTagReads(n, single_poll); }
+const UhfLinkStats& uhfLinkStats() { return uhfReader().linkStats(); }
+void uhfPrintLinkStats() { uhfReader().printLinkStats(); }
+void uhfResetLinkStats() { uhfReader().resetLinkStats(); }
+
+bool uhfStopMultiInventory() { return uhfReader().stopMultiInventory(); }
+bool uhfStartMultiPoll(uint16_t rounds) { return uhfReader().startMultiPoll(rounds); }
+uint8_t uhfPollInventory(RawTagData* out, uint8_t maxItems) {
+  return uhfReader().pollInventory(out, maxItems);
+}
+
+bool uhfSelectEpc(const uint8_t* epc, size_t epc_len) { return uhfReader().selectEpc(epc, epc_len); }
+bool uhfSelectTid64(const uint8_t tid[8]) { return uhfReader().selectTid64(tid); }
+
+int uhfRead(uint8_t bank, uint16_t word_ptr, uint8_t* data,
+            size_t max_len, uint8_t word_count, uint32_t pwd) {
+  return uhfReader().read(bank, word_ptr, data, max_len, word_count, pwd);
+}
+
+bool uhfWrite(uint8_t bank, uint16_t word_ptr, const uint8_t* data,
+              size_t data_len, uint32_t pwd) {
+  return uhfReader().write(bank, word_ptr, data, data_len, pwd);
+}
+
+bool uhfWritePcWord(uint16_t pc, uint32_t pwd) { return uhfReader().writePcWord(pc, pwd); }
+
+bool uhfReadEpcViaPc(uint8_t* epc_buf, size_t& epc_len, uint16_t& out_pc, uint32_t pwd) {
+  return uhfReader().readEpcViaPc(epc_buf, epc_len, out_pc, pwd);
+}
+
+bool uhfWritePcAndEpc(uint16_t new_pc, const uint8_t* epc, uint8_t words, uint32_t pwd) {
+  return uhfReader().writePcAndEpc(new_pc, epc, words, pwd);
+}
+
+// === Envoi/recv bruts (une trame de réponse, copiée dans resp) ===
+bool sendCmdRaw(const uint8_t* frame, size_t len, uint8_t* resp, size_t& rlen, uint32_t tout_ms) {
+  UhfFrame f;
+  if (!resp || !uhfTransact(frame, len, f, tout_ms)) { rlen = 0; return false; }
+  if (f.len > rlen) {
+    UHF_LOGW(LINK, LENGTH_MISMATCH, f.len, rlen);
+    rlen = 0;
+    return false;
+  }
+  memcpy(resp, f.data, f.len);
+  rlen = f.len;
+  return true;
+}
+
+bool sendCmdRawMultiFrame(const uint8_t* frame, size_t len,
+                          uint8_t* resp, size_t& rlen,
+                          uint32_t tout_ms) {
+  if (!uhfAttachedTransport() || !frame || !resp || rlen < 7) return false;
+
+  size_t total = rlen;
+  if (!sendCmdRaw(frame, len, resp, total, tout_ms)) return false;
+
+  // subsequent frames until timeout (40 ms max between frames)
+  uint32_t t0 = millis();
+  UhfFrame f;
+  while (millis() - t0 < tout_ms && total + 7 < rlen) {
+    if (!uhfNextFrame(f, 40)) break;
+    if (f.len > rlen - total) break;
+    memcpy(resp + total, f.data, f.len);
+    total += f.len;
+  }
+
+  rlen = total;
+  return total > 0;
+}
+
+// ---------- Heap allocation accounting ----------
+#if defined(ARDUINO) && defined(CONFIG_HEAP_USE_HOOKS)
+// Exact: IDF calls this hook on every successful allocation
+static volatile uint32_t gHeapAllocs = 0;
+extern "C" void esp_heap_trace_alloc_hook(void*, size_t, uint32_t) { gHeapAllocs++; }
+uint32_t uhfAllocCount() { return gHeapAllocs; }
+#elif defined(ARDUINO)
+// Without heap hooks: live block count, catches whatever a round keeps
+uint32_t uhfAllocCount() {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  return uint32_t(info.allocated_blocks);
+}
+#else
+uint32_t uhfAllocCount() { return hostAllocCount(); }
+#endif
+
+void UhfReader::noteInventoryRound(uint32_t allocs) {
+  if (int32_t(allocs) < 0) allocs = 0;   // blocks freed during the round
+  alloc_.rounds++;
+  alloc_.allocs += allocs;
+  if (allocs) alloc_.rounds_with_alloc++;
+}
+
+const UhfAllocStats& uhfInventoryAllocStats() { return uhfReader().allocStats(); }
+void uhfResetInventoryAllocStats() { uhfReader().resetAllocStats(); }
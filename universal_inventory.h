@@ -1,5 +1,11 @@
 #pragma once
 #include <Arduino.h>
+#include "uhf_transport.h"
+#include "uhf_frame_decoder.h"
+#include "uhf_latency.h"
+#include "uhf_frames.h"
+#include "uhf_rssi.h"
+#include "uhf_log.h"
 
 /*
   ---------------------------------------------------------
@@ -7,17 +13,34 @@
   - Sliding-window parser (multi-tag)
   - EPC dynamic (96..496 bits) with safe bounds
   - Multi-frame handling for CMD 0x27 (no re-send spam)
-  - Optional debug via DEBUG_RSSI
-  - Heap-friendly (string reserve)
+  - Debug traces through uhf_log.h (RSSI, FRAMES at
+    UHF_LOG_DEBUG), deferred to idle time
+  - Allocation-free: EPC kept as bytes + length, hex only
+    produced into caller buffers for display/logging
+  - One UhfReader per module; the uhf* functions use the
+    calling task's current reader (default: Serial2)
   ---------------------------------------------------------
 */
 
 // -------- UHF RAW API (propre/modulaire) --------
+#if defined(ARDUINO)
 // Attache le port série UHF (ex: &Serial2)
 void uhfAttachSerial(HardwareSerial* port);
+#endif
+
+// Attache un transport quelconque (émulateur host, trace, ...)
+void uhfAttachTransport(UhfTransport* transport);
+
+// Transport actuellement attaché (nullptr si aucun)
+UhfTransport* uhfAttachedTransport();
 
-// Stoppe l'inventory multi (commande 0x28)
-void uhfStopMultiInventory();
+// Stoppe l'inventory multi (commande 0x28) ; rend la main dès la réponse
+// du module (true), false si elle n'est pas arrivée
+bool uhfStopMultiInventory();
+
+// Lance un multi-poll 0x27 de `rounds` tours : le module diffuse ensuite les
+// trames tag (0x22) sans nouvelle requête, jusqu'à la fin des tours ou 0x28
+bool uhfStartMultiPoll(uint16_t rounds);
 
 // SELECT générique sur EPC (supporte 6..31 words)
 bool uhfSelectEpc(const uint8_t* epc, size_t epc_len_bytes);
@@ -43,8 +66,6 @@ bool uhfReadEpcViaPc(uint8_t* epc_buf, size_t& epc_len_bytes,
 bool uhfWritePcAndEpc(uint16_t new_pc, const uint8_t* epc,
                       uint8_t epc_words, uint32_t access_pwd=0);
 
-// #define DEBUG_RSSI  // opt-in
-
 // Protocol constants
 static constexpr uint8_t CMD_INVENTORY   = 0x22;
 static constexpr uint8_t CMD_MULTI_POLL  = 0x27;
@@ -52,81 +73,372 @@ static constexpr uint8_t FRAME_HEADER    = 0xBB;
 static constexpr uint8_t FRAME_TRAILER   = 0x7E;
 static constexpr uint8_t CMD_ERROR       = 0xFF;
 
-// Forward declaration - implemented in .ino (for inventory only)
-extern bool sendCmdRaw(const uint8_t* frame, size_t len,
-                       uint8_t* resp, size_t& rlen,
-                       uint32_t tout_ms);
+// Send one frame and receive one validated response frame.
+// Implemented in universal_inventory.cpp (current reader, see UhfReader)
+bool sendCmdRaw(const uint8_t* frame, size_t len,
+                uint8_t* resp, size_t& rlen,
+                uint32_t tout_ms);
 
 // ---------- Data model ----------
+static constexpr size_t EPC_MAX_BYTES = 62;                  // 31 words
+static constexpr size_t EPC_HEX_SIZE  = EPC_MAX_BYTES * 2 + 1;  // hex + NUL
+
 struct RawTagData {
-  uint8_t epc_raw[62];    // up to 31 words * 2 bytes
+  uint8_t epc_raw[EPC_MAX_BYTES];  // up to 31 words * 2 bytes
   uint8_t epc_len;        // parsed bytes copied in epc_raw
   uint8_t epc_len_total;  // bytes implied by PC word (may be > epc_len)
-  String  epc;            // uppercase hex (reserved to avoid fragmentation)
-  int8_t  rssi_dbm;       // approx dBm
+  int8_t  rssi_dbm;       // approx dBm (active RSSI profile)
+  uint8_t rssi_raw;       // byte it came from, 0 if none found
   uint8_t antenna;        // 0 if not present
   uint8_t phase;          // 0 if not present
 };
 
 // ---------- Helpers ----------
-static inline uint8_t _cs8(const uint8_t* p, size_t n) {
-  uint32_t s = 0; for (size_t i=0;i<n;i++) s += p[i]; return uint8_t(s & 0xFF);
-}
-static inline String _toHex(const uint8_t* b, size_t n) {
-  String s; s.reserve(n*2);
+// Uppercase hex into a caller buffer (NUL-terminated, truncated to fit).
+// Returns the number of hex chars written.
+static inline size_t _toHex(const uint8_t* b, size_t n, char* out, size_t cap) {
   static const char* H="0123456789ABCDEF";
-  for (size_t i=0;i<n;i++){ s += H[b[i]>>4]; s += H[b[i]&0xF]; }
-  return s;
+  if (!out || cap == 0) return 0;
+  if (n > (cap - 1) / 2) n = (cap - 1) / 2;
+  for (size_t i=0;i<n;i++){ out[2*i] = H[b[i]>>4]; out[2*i+1] = H[b[i]&0xF]; }
+  out[2*n] = '\0';
+  return 2*n;
 }
 static constexpr inline bool _looks_like_rssi(uint8_t b) {
   return b != 0x00 && b != 0xFF; // avoid padding bytes
 }
 
-// ---------- RSSI mapping ----------
-enum RssiProfile { RSSI_LINEAR, RSSI_CURVED, RSSI_CUSTOM };
+// Non bloquant : décode les notifications déjà reçues d'un multi-poll
+uint8_t uhfPollInventory(RawTagData* out, uint8_t maxItems);
+
+// ---------- Frame IO (multi-frame support) ----------
+// Implemented in universal_inventory.cpp (current reader, see UhfReader)
+
+// Reader TX buffer for variable frames (uhf_frames.h builders). Whoever owns
+// the UART owns it: build, then hand data()/size() to uhfTransact.
+UhfFrameWriter& uhfTxFrame();
+
+// Send one frame, wait for its reply (same CMD, or 0xFF error) and return it
+// as a view into the RX ring (valid until the next frame IO call).
+bool uhfTransact(const uint8_t* frame, size_t len, UhfFrame& resp, uint32_t tout_ms);
+
+// Next validated frame from the module, waiting up to tout_ms (0 = poll once)
+bool uhfNextFrame(UhfFrame& out, uint32_t tout_ms);
+
+// Decoder counters (checksum/trailer errors, resync bytes, overflows)
+const UhfDecoderStats& uhfRxStats();
+
+// Module error code (0xFF reply) of the last uhfTransact-based command:
+// 0 when it succeeded or got no reply at all
+uint8_t uhfLastErrorCode();
+
+// ---------- Response-driven timing ----------
+// A command returns as soon as its reply frame is decoded; nothing sleeps.
+// The timeout a caller passes is a ceiling: once UHF_TIMEOUT_WARMUP replies
+// to an opcode have been seen, its timeout becomes p99 x
+// UHF_TIMEOUT_MARGIN_PCT %, clamped to [UHF_TIMEOUT_FLOOR_MS, ceiling].
+// A timeout is recorded as a sample at the timeout value, so an opcode
+// that keeps timing out climbs back to its ceiling.
+#ifndef UHF_TIMEOUT_MARGIN_PCT
+#define UHF_TIMEOUT_MARGIN_PCT 300
+#endif
+#ifndef UHF_TIMEOUT_FLOOR_MS
+#define UHF_TIMEOUT_FLOOR_MS 20
+#endif
+#ifndef UHF_TIMEOUT_WARMUP
+#define UHF_TIMEOUT_WARMUP 16
+#endif
+
+// ---------- Link health ----------
+// Per opcode: latency to the first byte and to the complete reply, reply
+// errors by code, retries. Fixed memory (one slot per opcode seen), a few
+// additions per command: stays on in production builds.
+
+// 0xFF codes counted one by one (as mapped by parseWriteError), the rest
+// fall into the last counter
+static constexpr uint8_t UHF_TRACKED_ERRORS[] = { 0x09, 0x16, 0xA3, 0xA4, 0xB3 };
+static constexpr uint8_t UHF_TRACKED_ERROR_COUNT = sizeof(UHF_TRACKED_ERRORS);
+
+struct UhfCmdTiming {
+  uint8_t             cmd;
+  uint32_t            sent;
+  UhfLatencyHistogram first_byte; // TX flushed -> first byte back
+  UhfLatencyHistogram reply;      // TX flushed -> reply frame (successful replies)
+  uint32_t            timeouts;
+  uint32_t            corrupted;  // reply failed its checksum or trailer
+  uint32_t            errors;     // 0xFF replies
+  uint32_t            error_code[UHF_TRACKED_ERROR_COUNT + 1];  // UHF_TRACKED_ERRORS, then others
+  uint32_t            retries;    // reported by callers (uhfNoteRetry)
+};
+
+struct UhfLinkStats {
+  uint32_t since_ms;              // last reset
+  uint32_t inventory_rounds;      // 0x22 single-poll rounds
+  uint32_t stream_starts;         // 0x27 multi-poll streams started
+  uint32_t tag_reads;             // tags decoded, rounds and streams
+};
+
+uint32_t            uhfCommandTimeout(uint8_t cmd, uint32_t ceiling_ms);
+const UhfCmdTiming* uhfCommandTiming(uint8_t cmd);    // nullptr if never sent
+void                uhfSetAdaptiveTimeouts(bool on);  // default on
+void                uhfResetCommandTiming();          // timeouts are learned again
+
+// A command of this opcode is sent again after a failure
+void                uhfNoteRetry(uint8_t cmd);
+void                uhfNoteTagReads(uint8_t n, bool single_poll);
+const UhfLinkStats& uhfLinkStats();
+
+// Dump everything on Serial ("UHF ..." lines) / clear everything: command
+// timings, link counters and decoder counters. A snapshot: while continuous
+// mode runs, the parse task keeps updating it.
+void                uhfPrintLinkStats();
+void                uhfResetLinkStats();
+
+// ---------- Heap allocation accounting ----------
+// The inventory path must not touch the heap (long continuous sessions would
+// fragment it). Every inventory round records how many allocations it made,
+// in the reader that ran it (UhfReader::allocStats). The platform counter is
+// heap-wide: with readers on several tasks, a round may also count another
+// task's allocations, so the figures are an upper bound.
+struct UhfAllocStats {
+  uint32_t rounds;          // inventory rounds observed
+  uint32_t allocs;          // heap allocations made inside them
+  uint32_t rounds_with_alloc;
+};
+uint32_t uhfAllocCount();                 // platform allocation counter
+// The calling task's reader (uhfReader)
+const UhfAllocStats& uhfInventoryAllocStats();
+void     uhfResetInventoryAllocStats();
+
+// A 0x22 round has no end marker: it is over once the line stays quiet this
+// long after the last tag frame (UhfReader::pollRound)
+#ifndef UHF_ROUND_GAP_MS
+#define UHF_ROUND_GAP_MS 8
+#endif
 
-static inline int8_t _rssibyte_to_dbm(uint8_t v, RssiProfile profile = RSSI_CURVED) {
-#ifdef DEBUG_RSSI
-  Serial.printf("🔬 RSSI raw=0x%02X (%u) ", v, v);
+// ---------- Reader ----------
+// One module on one transport, with everything the protocol keeps about it:
+// TX buffer, RX decoder, learned timeouts, link counters, output power.
+// The uhf* functions act on the calling task's current reader (uhfReader()):
+// the default one, unless the task picked another with uhfUseReader or
+// UhfReaderScope. Several readers run at once from different tasks, or
+// from one task calling their methods in turn (uhf_multi_reader.h); a
+// reader itself is used by one task at a time.
+class UhfReader {
+public:
+  UhfReader();
+
+#if defined(ARDUINO)
+  void attachSerial(HardwareSerial* port);
 #endif
-  int16_t dbm;
-  switch (profile) {
-    case RSSI_LINEAR:
-      dbm = -95 + ((int16_t)v * 85) / 255; break;
-    case RSSI_CURVED:
-      if (v > 200)      dbm = -10 - ((255 - v) * 20) / 55;   // -10..-30
-      else if (v > 100) dbm = -30 - ((200 - v) * 40) / 100;  // -30..-70
-      else              dbm = -70 - ((100 - v) * 25) / 100;  // -70..-95
-      break;
-    case RSSI_CUSTOM:
-      dbm = -50 - ((255 - v) * 45) / 255; break;
+  void          attach(UhfTransport* transport) { port_ = transport; }
+  UhfTransport* transport() const { return port_; }
+
+  // Frame IO: same contracts as uhfTxFrame / uhfTransact / uhfNextFrame
+  UhfFrameWriter& txFrame() { return tx_; }
+  bool    transact(const uint8_t* frame, size_t len, UhfFrame& resp, uint32_t tout_ms) {
+    return transactImpl(frame, len, resp, tout_ms, false);
   }
-  if (dbm > -5)   dbm = -5;
-  if (dbm < -100) dbm = -100;
-#ifdef DEBUG_RSSI
-  Serial.printf("-> %d dBm\n", dbm);
+  bool    nextFrame(UhfFrame& out, uint32_t tout_ms);
+  uint8_t lastErrorCode() const { return last_error_; }
+  const UhfDecoderStats& rxStats() const { return rx_.stats(); }
+
+  // Commands: same contracts as the uhf* functions
+  bool    stopMultiInventory();
+  bool    startMultiPoll(uint16_t rounds);
+  uint8_t pollInventory(RawTagData* out, uint8_t maxItems);
+  uint8_t inventory(RawTagData* out, uint8_t maxItems);    // rawInventoryWithRssi
+  bool    selectEpc(const uint8_t* epc, size_t epc_len);
+  bool    selectTid64(const uint8_t tid[8]);
+  int     read(uint8_t bank, uint16_t word_ptr, uint8_t* data, size_t max_len, uint8_t word_count,
+               uint32_t pwd = 0);
+  bool    write(uint8_t bank, uint16_t word_ptr, const uint8_t* data, size_t data_len, uint32_t pwd = 0);
+  bool    writePcWord(uint16_t pc, uint32_t pwd = 0);
+  bool    readEpcViaPc(uint8_t* epc_buf, size_t& epc_len, uint16_t& out_pc, uint32_t pwd = 0);
+  bool    writePcAndEpc(uint16_t new_pc, const uint8_t* epc, uint8_t words, uint32_t pwd = 0);
+
+  // Any command without blocking: request sends it, pollReply takes what
+  // arrived since. 1: the reply (or a 0xFF error) is in resp; 0: not yet;
+  // -1: timed out or corrupted. Same bookkeeping as transact.
+  bool    request(const uint8_t* frame, size_t len, uint32_t tout_ms) { return send(frame, len, tout_ms); }
+  int8_t  pollReply(UhfFrame& resp, bool streaming = false) { return checkReply(resp, streaming); }
+
+  // One 0x22 round without blocking, so one task can keep several modules
+  // inventorying at once: beginInventory sends the request, pollRound takes
+  // the tag frames already here and sets done once the round is over (no
+  // frame for gap_ms after the last one, an error reply, or no reply within
+  // tout_ms). No 0x27 fallback here.
+  bool    beginInventory(uint32_t tout_ms);
+  uint8_t pollRound(RawTagData* out, uint8_t maxItems, uint32_t gap_ms, bool& done);
+
+  // Timing and link health (uhfCommandTimeout, uhfLinkStats, ...)
+  uint32_t            commandTimeout(uint8_t cmd, uint32_t ceiling_ms) const;
+  const UhfCmdTiming* commandTiming(uint8_t cmd) const;
+  void                setAdaptiveTimeouts(bool on) { adaptive_ = on; }
+  bool                adaptiveTimeouts() const { return adaptive_; }
+  void                resetCommandTiming() { timing_used_ = 0; }
+  void                noteRetry(uint8_t cmd);
+  void                noteTagReads(uint8_t n, bool single_poll);
+  const UhfLinkStats& linkStats() const { return link_; }
+  void                printLinkStats();
+  void                resetLinkStats();
+  const UhfAllocStats& allocStats() const { return alloc_; }
+  void                resetAllocStats() { alloc_ = UhfAllocStats{0, 0, 0}; }
+
+  // Output power the module last accepted (uhf_power.h), 0 if unknown
+  uint16_t txPower() const { return tx_power_; }
+  void     noteTxPower(uint16_t dbm100) { tx_power_ = dbm100; }
+
+private:
+  static constexpr uint8_t TIMING_SLOTS = 16;
+
+  bool          transactImpl(const uint8_t* frame, size_t len, UhfFrame& resp, uint32_t ceiling_ms,
+                             bool streaming);
+  // transact in two steps: send (stale frames dropped, clock and learned
+  // timeout started), then checkReply until it is not 0
+  bool          send(const uint8_t* frame, size_t len, uint32_t ceiling_ms);
+  int8_t        checkReply(UhfFrame& resp, bool streaming);
+  uint8_t       inventoryRound(RawTagData* out, uint8_t maxItems);
+  UhfCmdTiming* timingFor(uint8_t cmd);
+  void          noteError(UhfCmdTiming* t, uint8_t code);
+  void          noteInventoryRound(uint32_t allocs);
+
+  UhfTransport*   port_;
+#if defined(ARDUINO)
+  HardwareSerialTransport serial_;
 #endif
-  return (int8_t)dbm;
-}
+  // Variable frames are built in place here (largest: 0x49 with 31 words)
+  uint8_t         tx_buf_[7 + 9 + EPC_MAX_BYTES];
+  UhfFrameWriter  tx_;
+  UhfFrameDecoder rx_;            // every reply goes through it
+  uint8_t         last_error_;    // 0xFF code of the last transact, 0 if none
+  UhfCmdTiming    timing_[TIMING_SLOTS];
+  uint8_t         timing_used_;
+  bool            adaptive_;
+  UhfLinkStats    link_;
+  UhfAllocStats   alloc_;
+  uint16_t        tx_power_;
+  // Last request sent: opcode, timing slot, when it left, its timeout
+  uint8_t         sent_cmd_;
+  UhfCmdTiming*   sent_timing_;
+  uint32_t        sent_us_;
+  uint32_t        sent_tout_us_;
+  bool            sent_got_byte_;
+  // beginInventory -> pollRound
+  bool            round_open_;
+  bool            round_replied_;
+  uint32_t        round_last_us_;
+};
+
+// Reader the calling task's uhf* calls go to
+UhfReader& uhfReader();
+UhfReader& uhfDefaultReader();
+// nullptr: back to the default reader. Only for the calling task.
+void       uhfUseReader(UhfReader* reader);
+
+// Switches the calling task to a reader for a scope, then back
+class UhfReaderScope {
+public:
+  explicit UhfReaderScope(UhfReader& r) : prev_(&uhfReader()) { uhfUseReader(&r); }
+  ~UhfReaderScope() { uhfUseReader(prev_); }
+private:
+  UhfReader* prev_;
+};
 
-// ---------- Frame IO (multi-frame support) ----------
-// Implemented in universal_inventory.cpp (uses the attached HardwareSerial*)
 bool sendCmdRawMultiFrame(const uint8_t* frame, size_t len,
                           uint8_t* resp, size_t& rlen,
                           uint32_t tout_ms = 200);
 
+// ---------- Word-wise scan helpers ----------
+// size_t-wide loads: 4 bytes at a time on the ESP32, 8 on a 64-bit host
+static constexpr size_t _UHF_ONES = ~size_t(0) / 0xFF;   // 0x01 in every byte
+
+static inline size_t _uhfLoadWord(const uint8_t* p) { size_t w; memcpy(&w, p, sizeof(w)); return w; }
+
+// First index in [from, to) holding a nonzero byte, or `to`
+static inline size_t _uhfFirstNonZero(const uint8_t* p, size_t from, size_t to) {
+  while (from + sizeof(size_t) <= to && _uhfLoadWord(p + from) == 0) from += sizeof(size_t);
+  while (from < to && p[from] == 0) from++;
+  return from;
+}
+
+// First index in [from, to) holding a byte >= 0x30, or `to`: only such a byte
+// can be the high byte of a PC announcing 6..31 EPC words. Per byte b of the
+// word, (b & 0x7F) + 0x50 sets bit 7 when b & 0x7F >= 0x30 (no carry out).
+static inline size_t _uhfFirstPcCandidate(const uint8_t* p, size_t from, size_t to) {
+  while (from + sizeof(size_t) <= to) {
+    const size_t w = _uhfLoadWord(p + from);
+    if ((((w & (_UHF_ONES * 0x7F)) + _UHF_ONES * 0x50) | w) & (_UHF_ONES * 0x80)) break;
+    from += sizeof(size_t);
+  }
+  while (from < to && p[from] < 0x30) from++;
+  return from;
+}
+
 // ---------- Payload parser ----------
+// Same reads as the original byte-by-byte window (host/parser_ref.h, checked
+// by host/fuzz_parser and host/bench_parser), in time linear in plen.
+
+// Sliding-window fallback (raw protocol). Bytes that cannot start a PC are
+// skipped a word at a time; `nz`, the first nonzero byte at or after the
+// EPC start, only moves forward, so the all-zero EPC test costs O(1).
+// Kept out of line: its word masks and cursors take enough registers that,
+// inlined, every call paid for them in the prologue, fast path included
+// (0.9x the byte loop on a single M5 tag).
+__attribute__((noinline))
+static uint8_t _parseInventoryWindow(const uint8_t* payload, size_t plen,
+                                     RawTagData* out, uint8_t maxItems)
+{
+  uint8_t found = 0;
+  size_t pos = 0;
+  size_t nz = 0;
+  while (found < maxItems) {
+    pos = _uhfFirstPcCandidate(payload, pos, plen - 2);
+    if (pos + 2 > plen - 1) break;
+    uint8_t  epc_words = payload[pos] >> 3;          // (pc >> 11) & 0x1F, >= 6 here
+    size_t   epc_bytes_total = epc_words * 2;
+    size_t   epc_at = pos + 2;
+
+    if (epc_at + epc_bytes_total <= plen) {
+      if (nz < epc_at) nz = _uhfFirstNonZero(payload, epc_at, plen);
+
+      if (nz < epc_at + epc_bytes_total) {
+        const uint8_t* epc_ptr = &payload[epc_at];
+        size_t to_copy = min(epc_bytes_total, sizeof(out[found].epc_raw));
+        memcpy(out[found].epc_raw, epc_ptr, to_copy);
+        out[found].epc_len       = (uint8_t)to_copy;
+        out[found].epc_len_total = (uint8_t)min<size_t>(epc_bytes_total, sizeof(out[found].epc_raw));
+
+        // Heuristic RSSI around the EPC (prefer valid-looking byte)
+        uint8_t rssi_raw = 0;
+        if (pos > 0 && _looks_like_rssi(payload[pos - 1])) {
+          rssi_raw = payload[pos - 1];
+        } else if (epc_at + epc_bytes_total < plen && _looks_like_rssi(payload[epc_at + epc_bytes_total])) {
+          rssi_raw = payload[epc_at + epc_bytes_total];
+        }
+        const int8_t rssi_dbm = rssi_raw ? _rssibyte_to_dbm(rssi_raw) : int8_t(-70);
+        out[found].rssi_dbm = rssi_dbm;
+        out[found].rssi_raw = rssi_raw;
+        out[found].antenna = 0; out[found].phase = 0;
+
+        UHF_LOGD_BYTES(RSSI, PARSE_RAW, out[found].epc_raw, out[found].epc_len, epc_words * 16, rssi_dbm);
+        found++;
+        pos = epc_at + epc_bytes_total;
+        continue;
+      }
+    }
+    pos++;
+  }
+
+  return found;
+}
+
 static uint8_t _parseInventoryPayload(const uint8_t* payload, size_t plen,
                                       RawTagData* out, uint8_t maxItems)
 {
   if (!payload || !out || maxItems == 0 || plen < 3) return 0;
 
-#ifdef DEBUG_RSSI
-  Serial.printf("🔎 Parse payload plen=%u, cap=%u\n", (unsigned)plen, (unsigned)maxItems);
-#endif
-
-  uint8_t found = 0;
-  size_t pos = 0;
+  UHF_LOGD(RSSI, PARSE_PAYLOAD, plen, maxItems);
 
   // Fast-path: M5Stack style {RSSI | PC | 12 EPC bytes}
   if (plen >= 15) {
@@ -146,135 +458,36 @@ static uint8_t _parseInventoryPayload(const uint8_t* payload, size_t plen,
         memcpy(out[0].epc_raw, epc_ptr, epc_bytes);
         out[0].epc_len       = epc_bytes;
         out[0].epc_len_total = uint8_t(min<size_t>(epc_words * 2, sizeof(out[0].epc_raw)));
-        out[0].epc           = _toHex(epc_ptr, epc_bytes);
         out[0].rssi_dbm      = _rssibyte_to_dbm(rssi_byte);
+        out[0].rssi_raw      = rssi_byte;
         out[0].antenna = 0; out[0].phase = 0;
-#ifdef DEBUG_RSSI
-        Serial.printf("✅ M5 format EPC=%s RSSI=%d dBm\n", out[0].epc.c_str(), out[0].rssi_dbm);
-#endif
+        UHF_LOGD_BYTES(RSSI, PARSE_M5, out[0].epc_raw, out[0].epc_len, out[0].rssi_dbm);
         return 1;
       }
     }
   }
 
-  // Sliding-window fallback (raw protocol)
-  while (pos + 2 <= plen - 1 && found < maxItems) {
-    uint16_t pc = (uint16_t(payload[pos]) << 8) | payload[pos + 1];
-    uint8_t  epc_words = (pc >> 11) & 0x1F;
-
-    if (epc_words >= 6 && epc_words <= 31) {
-      size_t epc_bytes_total = epc_words * 2;
-      if (pos + 2 + epc_bytes_total <= plen) {
-        const uint8_t* epc_ptr = &payload[pos + 2];
-
-        bool all_zero = true;
-        for (size_t i=0;i<epc_bytes_total;i++){ if (epc_ptr[i] != 0){ all_zero=false; break; } }
-
-        if (!all_zero) {
-          size_t to_copy = min(epc_bytes_total, sizeof(out[found].epc_raw));
-          memcpy(out[found].epc_raw, epc_ptr, to_copy);
-          out[found].epc_len       = (uint8_t)to_copy;
-          out[found].epc_len_total = (uint8_t)min<size_t>(epc_bytes_total, sizeof(out[found].epc_raw));
-          out[found].epc           = _toHex(epc_ptr, to_copy);
-
-          // Heuristic RSSI around the EPC (prefer valid-looking byte)
-          int8_t rssi_dbm = -70;
-          if (pos > 0 && _looks_like_rssi(payload[pos - 1])) {
-            rssi_dbm = _rssibyte_to_dbm(payload[pos - 1]);
-          } else if (pos + 2 + epc_bytes_total < plen && _looks_like_rssi(payload[pos + 2 + epc_bytes_total])) {
-            rssi_dbm = _rssibyte_to_dbm(payload[pos + 2 + epc_bytes_total]);
-          }
-          out[found].rssi_dbm = rssi_dbm;
-          out[found].antenna = 0; out[found].phase = 0;
-
-#ifdef DEBUG_RSSI
-          Serial.printf("✅ RAW EPC=%s (%u bits) RSSI=%d dBm\n",
-                        out[found].epc.c_str(), (unsigned)(epc_words*16), rssi_dbm);
-#endif
-          found++;
-          pos += 2 + epc_bytes_total;
-          continue;
-        }
-      }
-    }
-    pos++;
-  }
-
-#ifdef DEBUG_RSSI
-  if (found == 0) Serial.println("❌ No valid tags in this payload");
-#endif
+  const uint8_t found = _parseInventoryWindow(payload, plen, out, maxItems);
+  if (found == 0) UHF_LOGD(RSSI, PARSE_NONE);
   return found;
 }
 
-// ---------- Init to avoid heap fragmentation ----------
+// ---------- Init (plain fields, nothing allocated) ----------
 static void _initRawTagData(RawTagData* out, uint8_t maxItems) {
   if (!out) return;
   for (uint8_t i=0;i<maxItems;i++) {
-    out[i].epc.reserve(124); // 62 bytes * 2 hex chars
     out[i].epc_len = 0;
     out[i].epc_len_total = 0;
     out[i].rssi_dbm = -70;
+    out[i].rssi_raw = 0;
     out[i].antenna = 0;
     out[i].phase = 0;
   }
 }
 
 // ---------- Public inventory API ----------
-static uint8_t rawInventoryWithRssi(RawTagData* out, uint8_t maxItems) {
-  if (!out || maxItems == 0) return 0;
-  _initRawTagData(out, maxItems);
-
-#ifdef DEBUG_RSSI
-  Serial.println("🔍 Inventory START");
-#endif
-
-  // Build request (payload length = 0)
-  uint8_t tx[] = { FRAME_HEADER, 0x00, CMD_INVENTORY, 0x00, 0x00, 0x00, FRAME_TRAILER };
-  tx[5] = _cs8(&tx[1], 4);
-  const size_t tx_len = sizeof(tx);
-
-  // Buffer to receive (can hold several frames)
-  uint8_t rx[512];
-  size_t rlen = sizeof(rx);
-
-  // First try 0x22
-  if (!sendCmdRaw(tx, tx_len, rx, rlen, 200)) return 0;
-
-  // If error 0x17, fallback to 0x27 with multi-frame read
-  bool used_multi = false;
-  if (rlen >= 6 && rx[2] == CMD_ERROR && rx[5] == 0x17) {
-#ifdef DEBUG_RSSI
-    Serial.println("🔄 Fallback to 0x27 (multi-poll)");
-#endif
-    tx[2] = CMD_MULTI_POLL;
-    tx[5] = _cs8(&tx[1], 4);
-    rlen = sizeof(rx);
-    if (!sendCmdRawMultiFrame(tx, tx_len, rx, rlen, 200)) return 0;
-    used_multi = true;
-  }
-
-  // Parse one or multiple frames concatenated in rx
-  uint8_t total_found = 0;
-  size_t off = 0;
-
-  while (off + 7 <= rlen && total_found < maxItems) {
-    if (rx[off] != FRAME_HEADER) { off++; continue; }
-    uint16_t pl = (uint16_t(rx[off+3]) << 8) | rx[off+4];
-    size_t flen = 5 + pl + 2;
-    if (off + flen > rlen) break;
-    if (rx[off + flen - 1] != FRAME_TRAILER) { off++; continue; }
-
-    uint8_t cmd = rx[off+2];
-    if (cmd != CMD_ERROR && (cmd == CMD_INVENTORY || cmd == CMD_MULTI_POLL || used_multi)) {
-      if (pl > 0) {
-        total_found += _parseInventoryPayload(&rx[off+5], pl, out + total_found, maxItems - total_found);
-      }
-    }
-    off += flen;
-  }
-
-#ifdef DEBUG_RSSI
-  Serial.printf("✅ Inventory DONE, found=%u\n", (unsigned)total_found);
-#endif
-  return total_found;
-}
\ No newline at end of file
+// One 0x22 round on the current reader (0x27 fallback if the module refuses
+// single polls); allocation-free, counted in the link stats
+static inline uint8_t rawInventoryWithRssi(RawTagData* out, uint8_t maxItems) {
+  return uhfReader().inventory(out, maxItems);
+}